@@ -0,0 +1,267 @@
+#include "engine/job_system.h"
+#include "vpet/interest_management.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Simulated session on a large location: clients spread over it walk around, each registering a sphere or a
+// camera frustum as its interest region and dragging a prop in front of it. Compares the bytes of broadcasting
+// every edit to every client with the per client batches of the interest plane, and how often nodes enter and
+// leave regions with and without hysteresis.
+
+namespace {
+
+    const float LOCATION_SIZE = 400.0f;
+    const float TICK_RATE = 30.0f;
+    const uint32_t TICK_COUNT = 1800u;
+
+    const float WALK_SPEED = 1.4f;
+    const float TURN_SPEED = 0.3f;
+    const float DRAG_SPEED = 0.5f;
+    // Tracking noise of a handheld tablet
+    const float JITTER = 0.05f;
+
+    struct sSimulatedClient {
+        uint8_t client_id = 0u;
+        sVPETInterest interest;
+        glm::vec2 walk_direction = {};
+        float yaw = 0.0f;
+        uint32_t dragged_editable = 0u;
+    };
+
+    struct sRunResult {
+        uint64_t broadcast_bytes = 0u;
+        uint64_t interest_bytes = 0u;
+        uint64_t interest_objects = 0u;
+        uint64_t transitions = 0u;
+        float average_ms = 0.0f;
+        float max_ms = 0.0f;
+        float average_members = 0.0f;
+    };
+
+    void create_location(sVPETContext& vpet, uint32_t editable_count)
+    {
+        std::mt19937 generator(1234u);
+        std::uniform_real_distribution<float> position_distribution(0.0f, LOCATION_SIZE);
+        std::uniform_real_distribution<float> size_distribution(0.5f, 3.0f);
+
+        for (uint32_t i = 0u; i < editable_count; ++i) {
+            sVPETNode* vpet_node = new sVPETNode();
+            vpet_node->editable = true;
+
+            glm::vec3 position = { position_distribution(generator), 0.0f, position_distribution(generator) };
+            glm::vec3 half_size = glm::vec3(size_distribution(generator)) * 0.5f;
+
+            vpet_node->position = position;
+            vpet_node->world_bounds.min = position - half_size;
+            vpet_node->world_bounds.max = position + half_size;
+
+            vpet.node_list.push_back(vpet_node);
+            vpet.editables_node_list.push_back(vpet_node);
+        }
+    }
+
+    // On a grid over the location, every other client looks through a camera instead of a radius around it
+    std::vector<sSimulatedClient> create_clients(const sVPETContext& vpet, uint32_t client_count)
+    {
+        std::mt19937 generator(5678u);
+        std::uniform_real_distribution<float> angle_distribution(0.0f, glm::radians(360.0f));
+
+        uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(client_count))));
+        uint32_t rows = (client_count + columns - 1u) / columns;
+
+        std::vector<sSimulatedClient> clients(client_count);
+
+        for (uint32_t i = 0u; i < client_count; ++i) {
+            sSimulatedClient& client = clients[i];
+            client.client_id = static_cast<uint8_t>(i + 1u);
+
+            float x = (static_cast<float>(i % columns) + 0.5f) / columns * LOCATION_SIZE;
+            float z = (static_cast<float>(i / columns) + 0.5f) / rows * LOCATION_SIZE;
+
+            client.interest.position = { x, 1.7f, z };
+            client.yaw = angle_distribution(generator);
+
+            float walk_angle = angle_distribution(generator);
+            client.walk_direction = { std::cos(walk_angle), std::sin(walk_angle) };
+
+            if (i % 2u == 0u) {
+                client.interest.shape = eVPETInterestShape::SPHERE;
+                client.interest.radius = 30.0f;
+            }
+            else {
+                client.interest.shape = eVPETInterestShape::FRUSTUM;
+                client.interest.fov = 60.0f;
+                client.interest.aspect = 16.0f / 9.0f;
+                client.interest.near_plane = 0.1f;
+                client.interest.far_plane = 60.0f;
+            }
+
+            // The closest prop is the one it edits
+            float closest_distance = FLT_MAX;
+            for (uint32_t editable_id = 0u; editable_id < vpet.editables_node_list.size(); ++editable_id) {
+                float distance = glm::length(vpet.editables_node_list[editable_id]->position - client.interest.position);
+                if (distance < closest_distance) {
+                    closest_distance = distance;
+                    client.dragged_editable = editable_id;
+                }
+            }
+        }
+
+        return clients;
+    }
+
+    void move_client(sSimulatedClient& client, float delta_time)
+    {
+        glm::vec3& position = client.interest.position;
+        position += glm::vec3(client.walk_direction.x, 0.0f, client.walk_direction.y) * WALK_SPEED * delta_time;
+
+        // Bounce off the borders of the location
+        if (position.x < 0.0f || position.x > LOCATION_SIZE) {
+            client.walk_direction.x = -client.walk_direction.x;
+        }
+        if (position.z < 0.0f || position.z > LOCATION_SIZE) {
+            client.walk_direction.y = -client.walk_direction.y;
+        }
+
+        client.yaw += TURN_SPEED * delta_time;
+        client.interest.rotation = glm::angleAxis(client.yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    void drag_editable(sVPETContext& vpet, const sSimulatedClient& client, float delta_time)
+    {
+        sVPETNode* vpet_node = vpet.editables_node_list[client.dragged_editable];
+
+        glm::vec3 forward = client.interest.rotation * glm::vec3(0.0f, 0.0f, -1.0f);
+        glm::vec3 offset = glm::vec3(forward.x, 0.0f, forward.z) * DRAG_SPEED * delta_time;
+
+        vpet_node->position += offset;
+        vpet_node->world_bounds.min += offset;
+        vpet_node->world_bounds.max += offset;
+    }
+
+    sRunResult run_session(uint32_t client_count, uint32_t editable_count, float hysteresis)
+    {
+        sVPETContext vpet;
+        create_location(vpet, editable_count);
+
+        std::vector<sSimulatedClient> clients = create_clients(vpet, client_count);
+
+        InterestManager interest_manager;
+        interest_manager.set_hysteresis(hysteresis);
+        interest_manager.build(vpet);
+
+        std::vector<sVPETInterestBatch> batches;
+        std::vector<uint8_t> message;
+        std::mt19937 generator(91011u);
+        std::uniform_real_distribution<float> jitter_distribution(-JITTER, JITTER);
+        uint8_t interest_message[INTEREST_FRUSTUM_MESSAGE_SIZE];
+
+        sRunResult result;
+        float total_ms = 0.0f;
+        uint64_t member_samples = 0u;
+
+        float delta_time = 1.0f / TICK_RATE;
+
+        for (uint32_t tick = 0u; tick < TICK_COUNT; ++tick) {
+            uint64_t now_us = static_cast<uint64_t>(tick * delta_time * 1e6f);
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            // Regions go through the wire format as the clients would send them
+            for (sSimulatedClient& client : clients) {
+                move_client(client, delta_time);
+                drag_editable(vpet, client, delta_time);
+
+                sVPETInterest tracked = client.interest;
+                tracked.position += glm::vec3(jitter_distribution(generator), jitter_distribution(generator), jitter_distribution(generator));
+
+                uint32_t message_size = write_interest_message(client.client_id, 0u, 0u, tracked, interest_message);
+
+                uint8_t scene_id = 0u;
+                sVPETInterest interest;
+                if (read_interest_message(interest_message, message_size, scene_id, interest)) {
+                    interest_manager.set_interest(client.client_id, interest, now_us);
+                }
+
+                interest_manager.mark_dirty(vpet.editables_node_list[client.dragged_editable]);
+            }
+
+            interest_manager.collect(batches);
+
+            for (const sVPETInterestBatch& batch : batches) {
+                message.assign(3u, 0u);
+
+                for (uint32_t editable_id : batch.editables) {
+                    const sVPETNode* vpet_node = vpet.editables_node_list[editable_id];
+                    write_transform_records(0u, static_cast<uint16_t>(editable_id + 1u), vpet_node->position, vpet_node->rotation, vpet_node->scale, message);
+                }
+
+                // Recipient frame and message
+                result.interest_bytes += 1u + message.size();
+                result.interest_objects += batch.editables.size();
+            }
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            float tick_ms = std::chrono::duration<float, std::milli>(end - start).count();
+            total_ms += tick_ms;
+            result.max_ms = std::max(result.max_ms, tick_ms);
+
+            // Without interest management one message with every edit goes to every client
+            result.broadcast_bytes += static_cast<uint64_t>(client_count) * (3u + client_count * TRANSFORM_RECORDS_SIZE);
+
+            if (tick % 30u == 0u) {
+                for (const sSimulatedClient& client : clients) {
+                    result.average_members += interest_manager.get_member_count(client.client_id);
+                    member_samples++;
+                }
+            }
+        }
+
+        result.transitions = interest_manager.get_entered_count() + interest_manager.get_left_count();
+        result.average_ms = total_ms / TICK_COUNT;
+        result.average_members /= std::max<uint64_t>(member_samples, 1u);
+
+        return result;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    JobSystem::initialize();
+
+    uint32_t client_count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 32u;
+    uint32_t editable_count = argc > 2 ? strtoul(argv[2], nullptr, 10) : 5000u;
+
+    client_count = std::clamp(client_count, 1u, 255u);
+
+    spdlog::info("Interest fan-out benchmark, {} clients, {} editables on {:.0f} x {:.0f} m, {:.0f} s at {:.0f} Hz", client_count,
+        editable_count, LOCATION_SIZE, LOCATION_SIZE, TICK_COUNT / TICK_RATE, TICK_RATE);
+
+    const float hysteresis_values[] = { 0.0f, 1.0f, 4.0f };
+
+    for (float hysteresis : hysteresis_values) {
+        sRunResult result = run_session(client_count, editable_count, hysteresis);
+
+        float seconds = TICK_COUNT / TICK_RATE;
+
+        spdlog::info("hysteresis {:.1f} m: broadcast {:8.1f} KB/s, interest {:7.1f} KB/s ({:5.1f}%), {:6.1f} objects/s per client, "
+            "{:5.1f} members per client, {:6.1f} region transitions/s, {:.3f} ms avg {:.3f} ms max per tick", hysteresis,
+            result.broadcast_bytes / seconds / 1024.0f, result.interest_bytes / seconds / 1024.0f,
+            100.0f * result.interest_bytes / std::max<uint64_t>(result.broadcast_bytes, 1u),
+            result.interest_objects / seconds / client_count, result.average_members, result.transitions / seconds,
+            result.average_ms, result.max_ms);
+    }
+
+    JobSystem::clean();
+
+    return 0;
+}
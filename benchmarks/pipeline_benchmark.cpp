@@ -0,0 +1,361 @@
+#include "engine/sample_engine.h"
+#include "graphics/sample_renderer.h"
+#include "vpet/scene_distribution.h"
+#include "engine/stats.h"
+
+#include "framework/nodes/mesh_instance_3d.h"
+#include "graphics/surface.h"
+#include "graphics/material.h"
+
+#include "spdlog/spdlog.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times the TRACER pipeline over synthetic scenes: process_scene_object, every get_scene_request_buffer
+// category, the set_scene_* deserializers and optionally load_tracer_scene, which needs a GPU and a window.
+// Results are written as JSON so runs can be compared across releases.
+//
+//  pipeline_benchmark [--nodes N] [--vertices N] [--texture-size N] [--sharing 0..1]
+//                     [--iterations N] [--engine] [--output file.json]
+
+extern sVPETContext vpet;
+
+void set_scene_objects(int8_t* byte_array, uint32_t array_size);
+void set_scene_textures(int8_t* byte_array, uint32_t array_size);
+void set_scene_materials(int8_t* byte_array, uint32_t array_size);
+void set_scene_nodes(int8_t* byte_array, uint32_t array_size);
+
+namespace {
+
+    std::atomic<uint64_t> allocation_count = 0u;
+    std::atomic<uint64_t> allocated_bytes = 0u;
+
+    struct sConfiguration {
+        uint32_t node_count = 1000u;
+        uint32_t vertex_count = 1000u;
+        uint32_t texture_size = 512u;
+        // Fraction of nodes that reuse a mesh, material and texture of a previous node
+        float sharing = 0.5f;
+        uint32_t iterations = 5u;
+        bool with_engine = false;
+        std::string output;
+    };
+
+    struct sResult {
+        std::string name;
+        uint32_t iterations = 0u;
+        double average_ms = 0.0;
+        double min_ms = 0.0;
+        uint64_t bytes = 0u;
+        uint64_t items = 0u;
+        uint64_t allocations = 0u;
+        uint64_t allocated_bytes = 0u;
+    };
+
+    std::vector<sResult> results;
+
+    // Runs fn iterations times, prepare runs untimed before each one
+    void measure(const std::string& name, uint32_t iterations, uint64_t bytes, uint64_t items,
+        const std::function<void()>& fn, const std::function<void()>& prepare = nullptr)
+    {
+        sResult result = { .name = name, .iterations = iterations, .min_ms = 1e30, .bytes = bytes, .items = items };
+
+        double total_ms = 0.0;
+
+        for (uint32_t i = 0u; i < iterations; ++i) {
+            if (prepare) {
+                prepare();
+            }
+
+            uint64_t allocations_start = allocation_count.load();
+            uint64_t bytes_start = allocated_bytes.load();
+            auto start = std::chrono::high_resolution_clock::now();
+
+            fn();
+
+            double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            total_ms += elapsed_ms;
+            result.min_ms = std::min(result.min_ms, elapsed_ms);
+
+            // Allocations of the last iteration, they are the same every run
+            result.allocations = allocation_count.load() - allocations_start;
+            result.allocated_bytes = allocated_bytes.load() - bytes_start;
+        }
+
+        result.average_ms = total_ms / iterations;
+
+        spdlog::info("{:<28} {:10.3f} ms avg {:10.3f} ms min {:10} allocations", name, result.average_ms, result.min_ms, result.allocations);
+
+        results.push_back(result);
+    }
+
+    Surface* create_surface(const std::string& name, uint32_t vertex_count, std::mt19937& generator)
+    {
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+        // Filled directly, create_surface_data would upload to the GPU
+        Surface* surface = new Surface();
+        surface->set_name(name);
+
+        sSurfaceData& surface_data = surface->get_surface_data();
+        surface_data.resize(vertex_count);
+
+        for (uint32_t i = 0u; i < vertex_count; ++i) {
+            surface_data.vertices[i] = { distribution(generator), distribution(generator), distribution(generator) };
+            surface_data.normals[i] = glm::normalize(surface_data.vertices[i] + glm::vec3(0.0f, 0.0f, 1e-3f));
+            surface_data.uvs[i] = { distribution(generator) * 0.5f + 0.5f, distribution(generator) * 0.5f + 0.5f };
+        }
+
+        surface_data.indices.resize((vertex_count / 3u) * 3u);
+        for (uint32_t i = 0u; i < surface_data.indices.size(); ++i) {
+            surface_data.indices[i] = i;
+        }
+
+        return surface;
+    }
+
+    std::vector<Node*> create_scene(const sConfiguration& configuration)
+    {
+        std::mt19937 generator(42u);
+        std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+        std::vector<Surface*> unique_surfaces;
+        std::vector<Node*> nodes;
+
+        for (uint32_t i = 0u; i < configuration.node_count; ++i) {
+            Surface* surface = nullptr;
+
+            if (!unique_surfaces.empty() && chance(generator) < configuration.sharing) {
+                surface = unique_surfaces[generator() % unique_surfaces.size()];
+            }
+            else {
+                surface = create_surface("surface_" + std::to_string(unique_surfaces.size()), configuration.vertex_count, generator);
+
+                Material* material = new Material();
+                material->set_name("material_" + std::to_string(unique_surfaces.size()));
+                surface->set_material(material);
+
+                unique_surfaces.push_back(surface);
+            }
+
+            MeshInstance3D* node = new MeshInstance3D();
+            node->set_name("node_" + std::to_string(i));
+            node->set_position({ position(generator), position(generator) * 0.1f, position(generator) });
+            node->add_surface(surface);
+
+            nodes.push_back(node);
+        }
+
+        return nodes;
+    }
+
+    // Texture objects need a device, so textures go straight into the context, shared like the meshes
+    void add_textures(sVPETContext& context, const sConfiguration& configuration)
+    {
+        uint32_t texture_count = std::max(1u, static_cast<uint32_t>(configuration.node_count * (1.0f - configuration.sharing)));
+
+        for (uint32_t i = 0u; i < texture_count; ++i) {
+            sVPETTexture* texture = new sVPETTexture();
+            texture->name = "texture_" + std::to_string(i);
+            texture->width = configuration.texture_size;
+            texture->height = configuration.texture_size;
+            texture->format = static_cast<uint32_t>(eVPETTextureFormat::RGBA32);
+            texture->texture_data.assign(configuration.texture_size * configuration.texture_size * 4u, static_cast<uint8_t>(i));
+
+            context.textures_byte_size += 4 * sizeof(uint32_t) + texture->texture_data.size();
+            context.texture_list.push_back(texture);
+        }
+    }
+
+    void write_json(const sConfiguration& configuration, FILE* file)
+    {
+        fprintf(file, "{\n  \"config\": {\"nodes\": %u, \"vertices\": %u, \"texture_size\": %u, \"sharing\": %.3f, \"iterations\": %u},\n",
+            configuration.node_count, configuration.vertex_count, configuration.texture_size, configuration.sharing, configuration.iterations);
+        fprintf(file, "  \"results\": [\n");
+
+        for (uint32_t i = 0u; i < results.size(); ++i) {
+            const sResult& result = results[i];
+            double seconds = result.average_ms / 1000.0;
+
+            fprintf(file, "    {\"name\": \"%s\", \"iterations\": %u, \"avg_ms\": %.4f, \"min_ms\": %.4f, \"bytes\": %llu, \"mb_per_s\": %.2f, "
+                "\"items\": %llu, \"items_per_s\": %.1f, \"allocations\": %llu, \"allocated_bytes\": %llu}%s\n",
+                result.name.c_str(), result.iterations, result.average_ms, result.min_ms,
+                static_cast<unsigned long long>(result.bytes), seconds > 0.0 ? result.bytes / (1024.0 * 1024.0) / seconds : 0.0,
+                static_cast<unsigned long long>(result.items), seconds > 0.0 ? result.items / seconds : 0.0,
+                static_cast<unsigned long long>(result.allocations), static_cast<unsigned long long>(result.allocated_bytes),
+                i + 1u < results.size() ? "," : "");
+        }
+
+        fprintf(file, "  ],\n  \"peak_rss_bytes\": %llu\n}\n", static_cast<unsigned long long>(Stats::get_peak_memory()));
+    }
+
+    bool parse_arguments(int argc, char** argv, sConfiguration& configuration)
+    {
+        for (int i = 1; i < argc; ++i) {
+            std::string argument = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+            if (argument == "--engine") {
+                configuration.with_engine = true;
+                continue;
+            }
+
+            if (!value) {
+                spdlog::error("Missing value for {}", argument);
+                return false;
+            }
+
+            if (argument == "--nodes") configuration.node_count = strtoul(value, nullptr, 10);
+            else if (argument == "--vertices") configuration.vertex_count = strtoul(value, nullptr, 10);
+            else if (argument == "--texture-size") configuration.texture_size = strtoul(value, nullptr, 10);
+            else if (argument == "--sharing") configuration.sharing = strtof(value, nullptr);
+            else if (argument == "--iterations") configuration.iterations = std::max(1ul, strtoul(value, nullptr, 10));
+            else if (argument == "--output") configuration.output = value;
+            else {
+                spdlog::error("Unknown argument {}", argument);
+                return false;
+            }
+
+            i++;
+        }
+
+        return true;
+    }
+}
+
+void* operator new(size_t size)
+{
+    allocation_count.fetch_add(1u, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (void* ptr = malloc(size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+int main(int argc, char** argv)
+{
+    sConfiguration configuration;
+
+    if (!parse_arguments(argc, argv, configuration)) {
+        return 1;
+    }
+
+    spdlog::set_level(spdlog::level::warn);
+
+    std::vector<Node*> scene = create_scene(configuration);
+
+    sVPETContext context;
+
+    spdlog::set_level(spdlog::level::info);
+
+    measure("process_scene_object", configuration.iterations, 0u, scene.size(), [&]() {
+        for (Node* node : scene) {
+            process_scene_object(context, node);
+        }
+    }, [&]() { context.clean(); });
+
+    add_textures(context, configuration);
+
+    // Every category, the serialized buffers are kept for the deserializers
+    struct sCategory {
+        const char* request;
+        void (*deserialize)(int8_t*, uint32_t);
+        uint64_t items;
+        std::vector<uint8_t> buffer;
+    };
+
+    std::vector<sCategory> categories = {
+        { "header", nullptr, 1u },
+        { "materials", set_scene_materials, context.material_list.size() },
+        { "textures", set_scene_textures, context.texture_list.size() },
+        { "objects", set_scene_objects, context.geo_list.size() },
+        { "nodes", set_scene_nodes, context.node_list.size() }
+    };
+
+    for (sCategory& category : categories) {
+        uint8_t* byte_array = nullptr;
+        uint32_t byte_array_size = get_scene_request_buffer(nullptr, category.request, context, &byte_array);
+        category.buffer.assign(byte_array, byte_array + byte_array_size);
+        delete[] byte_array;
+
+        measure(std::string("serialize.") + category.request, configuration.iterations, byte_array_size, category.items, [&]() {
+            uint8_t* byte_array = nullptr;
+            get_scene_request_buffer(nullptr, category.request, context, &byte_array);
+            delete[] byte_array;
+        });
+    }
+
+    for (sCategory& category : categories) {
+        if (!category.deserialize) {
+            continue;
+        }
+
+        measure(std::string("deserialize.") + category.request, configuration.iterations, category.buffer.size(), category.items, [&]() {
+            category.deserialize(reinterpret_cast<int8_t*>(category.buffer.data()), category.buffer.size());
+        }, [&]() { vpet.clean(); });
+    }
+
+    if (configuration.with_engine) {
+        SampleEngine* engine = new SampleEngine();
+        SampleRenderer* renderer = new SampleRenderer();
+
+        if (engine->initialize(renderer, { .window_title = "Pipeline benchmark" }) == 0) {
+            vpet.clean();
+
+            for (sCategory& category : categories) {
+                if (category.deserialize) {
+                    category.deserialize(reinterpret_cast<int8_t*>(category.buffer.data()), category.buffer.size());
+                }
+            }
+
+            measure("load_tracer_scene", 1u, 0u, vpet.node_list.size(), [&]() {
+                engine->load_tracer_scene();
+                engine->flush_uploads();
+            });
+        }
+
+        engine->clean();
+
+        delete engine;
+        delete renderer;
+    }
+
+    if (configuration.output.empty()) {
+        write_json(configuration, stdout);
+    }
+    else if (FILE* file = fopen(configuration.output.c_str(), "w")) {
+        write_json(configuration, file);
+        fclose(file);
+        spdlog::info("Results written to {}", configuration.output);
+    }
+    else {
+        spdlog::error("Could not open {}", configuration.output);
+        return 1;
+    }
+
+    return 0;
+}
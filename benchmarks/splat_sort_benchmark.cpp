@@ -0,0 +1,142 @@
+#include "engine/job_system.h"
+#include "engine/splat_sorter.h"
+
+#include "spdlog/spdlog.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Sorts random splat clouds of increasing size: full sorts from new views, walking and slowly turning
+// cameras that reuse the previous order, and the latency of an asynchronous request.
+
+namespace {
+
+    const uint32_t REPETITIONS = 5u;
+
+    std::vector<glm::vec3> generate_positions(uint32_t count)
+    {
+        std::mt19937 generator(1234u);
+        std::uniform_real_distribution<float> distribution(-50.0f, 50.0f);
+
+        std::vector<glm::vec3> positions(count);
+        for (glm::vec3& position : positions) {
+            position = { distribution(generator), distribution(generator) * 0.2f, distribution(generator) };
+        }
+
+        return positions;
+    }
+
+    bool is_back_to_front(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& order, const glm::vec3& eye, const glm::vec3& forward)
+    {
+        // Keys are quantized, allow one key of slack between neighbours
+        float tolerance = 200.0f / static_cast<float>((1u << SplatSorter::KEY_BITS) - 1u);
+
+        for (uint32_t i = 1u; i < order.size(); ++i) {
+            float previous_depth = glm::dot(positions[order[i - 1u]] - eye, forward);
+            float depth = glm::dot(positions[order[i]] - eye, forward);
+            if (depth > previous_depth + tolerance) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    const char* get_kind_name(SplatSorter::eSortKind kind)
+    {
+        switch (kind) {
+        case SplatSorter::SORT_REUSED: return "reused";
+        case SplatSorter::SORT_FULL: return "full";
+        default: return "none";
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    JobSystem::initialize();
+
+    std::vector<uint32_t> splat_counts = { 1000000u, 5000000u, 10000000u };
+
+    if (argc > 1) {
+        splat_counts.clear();
+        for (int i = 1; i < argc; ++i) {
+            splat_counts.push_back(strtoul(argv[i], nullptr, 10));
+        }
+    }
+
+    spdlog::info("Splat sort benchmark, {} worker threads", JobSystem::get_worker_count());
+
+    for (uint32_t splat_count : splat_counts) {
+        std::vector<glm::vec3> positions = generate_positions(splat_count);
+
+        SplatSorter sorter;
+        sorter.set_positions(std::vector<glm::vec3>(positions));
+
+        std::vector<uint32_t> order;
+
+        glm::vec3 eye = { 0.0f, 2.0f, -80.0f };
+        glm::vec3 forward = { 0.0f, 0.0f, 1.0f };
+
+        struct sCase {
+            const char* name;
+            glm::vec3 eye_step;
+            glm::vec3 forward_step;
+        };
+
+        // New views every repetition, then walking straight and turning a little
+        const sCase cases[] = {
+            { "new view", { 7.0f, 0.0f, 3.0f }, { 0.3f, 0.0f, 0.0f } },
+            { "walk", { 0.5f, 0.1f, 0.5f }, { 0.0f, 0.0f, 0.0f } },
+            { "slow turn", { 0.0f, 0.0f, 0.0f }, { 0.001f, 0.0f, 0.0f } }
+        };
+
+        for (const sCase& test_case : cases) {
+            float total_ms = 0.0f;
+            SplatSorter::eSortKind kind = SplatSorter::SORT_NONE;
+            bool valid = true;
+
+            for (uint32_t i = 0u; i < REPETITIONS; ++i) {
+                eye += test_case.eye_step;
+                forward = glm::normalize(forward + test_case.forward_step);
+
+                SplatSorter::sSortStats stats = sorter.sort(eye, forward, order);
+                total_ms += stats.sort_ms;
+                kind = stats.kind;
+
+                valid = valid && order.size() == splat_count;
+            }
+
+            // A reused order after turning belongs to a slightly different direction
+            if (test_case.forward_step.x == 0.0f) {
+                valid = valid && is_back_to_front(positions, order, eye, forward);
+            }
+
+            spdlog::info("{:>9} splats, {:<9}: {:8.2f} ms avg ({}){}", splat_count, test_case.name, total_ms / REPETITIONS,
+                get_kind_name(kind), valid ? "" : " WRONG ORDER");
+        }
+
+        // Time from request to a fetchable order, the render thread only pays for fetch_order
+        forward = glm::normalize(forward + glm::vec3(0.3f, 0.0f, 0.0f));
+
+        auto start = std::chrono::high_resolution_clock::now();
+        sorter.request_sort(eye, forward);
+
+        auto request_end = std::chrono::high_resolution_clock::now();
+        while (!sorter.fetch_order(order)) {
+            std::this_thread::yield();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        spdlog::info("{:>9} splats, async    : {:8.3f} ms to request, {:8.2f} ms until ready", splat_count,
+            std::chrono::duration<float, std::milli>(request_end - start).count(),
+            std::chrono::duration<float, std::milli>(end - start).count());
+    }
+
+    JobSystem::clean();
+
+    return 0;
+}
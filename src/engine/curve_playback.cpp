@@ -0,0 +1,139 @@
+#include "curve_playback.h"
+
+#include "framework/nodes/node_3d.h"
+
+#include <cassert>
+#include <cmath>
+
+void CurvePlayback::build(const sVPETContext& vpet)
+{
+    clear();
+
+    this->vpet = &vpet;
+
+    playbacks.resize(vpet.animation_list.size());
+
+    for (uint32_t animation_idx = 0u; animation_idx < vpet.animation_list.size(); ++animation_idx) {
+        playbacks[animation_idx].animation = vpet.animation_list[animation_idx];
+    }
+}
+
+void CurvePlayback::clear()
+{
+    vpet = nullptr;
+    playbacks.clear();
+}
+
+bool CurvePlayback::execute(const sVPETAnimationCommand& command)
+{
+    if (command.animation_id >= playbacks.size()) {
+        return false;
+    }
+
+    sPlayback& playback = playbacks[command.animation_id];
+
+    switch (command.command) {
+    case eVPETAnimationCommand::STOP:
+        playback.playing = false;
+        break;
+    case eVPETAnimationCommand::PLAY:
+        playback.playing = true;
+        playback.loop = command.loop;
+        playback.speed = command.speed;
+        break;
+    case eVPETAnimationCommand::SEEK:
+        break;
+    }
+
+    playback.time = std::clamp(command.time, 0.0f, playback.animation->duration);
+    playback.dirty = true;
+
+    return true;
+}
+
+void CurvePlayback::apply(const sPlayback& playback, std::vector<sVPETNode*>& moved_nodes)
+{
+    int32_t previous_node_id = -1;
+
+    for (const sVPETCurve& curve : playback.animation->curves) {
+        sVPETNode* vpet_node = vpet->node_list[curve.node_id];
+        Node3D* node_ref = vpet_node->node_ref;
+
+        if (!node_ref) {
+            continue;
+        }
+
+        glm::vec4 value = evaluate_curve(curve, playback.time);
+
+        // Back from the Unity coordinate system
+        switch (curve.parameter_id) {
+        case 0:
+            node_ref->set_position(glm::vec3(value.x, value.y, -value.z));
+            break;
+        case 1:
+            node_ref->set_rotation(glm::quat(value.w, -value.x, -value.y, value.z));
+            break;
+        case 2:
+            node_ref->set_scale(glm::vec3(value));
+            break;
+        default:
+            assert(0);
+        }
+
+        // Curves of a node are next to each other
+        if (curve.node_id != previous_node_id) {
+            moved_nodes.push_back(vpet_node);
+            previous_node_id = curve.node_id;
+        }
+    }
+}
+
+void CurvePlayback::update(float delta_time, std::vector<sVPETNode*>& moved_nodes)
+{
+    for (sPlayback& playback : playbacks) {
+        if (!playback.playing && !playback.dirty) {
+            continue;
+        }
+
+        if (playback.playing && !playback.dirty) {
+            float duration = playback.animation->duration;
+            playback.time += delta_time * playback.speed;
+
+            if (playback.loop && duration > 0.0f) {
+                playback.time = std::fmod(playback.time, duration);
+                if (playback.time < 0.0f) {
+                    playback.time += duration;
+                }
+            }
+            else if ((playback.speed > 0.0f && playback.time >= duration) || (playback.speed < 0.0f && playback.time <= 0.0f)) {
+                // Played through, stops on its last frame
+                playback.time = std::clamp(playback.time, 0.0f, duration);
+                playback.playing = false;
+            }
+        }
+
+        apply(playback, moved_nodes);
+
+        playback.dirty = false;
+    }
+}
+
+void CurvePlayback::get_playing(std::vector<sVPETAnimationCommand>& commands) const
+{
+    for (uint32_t animation_idx = 0u; animation_idx < playbacks.size(); ++animation_idx) {
+        const sPlayback& playback = playbacks[animation_idx];
+
+        if (!playback.playing) {
+            continue;
+        }
+
+        sVPETAnimationCommand command;
+        command.animation_id = static_cast<uint16_t>(animation_idx);
+        command.command = eVPETAnimationCommand::PLAY;
+        command.loop = playback.loop;
+        command.time = playback.time;
+        command.speed = playback.speed;
+
+        commands.push_back(command);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "vpet/curve_distribution.h"
+
+#include <vector>
+
+// Engine side of the "curve" animations. Nodes are set from the same quantized keys the clients evaluate, so all
+// of them show the same motion while only ANIMATION commands and a periodic state refresh cross the network.
+class CurvePlayback {
+
+    struct sPlayback {
+        const sVPETAnimation* animation = nullptr;
+        bool playing = false;
+        bool loop = true;
+        float time = 0.0f;
+        float speed = 1.0f;
+        // Stopped animations are set once after a command
+        bool dirty = false;
+    };
+
+    const sVPETContext* vpet = nullptr;
+    std::vector<sPlayback> playbacks;
+
+    void apply(const sPlayback& playback, std::vector<sVPETNode*>& moved_nodes);
+
+public:
+
+    void build(const sVPETContext& vpet);
+    void clear();
+
+    // False for animations the context does not have
+    bool execute(const sVPETAnimationCommand& command);
+
+    // Advances the playing animations, moved_nodes gets the nodes that were set
+    void update(float delta_time, std::vector<sVPETNode*>& moved_nodes);
+
+    // Where the playing animations are, for clients that missed the commands
+    void get_playing(std::vector<sVPETAnimationCommand>& commands) const;
+
+    uint32_t get_animation_count() const { return static_cast<uint32_t>(playbacks.size()); }
+};
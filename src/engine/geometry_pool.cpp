@@ -0,0 +1,240 @@
+#include "geometry_pool.h"
+
+#include "engine/upload_queue.h"
+
+#include "framework/nodes/mesh_instance_3d.h"
+#include "graphics/surface.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+
+void GeometryPool::add(MeshInstance3D* instance, Material* material, uint32_t vertex_count, uint32_t index_count,
+    GeometryFn get_geometry, std::function<void()> on_release)
+{
+    sMember member;
+    member.instance = instance;
+    member.material = material;
+    member.model = instance->get_global_model();
+    member.vertex_count = vertex_count;
+    member.index_count = index_count;
+    member.get_geometry = std::move(get_geometry);
+    member.on_release = std::move(on_release);
+
+    member_lookup[instance] = members.size();
+    members.push_back(std::move(member));
+
+    instance->set_visibility(false);
+}
+
+std::vector<MeshInstance3D*> GeometryPool::build(UploadQueue& upload_queue, const std::function<void(MeshInstance3D*)>& on_uploaded)
+{
+    std::vector<MeshInstance3D*> batch_instances;
+
+    // Only members added since the last build
+    uint32_t first_member = built_member_count;
+    uint32_t first_batch = batches.size();
+
+    built_member_count = members.size();
+
+    if (first_member == members.size()) {
+        return batch_instances;
+    }
+
+    glm::vec3 scene_min = glm::vec3(members[first_member].model[3]);
+    glm::vec3 scene_max = scene_min;
+
+    for (uint32_t i = first_member; i < members.size(); ++i) {
+        scene_min = glm::min(scene_min, glm::vec3(members[i].model[3]));
+        scene_max = glm::max(scene_max, glm::vec3(members[i].model[3]));
+    }
+
+    glm::vec3 extent = scene_max - scene_min;
+    float cell_size = std::max(std::max(extent.x, std::max(extent.y, extent.z)) / cells_per_axis, 1e-3f);
+
+    std::vector<glm::ivec3> member_cells(members.size());
+    for (uint32_t i = first_member; i < members.size(); ++i) {
+        member_cells[i] = glm::ivec3(glm::floor((glm::vec3(members[i].model[3]) - scene_min) / cell_size));
+    }
+
+    // Same material and cell end up next to each other
+    std::vector<uint32_t> order(members.size() - first_member);
+    for (uint32_t i = 0u; i < order.size(); ++i) {
+        order[i] = first_member + i;
+    }
+
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if (members[a].material != members[b].material) {
+            return members[a].material < members[b].material;
+        }
+
+        const glm::ivec3& cell_a = member_cells[a];
+        const glm::ivec3& cell_b = member_cells[b];
+
+        if (cell_a.x != cell_b.x) return cell_a.x < cell_b.x;
+        if (cell_a.y != cell_b.y) return cell_a.y < cell_b.y;
+        if (cell_a.z != cell_b.z) return cell_a.z < cell_b.z;
+
+        return a < b;
+    });
+
+    for (uint32_t i = 0u; i < order.size(); ++i) {
+        sMember& member = members[order[i]];
+
+        bool new_batch = i == 0u;
+
+        if (!new_batch) {
+            const sMember& previous = members[order[i - 1u]];
+            new_batch = member.material != previous.material || member_cells[order[i]] != member_cells[order[i - 1u]] ||
+                batches.back().vertex_count + member.vertex_count > max_batch_vertices;
+        }
+
+        if (new_batch) {
+            batches.push_back({});
+            batches.back().material = member.material;
+        }
+
+        sBatch& batch = batches.back();
+
+        member.batch = batches.size() - 1u;
+        member.index_start = batch.index_count;
+
+        batch.members.push_back(order[i]);
+        batch.vertex_count += member.vertex_count;
+        batch.index_count += member.index_count;
+    }
+
+    for (uint32_t batch_index = first_batch; batch_index < batches.size(); ++batch_index) {
+        sBatch& batch = batches[batch_index];
+
+        // Vertices are baked in world space
+        batch.instance = new MeshInstance3D();
+        batch.instance->set_name("GeometryBatch_" + std::to_string(batch_index));
+        batch_instances.push_back(batch.instance);
+
+        std::shared_ptr<sSurfaceData> staged = std::make_shared<sSurfaceData>();
+        uint64_t byte_size = batch.vertex_count * (2u * sizeof(glm::vec3) + sizeof(glm::vec2)) + batch.index_count * sizeof(uint32_t);
+
+        upload_queue.add(byte_size,
+            [this, batch_index, staged]() {
+                prepare_batch(batch_index, *staged);
+            },
+            [this, batch_index, staged, on_uploaded]() {
+                sBatch& batch = batches[batch_index];
+
+                batch.surface = new Surface();
+                batch.surface->create_surface_data(*staged);
+                batch.surface->create_index_buffer(batch.indices);
+
+                batch.instance->add_surface(batch.surface);
+
+                if (batch.material) {
+                    batch.instance->set_surface_material_override(batch.surface, batch.material);
+                }
+
+                on_uploaded(batch.instance);
+            });
+    }
+
+    spdlog::info("Geometry pool: {} meshes in {} batches", members.size() - first_member, batches.size() - first_batch);
+
+    return batch_instances;
+}
+
+void GeometryPool::prepare_batch(uint32_t batch_index, sSurfaceData& surface_data)
+{
+    sBatch& batch = batches[batch_index];
+
+    surface_data.resize(batch.vertex_count);
+    batch.indices.resize(batch.index_count);
+
+    sSurfaceData member_data;
+    std::vector<uint32_t> member_indices;
+
+    uint32_t vertex_offset = 0u;
+
+    for (uint32_t member_index : batch.members) {
+        const sMember& member = members[member_index];
+
+        member.get_geometry(member_data, member_indices);
+
+        assert(member_data.vertices.size() == member.vertex_count && member_indices.size() == member.index_count);
+
+        glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(member.model)));
+
+        for (uint32_t i = 0u; i < member.vertex_count; ++i) {
+            surface_data.vertices[vertex_offset + i] = glm::vec3(member.model * glm::vec4(member_data.vertices[i], 1.0f));
+            surface_data.normals[vertex_offset + i] = glm::normalize(normal_matrix * member_data.normals[i]);
+            surface_data.uvs[vertex_offset + i] = member_data.uvs[i];
+        }
+
+        for (uint32_t i = 0u; i < member.index_count; ++i) {
+            batch.indices[member.index_start + i] = vertex_offset + member_indices[i];
+        }
+
+        // Released before its batch got uploaded
+        if (member.released) {
+            collapse_member(member, batch.indices);
+        }
+
+        vertex_offset += member.vertex_count;
+    }
+}
+
+void GeometryPool::collapse_member(const sMember& member, std::vector<uint32_t>& indices)
+{
+    if (member.index_count == 0u) {
+        return;
+    }
+
+    // Zero area triangles, the ranges of the other members stay where they are
+    uint32_t first_index = indices[member.index_start];
+    std::fill(indices.begin() + member.index_start, indices.begin() + member.index_start + member.index_count, first_index);
+}
+
+bool GeometryPool::is_batched(MeshInstance3D* instance) const
+{
+    auto it = member_lookup.find(instance);
+    return it != member_lookup.end() && !members[it->second].released;
+}
+
+bool GeometryPool::release(MeshInstance3D* instance, UploadQueue& upload_queue)
+{
+    auto it = member_lookup.find(instance);
+
+    if (it == member_lookup.end() || members[it->second].released) {
+        return false;
+    }
+
+    sMember& member = members[it->second];
+    member.released = true;
+
+    sBatch& batch = batches[member.batch];
+
+    // Already on the GPU, send the index buffer again with the member collapsed
+    if (batch.surface) {
+        collapse_member(member, batch.indices);
+
+        Surface* surface = batch.surface;
+        std::shared_ptr<std::vector<uint32_t>> indices = std::make_shared<std::vector<uint32_t>>(batch.indices);
+
+        upload_queue.add(indices->size() * sizeof(uint32_t), nullptr, [surface, indices]() {
+            surface->create_index_buffer(*indices);
+        });
+    }
+
+    member.instance->set_visibility(true);
+    member.on_release();
+
+    return true;
+}
+
+void GeometryPool::clear()
+{
+    members.clear();
+    member_lookup.clear();
+    batches.clear();
+    built_member_count = 0u;
+}
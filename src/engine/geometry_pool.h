@@ -0,0 +1,85 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class Material;
+class MeshInstance3D;
+class Surface;
+class UploadQueue;
+struct sSurfaceData;
+
+// Static batching for small meshes. Members that share a material and a grid cell are merged, with their
+// world transform baked in, into the surface of one batch instance, so a scene with thousands of props binds
+// a few large vertex/index buffers instead of one pair per prop. Batches are spatial, so they still cull.
+// A member that moves is released: its triangles are collapsed in the batch and it is rebuilt standalone.
+class GeometryPool {
+
+public:
+
+    // Fills the member geometry in local space, called from the upload jobs
+    using GeometryFn = std::function<void(sSurfaceData& surface_data, std::vector<uint32_t>& indices)>;
+
+private:
+
+    struct sMember {
+        MeshInstance3D* instance = nullptr;
+        Material* material = nullptr;
+        glm::mat4 model = glm::mat4(1.0f);
+        uint32_t vertex_count = 0u;
+        uint32_t index_count = 0u;
+        GeometryFn get_geometry;
+        std::function<void()> on_release;
+
+        uint32_t batch = 0u;
+        uint32_t index_start = 0u;
+        bool released = false;
+    };
+
+    struct sBatch {
+        Material* material = nullptr;
+        MeshInstance3D* instance = nullptr;
+        Surface* surface = nullptr;
+        std::vector<uint32_t> members;
+        uint32_t vertex_count = 0u;
+        uint32_t index_count = 0u;
+        // Kept to collapse released members
+        std::vector<uint32_t> indices;
+    };
+
+    std::vector<sMember> members;
+    std::unordered_map<MeshInstance3D*, uint32_t> member_lookup;
+    std::vector<sBatch> batches;
+    uint32_t built_member_count = 0u;
+
+    void prepare_batch(uint32_t batch_index, sSurfaceData& surface_data);
+    void collapse_member(const sMember& member, std::vector<uint32_t>& indices);
+
+public:
+
+    // Members are binned in cells of about scene extent / cells_per_axis
+    uint32_t cells_per_axis = 8u;
+    uint32_t max_batch_vertices = 1u << 20;
+
+    // The instance is hidden and stays out of the scene BVH while batched, its transform must be final
+    void add(MeshInstance3D* instance, Material* material, uint32_t vertex_count, uint32_t index_count,
+        GeometryFn get_geometry, std::function<void()> on_release);
+
+    // Creates the batch instances and queues their geometry, on_uploaded runs once each batch has its surface
+    std::vector<MeshInstance3D*> build(UploadQueue& upload_queue, const std::function<void(MeshInstance3D*)>& on_uploaded);
+
+    bool is_batched(MeshInstance3D* instance) const;
+
+    // Returns false if the instance was not batched
+    bool release(MeshInstance3D* instance, UploadQueue& upload_queue);
+
+    // Batch instances belong to the scene and are deleted with it
+    void clear();
+
+    uint32_t get_batch_count() const { return batches.size(); }
+    uint32_t get_member_count() const { return member_lookup.size(); }
+};
@@ -0,0 +1,148 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> job_queue;
+    std::mutex queue_mutex;
+    std::condition_variable queue_condition;
+    bool running = false;
+
+    void worker_loop()
+    {
+        while (true) {
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_condition.wait(lock, [] { return !running || !job_queue.empty(); });
+
+                if (!running && job_queue.empty()) {
+                    return;
+                }
+
+                job = std::move(job_queue.front());
+                job_queue.pop_front();
+            }
+
+            job();
+        }
+    }
+}
+
+void JobSystem::initialize(uint32_t worker_count)
+{
+#ifndef __EMSCRIPTEN__
+    if (running) {
+        return;
+    }
+
+    if (worker_count == 0u) {
+        uint32_t hardware_threads = std::thread::hardware_concurrency();
+        worker_count = hardware_threads > 1u ? hardware_threads - 1u : 1u;
+    }
+
+    running = true;
+
+    workers.reserve(worker_count);
+    for (uint32_t i = 0u; i < worker_count; ++i) {
+        workers.emplace_back(worker_loop);
+    }
+#endif
+}
+
+void JobSystem::clean()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        running = false;
+    }
+
+    queue_condition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    workers.clear();
+}
+
+uint32_t JobSystem::get_worker_count()
+{
+    return static_cast<uint32_t>(workers.size());
+}
+
+void JobSystem::submit(std::function<void()> job)
+{
+    if (workers.empty()) {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        job_queue.push_back(std::move(job));
+    }
+
+    queue_condition.notify_one();
+}
+
+void JobSystem::parallel_for(uint32_t count, const std::function<void(uint32_t)>& fn)
+{
+    if (count == 0u) {
+        return;
+    }
+
+    if (workers.empty() || count == 1u) {
+        for (uint32_t i = 0u; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    // Shared so helpers that start late never touch a finished call
+    struct sParallelState {
+        std::atomic<uint32_t> next_index = 0u;
+        std::atomic<uint32_t> done_count = 0u;
+        uint32_t count = 0u;
+        std::function<void(uint32_t)> fn;
+        std::mutex done_mutex;
+        std::condition_variable done_condition;
+    };
+
+    std::shared_ptr<sParallelState> state = std::make_shared<sParallelState>();
+    state->count = count;
+    state->fn = fn;
+
+    auto run = [](sParallelState* state) {
+        uint32_t index;
+        while ((index = state->next_index.fetch_add(1u)) < state->count) {
+            state->fn(index);
+
+            if (state->done_count.fetch_add(1u) + 1u == state->count) {
+                std::lock_guard<std::mutex> lock(state->done_mutex);
+                state->done_condition.notify_all();
+            }
+        }
+    };
+
+    uint32_t helper_count = std::min(static_cast<uint32_t>(workers.size()), count - 1u);
+
+    for (uint32_t i = 0u; i < helper_count; ++i) {
+        submit([state, run]() { run(state.get()); });
+    }
+
+    run(state.get());
+
+    std::unique_lock<std::mutex> lock(state->done_mutex);
+    state->done_condition.wait(lock, [&] { return state->done_count.load() == state->count; });
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+class JobSystem {
+
+public:
+
+    // A worker_count of 0 uses the hardware concurrency minus the main thread
+    static void initialize(uint32_t worker_count = 0u);
+    static void clean();
+
+    static uint32_t get_worker_count();
+
+    // Fire and forget, runs inline when there are no workers (e.g. web builds without pthreads)
+    static void submit(std::function<void()> job);
+
+    // Runs fn(i) for every i in [0, count), the calling thread takes part until all of them are done
+    static void parallel_for(uint32_t count, const std::function<void(uint32_t)>& fn);
+};
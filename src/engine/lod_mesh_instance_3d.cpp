@@ -0,0 +1,53 @@
+#include "lod_mesh_instance_3d.h"
+
+#include "framework/camera/camera.h"
+
+float LODMeshInstance3D::lod_screen_threshold = 0.25f;
+
+void LODMeshInstance3D::add_lod_surface(Surface* surface, uint32_t triangle_count)
+{
+    if (lod_levels.empty()) {
+        add_surface(surface);
+    }
+
+    lod_levels.push_back({ surface, triangle_count });
+}
+
+uint32_t LODMeshInstance3D::select_lod(const Camera* camera)
+{
+    if (lod_levels.size() < 2u) {
+        return current_lod;
+    }
+
+    AABB aabb = get_aabb();
+    float radius = glm::length(aabb.half_size);
+    float distance = glm::distance(camera->get_eye(), aabb.center);
+
+    // Fraction of the screen height covered by the bounding sphere, projection[1][1] is 1 / tan(fov_y / 2)
+    float screen_size = distance > radius ? radius * camera->get_projection()[1][1] / distance : 1.0f;
+
+    uint32_t lod = 0u;
+    float threshold = lod_screen_threshold;
+
+    while (lod + 1u < lod_levels.size() && screen_size < threshold) {
+        threshold *= 0.5f;
+        lod++;
+    }
+
+    if (lod != current_lod) {
+        surfaces[0] = lod_levels[lod].surface;
+        current_lod = lod;
+    }
+
+    return current_lod;
+}
+
+uint32_t LODMeshInstance3D::get_triangle_count() const
+{
+    return lod_levels.empty() ? 0u : lod_levels[current_lod].triangle_count;
+}
+
+uint32_t LODMeshInstance3D::get_full_triangle_count() const
+{
+    return lod_levels.empty() ? 0u : lod_levels[0].triangle_count;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "framework/nodes/mesh_instance_3d.h"
+
+class Camera;
+
+// Mesh instance with a single surface that is swapped by projected screen size
+class LODMeshInstance3D : public MeshInstance3D {
+
+    struct sLODLevel {
+        Surface* surface = nullptr;
+        uint32_t triangle_count = 0;
+    };
+
+    std::vector<sLODLevel> lod_levels;
+    uint32_t current_lod = 0;
+
+public:
+
+    // Screen height fraction covered by the bounding sphere under which LOD 1 is used, halved for each next level
+    static float lod_screen_threshold;
+
+    // Level 0 is the full detail surface, the rest must be added from finer to coarser
+    void add_lod_surface(Surface* surface, uint32_t triangle_count);
+
+    uint32_t select_lod(const Camera* camera);
+
+    uint32_t get_lod_count() const { return lod_levels.size(); }
+    uint32_t get_current_lod() const { return current_lod; }
+    uint32_t get_triangle_count() const;
+    uint32_t get_full_triangle_count() const;
+};
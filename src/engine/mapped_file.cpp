@@ -0,0 +1,101 @@
+#include "mapped_file.h"
+
+#include "spdlog/spdlog.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        spdlog::error("Could not open {}", filename);
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        spdlog::error("Could not map {}", filename);
+        return false;
+    }
+
+    data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        spdlog::error("Could not map {}", filename);
+        return false;
+    }
+
+    size = static_cast<size_t>(file_size.QuadPart);
+    file_handle = file;
+    mapping_handle = mapping;
+
+    return true;
+#elif !defined(__EMSCRIPTEN__)
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        spdlog::error("Could not open {}", filename);
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        ::close(fd);
+        spdlog::error("Could not map {}", filename);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(fd);
+        spdlog::error("Could not map {}", filename);
+        return false;
+    }
+
+    data = static_cast<const uint8_t*>(mapping);
+    size = static_cast<size_t>(file_stat.st_size);
+    file_descriptor = fd;
+
+    return true;
+#else
+    spdlog::error("File mapping is not available on web builds");
+    return false;
+#endif
+}
+
+void MappedFile::close()
+{
+    if (!data) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+    CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+#elif !defined(__EMSCRIPTEN__)
+    munmap(const_cast<uint8_t*>(data), size);
+    ::close(file_descriptor);
+    file_descriptor = -1;
+#endif
+
+    data = nullptr;
+    size = 0;
+}
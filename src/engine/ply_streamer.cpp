@@ -0,0 +1,537 @@
+#include "ply_streamer.h"
+
+#include "engine/job_system.h"
+
+#include "spdlog/spdlog.h"
+
+#include <cstring>
+#include <thread>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/fetch.h>
+#endif
+
+namespace {
+
+    // Zeroth order spherical harmonic, maps f_dc to a base color
+    const float SH_C0 = 0.28209479177387814f;
+
+    // Enough for the header of any splat file, which lists ~60 properties
+    const uint32_t HEADER_FETCH_SIZE = 64u * 1024u;
+
+    float read_value(const uint8_t* ptr, uint8_t type)
+    {
+        switch (type) {
+        case 0: return static_cast<float>(*reinterpret_cast<const int8_t*>(ptr));
+        case 1: return static_cast<float>(*ptr);
+        case 2: { int16_t v; memcpy(&v, ptr, sizeof(v)); return static_cast<float>(v); }
+        case 3: { uint16_t v; memcpy(&v, ptr, sizeof(v)); return static_cast<float>(v); }
+        case 4: { int32_t v; memcpy(&v, ptr, sizeof(v)); return static_cast<float>(v); }
+        case 5: { uint32_t v; memcpy(&v, ptr, sizeof(v)); return static_cast<float>(v); }
+        case 6: { float v; memcpy(&v, ptr, sizeof(v)); return v; }
+        case 7: { double v; memcpy(&v, ptr, sizeof(v)); return static_cast<float>(v); }
+        default: return 0.0f;
+        }
+    }
+
+    uint32_t get_type_size(uint8_t type)
+    {
+        const uint32_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+        return sizes[type];
+    }
+
+    uint8_t parse_type(const std::string& name)
+    {
+        if (name == "char" || name == "int8") return 0;
+        if (name == "uchar" || name == "uint8") return 1;
+        if (name == "short" || name == "int16") return 2;
+        if (name == "ushort" || name == "uint16") return 3;
+        if (name == "int" || name == "int32") return 4;
+        if (name == "uint" || name == "uint32") return 5;
+        if (name == "float" || name == "float32") return 6;
+        if (name == "double" || name == "float64") return 7;
+        return 8;
+    }
+
+    float sigmoid(float value)
+    {
+        return 1.0f / (1.0f + expf(-value));
+    }
+}
+
+size_t sSplatBlock::get_byte_size() const
+{
+    return positions.size() * sizeof(glm::vec3) + colors.size() * sizeof(glm::vec4) +
+           scales.size() * sizeof(glm::vec3) + rotations.size() * sizeof(glm::quat);
+}
+
+bool PlyStreamer::open(const std::string& new_filename)
+{
+    close();
+
+    filename = new_filename;
+
+#ifdef __EMSCRIPTEN__
+    fetch_range(0, HEADER_FETCH_SIZE, [](PlyStreamer* streamer, uint32_t fetch_generation, uint32_t, const uint8_t* data, uint64_t size) {
+        if (fetch_generation != streamer->generation) {
+            return;
+        }
+
+        if (!data || !streamer->parse_header(data, size)) {
+            spdlog::error("Could not stream {}", streamer->filename);
+            streamer->close();
+        }
+    }, 0);
+
+    return true;
+#else
+    if (!mapped_file.open(filename)) {
+        filename.clear();
+        return false;
+    }
+
+    if (!parse_header(mapped_file.get_data(), mapped_file.get_size())) {
+        close();
+        return false;
+    }
+
+    if (data_offset + vertex_count * layout.stride > mapped_file.get_size()) {
+        spdlog::error("{} is truncated", filename);
+        close();
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+void PlyStreamer::close()
+{
+    while (active_jobs.load() > 0) {
+        std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ready_mutex);
+        generation++;
+        for (auto& ready_block : ready_blocks) {
+            delete ready_block.second;
+        }
+        ready_blocks.clear();
+    }
+
+    for (sBlockInfo& block : blocks) {
+        delete block.data;
+    }
+
+    blocks.clear();
+
+    mapped_file.close();
+
+    filename.clear();
+    header_ready = false;
+    vertex_count = 0;
+    data_offset = 0;
+    discovery_cursor = 0;
+    in_flight_count = 0;
+    resident_bytes = 0;
+}
+
+bool PlyStreamer::parse_header(const uint8_t* data, size_t size)
+{
+    const char* end_marker = "end_header\n";
+    const uint8_t* header_end = std::search(data, data + size, end_marker, end_marker + strlen(end_marker));
+
+    if (size < 4 || memcmp(data, "ply\n", 4) != 0 || header_end == data + size) {
+        spdlog::error("{} is not a PLY file", filename);
+        return false;
+    }
+
+    std::string header(reinterpret_cast<const char*>(data), header_end - data);
+
+    for (uint32_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+        layout.offsets[i] = -1;
+        layout.types[i] = PLY_UNKNOWN;
+    }
+
+    layout.stride = 0;
+
+    const char* attribute_names[ATTRIBUTE_COUNT] = {
+        "x", "y", "z", "f_dc_0", "f_dc_1", "f_dc_2", "red", "green", "blue",
+        "opacity", "scale_0", "scale_1", "scale_2", "rot_0", "rot_1", "rot_2", "rot_3"
+    };
+
+    bool binary_little_endian = false;
+    bool in_vertex_element = false;
+    bool vertex_element_seen = false;
+
+    size_t line_start = 0;
+    while (line_start < header.size()) {
+        size_t line_end = header.find('\n', line_start);
+        std::string line = header.substr(line_start, line_end - line_start);
+        line_start = line_end == std::string::npos ? header.size() : line_end + 1;
+
+        char word_0[64] = "", word_1[64] = "", word_2[64] = "";
+        sscanf(line.c_str(), "%63s %63s %63s", word_0, word_1, word_2);
+
+        if (strcmp(word_0, "format") == 0) {
+            binary_little_endian = strcmp(word_1, "binary_little_endian") == 0;
+        }
+        else if (strcmp(word_0, "element") == 0) {
+            // Only files where vertices come first can be streamed by offset
+            if (!vertex_element_seen && strcmp(word_1, "vertex") != 0) {
+                spdlog::error("{}: vertex element must come first", filename);
+                return false;
+            }
+
+            in_vertex_element = strcmp(word_1, "vertex") == 0;
+            if (in_vertex_element) {
+                vertex_element_seen = true;
+                vertex_count = strtoull(word_2, nullptr, 10);
+            }
+        }
+        else if (strcmp(word_0, "property") == 0 && in_vertex_element) {
+            if (strcmp(word_1, "list") == 0) {
+                spdlog::error("{}: list properties in vertices are not supported", filename);
+                return false;
+            }
+
+            uint8_t type = parse_type(word_1);
+            if (type == PLY_UNKNOWN) {
+                spdlog::error("{}: unknown property type {}", filename, word_1);
+                return false;
+            }
+
+            for (uint32_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+                if (strcmp(word_2, attribute_names[i]) == 0) {
+                    layout.offsets[i] = layout.stride;
+                    layout.types[i] = static_cast<ePlyType>(type);
+                }
+            }
+
+            layout.stride += get_type_size(type);
+        }
+    }
+
+    if (!binary_little_endian) {
+        spdlog::error("{}: only binary little endian PLY files can be streamed", filename);
+        return false;
+    }
+
+    if (layout.offsets[ATTRIBUTE_X] < 0 || layout.offsets[ATTRIBUTE_Y] < 0 || layout.offsets[ATTRIBUTE_Z] < 0) {
+        spdlog::error("{}: vertices have no position", filename);
+        return false;
+    }
+
+    data_offset = (header_end - data) + strlen(end_marker);
+
+    uint32_t block_count = static_cast<uint32_t>((vertex_count + BLOCK_VERTEX_COUNT - 1) / BLOCK_VERTEX_COUNT);
+    blocks.resize(block_count);
+
+    header_ready = true;
+
+    spdlog::info("Streaming {}: {} vertices in {} blocks, {} bytes per vertex", filename, vertex_count, block_count, layout.stride);
+
+    return true;
+}
+
+void PlyStreamer::decode_block(const sVertexLayout& layout, const uint8_t* data, uint32_t count, sSplatBlock& block)
+{
+    bool has_sh_color = layout.offsets[ATTRIBUTE_F_DC_0] >= 0;
+    bool has_rgb_color = layout.offsets[ATTRIBUTE_RED] >= 0;
+    bool has_opacity = layout.offsets[ATTRIBUTE_OPACITY] >= 0;
+    bool has_scale = layout.offsets[ATTRIBUTE_SCALE_0] >= 0;
+    bool has_rotation = layout.offsets[ATTRIBUTE_ROT_0] >= 0;
+
+    block.positions.resize(count);
+    block.colors.resize(count);
+
+    if (has_scale) {
+        block.scales.resize(count);
+    }
+
+    if (has_rotation) {
+        block.rotations.resize(count);
+    }
+
+    auto read_attribute = [&](const uint8_t* vertex, ePlyAttribute attribute) {
+        return read_value(vertex + layout.offsets[attribute], layout.types[attribute]);
+    };
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t* vertex = data + static_cast<size_t>(i) * layout.stride;
+
+        glm::vec3 position = { read_attribute(vertex, ATTRIBUTE_X), read_attribute(vertex, ATTRIBUTE_Y), read_attribute(vertex, ATTRIBUTE_Z) };
+        block.positions[i] = position;
+        block.bounds.extend(position);
+
+        glm::vec4 color = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        if (has_sh_color) {
+            color.x = 0.5f + SH_C0 * read_attribute(vertex, ATTRIBUTE_F_DC_0);
+            color.y = 0.5f + SH_C0 * read_attribute(vertex, ATTRIBUTE_F_DC_1);
+            color.z = 0.5f + SH_C0 * read_attribute(vertex, ATTRIBUTE_F_DC_2);
+        }
+        else if (has_rgb_color) {
+            float normalization = layout.types[ATTRIBUTE_RED] == PLY_UCHAR ? 1.0f / 255.0f : 1.0f;
+            color.x = read_attribute(vertex, ATTRIBUTE_RED) * normalization;
+            color.y = read_attribute(vertex, ATTRIBUTE_GREEN) * normalization;
+            color.z = read_attribute(vertex, ATTRIBUTE_BLUE) * normalization;
+        }
+
+        if (has_opacity) {
+            color.w = sigmoid(read_attribute(vertex, ATTRIBUTE_OPACITY));
+        }
+
+        block.colors[i] = color;
+
+        // Splat scales are stored as logarithms
+        if (has_scale) {
+            block.scales[i] = {
+                expf(read_attribute(vertex, ATTRIBUTE_SCALE_0)),
+                expf(read_attribute(vertex, ATTRIBUTE_SCALE_1)),
+                expf(read_attribute(vertex, ATTRIBUTE_SCALE_2))
+            };
+        }
+
+        if (has_rotation) {
+            glm::quat rotation = glm::quat(read_attribute(vertex, ATTRIBUTE_ROT_0), read_attribute(vertex, ATTRIBUTE_ROT_1),
+                                           read_attribute(vertex, ATTRIBUTE_ROT_2), read_attribute(vertex, ATTRIBUTE_ROT_3));
+            block.rotations[i] = glm::normalize(rotation);
+        }
+    }
+}
+
+uint32_t PlyStreamer::get_block_vertex_count(uint32_t block_index) const
+{
+    uint64_t first_vertex = static_cast<uint64_t>(block_index) * BLOCK_VERTEX_COUNT;
+    return static_cast<uint32_t>(std::min<uint64_t>(BLOCK_VERTEX_COUNT, vertex_count - first_vertex));
+}
+
+void PlyStreamer::request_block(uint32_t block_index)
+{
+    sBlockInfo& info = blocks[block_index];
+    info.state = BLOCK_LOADING;
+    in_flight_count++;
+
+    uint32_t count = get_block_vertex_count(block_index);
+    uint64_t offset = data_offset + static_cast<uint64_t>(block_index) * BLOCK_VERTEX_COUNT * layout.stride;
+
+#ifdef __EMSCRIPTEN__
+    fetch_range(offset, static_cast<uint64_t>(count) * layout.stride, [](PlyStreamer* streamer, uint32_t fetch_generation, uint32_t block_index, const uint8_t* data, uint64_t size) {
+        if (fetch_generation != streamer->generation) {
+            return;
+        }
+
+        sSplatBlock* block = nullptr;
+
+        if (data) {
+            block = new sSplatBlock();
+            block->block_index = block_index;
+            decode_block(streamer->layout, data, static_cast<uint32_t>(size / streamer->layout.stride), *block);
+        }
+
+        streamer->push_ready_block(fetch_generation, block ? block : new sSplatBlock{ block_index });
+    }, block_index);
+#else
+    const uint8_t* data = mapped_file.get_data() + offset;
+    const sVertexLayout block_layout = layout;
+    uint32_t block_generation = generation;
+
+    active_jobs++;
+
+    JobSystem::submit([this, data, count, block_index, block_layout, block_generation]() {
+        sSplatBlock* block = new sSplatBlock();
+        block->block_index = block_index;
+        decode_block(block_layout, data, count, *block);
+        push_ready_block(block_generation, block);
+        active_jobs--;
+    });
+#endif
+}
+
+void PlyStreamer::push_ready_block(uint32_t block_generation, sSplatBlock* block)
+{
+    std::lock_guard<std::mutex> lock(ready_mutex);
+
+    if (block_generation != generation) {
+        delete block;
+        return;
+    }
+
+    ready_blocks.push_back({ block_generation, block });
+}
+
+void PlyStreamer::evict_block(uint32_t block_index)
+{
+    sBlockInfo& info = blocks[block_index];
+
+    resident_bytes -= info.byte_size;
+
+    delete info.data;
+    info.data = nullptr;
+    info.byte_size = 0;
+    info.state = BLOCK_UNLOADED;
+}
+
+void PlyStreamer::release_block_data(uint32_t block_index)
+{
+    sSplatBlock* block = blocks[block_index].data;
+
+    if (!block) {
+        return;
+    }
+
+    std::vector<glm::vec4>().swap(block->colors);
+    std::vector<glm::vec3>().swap(block->scales);
+    std::vector<glm::quat>().swap(block->rotations);
+}
+
+void PlyStreamer::update(const glm::vec3& eye, float interest_radius, std::vector<sSplatBlock*>& loaded_blocks, std::vector<uint32_t>& evicted_blocks)
+{
+    if (!header_ready) {
+        return;
+    }
+
+    frame++;
+
+    // Collect decoded blocks, a few per frame to spread the uploads
+    {
+        std::lock_guard<std::mutex> lock(ready_mutex);
+
+        while (!ready_blocks.empty() && loaded_blocks.size() < max_uploads_per_update) {
+            sSplatBlock* block = ready_blocks.front().second;
+            ready_blocks.pop_front();
+
+            sBlockInfo& info = blocks[block->block_index];
+            info.state = BLOCK_RESIDENT;
+            info.data = block;
+            info.bounds = block->bounds;
+            info.bounds_known = true;
+            info.last_used_frame = frame;
+            info.byte_size = block->get_byte_size();
+
+            resident_bytes += info.byte_size;
+            in_flight_count--;
+
+            loaded_blocks.push_back(block);
+        }
+    }
+
+    float interest_radius_squared = interest_radius * interest_radius;
+
+    for (sBlockInfo& info : blocks) {
+        if (info.state == BLOCK_RESIDENT && info.bounds.distance_squared(eye) <= interest_radius_squared) {
+            info.last_used_frame = frame;
+        }
+    }
+
+    // Evict least recently used, farthest first on ties, never what is in use this frame
+    while (resident_bytes > memory_budget) {
+        int32_t victim = -1;
+
+        for (uint32_t i = 0; i < blocks.size(); ++i) {
+            const sBlockInfo& info = blocks[i];
+
+            if (info.state != BLOCK_RESIDENT || info.last_used_frame == frame) {
+                continue;
+            }
+
+            if (victim < 0 || info.last_used_frame < blocks[victim].last_used_frame ||
+                (info.last_used_frame == blocks[victim].last_used_frame && info.bounds.distance_squared(eye) > blocks[victim].bounds.distance_squared(eye))) {
+                victim = i;
+            }
+        }
+
+        if (victim < 0) {
+            break;
+        }
+
+        evict_block(victim);
+        evicted_blocks.push_back(victim);
+    }
+
+    uint32_t max_in_flight = std::max(1u, JobSystem::get_worker_count()) * 2u;
+    size_t block_byte_size = BLOCK_VERTEX_COUNT * (sizeof(glm::vec3) * 2 + sizeof(glm::vec4) + sizeof(glm::quat));
+
+    while (in_flight_count < max_in_flight) {
+        // Nearest known block in the interest radius first
+        int32_t candidate = -1;
+        float candidate_distance = interest_radius_squared;
+
+        for (uint32_t i = 0; i < blocks.size(); ++i) {
+            const sBlockInfo& info = blocks[i];
+
+            if (info.state != BLOCK_UNLOADED || !info.bounds_known) {
+                continue;
+            }
+
+            float distance = info.bounds.distance_squared(eye);
+            if (distance <= candidate_distance) {
+                candidate = i;
+                candidate_distance = distance;
+            }
+        }
+
+        // Then keep discovering the bounds of unseen blocks while there is room
+        if (candidate < 0) {
+            while (discovery_cursor < blocks.size() && blocks[discovery_cursor].bounds_known) {
+                discovery_cursor++;
+            }
+
+            size_t pending_bytes = resident_bytes + (in_flight_count + 1) * block_byte_size;
+
+            if (discovery_cursor < blocks.size() && blocks[discovery_cursor].state == BLOCK_UNLOADED && pending_bytes <= memory_budget) {
+                candidate = discovery_cursor++;
+            }
+        }
+
+        if (candidate < 0) {
+            break;
+        }
+
+        request_block(candidate);
+    }
+}
+
+#ifdef __EMSCRIPTEN__
+void PlyStreamer::fetch_range(uint64_t offset, uint64_t size, void (*on_data)(PlyStreamer*, uint32_t, uint32_t, const uint8_t*, uint64_t), uint32_t user_value)
+{
+    struct sFetchRequest {
+        PlyStreamer* streamer;
+        uint32_t generation;
+        uint32_t user_value;
+        void (*on_data)(PlyStreamer*, uint32_t, uint32_t, const uint8_t*, uint64_t);
+        std::string range;
+    };
+
+    sFetchRequest* request = new sFetchRequest{ this, generation, user_value, on_data };
+    request->range = "bytes=" + std::to_string(offset) + "-" + std::to_string(offset + size - 1);
+
+    const char* headers[] = { "Range", request->range.c_str(), nullptr };
+
+    emscripten_fetch_attr_t attr;
+    emscripten_fetch_attr_init(&attr);
+    strcpy(attr.requestMethod, "GET");
+    attr.attributes = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY;
+    attr.requestHeaders = headers;
+    attr.userData = request;
+
+    attr.onsuccess = [](emscripten_fetch_t* fetch) {
+        sFetchRequest* request = static_cast<sFetchRequest*>(fetch->userData);
+        request->on_data(request->streamer, request->generation, request->user_value, reinterpret_cast<const uint8_t*>(fetch->data), fetch->numBytes);
+        delete request;
+        emscripten_fetch_close(fetch);
+    };
+
+    attr.onerror = [](emscripten_fetch_t* fetch) {
+        sFetchRequest* request = static_cast<sFetchRequest*>(fetch->userData);
+        spdlog::error("Range request failed with status {}", fetch->status);
+        request->on_data(request->streamer, request->generation, request->user_value, nullptr, 0);
+        delete request;
+        emscripten_fetch_close(fetch);
+    };
+
+    emscripten_fetch(&attr, filename.c_str());
+}
+#endif
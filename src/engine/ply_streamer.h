@@ -0,0 +1,138 @@
+#pragma once
+
+#include "engine/mapped_file.h"
+#include "vpet/scene_bvh.h"
+
+#include "glm/gtx/quaternion.hpp"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct sSplatBlock {
+    uint32_t block_index = 0;
+    std::vector<glm::vec3> positions;
+    // Alpha holds the opacity
+    std::vector<glm::vec4> colors;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::quat> rotations;
+    sBVHBounds bounds;
+
+    size_t get_byte_size() const;
+};
+
+// Streams the vertices of binary little endian PLY files (points or gaussian splats) in fixed size
+// blocks. The file is memory mapped on desktop and range fetched on web, blocks are decoded on the
+// job system and only a memory budget worth of them stays resident, least recently used go first.
+class PlyStreamer {
+
+public:
+
+    static const uint32_t BLOCK_VERTEX_COUNT = 65536u;
+
+private:
+
+    enum ePlyType : uint8_t {
+        PLY_CHAR, PLY_UCHAR, PLY_SHORT, PLY_USHORT, PLY_INT, PLY_UINT, PLY_FLOAT, PLY_DOUBLE, PLY_UNKNOWN
+    };
+
+    enum ePlyAttribute : uint8_t {
+        ATTRIBUTE_X, ATTRIBUTE_Y, ATTRIBUTE_Z,
+        ATTRIBUTE_F_DC_0, ATTRIBUTE_F_DC_1, ATTRIBUTE_F_DC_2,
+        ATTRIBUTE_RED, ATTRIBUTE_GREEN, ATTRIBUTE_BLUE,
+        ATTRIBUTE_OPACITY,
+        ATTRIBUTE_SCALE_0, ATTRIBUTE_SCALE_1, ATTRIBUTE_SCALE_2,
+        ATTRIBUTE_ROT_0, ATTRIBUTE_ROT_1, ATTRIBUTE_ROT_2, ATTRIBUTE_ROT_3,
+        ATTRIBUTE_COUNT
+    };
+
+    struct sVertexLayout {
+        uint32_t stride = 0;
+        int32_t offsets[ATTRIBUTE_COUNT];
+        ePlyType types[ATTRIBUTE_COUNT];
+    };
+
+    enum eBlockState : uint8_t {
+        BLOCK_UNLOADED, BLOCK_LOADING, BLOCK_RESIDENT
+    };
+
+    struct sBlockInfo {
+        eBlockState state = BLOCK_UNLOADED;
+        bool bounds_known = false;
+        sBVHBounds bounds;
+        uint64_t last_used_frame = 0;
+        sSplatBlock* data = nullptr;
+        // Decoded size, still counted once the uploaded attributes are released
+        size_t byte_size = 0;
+    };
+
+    std::string filename;
+    MappedFile mapped_file;
+
+    sVertexLayout layout;
+    uint64_t vertex_count = 0;
+    uint64_t data_offset = 0;
+    bool header_ready = false;
+
+    std::vector<sBlockInfo> blocks;
+    uint32_t discovery_cursor = 0;
+    uint32_t in_flight_count = 0;
+
+    size_t memory_budget = 512ull * 1024ull * 1024ull;
+    size_t resident_bytes = 0;
+    uint32_t max_uploads_per_update = 4;
+
+    uint64_t frame = 0;
+
+    // Bumped on open and close so stale decodes are dropped
+    uint32_t generation = 0;
+
+    // Decodes still reading the mapped file, close waits for them before unmapping
+    std::atomic<uint32_t> active_jobs = 0;
+
+    std::mutex ready_mutex;
+    std::deque<std::pair<uint32_t, sSplatBlock*>> ready_blocks;
+
+    bool parse_header(const uint8_t* data, size_t size);
+    static void decode_block(const sVertexLayout& layout, const uint8_t* data, uint32_t count, sSplatBlock& block);
+
+    void request_block(uint32_t block_index);
+    void push_ready_block(uint32_t block_generation, sSplatBlock* block);
+    void evict_block(uint32_t block_index);
+
+    uint32_t get_block_vertex_count(uint32_t block_index) const;
+
+#ifdef __EMSCRIPTEN__
+    void fetch_range(uint64_t offset, uint64_t size, void (*on_data)(PlyStreamer*, uint32_t, uint32_t, const uint8_t*, uint64_t), uint32_t user_value);
+#endif
+
+public:
+
+    ~PlyStreamer() { close(); }
+
+    // On web the header arrives asynchronously, is_ready tells when blocks start streaming
+    bool open(const std::string& filename);
+    void close();
+
+    bool is_open() const { return !filename.empty(); }
+    bool is_ready() const { return header_ready; }
+
+    void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+    void set_max_uploads_per_update(uint32_t count) { max_uploads_per_update = count; }
+
+    // Blocks closer than interest_radius to the eye count as used this frame. Returns the decoded blocks
+    // to upload and the blocks whose data was freed, uploaded copies of those should be dropped too.
+    void update(const glm::vec3& eye, float interest_radius, std::vector<sSplatBlock*>& loaded_blocks, std::vector<uint32_t>& evicted_blocks);
+
+    // Drops everything but the positions of an uploaded block, sorting still needs those
+    void release_block_data(uint32_t block_index);
+
+    // Null unless the block is resident
+    const sSplatBlock* get_block(uint32_t block_index) const { return blocks[block_index].data; }
+
+    uint64_t get_vertex_count() const { return vertex_count; }
+    uint32_t get_block_count() const { return blocks.size(); }
+    size_t get_resident_bytes() const { return resident_bytes; }
+};
@@ -20,7 +20,16 @@
 #include "glm/gtx/quaternion.hpp"
 
 #include "engine/scene.h"
+#include "engine/job_system.h"
+#include "engine/stats.h"
+#include "engine/lod_mesh_instance_3d.h"
+#include "engine/splat_sorter.h"
+#include "engine/mapped_file.h"
 #include "vpet/scene_distribution.h"
+#include "vpet/texture_processing.h"
+#include "vpet/mesh_simplification.h"
+#include "vpet/scene_cache.h"
+#include "vpet/rpc_table.h"
 
 #include "spdlog/spdlog.h"
 
@@ -35,8 +44,59 @@
 
 sVPETContext vpet;
 
+// LOD levels generated below full detail for every unique mesh
+const uint32_t TRACER_LOD_COUNT = 3u;
+
+// Clients with round trip and clock offset gauges in the stats
+const uint32_t MAX_CLOCK_STATS_CLIENTS = 16u;
+
+// Light looks selectable through the "Environment" parameter object, over the colors and intensities of the scene
+struct sLightPreset {
+    const char* name;
+    glm::vec3 tint;
+    float intensity_scale;
+};
+
+const sLightPreset LIGHT_PRESETS[] = {
+    { "Scene", { 1.0f, 1.0f, 1.0f }, 1.0f },
+    { "Overcast", { 0.85f, 0.9f, 1.0f }, 0.6f },
+    { "Golden hour", { 1.0f, 0.75f, 0.5f }, 0.8f },
+    { "Night", { 0.45f, 0.55f, 1.0f }, 0.15f }
+};
+
+const int32_t LIGHT_PRESET_COUNT = sizeof(LIGHT_PRESETS) / sizeof(LIGHT_PRESETS[0]);
+
 GltfParser gltf_parser;
 
+uint64_t get_time_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// GLB files are mapped instead of read into a heap copy, the parser decodes from the page cache which the
+// OS can drop again under pressure. Files that cannot be mapped are parsed from disk with the same flags.
+// Returns false for other formats, which go through the regular scene parser
+bool read_mapped_glb(GltfParser& parser, const std::string& filename, std::vector<Node*>& entities, uint32_t flags)
+{
+    if (!filename.ends_with(".glb")) {
+        return false;
+    }
+
+#ifndef __EMSCRIPTEN__
+    MappedFile glb_file;
+
+    if (glb_file.open(filename) && glb_file.get_size() <= UINT32_MAX) {
+        // Read only, the parser does not write to its input
+        parser.read_data(reinterpret_cast<int8_t*>(const_cast<uint8_t*>(glb_file.get_data())), static_cast<uint32_t>(glb_file.get_size()), entities, flags);
+        return true;
+    }
+#endif
+
+    parser.parse(filename.c_str(), entities, flags);
+
+    return true;
+}
+
 int SampleEngine::initialize(Renderer* renderer, sEngineConfiguration configuration)
 {
     int error = Engine::initialize(renderer, configuration);
@@ -45,6 +105,18 @@ int SampleEngine::initialize(Renderer* renderer, sEngineConfiguration configurat
 
     main_scene = new Scene("main_scene");
 
+    JobSystem::initialize();
+
+    // Texture variants offered to TRACER clients along with the source textures
+    vpet.texture_profiles = {
+        { .name = "desktop", .max_size = 4096, .generate_mipmaps = true, .format = eVPETTextureFormat::DXT5 },
+        { .name = "mobile", .max_size = 1024, .generate_mipmaps = true, .format = eVPETTextureFormat::RGBA32 }
+    };
+
+    // Before the scene server can serve them
+    register_rpcs();
+    rpc_table.publish(vpet, vpet_engine_id);
+
 	return error;
 }
 
@@ -80,23 +152,95 @@ int SampleEngine::post_initialize()
 
     //load_glb("data/ContainerCity.glb");
 
+    vpet_scenes.set_default_scene(vpet_engine_id);
+    vpet_scenes.add(vpet_engine_id, &vpet);
+
 #ifndef __EMSCRIPTEN__
     // VPET connection
     {
         context = zmq_ctx_new();
 
+        // One I/O thread per plane, scene payloads never share a queue with updates
+        zmq_ctx_set(context, ZMQ_IO_THREADS, 2);
+
         {
             // Handles scene distribution
-            distributor = zmq_socket(context, ZMQ_REP);
-            int rc = zmq_bind(distributor, "tcp://127.0.0.1:5555");
-            assert(rc == 0);
+            scene_server.start(context, "tcp://127.0.0.1:5555", &vpet_scenes, &vpet_mutex, 2);
 
             // Handles scene updates
             subscriber = zmq_socket(context, ZMQ_SUB);
-            rc = zmq_connect(subscriber, "tcp://127.0.0.1:5556");
+            uint64_t affinity = 1u;
+            zmq_setsockopt(subscriber, ZMQ_AFFINITY, &affinity, sizeof(uint64_t));
+            int rc = zmq_connect(subscriber, "tcp://127.0.0.1:5556");
+            assert(rc == 0);
             zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
-            int opt_val = 1;
-            zmq_setsockopt(subscriber, ZMQ_RCVTIMEO, &opt_val, sizeof(int));
+
+            // Pings go through the server like the updates of the clients
+            publisher = zmq_socket(context, ZMQ_PUB);
+            zmq_setsockopt(publisher, ZMQ_AFFINITY, &affinity, sizeof(uint64_t));
+            rc = zmq_connect(publisher, "tcp://127.0.0.1:5557");
+            assert(rc == 0);
+
+            // Interest plane, clients subscribe to their own id. DIGITAL_LOCATIONS_INTEREST_ENDPOINT=endpoint, "off"
+            // disables the fan-out
+            const char* interest_endpoint = getenv("DIGITAL_LOCATIONS_INTEREST_ENDPOINT");
+            std::string endpoint = interest_endpoint ? interest_endpoint : "tcp://127.0.0.1:5559";
+
+            if (endpoint != "off") {
+                interest_publisher = zmq_socket(context, ZMQ_PUB);
+                zmq_setsockopt(interest_publisher, ZMQ_AFFINITY, &affinity, sizeof(uint64_t));
+
+                if (zmq_bind(interest_publisher, endpoint.c_str()) != 0) {
+                    spdlog::error("Could not bind interest socket to {}, interest fan-out disabled", endpoint);
+                    zmq_close(interest_publisher);
+                    interest_publisher = nullptr;
+                }
+            }
+
+            client_clocks.initialize(sVPETHeader().frame_rate, get_time_us());
+        }
+
+        // DIGITAL_LOCATIONS_SCENE_CACHE=directory, "off" disables it
+        const char* cache_directory = getenv("DIGITAL_LOCATIONS_SCENE_CACHE");
+        scene_cache_directory = cache_directory ? cache_directory : "cache";
+
+        if (scene_cache_directory == "off") {
+            scene_cache_directory.clear();
+        }
+
+        // DIGITAL_LOCATIONS_REPLAY=capture.bin, DIGITAL_LOCATIONS_REPLAY_SPEED=1 (default), 4, max...
+        if (const char* replay_path = getenv("DIGITAL_LOCATIONS_REPLAY")) {
+            float speed = 1.0f;
+
+            if (const char* replay_speed = getenv("DIGITAL_LOCATIONS_REPLAY_SPEED")) {
+                speed = std::string(replay_speed) == "max" ? 0.0f : static_cast<float>(atof(replay_speed));
+            }
+
+            if (update_replayer.open(replay_path)) {
+                // Nothing may be dropped while measuring
+                int high_water_mark = 0;
+                zmq_setsockopt(subscriber, ZMQ_RCVHWM, &high_water_mark, sizeof(int));
+
+                update_replayer.start(context, "inproc://tracer_replay", speed, true);
+                zmq_connect(subscriber, "inproc://tracer_replay");
+                replaying = true;
+            }
+        }
+
+        if (const char* capture_path = getenv("DIGITAL_LOCATIONS_CAPTURE")) {
+            update_capture.open(capture_path);
+        }
+
+        // DIGITAL_LOCATIONS_SMOOTHING=delay in ms, e.g. 100, off by default
+        if (const char* smoothing_delay = getenv("DIGITAL_LOCATIONS_SMOOTHING")) {
+            int delay_ms = atoi(smoothing_delay);
+            smoothing_enabled = delay_ms > 0;
+            jitter_buffer.delay_us = static_cast<uint64_t>(std::max(delay_ms, 0)) * 1000u;
+        }
+
+        // DIGITAL_LOCATIONS_INTEREST_HYSTERESIS=meters, 1 by default
+        if (const char* interest_hysteresis = getenv("DIGITAL_LOCATIONS_INTEREST_HYSTERESIS")) {
+            interest_manager.set_hysteresis(std::max(static_cast<float>(atof(interest_hysteresis)), 0.0f));
         }
 
         // (Using WebSockets)
@@ -119,19 +263,80 @@ int SampleEngine::post_initialize()
     }
 #endif
 
+    // DIGITAL_LOCATIONS_SKINNING=cpu for headless runs, skinned meshes are deformed by the renderer otherwise
+    if (const char* skinning_mode = getenv("DIGITAL_LOCATIONS_SKINNING")) {
+        character_skinning.cpu_skinning = std::string(skinning_mode) == "cpu";
+    }
+
+    // DIGITAL_LOCATIONS_GEOMETRY_POOL=off draws every tracer mesh on its own
+    if (const char* geometry_pool_mode = getenv("DIGITAL_LOCATIONS_GEOMETRY_POOL")) {
+        geometry_pool_enabled = std::string(geometry_pool_mode) != "off";
+    }
+
+    // DIGITAL_LOCATIONS_STATS=log and/or socket, off by default
+    if (const char* stats_mode = getenv("DIGITAL_LOCATIONS_STATS")) {
+        std::string mode = stats_mode;
+
+        Stats::sConfiguration stats_configuration;
+        stats_configuration.dump_to_log = mode.find("log") != std::string::npos;
+#ifndef __EMSCRIPTEN__
+        if (mode.find("socket") != std::string::npos) {
+            stats_configuration.zmq_context = context;
+        }
+#endif
+        Stats::initialize(stats_configuration);
+    }
+
     return 0;
 }
 
 void SampleEngine::clean()
 {
+#ifndef __EMSCRIPTEN__
+    // Before anything it serves from goes away
+    scene_server.stop();
+#endif
+
+    upload_queue.clear();
+    geometry_pool.clear();
+    transform_hierarchy.clear();
+    character_skinning.clear();
+    curve_playback.clear();
+    jitter_buffer.clear();
+    lock_table.clear();
+    interest_manager.clear();
+
+    // Contexts hand their assets back while the pool is still there
+    for (auto& [scene_id, hosted_scene] : hosted_scenes) {
+        vpet_scenes.remove(scene_id);
+    }
+
+    hosted_scenes.clear();
+    vpet.clean();
+    vpet.asset_pool = nullptr;
+
     Engine::clean();
 
+    Stats::clean();
+
 #ifndef __EMSCRIPTEN__
-    zmq_close(distributor);
+    update_replayer.stop();
+    update_capture.close();
+
     zmq_close(subscriber);
+    zmq_close(publisher);
+    if (interest_publisher) {
+        zmq_close(interest_publisher);
+        interest_publisher = nullptr;
+    }
+
     zmq_ctx_destroy(context);
 #endif
 
+    splat_sorter.wait();
+    ply_streamer.close();
+
+    JobSystem::clean();
 }
 
 #ifndef __EMSCRIPTEN__
@@ -139,343 +344,892 @@ void SampleEngine::clean()
 
 void SampleEngine::process_vpet_msg()
 {
-    // Check if any message is received
-    zmq_pollitem_t item;
-    item.socket = distributor;
-    item.fd = 0;
-    item.events = ZMQ_POLLIN;
-
-    int rc = zmq_poll(&item, 1, 0);
-
-    if (rc > 0 && item.revents != 0) {
-        // If so check message type and send data
-        spdlog::info("Messsage received...");
-
-        char buffer[64];
-        std::string buffer_str;
-        int msg_size = zmq_recv(distributor, buffer, 64, 0);
-        buffer_str.reserve(msg_size);
-        buffer_str.assign(buffer, msg_size);
+    static const uint32_t process_timer = Stats::get_metric("vpet.process_msg", Stats::METRIC_TIMER);
+    static const uint32_t pending_updates_gauge = Stats::get_metric("vpet.updates_pending", Stats::METRIC_GAUGE);
+    static const uint32_t apply_latency_timer = Stats::get_metric("vpet.apply_latency", Stats::METRIC_TIMER);
 
-        uint8_t* byte_array = nullptr;
+    ScopedTimer timer(process_timer);
 
-        spdlog::info("Requested: {}", buffer_str);
+    uint64_t now_us = get_time_us();
 
-        uint32_t byte_array_size = get_scene_request_buffer(distributor, buffer_str, vpet, &byte_array);
-
-        zmq_send(distributor, byte_array, byte_array_size, 0);
-
-        if (byte_array) {
-            delete byte_array;
-        }
+    if (now_us - last_ping_us >= static_cast<uint64_t>(ping_interval * 1e6f)) {
+        send_ping(now_us);
+        send_animation_states();
+        last_ping_us = now_us;
     }
 
-    {
+    expire_locks(now_us);
+
+    // Scene requests are answered by scene_server, everything waiting here is applied this frame
+    for (uint32_t message_idx = 0u; message_idx < max_updates_per_frame; ++message_idx) {
         zmq_msg_t message;
         zmq_msg_init(&message);
-        zmq_msg_recv(&message, subscriber, 0);
+
+        if (zmq_msg_recv(&message, subscriber, ZMQ_DONTWAIT) < 0) {
+            zmq_msg_close(&message);
+            break;
+        }
 
         uint32_t msg_size = zmq_msg_size(&message);
-        uint8_t* buffer = reinterpret_cast<uint8_t*>(zmq_msg_data(&message));
+        const uint8_t* buffer = reinterpret_cast<const uint8_t*>(zmq_msg_data(&message));
 
         if (msg_size > 0) {
 
-            uint32_t buffer_ptr = 0;
-
-            uint8_t client_id = buffer[buffer_ptr];
-            buffer_ptr += sizeof(uint8_t);
-
-            uint8_t time = buffer[buffer_ptr];
-            buffer_ptr += sizeof(uint8_t);
+            update_capture.write(buffer, msg_size);
 
-            eVPETMessageType message_type = static_cast<eVPETMessageType>(buffer[buffer_ptr]);
-            buffer_ptr += sizeof(uint8_t);
+            apply_vpet_message(buffer, msg_size);
 
-            //switch (message_type) {
-            //case eVPETMessageType::PARAMETER_UPDATE:
-            //    spdlog::info("MSG: PARAM UPDATE");
-            //    break;
-            //case eVPETMessageType::SYNC:
-            //    spdlog::info("MSG: SYNC");
-            //    break;
-            //default:
-            //    spdlog::info("MSG: {}", static_cast<uint8_t>(message_type));
-            //}
-
-            if (message_type == eVPETMessageType::PARAMETER_UPDATE) {
-                while (buffer_ptr < msg_size) {
-
-                    uint8_t scene_id = buffer[buffer_ptr];
-                    buffer_ptr += sizeof(uint8_t);
-
-                    uint16_t scene_object_id;
-                    memcpy(&scene_object_id, &buffer[buffer_ptr], sizeof(uint16_t));
-                    buffer_ptr += sizeof(uint16_t);
-
-                    scene_object_id--;
-
-                    uint16_t parameter_id;
-                    memcpy(&parameter_id, &buffer[buffer_ptr], sizeof(uint16_t));
-                    buffer_ptr += sizeof(uint16_t);
-
-                    eVPETParameterType param_type = static_cast<eVPETParameterType>(buffer[buffer_ptr]);
-                    buffer_ptr += sizeof(uint8_t);
-
-                    uint32_t param_length = buffer[buffer_ptr];
-                    buffer_ptr += sizeof(uint32_t);
-
-                    assert(scene_object_id < vpet.node_list.size());
-
-                    sVPETNode* vpet_node = vpet.editables_node_list[scene_object_id];
-                    Node3D* node_ref = vpet_node->node_ref;
-
-                    if (!node_ref) {
-                        return;
-                        zmq_msg_close(&message);
-                    }
-
-                    float f32;
-                    glm::vec2 vector2;
-                    glm::vec3 vector3;
-                    glm::vec4 vector4;
-                    glm::quat rotation;
-
-                    switch (param_type)
-                    {
-                    case eVPETParameterType::FLOAT: {
-                        memcpy(&f32, &buffer[buffer_ptr], sizeof(float));
-                        buffer_ptr += sizeof(float);
-                        break;
-                    }
-                    case eVPETParameterType::VECTOR2: {
-                        memcpy(&vector2[0], &buffer[buffer_ptr], sizeof(glm::vec2));
-                        //spdlog::info("Vec2: {}, {}", vector2.x, vector2.y);
-                        buffer_ptr += sizeof(glm::vec2);
-                        break;
-                    }
-                    case eVPETParameterType::VECTOR3: {
-                        memcpy(&vector3[0], &buffer[buffer_ptr], sizeof(glm::vec3));
-                        //spdlog::info("Vec3: {}, {}, {}", vector3.x, vector3.y, vector3.z);
-                        buffer_ptr += sizeof(glm::vec3);
-                        break;
-                    }
-                    case eVPETParameterType::COLOR: {
-                        memcpy(&vector4[0], &buffer[buffer_ptr], sizeof(glm::vec4));
-                        //spdlog::info("Color: {}, {}, {}, {}", vector4.x, vector4.y, vector4.z, vector4.w);
-                        buffer_ptr += sizeof(glm::vec4);
-                        break;
-                    }
-                    case eVPETParameterType::QUATERNION: {
-                        memcpy(&rotation[0], &buffer[buffer_ptr], sizeof(glm::quat));
-                        //spdlog::info("Rot: {}, {}, {}, {}", rotation.x, rotation.y, rotation.z, rotation.w);
-                        buffer_ptr += sizeof(glm::quat);
-                        break;
-                    }
-                    default:
-                        assert(0);
-                        break;
-                    }
-
-                    switch (parameter_id) {
-                    case 0:
-                        vector3.z = -vector3.z;
-                        node_ref->set_position(vector3);
-                        break;
-                    case 1:
-                        rotation.x = -rotation.x;
-                        rotation.y = -rotation.y;
-                        node_ref->set_rotation(rotation);
-                        break;
-                    case 2:
-                        node_ref->set_scale(vector3);
-                        break;
-                    case 3:
-                        if (vpet_node->node_type == eVPETNodeType::LIGHT) {
-                            Light3D* light_ref = static_cast<Light3D*>(node_ref);
-                            light_ref->set_color(vector4);
-                        }
-                        break;
-                    case 4:
-                        if (vpet_node->node_type == eVPETNodeType::LIGHT) {
-                            Light3D* light_ref = static_cast<Light3D*>(node_ref);
-                            light_ref->set_intensity(f32);
-                        }
-                        break;
-                    case 5:
-                        if (vpet_node->node_type == eVPETNodeType::LIGHT) {
-                            Light3D* light_ref = static_cast<Light3D*>(node_ref);
-                            light_ref->set_range(f32 * 2.0f);
-                        }
-                        break;
-                    default:
-                        assert(0);
-                    }
-                }
+            if (replaying) {
+                Stats::add_time(apply_latency_timer, update_replayer.mark_applied());
             }
         }
 
         zmq_msg_close(&message);
     }
-}
 
-#endif
+    if (replaying && update_replayer.is_finished() && update_replayer.get_pending_count() == 0u) {
+        update_replayer.log_summary();
+        replaying = false;
+    }
 
-void SampleEngine::update(float delta_time)
+    // ZMQ does not expose queue lengths, this only tells whether updates are still waiting after the drain
+    if (Stats::is_enabled()) {
+        int events = 0;
+        size_t events_size = sizeof(events);
+        zmq_getsockopt(subscriber, ZMQ_EVENTS, &events, &events_size);
+        Stats::set_gauge(pending_updates_gauge, (events & ZMQ_POLLIN) ? 1u : 0u);
+    }
+}
+
+void SampleEngine::apply_vpet_message(const uint8_t* buffer, uint32_t msg_size)
 {
-#ifndef __EMSCRIPTEN__
-    process_vpet_msg();
+    static const uint32_t updates_counter = Stats::get_metric("vpet.updates_applied", Stats::METRIC_COUNTER);
+    static const uint32_t update_latency_histogram = Stats::get_metric("vpet.update_latency", Stats::METRIC_HISTOGRAM);
+    // Updates of clients without a ping reply since the last SYNC, stock clients never reply
+    static const uint32_t unmeasured_updates_counter = Stats::get_metric("vpet.updates_unmeasured", Stats::METRIC_COUNTER);
+    static const uint32_t suppressed_updates_counter = Stats::get_metric("vpet.updates_suppressed", Stats::METRIC_COUNTER);
+    static const uint32_t rejected_updates_counter = Stats::get_metric("vpet.updates_rejected", Stats::METRIC_COUNTER);
+
+    if (msg_size < 3u) {
+        return;
+    }
 
-    //// RECEIVE SCENE REQ DATA
-    //{
-    //    zmq_msg_t message;
-    //    zmq_msg_init(&message);
-    //    zmq_msg_recv(&message, distributor, 0);
-    //    uint32_t msg_size = zmq_msg_size(&message);
-    //    if (msg_size) {
-    //        char* buffer = reinterpret_cast<char*>(zmq_msg_data(&message));
-    //        std::string str(buffer, msg_size);
-    //        spdlog::info(str);
-    //    }
-    //}
+    uint32_t buffer_ptr = 0;
 
-    //// SEND UPDATES
-    //{
-    //    std::string data = "Scene update!";
-    //    zmq_send(publisher, data.data(), data.size(), 0);
-    //}
+    uint8_t client_id = buffer[buffer_ptr];
+    buffer_ptr += sizeof(uint8_t);
 
-#endif
+    uint8_t time = buffer[buffer_ptr];
+    buffer_ptr += sizeof(uint8_t);
 
-    const std::vector<Node*>& scene_nodes = main_scene->get_nodes();
+    eVPETMessageType message_type = static_cast<eVPETMessageType>(buffer[buffer_ptr]);
+    buffer_ptr += sizeof(uint8_t);
 
-    if (rotate_scene) {
-        for (auto node : scene_nodes) {
-            MeshInstance3D* mesh_node = dynamic_cast<MeshInstance3D*>(node);
-            if (mesh_node) {
-                mesh_node->rotate(delta_time, normals::pY);
-            }
-        }
+    // Our own pings come back from the server
+    if (client_id == vpet_engine_id) {
+        return;
     }
 
-    Engine::update(delta_time);
+    uint64_t now_us = get_time_us();
 
-    main_scene->update(delta_time);
-    skybox->update(delta_time);
+    if (message_type == eVPETMessageType::SYNC) {
+        client_clocks.sync(time, now_us);
+        return;
+    }
 
-    //if (Input::was_key_pressed(GLFW_KEY_O)) {
-    //    set_camera_type(CAMERA_ORBIT);
-    //}
+    // A bare ping asks for an answer, one carrying our id and time answers ours
+    if (message_type == eVPETMessageType::PING) {
+        if (msg_size >= 5u && buffer[3] == vpet_engine_id) {
+            if (client_clocks.on_ping_reply(client_id, time, buffer[4], now_us)) {
+                update_client_clock_stats(client_id);
+            }
+        }
+        else {
+            answer_ping(client_id, time, now_us);
+        }
+        return;
+    }
 
-    //if (Input::was_key_pressed(GLFW_KEY_F)) {
-    //    set_camera_type(CAMERA_FLYOVER);
-    //}
+    if (message_type == eVPETMessageType::LOCK) {
+        apply_lock_message(client_id, buffer, msg_size, now_us);
+        return;
+    }
 
-    // Interpolate current camera position
-    if (target_camera_idx != -1)
-    {
-        // Lerp eye
-        glm::vec3 new_eye = cameras[target_camera_idx]->get_translation();
-        eye_lerp.value = smooth_damp(eye_lerp.value, new_eye, &eye_lerp.velocity, 0.75f / camera_interp_speed, 20.0f, delta_time);
+    if (message_type == eVPETMessageType::INTEREST) {
+        apply_interest_message(client_id, buffer, msg_size, now_us);
+        return;
+    }
 
-        Camera* camera = renderer->get_camera();
-        camera->look_at(eye_lerp.value, camera->get_center(), camera->get_up());
+    if (message_type == eVPETMessageType::RPC) {
+        static const uint32_t rpc_calls_counter = Stats::get_metric("vpet.rpc_calls", Stats::METRIC_COUNTER);
+        static const uint32_t rejected_rpcs_counter = Stats::get_metric("vpet.rpc_rejected", Stats::METRIC_COUNTER);
 
-        if (glm::distance(eye_lerp.value, new_eye) < 0.01f)
-        {
-            target_camera_idx = -1;
-        }
+        uint32_t rejected = 0u;
+        Stats::add_count(rpc_calls_counter, rpc_table.dispatch(buffer, msg_size, rejected));
+        Stats::add_count(rejected_rpcs_counter, rejected);
+        return;
     }
 
-    if (lerp_center) {
-        // Lerp center
-        center_lerp.value = smooth_damp(center_lerp.value, target_center, &center_lerp.velocity, 0.25f, 20.0f, delta_time);
+    uint64_t send_us = now_us;
 
-        Camera* camera = renderer->get_camera();
-        camera->look_at(camera->get_eye(), center_lerp.value, camera->get_up());
+    if (message_type == eVPETMessageType::PARAMETER_UPDATE || message_type == eVPETMessageType::ANIMATION) {
+        // Applied within this frame
+        uint64_t latency_us = 0u;
 
-        if (glm::distance(center_lerp.value, target_center) < 0.01f)
-        {
-            lerp_center = false;
+        if (client_clocks.get_latency(client_id, time, now_us, latency_us)) {
+            Stats::add_time(update_latency_histogram, latency_us);
+        }
+        else {
+            Stats::add_count(unmeasured_updates_counter);
         }
+
+        // Stamps of the jitter buffer, unmeasured clients are spread by their own steps
+        send_us = client_clocks.get_send_time(client_id, time, now_us);
     }
-}
 
-void SampleEngine::render()
-{
-#ifndef __EMSCRIPTEN__
-    render_default_gui();
-#endif
+    if (message_type == eVPETMessageType::ANIMATION) {
+        apply_animation_message(buffer, msg_size, now_us - send_us);
+        return;
+    }
 
-    skybox->render();
-    main_scene->render();
+    //switch (message_type) {
+    //case eVPETMessageType::PARAMETER_UPDATE:
+    //    spdlog::info("MSG: PARAM UPDATE");
+    //    break;
+    //case eVPETMessageType::SYNC:
+    //    spdlog::info("MSG: SYNC");
+    //    break;
+    //default:
+    //    spdlog::info("MSG: {}", static_cast<uint8_t>(message_type));
+    //}
 
-	Engine::render();
-}
+    if (message_type == eVPETMessageType::PARAMETER_UPDATE) {
+        while (buffer_ptr < msg_size) {
 
-#ifdef __EMSCRIPTEN__
-extern "C" {
-#endif
-void append_glb_data(int8_t* byte_array, uint32_t array_size)
-{
-    SampleEngine::get_sample_instance()->append_glb_data(byte_array, array_size);
-}
-#ifdef __EMSCRIPTEN__
-}
-#endif
+            uint8_t scene_id = buffer[buffer_ptr];
+            buffer_ptr += sizeof(uint8_t);
 
-#ifdef __EMSCRIPTEN__
-extern "C" {
-#endif
-void set_scene_objects(int8_t* byte_array, uint32_t array_size)
-{
-    uint32_t buffer_ptr = 0u;
+            uint16_t scene_object_id;
+            memcpy(&scene_object_id, &buffer[buffer_ptr], sizeof(uint16_t));
+            buffer_ptr += sizeof(uint16_t);
 
-    while (buffer_ptr < array_size) {
+            scene_object_id--;
 
-        sVPETMesh* mesh = new sVPETMesh();
+            uint16_t parameter_id;
+            memcpy(&parameter_id, &buffer[buffer_ptr], sizeof(uint16_t));
+            buffer_ptr += sizeof(uint16_t);
 
-        // Vertices
-        {
-            uint32_t vertices_size = 0u;
-            memcpy(&vertices_size, &byte_array[buffer_ptr], sizeof(uint32_t));
+            eVPETParameterType param_type = static_cast<eVPETParameterType>(buffer[buffer_ptr]);
+            buffer_ptr += sizeof(uint8_t);
+
+            uint32_t param_length = buffer[buffer_ptr];
             buffer_ptr += sizeof(uint32_t);
 
-            if (vertices_size > 0u) {
-                mesh->vertex_array.resize(vertices_size);
-                memcpy(mesh->vertex_array.data(), &byte_array[buffer_ptr], vertices_size * sizeof(glm::vec3));
-                buffer_ptr += vertices_size * sizeof(glm::vec3);
+            float f32;
+            glm::vec2 vector2;
+            glm::vec3 vector3;
+            glm::vec4 vector4;
+            glm::quat rotation;
+
+            switch (param_type)
+            {
+            case eVPETParameterType::FLOAT: {
+                memcpy(&f32, &buffer[buffer_ptr], sizeof(float));
+                buffer_ptr += sizeof(float);
+                break;
+            }
+            case eVPETParameterType::VECTOR2: {
+                memcpy(&vector2[0], &buffer[buffer_ptr], sizeof(glm::vec2));
+                //spdlog::info("Vec2: {}, {}", vector2.x, vector2.y);
+                buffer_ptr += sizeof(glm::vec2);
+                break;
+            }
+            case eVPETParameterType::VECTOR3: {
+                memcpy(&vector3[0], &buffer[buffer_ptr], sizeof(glm::vec3));
+                //spdlog::info("Vec3: {}, {}, {}", vector3.x, vector3.y, vector3.z);
+                buffer_ptr += sizeof(glm::vec3);
+                break;
+            }
+            case eVPETParameterType::COLOR: {
+                memcpy(&vector4[0], &buffer[buffer_ptr], sizeof(glm::vec4));
+                //spdlog::info("Color: {}, {}, {}, {}", vector4.x, vector4.y, vector4.z, vector4.w);
+                buffer_ptr += sizeof(glm::vec4);
+                break;
+            }
+            case eVPETParameterType::QUATERNION: {
+                memcpy(&rotation[0], &buffer[buffer_ptr], sizeof(glm::quat));
+                //spdlog::info("Rot: {}, {}, {}, {}", rotation.x, rotation.y, rotation.z, rotation.w);
+                buffer_ptr += sizeof(glm::quat);
+                break;
+            }
+            default:
+                assert(0);
+                break;
             }
-        }
 
-        // Indices
-        {
-            uint32_t indices_size = 0u;
-            memcpy(&indices_size, &byte_array[buffer_ptr], sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
+            // Hosted scenes are not drawn, their nodes are set right away and only their served bounds follow
+            sHostedScene* hosted_scene = find_hosted_scene(scene_id);
 
-            if (indices_size > 0u) {
-                mesh->index_array.resize(indices_size);
-                memcpy(mesh->index_array.data(), &byte_array[buffer_ptr], indices_size * sizeof(uint32_t));
-                buffer_ptr += indices_size * sizeof(uint32_t);
+            if (!hosted_scene && scene_id != vpet_engine_id) {
+                Stats::add_count(rejected_updates_counter);
+                continue;
             }
-        }
 
-        // Normals
-        {
-            uint32_t normals_size = 0u;
-            memcpy(&normals_size, &byte_array[buffer_ptr], sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
+            sVPETContext& scene = hosted_scene ? hosted_scene->vpet : vpet;
+            LockTable& scene_locks = hosted_scene ? hosted_scene->lock_table : lock_table;
+            bool smoothed = smoothing_enabled && !hosted_scene;
 
-            if (normals_size > 0u) {
-                mesh->normal_array.resize(normals_size);
-                memcpy(mesh->normal_array.data(), &byte_array[buffer_ptr], normals_size * sizeof(glm::vec3));
-                buffer_ptr += normals_size * sizeof(glm::vec3);
+            // Someone else holds the object, nothing of the scene is touched
+            if (!scene_locks.accepts(scene_object_id, client_id, now_us)) {
+                Stats::add_count(suppressed_updates_counter);
+                continue;
             }
-        }
 
-        // Uvs
-        {
-            uint32_t uvs_size = 0u;
+            if (scene_object_id >= scene.editables_node_list.size()) {
+                Stats::add_count(rejected_updates_counter);
+                continue;
+            }
+
+            sVPETNode* vpet_node = scene.editables_node_list[scene_object_id];
+            Node3D* node_ref = vpet_node->node_ref;
+
+            if (!node_ref) {
+                break;
+            }
+
+            auto mark_moved = [&]() {
+                if (hosted_scene) {
+                    hosted_scene->moved_vpet_nodes.push_back(vpet_node);
+                    hosted_scene->interest_manager.mark_dirty(vpet_node);
+                }
+                else {
+                    mark_node_moved(node_ref, vpet_node);
+                    interest_manager.mark_dirty(vpet_node);
+                }
+            };
+
+            switch (parameter_id) {
+            case 0:
+                vector3.z = -vector3.z;
+                if (smoothed) {
+                    jitter_buffer.push(vpet_node, JitterBuffer::CHANNEL_POSITION, glm::vec4(vector3, 0.0f), send_us);
+                    break;
+                }
+                node_ref->set_position(vector3);
+                mark_moved();
+                break;
+            case 1:
+                rotation.x = -rotation.x;
+                rotation.y = -rotation.y;
+                if (smoothed) {
+                    jitter_buffer.push(vpet_node, JitterBuffer::CHANNEL_ROTATION, glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w), send_us);
+                    break;
+                }
+                node_ref->set_rotation(rotation);
+                mark_moved();
+                break;
+            case 2:
+                if (smoothed) {
+                    jitter_buffer.push(vpet_node, JitterBuffer::CHANNEL_SCALE, glm::vec4(vector3, 0.0f), send_us);
+                    break;
+                }
+                node_ref->set_scale(vector3);
+                mark_moved();
+                break;
+            case 3:
+                if (vpet_node->node_type == eVPETNodeType::LIGHT) {
+                    Light3D* light_ref = static_cast<Light3D*>(node_ref);
+                    light_ref->set_color(vector4);
+                }
+                break;
+            case 4:
+                if (vpet_node->node_type == eVPETNodeType::LIGHT) {
+                    Light3D* light_ref = static_cast<Light3D*>(node_ref);
+                    light_ref->set_intensity(f32);
+                }
+                break;
+            case 5:
+                if (vpet_node->node_type == eVPETNodeType::LIGHT) {
+                    Light3D* light_ref = static_cast<Light3D*>(node_ref);
+                    light_ref->set_range(f32 * 2.0f);
+                }
+                break;
+            default:
+                assert(0);
+            }
+
+            Stats::add_count(updates_counter);
+        }
+    }
+}
+
+void SampleEngine::apply_smoothed_transforms()
+{
+    static const uint32_t smoothed_nodes_gauge = Stats::get_metric("vpet.smoothed_nodes", Stats::METRIC_GAUGE);
+
+    smoothed_vpet_nodes.clear();
+    jitter_buffer.update(get_time_us(), smoothed_vpet_nodes);
+
+    for (sVPETNode* vpet_node : smoothed_vpet_nodes) {
+        mark_node_moved(vpet_node->node_ref, vpet_node);
+        interest_manager.mark_dirty(vpet_node);
+    }
+
+    Stats::set_gauge(smoothed_nodes_gauge, jitter_buffer.get_track_count());
+}
+
+void SampleEngine::send_poses()
+{
+    static const uint32_t pose_bytes_counter = Stats::get_metric("vpet.pose_bytes", Stats::METRIC_COUNTER);
+
+    uint8_t time = client_clocks.get_time(get_time_us());
+    uint32_t message_count = character_skinning.write_pose_messages(vpet_engine_id, time, vpet_engine_id, pose_messages);
+
+    for (uint32_t i = 0u; i < message_count; ++i) {
+        zmq_send(publisher, pose_messages[i].data(), pose_messages[i].size(), ZMQ_DONTWAIT);
+        Stats::add_count(pose_bytes_counter, pose_messages[i].size());
+    }
+}
+
+void SampleEngine::apply_lock_message(uint8_t client_id, const uint8_t* buffer, uint32_t msg_size, uint64_t now_us)
+{
+    static const uint32_t contended_locks_counter = Stats::get_metric("vpet.locks_contended", Stats::METRIC_COUNTER);
+    static const uint32_t rejected_updates_counter = Stats::get_metric("vpet.updates_rejected", Stats::METRIC_COUNTER);
+
+    // Header, scene id, object id, lock state
+    if (msg_size < 7u) {
+        return;
+    }
+
+    uint32_t buffer_ptr = 3u;
+
+    uint8_t scene_id = buffer[buffer_ptr];
+    buffer_ptr += sizeof(uint8_t);
+
+    uint16_t scene_object_id;
+    memcpy(&scene_object_id, &buffer[buffer_ptr], sizeof(uint16_t));
+    buffer_ptr += sizeof(uint16_t);
+
+    scene_object_id--;
+
+    sHostedScene* hosted_scene = find_hosted_scene(scene_id);
+
+    if (!hosted_scene && scene_id != vpet_engine_id) {
+        Stats::add_count(rejected_updates_counter);
+        return;
+    }
+
+    const sVPETContext& scene = hosted_scene ? hosted_scene->vpet : vpet;
+    LockTable& scene_locks = hosted_scene ? hosted_scene->lock_table : lock_table;
+
+    if (scene_object_id >= scene.editables_node_list.size()) {
+        return;
+    }
+
+    bool locked = buffer[buffer_ptr] != 0u;
+
+    // The server relays every lock message to all clients, when the request is refused the lock is restated
+    // so nobody takes the object as free or as held by the wrong client
+    if (locked) {
+        uint8_t owner = 0u;
+
+        if (!scene_locks.lock(scene_object_id, client_id, now_us, owner)) {
+            spdlog::debug("Client {} asked for object {} held by client {}", client_id, scene_object_id, owner);
+            Stats::add_count(contended_locks_counter);
+            send_lock(scene_id, scene_object_id, true);
+        }
+    }
+    else if (!scene_locks.unlock(scene_object_id, client_id) && !scene_locks.accepts(scene_object_id, client_id, now_us)) {
+        send_lock(scene_id, scene_object_id, true);
+    }
+}
+
+void SampleEngine::send_lock(uint8_t scene_id, uint16_t object_id, bool locked)
+{
+    uint8_t message[7] = { vpet_engine_id, client_clocks.get_time(get_time_us()), static_cast<uint8_t>(eVPETMessageType::LOCK), scene_id };
+
+    // Object ids go out one based, as the clients use them
+    uint16_t scene_object_id = object_id + 1u;
+    memcpy(&message[4], &scene_object_id, sizeof(uint16_t));
+    message[6] = locked ? 1u : 0u;
+
+    zmq_send(publisher, message, sizeof(message), ZMQ_DONTWAIT);
+}
+
+void SampleEngine::expire_locks(uint64_t now_us)
+{
+    static const uint32_t expired_locks_counter = Stats::get_metric("vpet.locks_expired", Stats::METRIC_COUNTER);
+    static const uint32_t locks_gauge = Stats::get_metric("vpet.locks_held", Stats::METRIC_GAUGE);
+
+    // The owner is gone, free the object on every client
+    auto expire_scene_locks = [&](uint8_t scene_id, LockTable& scene_locks) {
+        expired_locks.clear();
+        scene_locks.expire(now_us, expired_locks);
+
+        for (const LockTable::sLockChange& change : expired_locks) {
+            spdlog::info("Lock of object {} in scene {} by client {} expired", change.object_id, scene_id, change.owner);
+            send_lock(scene_id, change.object_id, false);
+            Stats::add_count(expired_locks_counter);
+        }
+
+        return scene_locks.get_locked_count();
+    };
+
+    uint32_t locked_count = expire_scene_locks(vpet_engine_id, lock_table);
+
+    for (auto& [scene_id, hosted_scene] : hosted_scenes) {
+        locked_count += expire_scene_locks(scene_id, hosted_scene->lock_table);
+    }
+
+    Stats::set_gauge(locks_gauge, locked_count);
+}
+
+void SampleEngine::apply_animation_message(const uint8_t* buffer, uint32_t msg_size, uint64_t latency_us)
+{
+    static const uint32_t rejected_updates_counter = Stats::get_metric("vpet.updates_rejected", Stats::METRIC_COUNTER);
+
+    uint8_t scene_id = 0u;
+    sVPETAnimationCommand command;
+
+    if (!read_animation_message(buffer, msg_size, scene_id, command)) {
+        return;
+    }
+
+    // Curves of hosted scenes are only played by their clients
+    if (find_hosted_scene(scene_id)) {
+        return;
+    }
+
+    if (scene_id != vpet_engine_id) {
+        Stats::add_count(rejected_updates_counter);
+        return;
+    }
+
+    // The client was there latency_us ago
+    if (command.command == eVPETAnimationCommand::PLAY) {
+        command.time += latency_us * 1e-6f * command.speed;
+    }
+
+    curve_playback.execute(command);
+}
+
+void SampleEngine::send_animation_command(const sVPETAnimationCommand& command)
+{
+    static const uint32_t animation_bytes_counter = Stats::get_metric("vpet.animation_bytes", Stats::METRIC_COUNTER);
+
+    uint8_t message[ANIMATION_MESSAGE_SIZE];
+    write_animation_message(vpet_engine_id, client_clocks.get_time(get_time_us()), vpet_engine_id, command, message);
+
+    zmq_send(publisher, message, sizeof(message), ZMQ_DONTWAIT);
+    Stats::add_count(animation_bytes_counter, sizeof(message));
+}
+
+void SampleEngine::send_animation_states()
+{
+    animation_states.clear();
+    curve_playback.get_playing(animation_states);
+
+    for (const sVPETAnimationCommand& command : animation_states) {
+        send_animation_command(command);
+    }
+}
+
+void SampleEngine::send_rpc(uint16_t object_id, uint16_t parameter_id)
+{
+    rpc_message = { vpet_engine_id, client_clocks.get_time(get_time_us()), static_cast<uint8_t>(eVPETMessageType::RPC) };
+    rpc_table.write_call(vpet_engine_id, object_id, parameter_id, rpc_message);
+
+    zmq_send(publisher, rpc_message.data(), rpc_message.size(), ZMQ_DONTWAIT);
+}
+
+void SampleEngine::apply_interest_message(uint8_t client_id, const uint8_t* buffer, uint32_t msg_size, uint64_t now_us)
+{
+    uint8_t scene_id = 0u;
+    sVPETInterest interest;
+
+    // Without the interest plane nothing would reach the client
+    if (!interest_publisher || !read_interest_message(buffer, msg_size, scene_id, interest)) {
+        return;
+    }
+
+    sHostedScene* hosted_scene = find_hosted_scene(scene_id);
+
+    if (!hosted_scene && scene_id != vpet_engine_id) {
+        return;
+    }
+
+    // A client is in one scene at a time
+    if (hosted_scene) {
+        interest_manager.remove_client(client_id);
+    }
+
+    for (auto& [hosted_id, other_scene] : hosted_scenes) {
+        if (other_scene.get() != hosted_scene) {
+            other_scene->interest_manager.remove_client(client_id);
+        }
+    }
+
+    (hosted_scene ? hosted_scene->interest_manager : interest_manager).set_interest(client_id, interest, now_us);
+}
+
+void SampleEngine::send_interest_updates(uint64_t now_us)
+{
+    static const uint32_t interest_bytes_counter = Stats::get_metric("vpet.interest_bytes", Stats::METRIC_COUNTER);
+    static const uint32_t interest_objects_counter = Stats::get_metric("vpet.interest_objects", Stats::METRIC_COUNTER);
+    static const uint32_t interest_clients_gauge = Stats::get_metric("vpet.interest_clients", Stats::METRIC_GAUGE);
+
+    if (!interest_publisher || now_us - last_interest_us < 1000000u / sVPETHeader().frame_rate) {
+        return;
+    }
+
+    last_interest_us = now_us;
+
+    uint8_t time = client_clocks.get_time(now_us);
+    uint32_t client_count = 0u;
+
+    // One message per client and scene with the current transforms of its batch, several edits of a node since
+    // the last send go out once
+    auto send_scene_updates = [&](uint8_t scene_id, const sVPETContext& scene, InterestManager& scene_interest) {
+        scene_interest.expire(now_us);
+        scene_interest.collect(interest_batches);
+        client_count += scene_interest.get_client_count();
+
+        for (const sVPETInterestBatch& batch : interest_batches) {
+            interest_message = { vpet_engine_id, time, static_cast<uint8_t>(eVPETMessageType::PARAMETER_UPDATE) };
+
+            for (uint32_t editable_id : batch.editables) {
+                Node3D* node_ref = scene.editables_node_list[editable_id]->node_ref;
+
+                if (!node_ref) {
+                    continue;
+                }
+
+                const Transform& transform = node_ref->get_transform();
+
+                // Object ids go out one based, as the clients use them
+                write_transform_records(scene_id, static_cast<uint16_t>(editable_id + 1u), transform.get_position(),
+                    transform.get_rotation(), transform.get_scale(), interest_message);
+            }
+
+            zmq_send(interest_publisher, &batch.client_id, sizeof(uint8_t), ZMQ_SNDMORE | ZMQ_DONTWAIT);
+            zmq_send(interest_publisher, interest_message.data(), interest_message.size(), ZMQ_DONTWAIT);
+
+            Stats::add_count(interest_bytes_counter, sizeof(uint8_t) + interest_message.size());
+            Stats::add_count(interest_objects_counter, batch.editables.size());
+        }
+    };
+
+    send_scene_updates(vpet_engine_id, vpet, interest_manager);
+
+    for (auto& [scene_id, hosted_scene] : hosted_scenes) {
+        send_scene_updates(scene_id, hosted_scene->vpet, hosted_scene->interest_manager);
+    }
+
+    Stats::set_gauge(interest_clients_gauge, client_count);
+}
+
+void SampleEngine::send_ping(uint64_t now_us)
+{
+    uint8_t message[3] = { vpet_engine_id, client_clocks.send_ping(now_us), static_cast<uint8_t>(eVPETMessageType::PING) };
+    zmq_send(publisher, message, sizeof(message), ZMQ_DONTWAIT);
+}
+
+void SampleEngine::answer_ping(uint8_t client_id, uint8_t client_time, uint64_t now_us)
+{
+    // The client gets its own time back to measure its round trip, and ours to estimate the offset
+    uint8_t message[5] = { vpet_engine_id, client_clocks.get_time(now_us), static_cast<uint8_t>(eVPETMessageType::PING), client_id, client_time };
+    zmq_send(publisher, message, sizeof(message), ZMQ_DONTWAIT);
+}
+
+void SampleEngine::update_client_clock_stats(uint8_t client_id)
+{
+    static uint32_t round_trip_gauges[ClientClocks::MAX_CLIENTS] = {};
+    static uint32_t offset_gauges[ClientClocks::MAX_CLIENTS] = {};
+    static bool registered[ClientClocks::MAX_CLIENTS] = {};
+    static uint32_t registered_clients = 0u;
+
+    if (!Stats::is_enabled()) {
+        return;
+    }
+
+    // Two gauges per client, only for the first few so the registry does not fill up
+    if (!registered[client_id]) {
+        if (registered_clients >= MAX_CLOCK_STATS_CLIENTS) {
+            return;
+        }
+
+        std::string prefix = "vpet.client_" + std::to_string(client_id);
+        round_trip_gauges[client_id] = Stats::get_metric(prefix + ".rtt_us", Stats::METRIC_GAUGE);
+        offset_gauges[client_id] = Stats::get_metric(prefix + ".clock_offset_us", Stats::METRIC_GAUGE);
+        registered[client_id] = true;
+        registered_clients++;
+    }
+
+    Stats::set_gauge(round_trip_gauges[client_id], static_cast<int64_t>(client_clocks.get_round_trip_us(client_id)));
+    Stats::set_gauge(offset_gauges[client_id], static_cast<int64_t>(client_clocks.get_offset_us(client_id)));
+}
+
+#endif
+
+void SampleEngine::update(float delta_time)
+{
+    static const uint32_t frame_timer = Stats::get_metric("frame.delta", Stats::METRIC_TIMER);
+    static const uint32_t update_timer = Stats::get_metric("frame.update", Stats::METRIC_TIMER);
+
+    Stats::add_time(frame_timer, static_cast<uint64_t>(delta_time * 1e6f));
+    Stats::update(delta_time);
+
+    ScopedTimer timer(update_timer);
+
+#ifndef __EMSCRIPTEN__
+    process_vpet_msg();
+
+    if (smoothing_enabled) {
+        apply_smoothed_transforms();
+    }
+
+    //// RECEIVE SCENE REQ DATA
+    //{
+    //    zmq_msg_t message;
+    //    zmq_msg_init(&message);
+    //    zmq_msg_recv(&message, distributor, 0);
+    //    uint32_t msg_size = zmq_msg_size(&message);
+    //    if (msg_size) {
+    //        char* buffer = reinterpret_cast<char*>(zmq_msg_data(&message));
+    //        std::string str(buffer, msg_size);
+    //        spdlog::info(str);
+    //    }
+    //}
+
+    //// SEND UPDATES
+    //{
+    //    std::string data = "Scene update!";
+    //    zmq_send(publisher, data.data(), data.size(), 0);
+    //}
+
+#endif
+
+    animated_vpet_nodes.clear();
+    curve_playback.update(delta_time, animated_vpet_nodes);
+
+    for (sVPETNode* vpet_node : animated_vpet_nodes) {
+        mark_node_moved(vpet_node->node_ref, vpet_node);
+    }
+
+    publish_parameter_objects();
+
+    const std::vector<Node*>& scene_nodes = main_scene->get_nodes();
+
+    if (rotate_scene) {
+        for (auto node : scene_nodes) {
+            MeshInstance3D* mesh_node = dynamic_cast<MeshInstance3D*>(node);
+            if (mesh_node) {
+                mesh_node->rotate(delta_time, normals::pY);
+                mark_node_moved(mesh_node);
+            }
+        }
+    }
+
+    Engine::update(delta_time);
+
+    upload_queue.process();
+
+    update_ply_stream();
+
+    // Nodes added outside of build_scene_bvh, e.g. the skybox before any scene is loaded
+    if (transform_hierarchy.get_root_count() != main_scene->get_nodes().size()) {
+        transform_hierarchy.build(main_scene->get_nodes());
+    }
+
+    // Static subtrees have nothing to update, only animated nodes are visited
+    transform_hierarchy.update_nodes(delta_time);
+
+    character_skinning.update();
+
+#ifndef __EMSCRIPTEN__
+    send_poses();
+#endif
+
+    skybox->update(delta_time);
+
+    refit_scene_bvh();
+
+    update_hosted_scenes();
+
+#ifndef __EMSCRIPTEN__
+    // After the refit, regions are tested against the bounds the nodes have now
+    send_interest_updates(get_time_us());
+#endif
+
+    //if (Input::was_key_pressed(GLFW_KEY_O)) {
+    //    set_camera_type(CAMERA_ORBIT);
+    //}
+
+    //if (Input::was_key_pressed(GLFW_KEY_F)) {
+    //    set_camera_type(CAMERA_FLYOVER);
+    //}
+
+    // Interpolate current camera position
+    if (target_camera_idx != -1)
+    {
+        // Lerp eye
+        glm::vec3 new_eye = cameras[target_camera_idx]->get_translation();
+        eye_lerp.value = smooth_damp(eye_lerp.value, new_eye, &eye_lerp.velocity, 0.75f / camera_interp_speed, 20.0f, delta_time);
+
+        Camera* camera = renderer->get_camera();
+        camera->look_at(eye_lerp.value, camera->get_center(), camera->get_up());
+
+        if (glm::distance(eye_lerp.value, new_eye) < 0.01f)
+        {
+            target_camera_idx = -1;
+        }
+    }
+
+    if (lerp_center) {
+        // Lerp center
+        center_lerp.value = smooth_damp(center_lerp.value, target_center, &center_lerp.velocity, 0.25f, 20.0f, delta_time);
+
+        Camera* camera = renderer->get_camera();
+        camera->look_at(camera->get_eye(), center_lerp.value, camera->get_up());
+
+        if (glm::distance(center_lerp.value, target_center) < 0.01f)
+        {
+            lerp_center = false;
+        }
+    }
+}
+
+void SampleEngine::render()
+{
+    static const uint32_t render_timer = Stats::get_metric("frame.render", Stats::METRIC_TIMER);
+    static const uint32_t triangles_gauge = Stats::get_metric("render.triangles", Stats::METRIC_GAUGE);
+    static const uint32_t full_detail_gauge = Stats::get_metric("render.full_detail_triangles", Stats::METRIC_GAUGE);
+    static const uint32_t visible_gauge = Stats::get_metric("render.visible_instances", Stats::METRIC_GAUGE);
+
+    ScopedTimer timer(render_timer);
+
+#ifndef __EMSCRIPTEN__
+    render_default_gui();
+#endif
+
+    if (frustum_culling && !scene_bvh.empty()) {
+        Camera* camera = renderer->get_camera();
+
+        visible_items.clear();
+        scene_bvh.query_frustum(camera->get_view_projection(), visible_items);
+
+        bvh_instance_in_frustum.assign(bvh_instances.size(), 0u);
+        for (uint32_t item : visible_items) {
+            bvh_instance_in_frustum[item] = 1u;
+        }
+
+        for (uint32_t i = 0u; i < bvh_instances.size(); ++i) {
+            uint8_t visible = bvh_instance_in_frustum[i];
+
+            // Instances with children stay visible, hiding them would hide the whole subtree
+            if (bvh_instances[i] && visible != bvh_instance_visible[i] && bvh_instances[i]->get_children().empty()) {
+                bvh_instances[i]->set_visibility(visible);
+                bvh_instance_visible[i] = visible;
+            }
+        }
+    }
+
+    if (!lod_instances.empty()) {
+        Camera* camera = renderer->get_camera();
+
+        uint64_t triangles_rendered = 0u;
+        uint64_t full_detail_triangles = 0u;
+
+        for (LODMeshInstance3D* instance : lod_instances) {
+            if (!instance->get_visibility()) {
+                continue;
+            }
+
+            instance->select_lod(camera);
+            triangles_rendered += instance->get_triangle_count();
+            full_detail_triangles += instance->get_full_triangle_count();
+        }
+
+        Stats::set_gauge(triangles_gauge, triangles_rendered);
+        Stats::set_gauge(full_detail_gauge, full_detail_triangles);
+    }
+
+    if (frustum_culling && !scene_bvh.empty()) {
+        Stats::set_gauge(visible_gauge, visible_items.size());
+    }
+
+    skybox->render();
+    main_scene->render();
+
+	Engine::render();
+}
+
+#ifdef __EMSCRIPTEN__
+extern "C" {
+#endif
+void append_glb_data(int8_t* byte_array, uint32_t array_size)
+{
+    SampleEngine::get_sample_instance()->append_glb_data(byte_array, array_size);
+}
+#ifdef __EMSCRIPTEN__
+}
+#endif
+
+#ifdef __EMSCRIPTEN__
+extern "C" {
+#endif
+void set_scene_objects(int8_t* byte_array, uint32_t array_size)
+{
+    uint32_t buffer_ptr = 0u;
+
+    while (buffer_ptr < array_size) {
+
+        sVPETMesh* mesh = new sVPETMesh();
+
+        // Vertices
+        {
+            uint32_t vertices_size = 0u;
+            memcpy(&vertices_size, &byte_array[buffer_ptr], sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            if (vertices_size > 0u) {
+                mesh->vertex_array.resize(vertices_size);
+                memcpy(mesh->vertex_array.data(), &byte_array[buffer_ptr], vertices_size * sizeof(glm::vec3));
+                buffer_ptr += vertices_size * sizeof(glm::vec3);
+            }
+
+            mesh->compute_bounds();
+        }
+
+        // Indices
+        {
+            uint32_t indices_size = 0u;
+            memcpy(&indices_size, &byte_array[buffer_ptr], sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            if (indices_size > 0u) {
+                mesh->index_array.resize(indices_size);
+                memcpy(mesh->index_array.data(), &byte_array[buffer_ptr], indices_size * sizeof(uint32_t));
+                buffer_ptr += indices_size * sizeof(uint32_t);
+            }
+        }
+
+        // Normals
+        {
+            uint32_t normals_size = 0u;
+            memcpy(&normals_size, &byte_array[buffer_ptr], sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            if (normals_size > 0u) {
+                mesh->normal_array.resize(normals_size);
+                memcpy(mesh->normal_array.data(), &byte_array[buffer_ptr], normals_size * sizeof(glm::vec3));
+                buffer_ptr += normals_size * sizeof(glm::vec3);
+            }
+        }
+
+        // Uvs
+        {
+            uint32_t uvs_size = 0u;
             memcpy(&uvs_size, &byte_array[buffer_ptr], sizeof(uint32_t));
             buffer_ptr += sizeof(uint32_t);
 
@@ -501,7 +1255,7 @@ void set_scene_objects(int8_t* byte_array, uint32_t array_size)
 
         // Bone indices
         {
-            uint32_t bone_indices_size = mesh->bone_weights_array.size();
+            uint32_t bone_indices_size = mesh->bone_weights_array.size() * 4u;
 
             if (bone_indices_size > 0u) {
                 mesh->bone_indices_array.resize(bone_indices_size);
@@ -513,7 +1267,7 @@ void set_scene_objects(int8_t* byte_array, uint32_t array_size)
         vpet.geo_list.push_back(mesh);
     }
 
-    spdlog::info("Meshes: buffer {} array_size {}", buffer_ptr, array_size);
+    spdlog::debug("Meshes: buffer {} array_size {}", buffer_ptr, array_size);
 
     assert(buffer_ptr == array_size);
 }
@@ -539,14 +1293,14 @@ void set_scene_textures(int8_t* byte_array, uint32_t array_size)
         memcpy(&texture_size, &byte_array[buffer_ptr], sizeof(uint32_t));
         buffer_ptr += sizeof(uint32_t);
 
+        texture->texture_data.resize(texture_size);
         memcpy(texture->texture_data.data(), &byte_array[buffer_ptr], texture_size);
         buffer_ptr += texture_size;
 
         vpet.texture_list.push_back(texture);
     }
 
-    spdlog::info("Textures: buffer {} array_size {}", buffer_ptr, array_size);
-
+    spdlog::debug("Textures: buffer {} array_size {}", buffer_ptr, array_size);
 
     assert(buffer_ptr == array_size);
 }
@@ -559,41 +1313,41 @@ void set_scene_materials(int8_t* byte_array, uint32_t array_size)
 
         sVPETMaterial* material = new sVPETMaterial();
 
-        spdlog::info("NEW MATERIAL!");
+        spdlog::debug("NEW MATERIAL!");
 
         // type
         {
             memcpy(&material->type, &byte_array[buffer_ptr], sizeof(uint32_t));
             buffer_ptr += sizeof(uint32_t);
-            spdlog::info("B_PTR{} type {}", buffer_ptr, material->type);
+            spdlog::debug("B_PTR{} type {}", buffer_ptr, material->type);
         }
 
         // nameSize
         {
             memcpy(&material->name_size, &byte_array[buffer_ptr], sizeof(uint32_t));
             buffer_ptr += sizeof(uint32_t);
-            spdlog::info("B_PTR{} name_size {}", buffer_ptr, material->name_size);
+            spdlog::debug("B_PTR{} name_size {}", buffer_ptr, material->name_size);
         }
 
         // name
         {
             memcpy(&material->name, &byte_array[buffer_ptr], material->name_size);
             buffer_ptr += material->name_size;
-            spdlog::info("B_PTR{} name {}", buffer_ptr, material->name);
+            spdlog::debug("B_PTR{} name {}", buffer_ptr, material->name);
         }
 
         // srcSize
         {
             memcpy(&material->src_size, &byte_array[buffer_ptr], sizeof(uint32_t));
             buffer_ptr += sizeof(uint32_t);
-            spdlog::info("B_PTR{} src_size {}", buffer_ptr, material->src_size);
+            spdlog::debug("B_PTR{} src_size {}", buffer_ptr, material->src_size);
         }
 
         // src
         {
             memcpy(&material->src, &byte_array[buffer_ptr], material->src_size);
             buffer_ptr += material->src_size;
-            spdlog::info("B_PTR{} src {}", buffer_ptr, material->src);
+            spdlog::debug("B_PTR{} src {}", buffer_ptr, material->src);
         }
 
         // materialID
@@ -601,44 +1355,44 @@ void set_scene_materials(int8_t* byte_array, uint32_t array_size)
             material->material_id = vpet.material_list.size();// *reinterpret_cast<int32_t*>(buffer_ptr);
             // memcpy(&material->material_id, &byte_array[buffer_ptr], sizeof(uint32_t));
             buffer_ptr += sizeof(uint32_t);
-            spdlog::info("B_PTR{} material_id {}", buffer_ptr, material->material_id);
+            spdlog::debug("B_PTR{} material_id {}", buffer_ptr, material->material_id);
         }
 
         // textureIdsSize
         {
             memcpy(&material->texture_ids_size, &byte_array[buffer_ptr], sizeof(uint32_t));
             buffer_ptr += sizeof(uint32_t);
-            spdlog::info("B_PTR{} texture_ids_size {}", buffer_ptr, material->texture_ids_size);
+            spdlog::debug("B_PTR{} texture_ids_size {}", buffer_ptr, material->texture_ids_size);
         }
 
-        material->texture_ids.reserve(material->texture_ids_size);
-        material->texture_offsets.reserve(material->texture_ids_size);
-        material->texture_scales.reserve(material->texture_ids_size);
+        material->texture_ids.resize(material->texture_ids_size);
+        material->texture_offsets.resize(material->texture_ids_size);
+        material->texture_scales.resize(material->texture_ids_size);
 
         // textureIds
         {
-            memcpy(&material->texture_ids, &byte_array[buffer_ptr], material->texture_ids_size * sizeof(uint32_t));
+            memcpy(material->texture_ids.data(), &byte_array[buffer_ptr], material->texture_ids_size * sizeof(uint32_t));
             buffer_ptr += material->texture_ids_size * sizeof(uint32_t);
             for (uint32_t i = 0; i < material->texture_ids_size; ++i) {
-                spdlog::info("B_PTR{} texture_id {} {}", buffer_ptr, i, material->texture_ids[i]);
+                spdlog::debug("B_PTR{} texture_id {} {}", buffer_ptr, i, material->texture_ids[i]);
             }
         }
 
         // textureOffsets
         {
-            memcpy(&material->texture_offsets, &byte_array[buffer_ptr], material->texture_ids_size * sizeof(glm::vec2));
+            memcpy(material->texture_offsets.data(), &byte_array[buffer_ptr], material->texture_ids_size * sizeof(glm::vec2));
             buffer_ptr += material->texture_ids_size * sizeof(glm::vec2);
             for (uint32_t i = 0; i < material->texture_ids_size; ++i) {
-                spdlog::info("B_PTR{} texture_offsets {} [{},{}]", buffer_ptr, i, material->texture_offsets[i].x, material->texture_offsets[i].y);
+                spdlog::debug("B_PTR{} texture_offsets {} [{},{}]", buffer_ptr, i, material->texture_offsets[i].x, material->texture_offsets[i].y);
             }
         }
 
         // textureScales
         {
-            memcpy(&material->texture_scales, &byte_array[buffer_ptr], material->texture_ids_size * sizeof(glm::vec2));
+            memcpy(material->texture_scales.data(), &byte_array[buffer_ptr], material->texture_ids_size * sizeof(glm::vec2));
             buffer_ptr += material->texture_ids_size * sizeof(glm::vec2);
             for (uint32_t i = 0; i < material->texture_ids_size; ++i) {
-                spdlog::info("B_PTR{} texture_scales {} [{},{}]", buffer_ptr, i, material->texture_scales[i].x, material->texture_scales[i].y);
+                spdlog::debug("B_PTR{} texture_scales {} [{},{}]", buffer_ptr, i, material->texture_scales[i].x, material->texture_scales[i].y);
             }
         }
 
@@ -648,8 +1402,11 @@ void set_scene_materials(int8_t* byte_array, uint32_t array_size)
             {
                 memcpy(&material->shader_config_size, &byte_array[buffer_ptr], sizeof(uint32_t));
                 buffer_ptr += sizeof(uint32_t);
-                spdlog::info("B_PTR{} shader_config_size {}", buffer_ptr, material->shader_config_size);
-                memcpy(&material->shader_configs, &byte_array[buffer_ptr], material->shader_config_size * sizeof(bool));
+                spdlog::debug("B_PTR{} shader_config_size {}", buffer_ptr, material->shader_config_size);
+                material->shader_configs.resize(material->shader_config_size);
+                for (uint32_t i = 0; i < material->shader_config_size; ++i) {
+                    material->shader_configs[i] = byte_array[buffer_ptr + i] != 0;
+                }
                 buffer_ptr += material->shader_config_size * sizeof(bool);
             }
 
@@ -657,8 +1414,9 @@ void set_scene_materials(int8_t* byte_array, uint32_t array_size)
             {
                 memcpy(&material->shader_properties_ids_size, &byte_array[buffer_ptr], sizeof(uint32_t));
                 buffer_ptr += sizeof(uint32_t);
-                spdlog::info("B_PTR{} shader_properties_ids_size {}", buffer_ptr, material->shader_properties_ids_size);
-                memcpy(&material->shader_property_ids, &byte_array[buffer_ptr], material->shader_properties_ids_size * sizeof(uint32_t));
+                spdlog::debug("B_PTR{} shader_properties_ids_size {}", buffer_ptr, material->shader_properties_ids_size);
+                material->shader_property_ids.resize(material->shader_properties_ids_size);
+                memcpy(material->shader_property_ids.data(), &byte_array[buffer_ptr], material->shader_properties_ids_size * sizeof(uint32_t));
                 buffer_ptr += material->shader_properties_ids_size * sizeof(uint32_t);
             }
 
@@ -666,8 +1424,9 @@ void set_scene_materials(int8_t* byte_array, uint32_t array_size)
             {
                 memcpy(&material->shader_properties_types_size, &byte_array[buffer_ptr], sizeof(uint32_t));
                 buffer_ptr += sizeof(uint32_t);
-                spdlog::info("B_PTR{} shader_properties_types_size {}", buffer_ptr, material->shader_properties_types_size);
-                memcpy(&material->shader_property_types, &byte_array[buffer_ptr], material->shader_properties_types_size * sizeof(uint32_t));
+                spdlog::debug("B_PTR{} shader_properties_types_size {}", buffer_ptr, material->shader_properties_types_size);
+                material->shader_property_types.resize(material->shader_properties_types_size);
+                memcpy(material->shader_property_types.data(), &byte_array[buffer_ptr], material->shader_properties_types_size * sizeof(uint32_t));
                 buffer_ptr += material->shader_properties_types_size * sizeof(uint32_t);
             }
 
@@ -675,8 +1434,9 @@ void set_scene_materials(int8_t* byte_array, uint32_t array_size)
             {
                 memcpy(&material->shader_properties_size, &byte_array[buffer_ptr], sizeof(uint32_t));
                 buffer_ptr += sizeof(uint32_t);
-                spdlog::info("B_PTR{} shader_properties_size {}", buffer_ptr, material->shader_properties_size);
-                memcpy(&material->shader_properties, &byte_array[buffer_ptr], material->shader_properties_size * sizeof(uint8_t));
+                spdlog::debug("B_PTR{} shader_properties_size {}", buffer_ptr, material->shader_properties_size);
+                material->shader_properties.resize(material->shader_properties_size);
+                memcpy(material->shader_properties.data(), &byte_array[buffer_ptr], material->shader_properties_size * sizeof(uint8_t));
                 buffer_ptr += material->shader_properties_size * sizeof(uint8_t);
             }
         }
@@ -685,7 +1445,7 @@ void set_scene_materials(int8_t* byte_array, uint32_t array_size)
     }
 
     if (buffer_ptr != array_size) {
-        spdlog::info("DIFFERENT!! buffer {} array_size {}", buffer_ptr, array_size);
+        spdlog::error("DIFFERENT!! buffer {} array_size {}", buffer_ptr, array_size);
     }
 
     assert(buffer_ptr == array_size);
@@ -697,12 +1457,34 @@ void set_scene_nodes(int8_t* byte_array, uint32_t array_size)
 
     while (buffer_ptr < array_size) {
 
-        sVPETNode* node = new sVPETNode();
-
-        memcpy(&node->node_type, &byte_array[buffer_ptr], sizeof(uint32_t));
+        eVPETNodeType node_type;
+        memcpy(&node_type, &byte_array[buffer_ptr], sizeof(uint32_t));
         buffer_ptr += sizeof(uint32_t);
 
-        memcpy(&node->editable, &byte_array[buffer_ptr], sizeof(uint32_t));
+        // Allocate the actual node type, the fields below are written through casts
+        sVPETNode* node = nullptr;
+
+        switch (node_type)
+        {
+        case eVPETNodeType::GEO:
+            node = new sVPETGeoNode();
+            break;
+        case eVPETNodeType::LIGHT:
+            node = new sVPETLightNode();
+            break;
+        case eVPETNodeType::CAMERA:
+            node = new sVPETCamNode();
+            break;
+        default:
+            node = new sVPETNode();
+            break;
+        }
+
+        node->node_type = node_type;
+
+        uint32_t editable = 0u;
+        memcpy(&editable, &byte_array[buffer_ptr], sizeof(uint32_t));
+        node->editable = editable != 0u;
         buffer_ptr += sizeof(uint32_t);
 
         memcpy(&node->child_count, &byte_array[buffer_ptr], sizeof(uint32_t));
@@ -723,7 +1505,7 @@ void set_scene_nodes(int8_t* byte_array, uint32_t array_size)
         // Transform to unity coordinate system
         transformed_rot.x = -transformed_rot.x;
         transformed_rot.y = -transformed_rot.y;
-        node->rotation = transformed_pos;
+        node->rotation = transformed_rot;
         buffer_ptr += sizeof(glm::quat);
 
         memcpy(&node->name, &byte_array[buffer_ptr], 64);
@@ -805,7 +1587,7 @@ void set_scene_nodes(int8_t* byte_array, uint32_t array_size)
         }
     }
 
-    spdlog::info("Nodes: buffer {} array_size {}", buffer_ptr, array_size);
+    spdlog::debug("Nodes: buffer {} array_size {}", buffer_ptr, array_size);
 
     assert(buffer_ptr == array_size);
 }
@@ -815,6 +1597,9 @@ void set_scene_nodes(int8_t* byte_array, uint32_t array_size)
 
 void SampleEngine::update_scene_parameter(uint32_t scene_object_id, uint16_t parameter_id, float vx, float vy, float vz, float vw)
 {
+    static const uint32_t updates_counter = Stats::get_metric("vpet.updates_applied", Stats::METRIC_COUNTER);
+    Stats::add_count(updates_counter);
+
     assert(scene_object_id < vpet.node_list.size());
 
     sVPETNode* vpet_node = vpet.editables_node_list[scene_object_id];
@@ -828,14 +1613,20 @@ void SampleEngine::update_scene_parameter(uint32_t scene_object_id, uint16_t par
     case 0:
         vz = -vz;
         node_ref->set_position(glm::vec3(vx, vy, vz));
+        mark_node_moved(node_ref, vpet_node);
+        interest_manager.mark_dirty(vpet_node);
         break;
     case 1:
         vx = -vx;
         vy = -vy;
         node_ref->set_rotation(glm::quat(vx, vy, vz, vw));
+        mark_node_moved(node_ref, vpet_node);
+        interest_manager.mark_dirty(vpet_node);
         break;
     case 2:
         node_ref->set_scale(glm::vec3(vx, vy, vz));
+        mark_node_moved(node_ref, vpet_node);
+        interest_manager.mark_dirty(vpet_node);
         break;
     case 3:
         if (vpet_node->node_type == eVPETNodeType::LIGHT) {
@@ -859,7 +1650,128 @@ void SampleEngine::update_scene_parameter(uint32_t scene_object_id, uint16_t par
         assert(0);
     }
 
-    spdlog::info("Node {} updated succesfully!", scene_object_id);
+    spdlog::debug("Node {} updated succesfully!", scene_object_id);
+}
+
+// Back to engine coordinates, CPU only so it can run on any thread
+void convert_tracer_mesh(const sVPETMesh& vpet_mesh, sSurfaceData& surface_data, std::vector<uint32_t>& indices)
+{
+    surface_data.resize(vpet_mesh.vertex_array.size());
+
+    for (uint32_t i = 0u; i < surface_data.size(); ++i) {
+        surface_data.vertices[i] = vpet_mesh.vertex_array[i];
+        surface_data.vertices[i].z = -surface_data.vertices[i].z;
+        surface_data.normals[i]= vpet_mesh.normal_array[i];
+        surface_data.normals[i].z = -surface_data.normals[i].z;
+        surface_data.uvs[i] = vpet_mesh.uv_array[i];
+    }
+
+    indices.resize(vpet_mesh.index_array.size());
+    uint32_t add_idx = 0;
+    for (uint32_t idx = vpet_mesh.index_array.size(); idx > 0; --idx) {
+        indices[add_idx] = vpet_mesh.index_array[idx - 1];
+        add_idx++;
+    }
+}
+
+uint64_t get_tracer_mesh_upload_size(const sVPETMesh& vpet_mesh)
+{
+    return vpet_mesh.vertex_array.size() * (2u * sizeof(glm::vec3) + sizeof(glm::vec2)) + vpet_mesh.index_array.size() * sizeof(uint32_t);
+}
+
+// Everything that selects a distinct Material, and so a distinct pipeline
+struct sTracerMaterialKey {
+    int32_t material_id = -1;
+    uint32_t shader_variant = 0u; // Only mesh_forward for now
+    eTransparencyType transparency = ALPHA_OPAQUE;
+    eCullType cull = CULL_BACK;
+
+    bool operator==(const sTracerMaterialKey& other) const = default;
+};
+
+struct sTracerMaterialKeyHash {
+    size_t operator()(const sTracerMaterialKey& key) const {
+        return std::hash<uint64_t>()((static_cast<uint64_t>(static_cast<uint32_t>(key.material_id)) << 32) ^
+            (key.shader_variant << 16) ^ (static_cast<uint32_t>(key.transparency) << 8) ^ static_cast<uint32_t>(key.cull));
+    }
+};
+
+sTracerMaterialKey get_tracer_material_key(const sVPETGeoNode& vpet_geo)
+{
+    sTracerMaterialKey key;
+    key.material_id = vpet_geo.material_id;
+    return key;
+}
+
+Material* create_tracer_material(const sTracerMaterialKey& key, std::vector<Texture*>& engine_textures)
+{
+    sVPETMaterial* vpet_material = vpet.material_list[key.material_id];
+
+    Material* material = new Material();
+    material->set_name(vpet_material->name);
+    material->set_transparency_type(key.transparency);
+    material->set_cull_type(key.cull);
+
+    // Texture, created once per context texture
+    if (vpet_material->texture_ids_size > 0u && vpet_material->texture_ids[0] >= 0) {
+        uint32_t texture_id = vpet_material->texture_ids[0];
+
+        if (!engine_textures[texture_id]) {
+            sVPETTexture* vpet_texture = vpet.texture_list[texture_id];
+            const std::vector<uint8_t>& texture_data = vpet_texture->get_texture_data();
+
+            if (vpet_texture->format == static_cast<uint32_t>(eVPETTextureFormat::RGBA32) &&
+                texture_data.size() == static_cast<size_t>(vpet_texture->width) * vpet_texture->height * 4u) {
+                Texture* texture = new Texture();
+                texture->set_name(vpet_texture->name);
+                texture->load_from_data(vpet_texture->name, WGPUTextureDimension_2D, vpet_texture->width, vpet_texture->height, 1u,
+                    const_cast<uint8_t*>(texture_data.data()));
+                engine_textures[texture_id] = texture;
+            }
+        }
+
+        material->set_diffuse_texture(engine_textures[texture_id]);
+    }
+
+    // Set last, the pipeline is built for the state above
+    material->set_shader(RendererStorage::get_shader_from_source(shaders::mesh_forward::source, shaders::mesh_forward::path, shaders::mesh_forward::libraries, material));
+
+    return material;
+}
+
+void SampleEngine::queue_tracer_surfaces(LODMeshInstance3D* mesh_instance, sVPETNode* vpet_node, const sVPETMesh* vpet_mesh, Material* material)
+{
+    // Surfaces are attached as their uploads run in the next frames, finest level first
+    struct sStagedSurface {
+        sSurfaceData surface_data;
+        std::vector<uint32_t> indices;
+    };
+
+    for (uint32_t level = 0u; level <= vpet_mesh->lod_list.size(); ++level) {
+        const sVPETMesh* lod_mesh = &vpet_mesh->get_lod(level);
+        std::shared_ptr<sStagedSurface> staged = std::make_shared<sStagedSurface>();
+
+        upload_queue.add(get_tracer_mesh_upload_size(*lod_mesh),
+            [staged, lod_mesh]() {
+                convert_tracer_mesh(*lod_mesh, staged->surface_data, staged->indices);
+            },
+            [this, staged, lod_mesh, level, mesh_instance, vpet_node, material]() {
+                Surface* lod_surface = new Surface();
+                lod_surface->create_surface_data(staged->surface_data);
+                lod_surface->create_index_buffer(staged->indices);
+
+                mesh_instance->add_lod_surface(lod_surface, lod_mesh->index_array.size() / 3u);
+
+                if (material) {
+                    mesh_instance->set_surface_material_override(lod_surface, material);
+                }
+
+                // Bounds are only known once the full detail surface exists
+                if (level == 0u) {
+                    mark_node_moved(mesh_instance, vpet_node);
+                }
+            });
+    }
 }
 
 void SampleEngine::load_tracer_scene()
@@ -874,9 +1786,44 @@ void SampleEngine::load_tracer_scene()
 
     spdlog::info("VPET NODES: {}", vpet.node_list.size());
 
+    // Clients only receive full detail meshes, build the chains here
+    if (vpet.lod_count == 0u) {
+        generate_context_lods(vpet, TRACER_LOD_COUNT);
+    }
+
+    // Materials and their pipelines are all created here during load, not on the first frame they are drawn
+    std::vector<Texture*> engine_textures(vpet.texture_list.size(), nullptr);
+    std::unordered_map<sTracerMaterialKey, Material*, sTracerMaterialKeyHash> tracer_materials;
+    uint32_t geo_node_count = 0u;
+
+    for (sVPETNode* vpet_node : vpet.node_list) {
+        if (vpet_node->node_type != eVPETNodeType::GEO) {
+            continue;
+        }
+
+        geo_node_count++;
+
+        sTracerMaterialKey key = get_tracer_material_key(*static_cast<sVPETGeoNode*>(vpet_node));
+
+        if (key.material_id >= 0 && !tracer_materials.contains(key)) {
+            tracer_materials[key] = create_tracer_material(key, engine_textures);
+        }
+    }
+
+    spdlog::info("{} materials for {} geometry nodes", tracer_materials.size(), geo_node_count);
+
+    struct sPoolCandidate {
+        LODMeshInstance3D* instance = nullptr;
+        sVPETNode* vpet_node = nullptr;
+        const sVPETMesh* vpet_mesh = nullptr;
+        Material* material = nullptr;
+    };
+
+    std::vector<sPoolCandidate> pool_candidates;
+
     for (sVPETNode* vpet_node : vpet.node_list) {
 
-        spdlog::info("Node {} of type {}:", vpet_node->name, static_cast<uint32_t>(vpet_node->node_type));
+        spdlog::debug("Node {} of type {}:", vpet_node->name, static_cast<uint32_t>(vpet_node->node_type));
 
         Node3D* engine_node = nullptr;
 
@@ -889,54 +1836,20 @@ void SampleEngine::load_tracer_scene()
             sVPETGeoNode* vpet_geo = static_cast<sVPETGeoNode*>(vpet_node);
             sVPETMesh* vpet_mesh = vpet.geo_list[vpet_geo->geo_id];
 
-            MeshInstance3D* mesh_instance = new MeshInstance3D();
-            Surface* surface = new Surface();
-
-            sSurfaceData surface_data;
+            LODMeshInstance3D* mesh_instance = new LODMeshInstance3D();
 
-            surface_data.resize(vpet_mesh->vertex_array.size());
+            lod_instances.push_back(mesh_instance);
 
-            for (uint32_t i = 0u; i < surface_data.size(); ++i) {
-                surface_data.vertices[i] = vpet_mesh->vertex_array[i];
-                surface_data.vertices[i].z = -surface_data.vertices[i].z;
-                surface_data.normals[i]= vpet_mesh->normal_array[i];
-                surface_data.normals[i].z = -surface_data.normals[i].z;
-                surface_data.uvs[i] = vpet_mesh->uv_array[i];
-            }
-
-            surface->create_surface_data(surface_data);
+            // Material, shared by every node with the same key
+            auto material_it = tracer_materials.find(get_tracer_material_key(*vpet_geo));
+            Material* material = material_it != tracer_materials.end() ? material_it->second : nullptr;
 
-            std::vector<uint32_t> indices;
-            indices.resize(vpet_mesh->index_array.size());
-            uint32_t add_idx = 0;
-            for (uint32_t idx = vpet_mesh->index_array.size(); idx > 0; --idx) {
-                indices[add_idx] = vpet_mesh->index_array[idx - 1];
-                add_idx++;
+            // Small meshes go to the geometry pool once the hierarchy is complete, their transform is baked
+            if (geometry_pool_enabled && vpet_mesh->index_array.size() / 3u <= geometry_pool_max_triangles) {
+                pool_candidates.push_back({ mesh_instance, vpet_node, vpet_mesh, material });
             }
-
-            surface->create_index_buffer(indices);
-            mesh_instance->add_surface(surface);
-
-            // Material
-            {
-                sVPETMaterial* vpet_material = vpet.material_list[vpet_geo->material_id];
-
-                Material* geo_material = new Material();
-                geo_material->set_name(vpet_material->name);
-
-                // Texture
-                {
-                    /*sVPETTexture* vpet_texture = vpet.texture_list[vpet_material->texture_id];
-                    if (vpet_texture) {
-                        Texture* texture = new Texture();
-                        texture->set_name(vpet_texture->name);
-                        texture->load_from_data(vpet_texture->name, WGPUTextureDimension_2D, vpet_texture->width, vpet_texture->height, 1u, &vpet_texture->texture_data);
-                        geo_material->set_diffuse_texture(texture);
-                    }*/
-                }
-
-                geo_material->set_shader(RendererStorage::get_shader_from_source(shaders::mesh_forward::source, shaders::mesh_forward::path, shaders::mesh_forward::libraries, geo_material));
-                mesh_instance->set_surface_material_override(surface, geo_material);
+            else {
+                queue_tracer_surfaces(mesh_instance, vpet_node, vpet_mesh, material);
             }
 
             engine_node = mesh_instance;
@@ -992,6 +1905,8 @@ void SampleEngine::load_tracer_scene()
 
         engine_node->set_name(vpet_node->name);
 
+        vpet_node->node_ref = engine_node;
+
         sParentStack* parent = nullptr;
         if (!parent_stack.empty()) {
             sParentStack& parent = parent_stack.back();
@@ -1012,9 +1927,91 @@ void SampleEngine::load_tracer_scene()
         }
     }
 
+    for (const sPoolCandidate& candidate : pool_candidates) {
+        const sVPETMesh* vpet_mesh = candidate.vpet_mesh;
+
+        geometry_pool.add(candidate.instance, candidate.material, vpet_mesh->vertex_array.size(), vpet_mesh->index_array.size(),
+            [vpet_mesh](sSurfaceData& surface_data, std::vector<uint32_t>& indices) {
+                convert_tracer_mesh(*vpet_mesh, surface_data, indices);
+            },
+            [this, candidate]() {
+                queue_tracer_surfaces(candidate.instance, candidate.vpet_node, candidate.vpet_mesh, candidate.material);
+            });
+    }
+
+    for (MeshInstance3D* batch_instance : geometry_pool.build(upload_queue, [this](MeshInstance3D* batch_instance) { mark_node_moved(batch_instance); })) {
+        main_scene->add_node(batch_instance);
+    }
+
+    // Pooled members have no surfaces, bounds come from the meshes of the context
+    for (sVPETNode* vpet_node : vpet.node_list) {
+        if (vpet_node->node_ref) {
+            vpet_node->world_bounds = get_context_bounds(vpet, vpet_node);
+        }
+    }
+
+    build_context_bvh(vpet);
+    interest_manager.build(vpet);
+    build_scene_bvh();
+
+    spdlog::info("Queued {:.1f} MB of geometry uploads", upload_queue.get_pending_bytes() / (1024.0f * 1024.0f));
+
     spdlog::info("Tracer scene loaded!");
 }
 
+void SampleEngine::pool_scene_meshes(const std::vector<Node*>& nodes)
+{
+    if (!geometry_pool_enabled) {
+        return;
+    }
+
+    std::function<void(Node*)> add_meshes = [&](Node* node) {
+        MeshInstance3D* mesh_instance = dynamic_cast<MeshInstance3D*>(node);
+
+        // One surface per member, skinned meshes are posed every frame
+        if (mesh_instance && !dynamic_cast<Environment3D*>(node) && mesh_instance->get_surfaces().size() == 1u && !mesh_instance->get_skeleton()) {
+            Surface* surface = mesh_instance->get_surface(0);
+            const sSurfaceData& surface_data = surface->get_surface_data();
+
+            uint32_t vertex_count = surface_data.vertices.size();
+            uint32_t index_count = surface_data.indices.empty() ? vertex_count : surface_data.indices.size();
+
+            if (vertex_count > 0u && index_count / 3u <= geometry_pool_max_triangles) {
+                Material* material = mesh_instance->get_surface_material_override(surface);
+
+                geometry_pool.add(mesh_instance, material ? material : surface->get_material(), vertex_count, index_count,
+                    [surface](sSurfaceData& member_data, std::vector<uint32_t>& indices) {
+                        member_data = surface->get_surface_data();
+
+                        if (member_data.indices.empty()) {
+                            indices.resize(member_data.vertices.size());
+                            for (uint32_t i = 0u; i < indices.size(); ++i) {
+                                indices[i] = i;
+                            }
+                        }
+                        else {
+                            indices = member_data.indices;
+                        }
+                    },
+                    // The instance still has its surface and shows it again
+                    []() {});
+            }
+        }
+
+        for (Node* child : node->get_children()) {
+            add_meshes(child);
+        }
+    };
+
+    for (Node* node : nodes) {
+        add_meshes(node);
+    }
+
+    for (MeshInstance3D* batch_instance : geometry_pool.build(upload_queue, [this](MeshInstance3D* batch_instance) { mark_node_moved(batch_instance); })) {
+        main_scene->add_node(batch_instance);
+    }
+}
+
 void SampleEngine::set_skybox_texture(const std::string& filename)
 {
     if (!skybox) {
@@ -1027,16 +2024,73 @@ void SampleEngine::set_skybox_texture(const std::string& filename)
 
 std::vector<std::string> SampleEngine::load_glb(const std::string& filename)
 {
-    main_scene->delete_all();
+    auto start = std::chrono::high_resolution_clock::now();
 
     std::vector<Node*> entities;
-    parse_scene(filename.c_str(), entities, true);
 
-    main_scene->add_nodes(entities);
+    GltfParser parser;
+    if (!read_mapped_glb(parser, filename, entities, PARSE_GLTF_FILL_SURFACE_DATA)) {
+        parse_scene(filename.c_str(), entities, true);
+    }
+
+    // The loaded scene stays
+    if (entities.empty()) {
+        spdlog::error("Nothing to load in {}", filename);
+        return {};
+    }
+
+    close_ply_stream();
+    upload_queue.clear();
+    geometry_pool.clear();
+    transform_hierarchy.clear();
+    character_skinning.clear();
+    curve_playback.clear();
+    jitter_buffer.clear();
+    lock_table.clear();
+    interest_manager.clear();
+    lod_instances.clear();
 
     cameras.clear();
 
-    vpet.clean();
+    // Built without the context lock as hosted scenes are, the scene server keeps serving the loaded scene until
+    // the swap below
+    sVPETContext next_vpet;
+    next_vpet.texture_profiles = vpet.texture_profiles;
+
+    uint64_t cache_key = 0u;
+    std::string cache_path;
+    bool cached = false;
+
+    if (!scene_cache_directory.empty()) {
+        cache_key = get_scene_cache_key(filename, next_vpet, TRACER_LOD_COUNT);
+
+        if (cache_key != 0u) {
+            cache_path = get_scene_cache_path(scene_cache_directory, cache_key);
+            cached = read_scene_cache(next_vpet, cache_path, cache_key);
+        }
+    }
+
+    // The rendered scene always comes from the file and the served textures share its pixels, a cache hit skips
+    // building the nodes, meshes, LODs and texture variants of the served context
+    if (cached) {
+        uint32_t node_idx = 0u;
+
+        for (Node* node : entities) {
+            cached = cached && link_scene_objects(next_vpet, node, node_idx);
+        }
+
+        // Every cached texture is used by some surface and got its pixels from it
+        cached = cached && std::all_of(next_vpet.texture_list.begin(), next_vpet.texture_list.end(), [](const sVPETTexture* texture) {
+            return texture->shared_data != nullptr;
+        });
+
+        if (!cached || node_idx != next_vpet.node_list.size()) {
+            spdlog::warn("Scene cache entry {} does not match {}, rebuilding it", cache_path, filename);
+
+            cached = false;
+            next_vpet.clean();
+        }
+    }
 
     std::function<void(Node*)> recurse_tree = [&](Node* node) {
         EntityCamera* new_camera = dynamic_cast<EntityCamera*>(node);
@@ -1044,7 +2098,9 @@ std::vector<std::string> SampleEngine::load_glb(const std::string& filename)
             cameras.push_back(new_camera);
         }
 
-        process_scene_object(vpet, node);
+        if (!cached) {
+            process_scene_object(next_vpet, node);
+        }
 
         if (!node->get_children().empty()) {
             for (auto child : node->get_children()) {
@@ -1053,34 +2109,255 @@ std::vector<std::string> SampleEngine::load_glb(const std::string& filename)
         }
     };
 
-    if (main_scene->get_nodes().empty()) {
-        return {};
-    }
-
     // Each time we load entities, get vpet nodes and the cameras
-    for (auto node : main_scene->get_nodes()) {
+    for (auto node : entities) {
         recurse_tree(node);
     }
 
+    // Before sharing, pooled assets are served by other contexts and are not written outside the lock
+    if (!cached) {
+        bake_texture_variants(next_vpet);
+        generate_context_lods(next_vpet, TRACER_LOD_COUNT);
+    }
+
+    build_context_bvh(next_vpet);
+
+    // Skeletons and animations are not cached, files with them always take the full path
+    if (!cached) {
+        process_animations(next_vpet, filename);
+    }
+
+    {
+        // Replies being served finish first, the loaded context hands its assets back before the nodes its
+        // textures point at are deleted
+        std::unique_lock<std::shared_mutex> vpet_lock(vpet_mutex);
+
+        vpet_scenes.asset_pool.share(next_vpet);
+
+        vpet.swap_scene(next_vpet);
+        next_vpet.clean();
+    }
+
+    main_scene->delete_all();
+    main_scene->add_nodes(entities);
+
+    interest_manager.build(vpet);
+
+    // After the context is built, batch instances are not part of it
+    pool_scene_meshes(entities);
+
+    build_scene_bvh();
+
+    if (!cached) {
+        character_skinning.build(vpet);
+
+        if (!vpet.animation_list.empty()) {
+            log_curve_report(vpet.animation_list, sVPETHeader().frame_rate, ping_interval);
+            curve_playback.build(vpet);
+        }
+
+        if (!cache_path.empty() && vpet.character_list.empty() && vpet.animation_list.empty()) {
+            write_scene_cache(vpet, cache_path, cache_key);
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    spdlog::info("Loaded {}{} in {:.2f} ms, peak RSS {:.1f} MB", filename, cached ? " from the scene cache" : "",
+        std::chrono::duration<float, std::milli>(end - start).count(), Stats::get_peak_memory() / (1024.0f * 1024.0f));
+
     reset_camera();
 
     if (!cameras.empty()) {
         set_camera_lookat_index(0);
     }
 
+    apply_environment();
+
     return get_cameras_names();
 }
 
 void SampleEngine::load_ply(const std::string& filename)
 {
+    std::unique_lock<std::shared_mutex> vpet_lock(vpet_mutex);
+
+    close_ply_stream();
+    upload_queue.clear();
+    geometry_pool.clear();
+    transform_hierarchy.clear();
+    character_skinning.clear();
+    curve_playback.clear();
+    jitter_buffer.clear();
+    lock_table.clear();
+    interest_manager.clear();
+
+    // Splats are not served, the context of the previous scene would point at freed textures
+    vpet.clean();
+    rpc_table.publish(vpet, vpet_engine_id);
+
     main_scene->delete_all();
+    lod_instances.clear();
+    build_scene_bvh();
+
+    cameras.clear();
+
+    // Blocks arrive in the following updates, ascii files still go through the regular parser
+    if (ply_streamer.open(filename)) {
+        return;
+    }
+
+    std::vector<Node*> entities;
+    parse_scene(filename.c_str(), entities);
+
+    main_scene->add_nodes(entities);
+
+    build_scene_bvh();
+}
+
+void SampleEngine::update_ply_stream()
+{
+    if (!ply_streamer.is_open()) {
+        return;
+    }
+
+    std::vector<sSplatBlock*> loaded_blocks;
+    std::vector<uint32_t> evicted_blocks;
+
+    ply_streamer.update(renderer->get_camera()->get_eye(), ply_interest_radius, loaded_blocks, evicted_blocks);
+
+    if (loaded_blocks.empty() && evicted_blocks.empty()) {
+        sort_splats();
+        return;
+    }
+
+    // The node takes its surface with it, the material stays for the next blocks
+    for (uint32_t block_index : evicted_blocks) {
+        auto it = splat_block_nodes.find(block_index);
+        if (it == splat_block_nodes.end()) {
+            continue;
+        }
+
+        remove_bvh_instance(it->second);
+        main_scene->remove_node(it->second);
+        delete it->second;
+        splat_block_nodes.erase(it);
+    }
+
+    if (!splat_material && !loaded_blocks.empty()) {
+        splat_material = new Material();
+        splat_material->set_type(MATERIAL_UNLIT);
+        splat_material->set_topology_type(TOPOLOGY_POINT_LIST);
+        splat_material->set_transparency_type(ALPHA_BLEND);
+        splat_material->set_shader(RendererStorage::get_shader_from_source(shaders::mesh_forward::source, shaders::mesh_forward::path, shaders::mesh_forward::libraries, splat_material));
+    }
+
+    for (sSplatBlock* block : loaded_blocks) {
+        if (block->positions.empty()) {
+            continue;
+        }
+
+        sSurfaceData surface_data;
+        surface_data.resize(block->positions.size());
+
+        for (uint32_t i = 0u; i < surface_data.size(); ++i) {
+            surface_data.vertices[i] = block->positions[i];
+            surface_data.colors[i] = glm::vec3(block->colors[i]);
+        }
+
+        Surface* surface = new Surface();
+        surface->create_surface_data(surface_data);
+
+        MeshInstance3D* block_node = new MeshInstance3D();
+        block_node->set_name("splat_block_" + std::to_string(block->block_index));
+        block_node->add_surface(surface);
+        block_node->set_surface_material_override(surface, splat_material);
+
+        main_scene->add_node(block_node);
+        splat_block_nodes[block->block_index] = block_node;
+
+        add_bvh_instance(block_node);
+
+        ply_streamer.release_block_data(block->block_index);
+    }
+
+    // Flattening is cheap, the scene BVH only gets the blocks that changed
+    transform_hierarchy.build(main_scene->get_nodes());
+
+    if (scene_bvh.is_degraded()) {
+        build_scene_bvh();
+    }
+
+    splat_blocks_dirty = true;
+    sort_splats();
+}
+
+void SampleEngine::sort_splats()
+{
+    // Swapping the splat set waits for the running sort, so only do it once the sorter is idle
+    if (splat_blocks_dirty && !splat_sorter.is_busy()) {
+        std::vector<glm::vec3> positions;
+
+        splat_block_offsets.clear();
+        splat_sorted_blocks.clear();
+
+        for (auto& block_node : splat_block_nodes) {
+            const sSplatBlock* block = ply_streamer.get_block(block_node.first);
+
+            splat_block_offsets.push_back(positions.size());
+            splat_sorted_blocks.push_back(block_node.second);
+            positions.insert(positions.end(), block->positions.begin(), block->positions.end());
+        }
+
+        // Kept with their capacity, every block gets its first order uploaded
+        splat_block_orders.resize(splat_sorted_blocks.size());
+        for (std::vector<uint32_t>& block_order : splat_block_orders) {
+            block_order.clear();
+        }
+
+        splat_sorter.set_positions(std::move(positions), std::vector<uint32_t>(splat_block_offsets));
+        splat_blocks_dirty = false;
+    }
+
+    if (splat_blocks_dirty || splat_sorter.get_splat_count() == 0u) {
+        return;
+    }
+
+    Camera* camera = renderer->get_camera();
+    splat_sorter.request_sort(camera->get_eye(), camera->get_center() - camera->get_eye());
+
+    if (!splat_sorter.fetch_order(splat_order)) {
+        return;
+    }
+
+    // Blocks are separate draws, the sorter already split the order by block. Only blocks whose order
+    // changed are uploaded again
+    for (uint32_t i = 0u; i < splat_sorted_blocks.size(); ++i) {
+        auto first = splat_order.begin() + splat_block_offsets[i];
+        auto last = i + 1u < splat_block_offsets.size() ? splat_order.begin() + splat_block_offsets[i + 1u] : splat_order.end();
+
+        std::vector<uint32_t>& block_order = splat_block_orders[i];
 
-    std::vector<Node*> entities;
-    parse_scene(filename.c_str(), entities);
+        if (std::equal(first, last, block_order.begin(), block_order.end())) {
+            continue;
+        }
 
-    main_scene->add_nodes(entities);
+        block_order.assign(first, last);
+        splat_sorted_blocks[i]->get_surface(0)->create_index_buffer(block_order);
+    }
+}
 
-    cameras.clear();
+void SampleEngine::close_ply_stream()
+{
+    // The nodes themselves go away with the scene
+    splat_sorter.set_positions({});
+    splat_order.clear();
+    splat_block_offsets.clear();
+    splat_sorted_blocks.clear();
+    splat_block_orders.clear();
+    splat_blocks_dirty = false;
+
+    ply_streamer.close();
+    splat_block_nodes.clear();
 }
 
 void SampleEngine::toggle_rotation()
@@ -1106,6 +2383,19 @@ void SampleEngine::reset_camera()
     SampleRenderer* renderer = static_cast<SampleRenderer*>(SampleRenderer::instance);
     Camera3D* camera = static_cast<Camera3D*>(renderer->get_camera());
 
+    sBVHBounds scene_bounds = get_scene_bounds();
+
+    // Frame the whole location when it is indexed
+    if (scene_bounds.is_valid()) {
+        glm::vec3 center = scene_bounds.get_center();
+        float radius = glm::max(glm::length(scene_bounds.get_size()) * 0.5f, 0.1f);
+
+        camera->look_at(center + glm::normalize(glm::vec3(0.0f, 0.5f, 1.0f)) * radius * 2.0f, center, normals::pY);
+        target_center = center;
+        lerp_center = true;
+        return;
+    }
+
     for (auto node : main_scene->get_nodes())
     {
         EntityCamera* is_camera = dynamic_cast<EntityCamera*>(node);
@@ -1159,13 +2449,348 @@ std::vector<std::string> SampleEngine::get_cameras_names()
     return names;
 }
 
+std::vector<std::string> SampleEngine::get_animation_names()
+{
+    std::vector<std::string> names;
+
+    for (sVPETAnimation* animation : vpet.animation_list) {
+        names.push_back(animation->name);
+    }
+
+    return names;
+}
+
+void SampleEngine::execute_animation_command(const sVPETAnimationCommand& command)
+{
+    if (!curve_playback.execute(command)) {
+        return;
+    }
+
+#ifndef __EMSCRIPTEN__
+    send_animation_command(command);
+#endif
+}
+
+void SampleEngine::play_animation(int index, bool loop)
+{
+    sVPETAnimationCommand command;
+    command.animation_id = static_cast<uint16_t>(index);
+    command.command = eVPETAnimationCommand::PLAY;
+    command.loop = loop;
+
+    execute_animation_command(command);
+}
+
+void SampleEngine::stop_animation(int index)
+{
+    sVPETAnimationCommand command;
+    command.animation_id = static_cast<uint16_t>(index);
+    command.command = eVPETAnimationCommand::STOP;
+
+    execute_animation_command(command);
+}
+
+void SampleEngine::seek_animation(int index, float time)
+{
+    sVPETAnimationCommand command;
+    command.animation_id = static_cast<uint16_t>(index);
+    command.command = eVPETAnimationCommand::SEEK;
+    command.time = time;
+
+    execute_animation_command(command);
+}
+
+void SampleEngine::register_rpcs()
+{
+    environment_object_id = rpc_table.add_object("Environment");
+
+    time_of_day_parameter_id = rpc_table.add_parameter<float>(environment_object_id, "time_of_day", time_of_day, [this](const float& hours) {
+        time_of_day = hours < 0.0f ? -1.0f : std::fmod(hours, 24.0f);
+        apply_environment();
+        return time_of_day;
+    });
+
+    light_preset_parameter_id = rpc_table.add_parameter<int32_t>(environment_object_id, "light_preset", light_preset, [this](const int32_t& preset) {
+        light_preset = std::clamp(preset, 0, LIGHT_PRESET_COUNT - 1);
+        apply_environment();
+        return light_preset;
+    });
+
+    // Preset names in order, read only
+    for (int32_t preset = 0; preset < LIGHT_PRESET_COUNT; ++preset) {
+        rpc_table.add_parameter<std::string_view>(environment_object_id, "light_preset_" + std::to_string(preset), LIGHT_PRESETS[preset].name, nullptr);
+    }
+
+    uint16_t camera_object_id = rpc_table.add_object("Camera");
+
+    rpc_table.add_parameter<int32_t>(camera_object_id, "lookat_index", 0, [this](const int32_t& index) {
+        // Out of range indices keep the current camera
+        set_camera_lookat_index(index);
+        return static_cast<int32_t>(std::max(target_camera_idx, 0));
+    });
+
+    rpc_table.add_parameter<float>(camera_object_id, "speed", camera_interp_speed, [this](const float& speed) {
+        set_camera_speed(speed);
+        return camera_interp_speed;
+    });
+
+    rpc_table.add_parameter<sVPETAction>(camera_object_id, "reset", {}, [this](const sVPETAction& action) {
+        reset_camera();
+        return action;
+    });
+}
+
+void SampleEngine::publish_parameter_objects()
+{
+    if (!rpc_table.is_dirty()) {
+        return;
+    }
+
+    // Not worth a frame, while a reply is being served the values are published on a later one
+    std::unique_lock<std::shared_mutex> vpet_lock(vpet_mutex, std::try_to_lock);
+
+    if (vpet_lock.owns_lock()) {
+        rpc_table.publish(vpet, vpet_engine_id);
+    }
+}
+
+void SampleEngine::apply_environment()
+{
+    const sLightPreset& preset = LIGHT_PRESETS[std::clamp(light_preset, 0, LIGHT_PRESET_COUNT - 1)];
+
+    // 15 degrees per hour, the sun rises at 6 in -Z, is at the zenith at 12 and sets at 18 in +Z
+    float elevation = glm::radians((time_of_day - 6.0f) * 15.0f);
+    float sun_scale = std::clamp(std::sin(elevation), 0.05f, 1.0f);
+
+    for (sVPETNode* vpet_node : vpet.node_list) {
+        if (vpet_node->node_type != eVPETNodeType::LIGHT || !vpet_node->node_ref) {
+            continue;
+        }
+
+        sVPETLightNode* vpet_light = static_cast<sVPETLightNode*>(vpet_node);
+        Light3D* light = static_cast<Light3D*>(vpet_node->node_ref);
+
+        float intensity = vpet_light->intensity * preset.intensity_scale;
+
+        if (vpet_light->light_type == eVPETLightType::DIRECTIONAL) {
+            if (time_of_day >= 0.0f) {
+                // Stays on the horizon at night
+                float sun_elevation = std::clamp(elevation, 0.0f, glm::radians(180.0f));
+                light->set_rotation(glm::angleAxis(-sun_elevation, glm::vec3(1.0f, 0.0f, 0.0f)));
+                intensity *= sun_scale;
+            }
+            else {
+                light->set_rotation(vpet_node->rotation);
+            }
+
+            mark_node_moved(light, vpet_node);
+        }
+
+        light->set_color(vpet_light->color * preset.tint);
+        light->set_intensity(intensity);
+    }
+}
+
+void SampleEngine::set_time_of_day(float hours)
+{
+    if (!rpc_table.call(environment_object_id, time_of_day_parameter_id, hours)) {
+        return;
+    }
+
+#ifndef __EMSCRIPTEN__
+    send_rpc(environment_object_id, time_of_day_parameter_id);
+#endif
+}
+
+void SampleEngine::set_light_preset(int preset)
+{
+    if (!rpc_table.call(environment_object_id, light_preset_parameter_id, static_cast<int32_t>(preset))) {
+        return;
+    }
+
+#ifndef __EMSCRIPTEN__
+    send_rpc(environment_object_id, light_preset_parameter_id);
+#endif
+}
+
+SampleEngine::sHostedScene::~sHostedScene()
+{
+    // Assets go back to the pool before the engine textures they may point at
+    vpet.clean();
+
+    for (Node* entity : entities) {
+        delete entity;
+    }
+}
+
+SampleEngine::sHostedScene* SampleEngine::find_hosted_scene(uint8_t scene_id)
+{
+    auto it = hosted_scenes.find(scene_id);
+    return it != hosted_scenes.end() ? it->second.get() : nullptr;
+}
+
+void SampleEngine::remove_hosted_scene(uint8_t scene_id)
+{
+    auto it = hosted_scenes.find(scene_id);
+    if (it == hosted_scenes.end()) {
+        return;
+    }
+
+    // Unreachable for the scene server first, then the context releases its assets
+    vpet_scenes.remove(scene_id);
+    hosted_scenes.erase(it);
+}
+
+void SampleEngine::update_hosted_scenes()
+{
+    bool moved = false;
+    for (auto& [scene_id, hosted_scene] : hosted_scenes) {
+        moved |= !hosted_scene->moved_vpet_nodes.empty();
+    }
+
+    if (!moved) {
+        return;
+    }
+
+    // As for the rendered scene, the bounds catch up on a later frame while a reply is being served
+    std::unique_lock<std::shared_mutex> vpet_lock(vpet_mutex, std::try_to_lock);
+
+    if (!vpet_lock.owns_lock()) {
+        return;
+    }
+
+    for (auto& [scene_id, hosted_scene] : hosted_scenes) {
+        for (sVPETNode* vpet_node : hosted_scene->moved_vpet_nodes) {
+            update_context_bounds(hosted_scene->vpet, vpet_node);
+        }
+
+        hosted_scene->moved_vpet_nodes.clear();
+    }
+}
+
+bool SampleEngine::host_glb(int scene_id, const std::string& filename)
+{
+    static const uint32_t hosted_scenes_gauge = Stats::get_metric("vpet.hosted_scenes", Stats::METRIC_GAUGE);
+    static const uint32_t pooled_meshes_gauge = Stats::get_metric("vpet.pooled_meshes", Stats::METRIC_GAUGE);
+    static const uint32_t pooled_textures_gauge = Stats::get_metric("vpet.pooled_textures", Stats::METRIC_GAUGE);
+
+    if (scene_id < 0 || scene_id > 255 || scene_id == vpet_engine_id) {
+        spdlog::error("Scene id {} can not be hosted, ids are 0 to 255 and {} is the rendered scene", scene_id, vpet_engine_id);
+        return false;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Built without the context lock, the scene server does not know about it until it is added below
+    std::unique_ptr<sHostedScene> hosted_scene = std::make_unique<sHostedScene>();
+    sVPETContext& scene = hosted_scene->vpet;
+
+    scene.texture_profiles = vpet.texture_profiles;
+
+    GltfParser parser;
+    if (!read_mapped_glb(parser, filename, hosted_scene->entities, PARSE_GLTF_FILL_SURFACE_DATA)) {
+        parse_scene(filename.c_str(), hosted_scene->entities, true);
+    }
+
+    // A scene already hosted under the id stays
+    if (hosted_scene->entities.empty()) {
+        spdlog::error("Nothing to host in {}", filename);
+        return false;
+    }
+
+    std::function<void(Node*)> recurse_tree = [&](Node* node) {
+        process_scene_object(scene, node);
+
+        for (auto child : node->get_children()) {
+            recurse_tree(child);
+        }
+    };
+
+    for (Node* entity : hosted_scene->entities) {
+        recurse_tree(entity);
+    }
+
+    // While the assets are only reachable from this context, pooled ones are served by others and stay untouched
+    bake_texture_variants(scene);
+    generate_context_lods(scene, TRACER_LOD_COUNT);
+
+    uint32_t shared_count = 0u;
+
+    // Pooled textures may be copied on share while other contexts serve them
+    {
+        std::unique_lock<std::shared_mutex> vpet_lock(vpet_mutex);
+        shared_count = vpet_scenes.asset_pool.share(scene);
+    }
+
+    build_context_bvh(scene);
+    process_animations(scene, filename);
+
+    hosted_scene->interest_manager.set_hysteresis(interest_manager.get_hysteresis());
+    hosted_scene->interest_manager.build(scene);
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    spdlog::info("Hosting {} as scene {} in {:.2f} ms, {} of {} meshes and textures shared with other scenes", filename, scene_id,
+        std::chrono::duration<float, std::milli>(end - start).count(), shared_count, scene.geo_list.size() + scene.texture_list.size());
+
+    {
+        // A scene hosted under the same id is replaced, replies being served finish first
+        std::unique_lock<std::shared_mutex> vpet_lock(vpet_mutex);
+
+        remove_hosted_scene(static_cast<uint8_t>(scene_id));
+
+        vpet_scenes.add(static_cast<uint8_t>(scene_id), &scene);
+        hosted_scenes[static_cast<uint8_t>(scene_id)] = std::move(hosted_scene);
+    }
+
+    Stats::set_gauge(hosted_scenes_gauge, hosted_scenes.size());
+    Stats::set_gauge(pooled_meshes_gauge, vpet_scenes.asset_pool.get_mesh_count());
+    Stats::set_gauge(pooled_textures_gauge, vpet_scenes.asset_pool.get_texture_count());
+
+    return true;
+}
+
+void SampleEngine::unhost_scene(int scene_id)
+{
+    static const uint32_t hosted_scenes_gauge = Stats::get_metric("vpet.hosted_scenes", Stats::METRIC_GAUGE);
+    static const uint32_t pooled_meshes_gauge = Stats::get_metric("vpet.pooled_meshes", Stats::METRIC_GAUGE);
+    static const uint32_t pooled_textures_gauge = Stats::get_metric("vpet.pooled_textures", Stats::METRIC_GAUGE);
+
+    if (scene_id < 0 || scene_id > 255) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> vpet_lock(vpet_mutex);
+
+    remove_hosted_scene(static_cast<uint8_t>(scene_id));
+
+    Stats::set_gauge(hosted_scenes_gauge, hosted_scenes.size());
+    Stats::set_gauge(pooled_meshes_gauge, vpet_scenes.asset_pool.get_mesh_count());
+    Stats::set_gauge(pooled_textures_gauge, vpet_scenes.asset_pool.get_texture_count());
+}
+
+std::vector<int> SampleEngine::get_hosted_scene_ids()
+{
+    std::vector<int> scene_ids;
+
+    for (auto& [scene_id, hosted_scene] : hosted_scenes) {
+        scene_ids.push_back(scene_id);
+    }
+
+    std::sort(scene_ids.begin(), scene_ids.end());
+
+    return scene_ids;
+}
+
 void SampleEngine::append_glb(const std::string& filename)
 {
     std::vector<Node*> entities;
 
     gltf_parser.push_scene_root(scene_root);
 
-    gltf_parser.parse(filename.c_str(), entities, PARSE_NO_FLAGS);
+    if (!read_mapped_glb(gltf_parser, filename, entities, PARSE_NO_FLAGS)) {
+        gltf_parser.parse(filename.c_str(), entities, PARSE_NO_FLAGS);
+    }
 
     if (!entities.empty()) {
         assert(!scene_root);
@@ -1173,6 +2798,8 @@ void SampleEngine::append_glb(const std::string& filename)
         scene_root = static_cast<Node3D*>(entities[0]);
         main_scene->add_nodes(entities);
     }
+
+    build_scene_bvh();
 }
 
 void SampleEngine::append_glb_data(int8_t* byte_array, uint32_t array_size)
@@ -1190,6 +2817,166 @@ void SampleEngine::append_glb_data(int8_t* byte_array, uint32_t array_size)
         main_scene->add_nodes(entities);
     }
 
+    build_scene_bvh();
+}
+
+void SampleEngine::build_scene_bvh()
+{
+    transform_hierarchy.build(main_scene->get_nodes());
+
+    bvh_instances.clear();
+    bvh_instance_items.clear();
+    moved_nodes.clear();
+    moved_vpet_nodes.clear();
+
+    std::function<void(Node*)> recurse_tree = [&](Node* node) {
+        // Batched meshes draw through their batch instance
+        MeshInstance3D* mesh_instance = dynamic_cast<MeshInstance3D*>(node);
+        if (mesh_instance && !dynamic_cast<Environment3D*>(node) && !geometry_pool.is_batched(mesh_instance)) {
+            bvh_instance_items[mesh_instance] = bvh_instances.size();
+            bvh_instances.push_back(mesh_instance);
+        }
+
+        for (auto child : node->get_children()) {
+            recurse_tree(child);
+        }
+    };
+
+    for (Node* node : main_scene->get_nodes()) {
+        recurse_tree(node);
+    }
+
+    std::vector<sBVHBounds> instance_bounds(bvh_instances.size());
+    for (uint32_t i = 0u; i < bvh_instances.size(); ++i) {
+        instance_bounds[i] = get_world_bounds(bvh_instances[i]);
+    }
+
+    scene_bvh.build(instance_bounds);
+
+    // Culling starts over with everything visible
+    bvh_instance_visible.assign(bvh_instances.size(), 1u);
+    for (MeshInstance3D* instance : bvh_instances) {
+        if (instance->get_children().empty()) {
+            instance->set_visibility(true);
+        }
+    }
+}
+
+void SampleEngine::add_bvh_instance(MeshInstance3D* instance)
+{
+    uint32_t item = scene_bvh.insert_item(get_world_bounds(instance));
+
+    if (item >= bvh_instances.size()) {
+        bvh_instances.resize(item + 1u, nullptr);
+        bvh_instance_visible.resize(item + 1u, 1u);
+    }
+
+    bvh_instances[item] = instance;
+    bvh_instance_visible[item] = 1u;
+    bvh_instance_items[instance] = item;
+
+    instance->set_visibility(true);
+}
+
+void SampleEngine::remove_bvh_instance(MeshInstance3D* instance)
+{
+    auto it = bvh_instance_items.find(instance);
+    if (it == bvh_instance_items.end()) {
+        return;
+    }
+
+    scene_bvh.remove_item(it->second);
+    bvh_instances[it->second] = nullptr;
+    bvh_instance_items.erase(it);
+}
+
+void SampleEngine::mark_node_moved(Node3D* node, sVPETNode* vpet_node)
+{
+    if (!transform_hierarchy.mark_dirty(node)) {
+        moved_nodes.push_back(node);
+    }
+
+    if (vpet_node) {
+        moved_vpet_nodes.push_back(vpet_node);
+    }
+}
+
+void SampleEngine::refit_scene_bvh()
+{
+    static const uint32_t transform_timer = Stats::get_metric("scene.transform_update", Stats::METRIC_TIMER);
+    static const uint32_t transform_counter = Stats::get_metric("scene.transform_nodes", Stats::METRIC_COUNTER);
+
+    if (!transform_hierarchy.is_dirty() && moved_nodes.empty() && moved_vpet_nodes.empty()) {
+        return;
+    }
+
+    bool released_batched = false;
+
+    auto refit_node = [&](Node* node) {
+        // Moving a batched mesh takes it out of its batch, it joins the BVH on the rebuild below
+        if (geometry_pool.release(dynamic_cast<MeshInstance3D*>(node), upload_queue)) {
+            released_batched = true;
+        }
+
+        auto it = bvh_instance_items.find(dynamic_cast<MeshInstance3D*>(node));
+        if (it != bvh_instance_items.end()) {
+            scene_bvh.update_item(it->second, get_world_bounds(it->first));
+        }
+    };
+
+    {
+        ScopedTimer timer(transform_timer);
+        Stats::add_count(transform_counter, transform_hierarchy.update());
+    }
+
+    // Moved subtrees come without overlaps, each node is refit once
+    for (const TransformHierarchy::sRange& range : transform_hierarchy.get_updated_ranges()) {
+        for (uint32_t i = range.begin; i < range.end; ++i) {
+            refit_node(transform_hierarchy.get_node(i));
+        }
+    }
+
+    std::function<void(Node*)> refit_subtree = [&](Node* node) {
+        refit_node(node);
+
+        for (auto child : node->get_children()) {
+            refit_subtree(child);
+        }
+    };
+
+    for (Node3D* node : moved_nodes) {
+        refit_subtree(node);
+    }
+
+    // Not worth a frame, while a reply is being served the context bounds catch up on a later one
+    std::unique_lock<std::shared_mutex> vpet_lock(vpet_mutex, std::try_to_lock);
+
+    if (vpet_lock.owns_lock()) {
+        for (sVPETNode* vpet_node : moved_vpet_nodes) {
+            update_context_bounds(vpet, vpet_node);
+        }
+
+        moved_vpet_nodes.clear();
+    }
+
+    moved_nodes.clear();
+
+    if (released_batched || scene_bvh.is_degraded()) {
+        // Deferred context bounds survive the rebuild
+        std::vector<sVPETNode*> pending_vpet_nodes = std::move(moved_vpet_nodes);
+        build_scene_bvh();
+        moved_vpet_nodes = std::move(pending_vpet_nodes);
+    }
+}
+
+void SampleEngine::query_scene_region(const glm::vec3& center, float radius, std::vector<MeshInstance3D*>& instances) const
+{
+    std::vector<uint32_t> items;
+    scene_bvh.query_sphere(center, radius, items);
+
+    for (uint32_t item : items) {
+        instances.push_back(bvh_instances[item]);
+    }
 }
 
 Camera* SampleEngine::get_current_camera()
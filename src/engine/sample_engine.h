@@ -6,12 +6,37 @@
 
 #include "framework/math/math_utils.h"
 
+#include "engine/ply_streamer.h"
+#include "engine/splat_sorter.h"
+#include "engine/upload_queue.h"
+#include "engine/geometry_pool.h"
+#include "engine/transform_hierarchy.h"
+#include "engine/skinning.h"
+#include "engine/curve_playback.h"
+#include "vpet/scene_bvh.h"
+#include "vpet/update_replay.h"
+#include "vpet/scene_server.h"
+#include "vpet/client_clocks.h"
+#include "vpet/jitter_buffer.h"
+#include "vpet/lock_table.h"
+#include "vpet/rpc_table.h"
+#include "vpet/scene_registry.h"
+#include "vpet/interest_management.h"
+
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class EntityCamera;
 class MeshInstance3D;
+class LODMeshInstance3D;
+class Node;
 class Node3D;
+struct sVPETNode;
+struct sVPETMesh;
+class Material;
 
 class SampleEngine : public Engine {
 
@@ -31,13 +56,175 @@ class SampleEngine : public Engine {
 
     float camera_interp_speed = 1.0f;
 
+    // Instances created by load_tracer_scene, their LOD is picked every frame
+    std::vector<LODMeshInstance3D*> lod_instances;
+
+    // Spatial index over every mesh instance in the scene, item i is bvh_instances[i]
+    SceneBVH scene_bvh;
+    std::vector<MeshInstance3D*> bvh_instances;
+    std::unordered_map<MeshInstance3D*, uint32_t> bvh_instance_items;
+    std::vector<uint32_t> visible_items;
+    std::vector<uint8_t> bvh_instance_visible;
+    // Reused every frame by the culling in render
+    std::vector<uint8_t> bvh_instance_in_frustum;
+    bool frustum_culling = true;
+
+    // Scene nodes with dirty flags, only moved subtrees are refit
+    TransformHierarchy transform_hierarchy;
+
+    // Moved since the last refit and not part of transform_hierarchy
+    std::vector<Node3D*> moved_nodes;
+    std::vector<sVPETNode*> moved_vpet_nodes;
+
+    void build_scene_bvh();
+    void refit_scene_bvh();
+    // For instances that come and go between builds, their slot in bvh_instances is null once removed
+    void add_bvh_instance(MeshInstance3D* instance);
+    void remove_bvh_instance(MeshInstance3D* instance);
+    void mark_node_moved(Node3D* node, sVPETNode* vpet_node = nullptr);
+
+    // Tracer scene geometry, uploaded over the next frames
+    UploadQueue upload_queue;
+
+    // Tracer and GLB meshes up to geometry_pool_max_triangles are batched by material and cell
+    GeometryPool geometry_pool;
+    bool geometry_pool_enabled = true;
+    uint32_t geometry_pool_max_triangles = 2048u;
+
+    // Poses of the skinned tracer meshes, streamed to the clients, DIGITAL_LOCATIONS_SKINNING=cpu skins them here
+    CharacterSkinning character_skinning;
+    std::vector<std::vector<uint8_t>> pose_messages;
+
+    // Animations served in "curve", clients play them locally and only the commands are sent
+    CurvePlayback curve_playback;
+    std::vector<sVPETNode*> animated_vpet_nodes;
+    std::vector<sVPETAnimationCommand> animation_states;
+
+    void queue_tracer_surfaces(LODMeshInstance3D* mesh_instance, sVPETNode* vpet_node, const sVPETMesh* vpet_mesh, Material* material);
+    // Batches the small static meshes of a parsed scene, they keep their own surfaces for when they are released
+    void pool_scene_meshes(const std::vector<Node*>& nodes);
+
+    // Out of core PLY, each resident block is a point list instance
+    PlyStreamer ply_streamer;
+    std::unordered_map<uint32_t, MeshInstance3D*> splat_block_nodes;
+    // Shared by every block
+    Material* splat_material = nullptr;
+    float ply_interest_radius = 25.0f;
+
+    // Back to front order over all resident blocks, grouped by block by the sorter. splat_block_offsets[i] is
+    // where the splats of splat_sorted_blocks[i] start, splat_block_orders[i] what its index buffer holds
+    SplatSorter splat_sorter;
+    std::vector<uint32_t> splat_order;
+    std::vector<uint32_t> splat_block_offsets;
+    std::vector<MeshInstance3D*> splat_sorted_blocks;
+    std::vector<std::vector<uint32_t>> splat_block_orders;
+    bool splat_blocks_dirty = false;
+
+    void update_ply_stream();
+    void sort_splats();
+    void close_ply_stream();
+
     // Vpet connection
     void* context;
-    void* distributor; // to send scene
-    void* subscriber; // to sync scene
-    //void* publisher;
+    SceneServer scene_server; // to send scene, bulk plane on its own thread
+    void* subscriber; // to sync scene, control plane drained every frame
+    void* publisher; // to answer and send pings
     void* poller; // to avoid blocking checking for messages
 
+    // Taken exclusively to change vpet while the scene server may be reading it
+    std::shared_mutex vpet_mutex;
+
+    // Contexts served by scene id, vpet is vpet_engine_id. Updates for other ids that are not hosted are rejected
+    SceneRegistry vpet_scenes;
+
+    // Locations served next to the rendered one, kept up to date from the clients but not drawn
+    struct sHostedScene {
+        sVPETContext vpet;
+        LockTable lock_table;
+        InterestManager interest_manager;
+        std::vector<Node*> entities;
+        std::vector<sVPETNode*> moved_vpet_nodes;
+
+        ~sHostedScene();
+    };
+
+    std::unordered_map<uint8_t, std::unique_ptr<sHostedScene>> hosted_scenes;
+
+    sHostedScene* find_hosted_scene(uint8_t scene_id);
+    void remove_hosted_scene(uint8_t scene_id);
+    void update_hosted_scenes();
+
+    // Updates applied per frame, the rest wait for the next one
+    uint32_t max_updates_per_frame = 1024u;
+
+    // Scene id of the rendered scene, its header advertises it as sVPETHeader::sender_id
+    uint8_t vpet_engine_id = 0u;
+
+    // Step clock of the TRACER messages, with round trip and offset per client from PINGs
+    ClientClocks client_clocks;
+    float ping_interval = 1.0f;
+    uint64_t last_ping_us = 0u;
+
+    // Remote transform edits shown jitter_buffer.delay_us late but smooth, set by DIGITAL_LOCATIONS_SMOOTHING
+    JitterBuffer jitter_buffer;
+    bool smoothing_enabled = false;
+    std::vector<sVPETNode*> smoothed_vpet_nodes;
+
+    // Owners of the locked editables, updates of other clients are dropped undecoded
+    LockTable lock_table;
+    std::vector<LockTable::sLockChange> expired_locks;
+
+    // Edits fanned out on the interest plane at the TRACER frame rate, each client only gets the editables in the
+    // region it registered. DIGITAL_LOCATIONS_INTEREST_HYSTERESIS sets how far they leave it, in meters
+    void* interest_publisher = nullptr;
+    InterestManager interest_manager;
+    std::vector<sVPETInterestBatch> interest_batches;
+    std::vector<uint8_t> interest_message;
+    uint64_t last_interest_us = 0u;
+
+    // Scene wide controls served in "parameterobjects", RPC messages call their handlers
+    RPCTable rpc_table;
+    std::vector<uint8_t> rpc_message;
+    uint16_t environment_object_id = 0u;
+    uint16_t time_of_day_parameter_id = 0u;
+    uint16_t light_preset_parameter_id = 0u;
+
+    // Hours, below 0 the lights stay as the scene has them
+    float time_of_day = -1.0f;
+    int32_t light_preset = 0;
+
+    void register_rpcs();
+    void publish_parameter_objects();
+    void apply_environment();
+
+#ifndef __EMSCRIPTEN__
+    void apply_vpet_message(const uint8_t* buffer, uint32_t msg_size);
+    void send_ping(uint64_t now_us);
+    void answer_ping(uint8_t client_id, uint8_t client_time, uint64_t now_us);
+    void update_client_clock_stats(uint8_t client_id);
+    void apply_smoothed_transforms();
+    void send_poses();
+    void apply_lock_message(uint8_t client_id, const uint8_t* buffer, uint32_t msg_size, uint64_t now_us);
+    void send_lock(uint8_t scene_id, uint16_t object_id, bool locked);
+    void expire_locks(uint64_t now_us);
+    void apply_animation_message(const uint8_t* buffer, uint32_t msg_size, uint64_t latency_us);
+    void send_animation_command(const sVPETAnimationCommand& command);
+    void send_animation_states();
+    void send_rpc(uint16_t object_id, uint16_t parameter_id);
+    void apply_interest_message(uint8_t client_id, const uint8_t* buffer, uint32_t msg_size, uint64_t now_us);
+    void send_interest_updates(uint64_t now_us);
+#endif
+
+    void execute_animation_command(const sVPETAnimationCommand& command);
+
+    // Processed GLB scenes by content hash, empty when disabled
+    std::string scene_cache_directory;
+
+    // DIGITAL_LOCATIONS_CAPTURE records received updates, DIGITAL_LOCATIONS_REPLAY feeds a capture back in
+    UpdateCaptureWriter update_capture;
+    UpdateReplayer update_replayer;
+    bool replaying = false;
+
 public:
 
     int initialize(Renderer* renderer, sEngineConfiguration configuration = {}) override;
@@ -54,8 +241,13 @@ public:
     void update(float delta_time) override;
     void render() override;
 
+    sBVHBounds get_scene_bounds() const { return scene_bvh.get_bounds(); }
+    void query_scene_region(const glm::vec3& center, float radius, std::vector<MeshInstance3D*>& instances) const;
+
     void update_scene_parameter(uint32_t scene_object_id, uint16_t parameter_id, float vx, float vy, float vz, float vw);
     void load_tracer_scene();
+    // Runs every pending upload now instead of over the next frames
+    void flush_uploads() { upload_queue.flush(); }
 
     // Methods to use in web demonstrator
     void set_skybox_texture(const std::string& filename);
@@ -67,6 +259,18 @@ public:
     void reset_camera();
     void set_camera_speed(float value);
     std::vector<std::string> get_cameras_names();
+    std::vector<std::string> get_animation_names();
+    void play_animation(int index, bool loop);
+    void stop_animation(int index);
+    void seek_animation(int index, float time);
+    void set_time_of_day(float hours);
+    void set_light_preset(int preset);
+
+    // Serves another location as scene_id without rendering it, its meshes and textures are shared with the
+    // other scenes where equal. Clients pick it with the "scene" request option and its id in the updates
+    bool host_glb(int scene_id, const std::string& filename);
+    void unhost_scene(int scene_id);
+    std::vector<int> get_hosted_scene_ids();
 
     // Methods to use in UHasselts gltf streaming demo
     void append_glb(const std::string& filename);
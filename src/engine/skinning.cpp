@@ -0,0 +1,280 @@
+#include "skinning.h"
+
+#include "engine/job_system.h"
+
+#include "vpet/character_distribution.h"
+
+#include "framework/nodes/mesh_instance_3d.h"
+#include "framework/animation/skeleton.h"
+
+#include "graphics/surface.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SKINNING_SSE
+#endif
+
+namespace {
+
+    uint32_t get_bone_index(const sSkinData& skin, uint32_t influence)
+    {
+        if (skin.index_size == 1u) {
+            return skin.indices[influence];
+        }
+
+        uint16_t bone;
+        memcpy(&bone, &skin.indices[influence * 2u], sizeof(uint16_t));
+        return bone;
+    }
+
+    // Degenerate bone matrices can collapse the normal, normalizing it would give NaN
+    glm::vec3 get_skinned_normal(const glm::vec3& skinned, const glm::vec3& source)
+    {
+        float length_squared = glm::dot(skinned, skinned);
+        return length_squared > 1e-12f ? skinned / sqrtf(length_squared) : source;
+    }
+}
+
+void skin_vertices(const sSkinData& skin, const glm::mat4* bone_matrices, uint32_t first, uint32_t count,
+    glm::vec3* out_positions, glm::vec3* out_normals)
+{
+    const float weight_scale = 1.0f / 255.0f;
+
+    for (uint32_t vertex_idx = first; vertex_idx < first + count; ++vertex_idx) {
+        const uint8_t* weights = &skin.weights[vertex_idx * 4u];
+
+        // Unweighted vertices stay in the bind pose
+        if (weights[0] == 0u && weights[1] == 0u && weights[2] == 0u && weights[3] == 0u) {
+            out_positions[vertex_idx] = skin.positions[vertex_idx];
+
+            if (skin.normals && out_normals) {
+                out_normals[vertex_idx] = skin.normals[vertex_idx];
+            }
+
+            continue;
+        }
+
+#ifdef SKINNING_SSE
+        // Blended matrix, one register per column
+        __m128 columns[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+
+        for (uint32_t i = 0u; i < 4u; ++i) {
+            if (weights[i] == 0u) {
+                continue;
+            }
+
+            const float* matrix = &bone_matrices[get_bone_index(skin, vertex_idx * 4u + i)][0][0];
+            __m128 weight = _mm_set1_ps(weights[i] * weight_scale);
+
+            columns[0] = _mm_add_ps(columns[0], _mm_mul_ps(weight, _mm_loadu_ps(matrix)));
+            columns[1] = _mm_add_ps(columns[1], _mm_mul_ps(weight, _mm_loadu_ps(matrix + 4)));
+            columns[2] = _mm_add_ps(columns[2], _mm_mul_ps(weight, _mm_loadu_ps(matrix + 8)));
+            columns[3] = _mm_add_ps(columns[3], _mm_mul_ps(weight, _mm_loadu_ps(matrix + 12)));
+        }
+
+        const glm::vec3& position = skin.positions[vertex_idx];
+
+        __m128 result = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(position.x)), _mm_mul_ps(columns[1], _mm_set1_ps(position.y))),
+            _mm_add_ps(_mm_mul_ps(columns[2], _mm_set1_ps(position.z)), columns[3]));
+
+        float skinned[4];
+        _mm_storeu_ps(skinned, result);
+        out_positions[vertex_idx] = glm::vec3(skinned[0], skinned[1], skinned[2]);
+
+        if (skin.normals && out_normals) {
+            const glm::vec3& normal = skin.normals[vertex_idx];
+
+            result = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(normal.x)), _mm_mul_ps(columns[1], _mm_set1_ps(normal.y))),
+                _mm_mul_ps(columns[2], _mm_set1_ps(normal.z)));
+
+            _mm_storeu_ps(skinned, result);
+            out_normals[vertex_idx] = get_skinned_normal(glm::vec3(skinned[0], skinned[1], skinned[2]), normal);
+        }
+#else
+        glm::mat4 matrix = glm::mat4(0.0f);
+
+        for (uint32_t i = 0u; i < 4u; ++i) {
+            if (weights[i] == 0u) {
+                continue;
+            }
+
+            const glm::mat4& bone_matrix = bone_matrices[get_bone_index(skin, vertex_idx * 4u + i)];
+            float weight = weights[i] * weight_scale;
+
+            for (int column = 0; column < 4; ++column) {
+                matrix[column] += bone_matrix[column] * weight;
+            }
+        }
+
+        out_positions[vertex_idx] = glm::vec3(matrix * glm::vec4(skin.positions[vertex_idx], 1.0f));
+
+        if (skin.normals && out_normals) {
+            out_normals[vertex_idx] = get_skinned_normal(glm::vec3(matrix * glm::vec4(skin.normals[vertex_idx], 0.0f)), skin.normals[vertex_idx]);
+        }
+#endif
+    }
+}
+
+void CharacterSkinning::build(const sVPETContext& vpet)
+{
+    clear();
+
+    for (uint32_t character_idx = 0u; character_idx < vpet.character_list.size(); ++character_idx) {
+        const sVPETCharacter* vpet_character = vpet.character_list[character_idx];
+
+        if (!vpet_character->skeleton_ref || vpet_character->node_id < 0) {
+            continue;
+        }
+
+        const sVPETNode* vpet_node = vpet.node_list[vpet_character->node_id];
+        MeshInstance3D* mesh_instance = static_cast<MeshInstance3D*>(vpet_node->node_ref);
+
+        if (!mesh_instance) {
+            continue;
+        }
+
+        characters.emplace_back();
+
+        sCharacter& character = characters.back();
+        character.character = vpet_character;
+        character.character_id = static_cast<uint16_t>(character_idx);
+
+        uint32_t bone_count = vpet_character->bone_parents.size();
+        character.global_matrices.resize(bone_count);
+        character.bone_matrices.resize(bone_count);
+        character.pose.resize(bone_count * 4u);
+
+        if (!cpu_skinning) {
+            continue;
+        }
+
+        // Surfaces are the geo nodes right after their mesh instance
+        const std::vector<Surface*>& surfaces = mesh_instance->get_surfaces();
+
+        for (uint32_t surface_idx = 0u; surface_idx < surfaces.size(); ++surface_idx) {
+            const sVPETGeoNode* geo_node = static_cast<const sVPETGeoNode*>(vpet.node_list[vpet_character->node_id + 1 + surface_idx]);
+            const sVPETMesh* mesh = geo_node->geo_id >= 0 ? vpet.geo_list[geo_node->geo_id] : nullptr;
+
+            sSurfaceData& surface_data = surfaces[surface_idx]->get_surface_data();
+
+            if (!mesh || mesh->skin_weights.size() != surface_data.vertices.size() * 4u) {
+                continue;
+            }
+
+            sSkin skin;
+            skin.surface = surfaces[surface_idx];
+            skin.mesh = mesh;
+            skin.positions = surface_data.vertices;
+            skin.normals = surface_data.normals;
+
+            character.skins.push_back(std::move(skin));
+        }
+    }
+}
+
+void CharacterSkinning::clear()
+{
+    characters.clear();
+}
+
+void CharacterSkinning::sample_pose(sCharacter& character)
+{
+    const sVPETCharacter& vpet_character = *character.character;
+    const Pose& pose = vpet_character.skeleton_ref->get_current_pose();
+
+    uint32_t bone_count = std::min(static_cast<uint32_t>(vpet_character.bone_parents.size()), pose.size());
+
+    for (uint32_t bone_idx : vpet_character.bone_order) {
+        if (bone_idx >= bone_count) {
+            continue;
+        }
+
+        Transform local_transform = pose.get_local_transform(bone_idx);
+
+        glm::mat4 local_matrix = glm::translate(glm::mat4(1.0f), local_transform.get_position());
+        local_matrix = local_matrix * glm::mat4_cast(local_transform.get_rotation());
+        local_matrix = glm::scale(local_matrix, local_transform.get_scale());
+
+        int32_t parent = vpet_character.bone_parents[bone_idx];
+        character.global_matrices[bone_idx] = parent >= 0 ? character.global_matrices[parent] * local_matrix : local_matrix;
+        character.bone_matrices[bone_idx] = character.global_matrices[bone_idx] * vpet_character.inverse_bind_matrices[bone_idx];
+
+        pack_bone_rotation(local_transform.get_rotation(), &character.pose[bone_idx * 4u]);
+
+        if (bone_idx == vpet_character.bone_order[0]) {
+            character.root_position = local_transform.get_position();
+        }
+    }
+
+    character.pose_changed |= character.pose != character.sent_pose || character.root_position != character.sent_root_position;
+}
+
+void CharacterSkinning::skin(sCharacter& character)
+{
+    for (sSkin& skin : character.skins) {
+        sSurfaceData& surface_data = skin.surface->get_surface_data();
+
+        sSkinData skin_data;
+        skin_data.positions = skin.positions.data();
+        skin_data.normals = skin.normals.size() == skin.positions.size() ? skin.normals.data() : nullptr;
+        skin_data.weights = skin.mesh->skin_weights.data();
+        skin_data.indices = skin.mesh->skin_indices.data();
+        skin_data.index_size = skin.mesh->skin_index_size;
+
+        uint32_t vertex_count = skin.positions.size();
+        uint32_t job_count = (vertex_count + skinning_grain - 1u) / skinning_grain;
+
+        glm::vec3* out_positions = surface_data.vertices.data();
+        glm::vec3* out_normals = skin_data.normals ? surface_data.normals.data() : nullptr;
+
+        JobSystem::parallel_for(job_count, [&](uint32_t job_idx) {
+            uint32_t first = job_idx * skinning_grain;
+            skin_vertices(skin_data, character.bone_matrices.data(), first, std::min(skinning_grain, vertex_count - first), out_positions, out_normals);
+        });
+    }
+}
+
+void CharacterSkinning::update()
+{
+    for (sCharacter& character : characters) {
+        sample_pose(character);
+
+        if (cpu_skinning) {
+            skin(character);
+        }
+    }
+}
+
+uint32_t CharacterSkinning::write_pose_messages(uint8_t sender_id, uint8_t time, uint8_t scene_id, std::vector<std::vector<uint8_t>>& messages)
+{
+    uint32_t message_count = 0u;
+
+    for (sCharacter& character : characters) {
+        if (!character.pose_changed) {
+            continue;
+        }
+
+        if (messages.size() <= message_count) {
+            messages.emplace_back();
+        }
+
+        uint32_t bone_count = character.pose.size() / 4u;
+
+        std::vector<uint8_t>& message = messages[message_count++];
+        message.resize(get_pose_message_size(bone_count));
+
+        write_pose_message(sender_id, time, scene_id, character.character_id, character.root_position, character.pose.data(), bone_count, message.data());
+
+        character.sent_pose = character.pose;
+        character.sent_root_position = character.root_position;
+        character.pose_changed = false;
+    }
+
+    return message_count;
+}
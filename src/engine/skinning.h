@@ -0,0 +1,76 @@
+#pragma once
+
+#include "vpet/structs.h"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class MeshInstance3D;
+class Surface;
+
+// Compact skin of one mesh, as sent in "characters"
+struct sSkinData {
+    const glm::vec3* positions = nullptr;
+    const glm::vec3* normals = nullptr;
+    const uint8_t* weights = nullptr;
+    const uint8_t* indices = nullptr;
+    uint32_t index_size = 1u;
+};
+
+// Linear blend skinning of vertices [first, first + count), 4 influences each. Uses SSE where the target has it
+void skin_vertices(const sSkinData& skin, const glm::mat4* bone_matrices, uint32_t first, uint32_t count,
+    glm::vec3* out_positions, glm::vec3* out_normals);
+
+// Per frame pose of the characters of the tracer context. With a renderer, skinned mesh instances are deformed on
+// the GPU by the framework and only the poses are sampled, to stream them to the clients. cpu_skinning is for
+// headless runs: the skinned vertices are computed here and written to the CPU copy of the surfaces.
+class CharacterSkinning {
+
+    struct sSkin {
+        Surface* surface = nullptr;
+        const sVPETMesh* mesh = nullptr;
+        // Bind pose, the surface data holds the skinned vertices
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+    };
+
+    struct sCharacter {
+        const sVPETCharacter* character = nullptr;
+        // Index in character_list
+        uint16_t character_id = 0u;
+        std::vector<glm::mat4> global_matrices;
+        std::vector<glm::mat4> bone_matrices;
+        std::vector<sSkin> skins;
+
+        // Quantized local rotations and root bone position, the last sent and the current ones
+        std::vector<int16_t> sent_pose;
+        std::vector<int16_t> pose;
+        glm::vec3 sent_root_position = {};
+        glm::vec3 root_position = {};
+        bool pose_changed = false;
+    };
+
+    std::vector<sCharacter> characters;
+
+    void sample_pose(sCharacter& character);
+    void skin(sCharacter& character);
+
+public:
+
+    bool cpu_skinning = false;
+
+    // Vertices per skinning job
+    uint32_t skinning_grain = 4096u;
+
+    void build(const sVPETContext& vpet);
+    void clear();
+
+    void update();
+
+    // POSE messages of the characters whose quantized pose changed since the last call
+    uint32_t write_pose_messages(uint8_t sender_id, uint8_t time, uint8_t scene_id, std::vector<std::vector<uint8_t>>& messages);
+
+    uint32_t get_character_count() const { return static_cast<uint32_t>(characters.size()); }
+};
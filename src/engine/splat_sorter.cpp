@@ -0,0 +1,305 @@
+#include "splat_sorter.h"
+
+#include "engine/job_system.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+    const uint32_t RADIX_BITS = 8u;
+    const uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+
+    // Below this many splats per chunk the threading overhead wins
+    const uint32_t MIN_CHUNK_SIZE = 65536u;
+}
+
+void SplatSorter::set_positions(std::vector<glm::vec3>&& new_positions, std::vector<uint32_t>&& new_group_offsets)
+{
+    wait();
+
+    positions = std::move(new_positions);
+    group_offsets = std::move(new_group_offsets);
+
+    order.resize(positions.size());
+    std::iota(order.begin(), order.end(), 0u);
+
+    has_previous_view = false;
+
+    std::lock_guard<std::mutex> lock(state_mutex);
+    has_ready_order = false;
+    ready_order.clear();
+}
+
+void SplatSorter::wait()
+{
+    std::unique_lock<std::mutex> lock(state_mutex);
+    idle_condition.wait(lock, [&] { return !busy; });
+}
+
+bool SplatSorter::is_busy()
+{
+    std::lock_guard<std::mutex> lock(state_mutex);
+    return busy;
+}
+
+uint32_t SplatSorter::get_chunk_count() const
+{
+    uint32_t thread_count = JobSystem::get_worker_count() + 1u;
+    uint32_t max_chunks = static_cast<uint32_t>(positions.size() / MIN_CHUNK_SIZE) + 1u;
+    return std::min(thread_count * 2u, max_chunks);
+}
+
+void SplatSorter::compute_keys(const glm::vec3& eye, const glm::vec3& forward)
+{
+    uint32_t count = positions.size();
+    uint32_t chunk_count = get_chunk_count();
+    uint32_t chunk_size = (count + chunk_count - 1u) / chunk_count;
+
+    depths.resize(count);
+    keys.resize(count);
+
+    std::vector<glm::vec2> chunk_ranges(chunk_count, glm::vec2(FLT_MAX, -FLT_MAX));
+
+    JobSystem::parallel_for(chunk_count, [&](uint32_t chunk) {
+        uint32_t first = chunk * chunk_size;
+        uint32_t last = std::min(count, first + chunk_size);
+
+        glm::vec2 range = chunk_ranges[chunk];
+
+        for (uint32_t i = first; i < last; ++i) {
+            float depth = glm::dot(positions[i] - eye, forward);
+            depths[i] = depth;
+            range.x = std::min(range.x, depth);
+            range.y = std::max(range.y, depth);
+        }
+
+        chunk_ranges[chunk] = range;
+    });
+
+    float min_depth = FLT_MAX;
+    float max_depth = -FLT_MAX;
+    for (const glm::vec2& range : chunk_ranges) {
+        min_depth = std::min(min_depth, range.x);
+        max_depth = std::max(max_depth, range.y);
+    }
+
+    // Farthest splats get the smallest keys so an ascending sort is back to front
+    float key_scale = static_cast<float>((1u << KEY_BITS) - 1u) / std::max(max_depth - min_depth, 1e-6f);
+
+    JobSystem::parallel_for(chunk_count, [&](uint32_t chunk) {
+        uint32_t first = chunk * chunk_size;
+        uint32_t last = std::min(count, first + chunk_size);
+
+        for (uint32_t i = first; i < last; ++i) {
+            keys[i] = static_cast<uint16_t>((max_depth - depths[i]) * key_scale);
+        }
+    });
+
+    std::iota(order.begin(), order.end(), 0u);
+}
+
+void SplatSorter::radix_sort()
+{
+    uint32_t count = keys.size();
+    uint32_t chunk_count = get_chunk_count();
+    uint32_t chunk_size = (count + chunk_count - 1u) / chunk_count;
+
+    keys_scratch.resize(count);
+    order_scratch.resize(count);
+
+    std::vector<uint32_t> histograms(chunk_count * RADIX_SIZE);
+
+    uint16_t* src_keys = keys.data();
+    uint16_t* dst_keys = keys_scratch.data();
+    uint32_t* src_order = order.data();
+    uint32_t* dst_order = order_scratch.data();
+
+    for (uint32_t shift = 0u; shift < KEY_BITS; shift += RADIX_BITS) {
+
+        std::fill(histograms.begin(), histograms.end(), 0u);
+
+        JobSystem::parallel_for(chunk_count, [&](uint32_t chunk) {
+            uint32_t* histogram = &histograms[chunk * RADIX_SIZE];
+            uint32_t first = chunk * chunk_size;
+            uint32_t last = std::min(count, first + chunk_size);
+
+            for (uint32_t i = first; i < last; ++i) {
+                histogram[(src_keys[i] >> shift) & (RADIX_SIZE - 1u)]++;
+            }
+        });
+
+        // Bucket major prefix sum keeps the sort stable across chunks
+        uint32_t offset = 0u;
+        for (uint32_t bucket = 0u; bucket < RADIX_SIZE; ++bucket) {
+            for (uint32_t chunk = 0u; chunk < chunk_count; ++chunk) {
+                uint32_t& entry = histograms[chunk * RADIX_SIZE + bucket];
+                uint32_t bucket_count = entry;
+                entry = offset;
+                offset += bucket_count;
+            }
+        }
+
+        JobSystem::parallel_for(chunk_count, [&](uint32_t chunk) {
+            uint32_t* offsets = &histograms[chunk * RADIX_SIZE];
+            uint32_t first = chunk * chunk_size;
+            uint32_t last = std::min(count, first + chunk_size);
+
+            for (uint32_t i = first; i < last; ++i) {
+                uint32_t destination = offsets[(src_keys[i] >> shift) & (RADIX_SIZE - 1u)]++;
+                dst_keys[destination] = src_keys[i];
+                dst_order[destination] = src_order[i];
+            }
+        });
+
+        std::swap(src_keys, dst_keys);
+        std::swap(src_order, dst_order);
+    }
+
+    // An odd number of passes leaves the result in the scratch buffers
+    if (src_order != order.data()) {
+        order.swap(order_scratch);
+        keys.swap(keys_scratch);
+    }
+}
+
+void SplatSorter::write_result_order()
+{
+    if (group_offsets.empty()) {
+        result_order.assign(order.begin(), order.end());
+        return;
+    }
+
+    // Stable scatter into the groups, the global order is kept within each one
+    result_order.resize(order.size());
+    group_cursors.assign(group_offsets.begin(), group_offsets.end());
+
+    for (uint32_t splat : order) {
+        uint32_t group = std::upper_bound(group_offsets.begin(), group_offsets.end(), splat) - group_offsets.begin() - 1u;
+        result_order[group_cursors[group]++] = splat - group_offsets[group];
+    }
+}
+
+SplatSorter::sSortStats SplatSorter::sort(const glm::vec3& eye, const glm::vec3& forward, std::vector<uint32_t>& out_order)
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        busy = true;
+        has_pending = true;
+        pending_eye = eye;
+        pending_forward = forward;
+    }
+
+    run_sorts();
+
+    std::lock_guard<std::mutex> lock(state_mutex);
+
+    if (has_ready_order) {
+        out_order.swap(ready_order);
+        has_ready_order = false;
+    }
+    else {
+        write_result_order();
+        out_order.assign(result_order.begin(), result_order.end());
+    }
+
+    return last_stats;
+}
+
+void SplatSorter::request_sort(const glm::vec3& eye, const glm::vec3& forward)
+{
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+
+        has_pending = true;
+        pending_eye = eye;
+        pending_forward = forward;
+
+        if (busy) {
+            return;
+        }
+
+        busy = true;
+    }
+
+    JobSystem::submit([this]() { run_sorts(); });
+}
+
+void SplatSorter::run_sorts()
+{
+    while (true) {
+        glm::vec3 eye;
+        glm::vec3 forward;
+
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+
+            if (!has_pending) {
+                busy = false;
+                idle_condition.notify_all();
+                return;
+            }
+
+            has_pending = false;
+            eye = pending_eye;
+            forward = glm::normalize(pending_forward);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        sSortStats stats;
+        stats.kind = SORT_FULL;
+
+        if (positions.empty()) {
+            stats.kind = SORT_NONE;
+        }
+        else if (has_previous_view && glm::dot(forward, previous_forward) >= reuse_cos_angle) {
+            stats.kind = SORT_REUSED;
+        }
+
+        // A reused order keeps the direction it was sorted for, so turning slowly still adds up to a new sort
+        if (stats.kind == SORT_FULL) {
+            compute_keys(eye, forward);
+            radix_sort();
+            write_result_order();
+
+            has_previous_view = true;
+            previous_forward = forward;
+        }
+
+        stats.sort_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(state_mutex);
+
+        // Swapped, the buffers go around between the worker, the ready slot and the caller
+        if (stats.kind == SORT_FULL) {
+            ready_order.swap(result_order);
+            has_ready_order = true;
+        }
+
+        last_stats = stats;
+    }
+}
+
+bool SplatSorter::fetch_order(std::vector<uint32_t>& out_order, sSortStats* stats)
+{
+    std::lock_guard<std::mutex> lock(state_mutex);
+
+    if (!has_ready_order) {
+        return false;
+    }
+
+    out_order.swap(ready_order);
+    has_ready_order = false;
+
+    if (stats) {
+        *stats = last_stats;
+    }
+
+    return true;
+}
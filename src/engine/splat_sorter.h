@@ -0,0 +1,94 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Back to front ordering of splats by quantized view depth using a parallel LSD radix sort. Depth is
+// measured along the view direction, so translating the camera keeps the previous order valid and only
+// turning past a threshold triggers a new sort. Sorts run on the job system, rendering keeps using the
+// last completed order until a new one is fetched.
+class SplatSorter {
+
+public:
+
+    static const uint32_t KEY_BITS = 16u;
+
+    enum eSortKind : uint8_t {
+        SORT_NONE,
+        SORT_REUSED,
+        SORT_FULL
+    };
+
+    struct sSortStats {
+        eSortKind kind = SORT_NONE;
+        float sort_ms = 0.0f;
+    };
+
+private:
+
+    std::vector<glm::vec3> positions;
+    // Where each group starts in positions, empty for a single group
+    std::vector<uint32_t> group_offsets;
+
+    // Worker side, order holds the result of the last sort and result_order what is handed out
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> result_order;
+    std::vector<uint32_t> group_cursors;
+    std::vector<uint32_t> order_scratch;
+    std::vector<uint16_t> keys;
+    std::vector<uint16_t> keys_scratch;
+    std::vector<float> depths;
+
+    bool has_previous_view = false;
+    glm::vec3 previous_forward = {};
+
+    // Cosine of the view direction change tolerated before sorting again, ~0.5 degrees
+    float reuse_cos_angle = 0.99996f;
+
+    std::mutex state_mutex;
+    std::condition_variable idle_condition;
+    bool busy = false;
+    bool has_pending = false;
+    glm::vec3 pending_eye = {};
+    glm::vec3 pending_forward = {};
+
+    std::vector<uint32_t> ready_order;
+    bool has_ready_order = false;
+    sSortStats last_stats;
+
+    void run_sorts();
+
+    void compute_keys(const glm::vec3& eye, const glm::vec3& forward);
+    void radix_sort();
+    void write_result_order();
+
+    uint32_t get_chunk_count() const;
+
+public:
+
+    ~SplatSorter() { wait(); }
+
+    // Waits for the running sort and starts over from the identity order. With group offsets, e.g. one per
+    // separately drawn block, orders come out grouped: the splats of each group back to front in the range
+    // the group has in positions, as indices local to the group
+    void set_positions(std::vector<glm::vec3>&& new_positions, std::vector<uint32_t>&& new_group_offsets = {});
+    uint32_t get_splat_count() const { return positions.size(); }
+
+    void set_reuse_angle(float degrees) { reuse_cos_angle = cosf(glm::radians(degrees)); }
+
+    // Starts sorting for this view, if a sort is running the latest requested view goes next
+    void request_sort(const glm::vec3& eye, const glm::vec3& forward);
+
+    // Synchronous version, the resulting order is returned directly
+    sSortStats sort(const glm::vec3& eye, const glm::vec3& forward, std::vector<uint32_t>& out_order);
+
+    // Swaps in the newest completed order, returns false if nothing finished since the last call
+    bool fetch_order(std::vector<uint32_t>& out_order, sSortStats* stats = nullptr);
+
+    bool is_busy();
+    void wait();
+};
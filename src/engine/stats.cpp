@@ -0,0 +1,337 @@
+#include "stats.h"
+
+#include "spdlog/spdlog.h"
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <mutex>
+
+#ifndef __EMSCRIPTEN__
+#include "zmq.h"
+#endif
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <cstdio>
+#include <cstring>
+#endif
+
+namespace {
+
+    struct sMetric {
+        std::string name;
+        Stats::eMetricType type = Stats::METRIC_COUNTER;
+        std::atomic<uint64_t> count = 0u;
+        std::atomic<uint64_t> sum = 0u;
+        std::atomic<uint64_t> max = 0u;
+        std::atomic<uint64_t> last = 0u;
+        std::atomic<uint64_t> buckets[Stats::HISTOGRAM_BUCKETS] = {};
+    };
+
+    // The slot past the last one takes the samples of metrics registered once the registry is full, it is never dumped
+    sMetric metrics[Stats::MAX_METRICS + 1u];
+    std::atomic<uint32_t> metric_count = 0u;
+    std::mutex registry_mutex;
+
+    Stats::sConfiguration configuration;
+    float elapsed_time = 0.0f;
+
+    void* publisher = nullptr;
+
+    void store_max(std::atomic<uint64_t>& target, uint64_t value)
+    {
+        uint64_t current = target.load(std::memory_order_relaxed);
+        while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed));
+    }
+
+    // Gauges keep the bits of a signed value
+    void store_max_signed(std::atomic<uint64_t>& target, int64_t value)
+    {
+        uint64_t current = target.load(std::memory_order_relaxed);
+        while (value > static_cast<int64_t>(current) && !target.compare_exchange_weak(current, static_cast<uint64_t>(value), std::memory_order_relaxed));
+    }
+
+    uint32_t get_histogram_bucket(uint64_t microseconds)
+    {
+        uint32_t bucket = 0u;
+
+        for (uint64_t value = microseconds >> 6; value > 0u && bucket + 1u < Stats::HISTOGRAM_BUCKETS; value >>= 1) {
+            bucket++;
+        }
+
+        return bucket;
+    }
+
+    // Upper bound of the bucket holding the given fraction of the samples
+    float get_histogram_percentile_ms(const uint64_t* bucket_counts, uint64_t count, float fraction)
+    {
+        uint64_t target = static_cast<uint64_t>(ceil(count * fraction));
+        uint64_t accumulated = 0u;
+
+        for (uint32_t i = 0u; i < Stats::HISTOGRAM_BUCKETS; ++i) {
+            accumulated += bucket_counts[i];
+
+            if (accumulated >= target) {
+                return (64ull << i) / 1000.0f;
+            }
+        }
+
+        return (64ull << (Stats::HISTOGRAM_BUCKETS - 1u)) / 1000.0f;
+    }
+}
+
+void Stats::initialize(const sConfiguration& new_configuration)
+{
+    configuration = new_configuration;
+    elapsed_time = 0.0f;
+
+#ifndef __EMSCRIPTEN__
+    if (configuration.zmq_context) {
+        publisher = zmq_socket(configuration.zmq_context, ZMQ_PUB);
+
+        if (zmq_bind(publisher, configuration.endpoint.c_str()) != 0) {
+            spdlog::error("Could not bind stats socket to {}", configuration.endpoint);
+            zmq_close(publisher);
+            publisher = nullptr;
+        }
+    }
+#endif
+
+    enabled = true;
+}
+
+void Stats::clean()
+{
+    enabled = false;
+
+#ifndef __EMSCRIPTEN__
+    if (publisher) {
+        zmq_close(publisher);
+        publisher = nullptr;
+    }
+#endif
+}
+
+uint32_t Stats::get_metric(const std::string& name, eMetricType type)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    uint32_t count = metric_count.load();
+
+    for (uint32_t i = 0u; i < count; ++i) {
+        if (metrics[i].name == name) {
+            assert(metrics[i].type == type);
+            return i;
+        }
+    }
+
+    if (count == MAX_METRICS) {
+        static bool warned = false;
+        if (!warned) {
+            spdlog::warn("Stats registry is full, {} and later metrics are not recorded", name);
+            warned = true;
+        }
+        return MAX_METRICS;
+    }
+
+    metrics[count].name = name;
+    metrics[count].type = type;
+    metric_count.store(count + 1u);
+
+    return count;
+}
+
+void Stats::add_time(uint32_t metric, uint64_t microseconds)
+{
+    if (!enabled) {
+        return;
+    }
+
+    sMetric& entry = metrics[metric];
+    entry.count.fetch_add(1u, std::memory_order_relaxed);
+    entry.sum.fetch_add(microseconds, std::memory_order_relaxed);
+    store_max(entry.max, microseconds);
+
+    if (entry.type == METRIC_HISTOGRAM) {
+        entry.buckets[get_histogram_bucket(microseconds)].fetch_add(1u, std::memory_order_relaxed);
+    }
+}
+
+void Stats::add_count(uint32_t metric, uint64_t value)
+{
+    if (!enabled) {
+        return;
+    }
+
+    metrics[metric].sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Stats::set_gauge(uint32_t metric, int64_t value)
+{
+    if (!enabled) {
+        return;
+    }
+
+    sMetric& entry = metrics[metric];
+
+    // The first value of an interval starts the max over
+    if (entry.count.fetch_add(1u, std::memory_order_relaxed) == 0u) {
+        entry.max.store(static_cast<uint64_t>(value), std::memory_order_relaxed);
+    }
+
+    entry.last.store(static_cast<uint64_t>(value), std::memory_order_relaxed);
+    store_max_signed(entry.max, value);
+}
+
+void Stats::update(float delta_time)
+{
+    if (!enabled) {
+        return;
+    }
+
+    elapsed_time += delta_time;
+
+    if (elapsed_time < configuration.dump_interval) {
+        return;
+    }
+
+    std::string json = fmt::format("{{\"interval\":{:.3f},\"metrics\":{{", elapsed_time);
+
+    uint32_t count = metric_count.load();
+    bool first = true;
+
+    for (uint32_t i = 0u; i < count; ++i) {
+        sMetric& entry = metrics[i];
+
+        uint64_t entry_count = entry.count.exchange(0u, std::memory_order_relaxed);
+        uint64_t sum = entry.sum.exchange(0u, std::memory_order_relaxed);
+        uint64_t max = entry.max.exchange(0u, std::memory_order_relaxed);
+        uint64_t last = entry.last.load(std::memory_order_relaxed);
+
+        std::string values;
+        std::string line;
+
+        switch (entry.type) {
+        case METRIC_TIMER: {
+            if (entry_count == 0u) {
+                continue;
+            }
+
+            float average_ms = sum / 1000.0f / entry_count;
+            values = fmt::format("\"count\":{},\"avg_ms\":{:.3f},\"max_ms\":{:.3f}", entry_count, average_ms, max / 1000.0f);
+            line = fmt::format("{}: {} calls, {:.3f} ms avg, {:.3f} ms max", entry.name, entry_count, average_ms, max / 1000.0f);
+            break;
+        }
+        case METRIC_COUNTER: {
+            if (sum == 0u) {
+                continue;
+            }
+
+            float per_second = sum / elapsed_time;
+            values = fmt::format("\"total\":{},\"per_second\":{:.1f}", sum, per_second);
+            line = fmt::format("{}: {} ({:.1f}/s)", entry.name, sum, per_second);
+            break;
+        }
+        case METRIC_GAUGE: {
+            // Not set this interval, the max is the last value
+            int64_t signed_last = static_cast<int64_t>(last);
+            int64_t signed_max = entry_count == 0u ? signed_last : static_cast<int64_t>(max);
+
+            values = fmt::format("\"value\":{},\"max\":{}", signed_last, signed_max);
+            line = fmt::format("{}: {} (max {})", entry.name, signed_last, signed_max);
+            break;
+        }
+        case METRIC_HISTOGRAM: {
+            uint64_t bucket_counts[HISTOGRAM_BUCKETS];
+            for (uint32_t b = 0u; b < HISTOGRAM_BUCKETS; ++b) {
+                bucket_counts[b] = entry.buckets[b].exchange(0u, std::memory_order_relaxed);
+            }
+
+            if (entry_count == 0u) {
+                continue;
+            }
+
+            float average_ms = sum / 1000.0f / entry_count;
+            float p50_ms = get_histogram_percentile_ms(bucket_counts, entry_count, 0.5f);
+            float p90_ms = get_histogram_percentile_ms(bucket_counts, entry_count, 0.9f);
+            float p99_ms = get_histogram_percentile_ms(bucket_counts, entry_count, 0.99f);
+
+            std::string buckets;
+            for (uint32_t b = 0u; b < HISTOGRAM_BUCKETS; ++b) {
+                buckets += fmt::format("{}{}", b == 0u ? "" : ",", bucket_counts[b]);
+            }
+
+            values = fmt::format("\"count\":{},\"avg_ms\":{:.3f},\"p50_ms\":{:.3f},\"p90_ms\":{:.3f},\"p99_ms\":{:.3f},\"max_ms\":{:.3f},\"buckets\":[{}]",
+                entry_count, average_ms, p50_ms, p90_ms, p99_ms, max / 1000.0f, buckets);
+            line = fmt::format("{}: {} samples, {:.3f} ms avg, p50 <{:.3f} ms, p90 <{:.3f} ms, p99 <{:.3f} ms, {:.3f} ms max",
+                entry.name, entry_count, average_ms, p50_ms, p90_ms, p99_ms, max / 1000.0f);
+            break;
+        }
+        }
+
+        json += fmt::format("{}\"{}\":{{{}}}", first ? "" : ",", entry.name, values);
+        first = false;
+
+        if (configuration.dump_to_log) {
+            spdlog::info("[stats] {}", line);
+        }
+    }
+
+    json += "}}";
+
+    publish(json);
+
+    elapsed_time = 0.0f;
+}
+
+void Stats::publish(const std::string& json)
+{
+#ifndef __EMSCRIPTEN__
+    if (publisher) {
+        zmq_send(publisher, json.data(), json.size(), ZMQ_DONTWAIT);
+    }
+#endif
+}
+
+uint64_t Stats::get_peak_memory()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0u;
+#elif defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // Bytes on macOS
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#elif defined(__EMSCRIPTEN__)
+    return 0u;
+#else
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status) {
+        return 0u;
+    }
+
+    uint64_t peak_kb = 0u;
+    char line[256];
+
+    while (fgets(line, sizeof(line), status)) {
+        if (strncmp(line, "VmHWM:", 6) == 0) {
+            peak_kb = strtoull(line + 6, nullptr, 10);
+            break;
+        }
+    }
+
+    fclose(status);
+
+    return peak_kb * 1024u;
+#endif
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Process wide timers, counters and gauges. Everything is a no-op until initialize is called, so call
+// sites only pay for a flag check. Metrics are aggregated per interval and dumped to the log and/or
+// published as JSON on a local ZMQ PUB socket.
+class Stats {
+
+public:
+
+    enum eMetricType : uint8_t {
+        METRIC_TIMER,     // count, average and max duration
+        METRIC_COUNTER,   // total and rate per second
+        METRIC_GAUGE,     // last and max value, may be negative
+        METRIC_HISTOGRAM  // timer with percentiles from power of two buckets
+    };
+
+    static const uint32_t MAX_METRICS = 128u;
+
+    // Bucket 0 holds durations under 64 us, bucket i up to 64 << i, the last one everything above
+    static const uint32_t HISTOGRAM_BUCKETS = 20u;
+
+    struct sConfiguration {
+        float dump_interval = 1.0f;
+        bool dump_to_log = true;
+        // Needs a ZMQ context, ignored on web
+        void* zmq_context = nullptr;
+        std::string endpoint = "tcp://127.0.0.1:5560";
+    };
+
+private:
+
+    inline static bool enabled = false;
+
+    static void publish(const std::string& json);
+
+public:
+
+    static void initialize(const sConfiguration& configuration);
+    static void clean();
+
+    static bool is_enabled() { return enabled; }
+
+    // Registers the metric on first use, keep the id in a static to skip the lookup. Once MAX_METRICS are
+    // registered new names get an id that records nothing
+    static uint32_t get_metric(const std::string& name, eMetricType type);
+
+    // Timers and histograms
+    static void add_time(uint32_t metric, uint64_t microseconds);
+    static void add_count(uint32_t metric, uint64_t value = 1u);
+    static void set_gauge(uint32_t metric, int64_t value);
+
+    // Once per frame from the main thread
+    static void update(float delta_time);
+
+    // Peak resident set size of the process in bytes, 0 where unsupported. Works while disabled
+    static uint64_t get_peak_memory();
+};
+
+class ScopedTimer {
+
+    uint32_t metric;
+    bool active;
+    std::chrono::high_resolution_clock::time_point start;
+
+public:
+
+    ScopedTimer(uint32_t metric) : metric(metric), active(Stats::is_enabled())
+    {
+        if (active) {
+            start = std::chrono::high_resolution_clock::now();
+        }
+    }
+
+    ~ScopedTimer()
+    {
+        if (active) {
+            auto elapsed = std::chrono::high_resolution_clock::now() - start;
+            Stats::add_time(metric, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        }
+    }
+};
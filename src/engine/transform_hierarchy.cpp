@@ -0,0 +1,142 @@
+#include "transform_hierarchy.h"
+
+#include "engine/lod_mesh_instance_3d.h"
+
+#include "framework/nodes/mesh_instance_3d.h"
+
+#include <algorithm>
+#include <typeinfo>
+
+void TransformHierarchy::build(const std::vector<Node*>& roots)
+{
+    // Moved before the rebuild and not refit yet, the ones still in the tree stay dirty
+    std::vector<Node3D*> dirty_nodes(dirty_entries.size());
+    for (uint32_t i = 0u; i < dirty_entries.size(); ++i) {
+        dirty_nodes[i] = entries[dirty_entries[i]].node;
+    }
+
+    clear();
+
+    root_count = roots.size();
+
+    for (Node* root : roots) {
+        flatten(root, false);
+    }
+
+    dirty_flags.assign(entries.size(), 0u);
+
+    for (Node3D* node : dirty_nodes) {
+        mark_dirty(node);
+    }
+}
+
+void TransformHierarchy::flatten(Node* node, bool under_active)
+{
+    // Exact types, anything derived may animate or simulate in its update
+    const std::type_info& type = typeid(*node);
+    bool passive = type == typeid(Node3D) || type == typeid(MeshInstance3D) || type == typeid(LODMeshInstance3D);
+
+    bool active = !passive && !under_active;
+
+    if (active) {
+        active_nodes.push_back({ node, static_cast<uint32_t>(entries.size()), 0u });
+        under_active = true;
+    }
+
+    Node3D* node_3d = dynamic_cast<Node3D*>(node);
+
+    if (!node_3d) {
+        for (Node* child : node->get_children()) {
+            flatten(child, under_active);
+        }
+    }
+    else {
+        uint32_t index = entries.size();
+        entries.push_back({ node_3d, 0u });
+        entry_lookup[node_3d] = index;
+
+        for (Node* child : node->get_children()) {
+            flatten(child, under_active);
+        }
+
+        entries[index].subtree_end = entries.size();
+    }
+
+    // Nothing under an active node is pushed, it is still the last one
+    if (active) {
+        active_nodes.back().entries.end = entries.size();
+    }
+}
+
+void TransformHierarchy::clear()
+{
+    entries.clear();
+    entry_lookup.clear();
+    root_count = 0u;
+
+    dirty_entries.clear();
+    dirty_flags.clear();
+    updated_ranges.clear();
+
+    active_nodes.clear();
+}
+
+bool TransformHierarchy::mark_dirty(Node3D* node)
+{
+    auto it = entry_lookup.find(node);
+
+    if (it == entry_lookup.end()) {
+        return false;
+    }
+
+    if (!dirty_flags[it->second]) {
+        dirty_flags[it->second] = 1u;
+        dirty_entries.push_back(it->second);
+    }
+
+    return true;
+}
+
+uint32_t TransformHierarchy::update()
+{
+    updated_ranges.clear();
+
+    if (dirty_entries.empty()) {
+        return 0u;
+    }
+
+    // Dirty nodes inside an earlier dirty subtree are covered by it
+    std::sort(dirty_entries.begin(), dirty_entries.end());
+
+    uint32_t updated_count = 0u;
+
+    for (uint32_t index : dirty_entries) {
+        dirty_flags[index] = 0u;
+
+        if (!updated_ranges.empty() && index < updated_ranges.back().end) {
+            continue;
+        }
+
+        updated_ranges.push_back({ index, entries[index].subtree_end });
+        updated_count += entries[index].subtree_end - index;
+    }
+
+    dirty_entries.clear();
+
+    return updated_count;
+}
+
+void TransformHierarchy::update_nodes(float delta_time)
+{
+    for (const sActiveNode& active_node : active_nodes) {
+        active_node.node->update(delta_time);
+
+        // Whatever it animated has to propagate
+        for (uint32_t i = active_node.entries.begin; i < active_node.entries.end; i = entries[i].subtree_end) {
+            if (!dirty_flags[i]) {
+                dirty_flags[i] = 1u;
+                dirty_entries.push_back(i);
+            }
+        }
+    }
+}
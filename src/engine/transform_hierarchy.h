@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Node;
+class Node3D;
+
+// Flattened copy of the scene hierarchy with dirty flags, so a frame only touches the subtrees that moved.
+// Nodes are stored in preorder, every subtree is the contiguous range [index, subtree_end). Models stay with the
+// nodes, the hierarchy only tracks which subtrees moved so bounds are refit once per node.
+class TransformHierarchy {
+
+    struct sEntry {
+        Node3D* node = nullptr;
+        uint32_t subtree_end = 0u;
+    };
+
+public:
+
+    struct sRange {
+        uint32_t begin = 0u;
+        uint32_t end = 0u;
+    };
+
+private:
+
+    struct sActiveNode {
+        Node* node = nullptr;
+        sRange entries;
+    };
+
+    std::vector<sEntry> entries;
+    std::unordered_map<Node3D*, uint32_t> entry_lookup;
+    uint32_t root_count = 0u;
+
+    std::vector<uint32_t> dirty_entries;
+    std::vector<uint8_t> dirty_flags;
+    std::vector<sRange> updated_ranges;
+
+    // Nodes whose update does more than visiting children, topmost only since update recurses
+    std::vector<sActiveNode> active_nodes;
+
+    void flatten(Node* node, bool under_active);
+
+public:
+
+    void build(const std::vector<Node*>& roots);
+    void clear();
+
+    // Returns false if the node is not part of the hierarchy, e.g. added after the last build
+    bool mark_dirty(Node3D* node);
+
+    // Collects the dirty subtrees into updated ranges and clears the flags, returns the number of nodes in them
+    uint32_t update();
+
+    // Calls update on the active nodes only and marks their subtrees dirty, static Node3D and mesh
+    // subtrees have nothing to do per frame
+    void update_nodes(float delta_time);
+
+    // Subtrees moved before the last update, in hierarchy order and without overlaps
+    const std::vector<sRange>& get_updated_ranges() const { return updated_ranges; }
+    Node3D* get_node(uint32_t index) const { return entries[index].node; }
+
+    bool is_dirty() const { return !dirty_entries.empty(); }
+    uint32_t get_node_count() const { return entries.size(); }
+    uint32_t get_root_count() const { return root_count; }
+};
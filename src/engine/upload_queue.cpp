@@ -0,0 +1,70 @@
+#include "upload_queue.h"
+
+#include "engine/job_system.h"
+#include "engine/stats.h"
+
+#include <vector>
+
+void UploadQueue::add(uint64_t byte_size, std::function<void()> prepare, std::function<void()> upload)
+{
+    uploads.push_back({ byte_size, std::move(prepare), std::move(upload) });
+    pending_bytes += byte_size;
+}
+
+uint32_t UploadQueue::run_batch(uint64_t byte_budget)
+{
+    static const uint32_t upload_timer = Stats::get_metric("upload.batch", Stats::METRIC_TIMER);
+    static const uint32_t upload_bytes_counter = Stats::get_metric("upload.bytes", Stats::METRIC_COUNTER);
+
+    ScopedTimer timer(upload_timer);
+
+    std::vector<sUpload> batch;
+    uint64_t batch_bytes = 0u;
+
+    while (!uploads.empty() && (batch.empty() || batch_bytes + uploads.front().byte_size <= byte_budget)) {
+        batch_bytes += uploads.front().byte_size;
+        batch.push_back(std::move(uploads.front()));
+        uploads.pop_front();
+    }
+
+    JobSystem::parallel_for(batch.size(), [&](uint32_t i) {
+        if (batch[i].prepare) {
+            batch[i].prepare();
+        }
+    });
+
+    // Resource creation stays on the main thread, in submission order
+    for (sUpload& upload : batch) {
+        upload.upload();
+    }
+
+    pending_bytes -= batch_bytes;
+
+    Stats::add_count(upload_bytes_counter, batch_bytes);
+
+    return batch.size();
+}
+
+uint32_t UploadQueue::process()
+{
+    static const uint32_t pending_gauge = Stats::get_metric("upload.pending_bytes", Stats::METRIC_GAUGE);
+
+    uint32_t upload_count = uploads.empty() ? 0u : run_batch(frame_byte_budget);
+
+    Stats::set_gauge(pending_gauge, pending_bytes);
+
+    return upload_count;
+}
+
+void UploadQueue::flush()
+{
+    while (!uploads.empty()) {
+        run_batch(frame_byte_budget);
+    }
+}
+
+void UploadQueue::clear()
+{
+    uploads.clear();
+    pending_bytes = 0u;
+}
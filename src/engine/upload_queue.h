@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Spreads GPU uploads over frames under a byte budget. Each upload has a prepare step, CPU only and run in
+// parallel with the rest of its batch (e.g. converting vertex data into the staging buffers), and an upload
+// step on the main thread that creates and fills the GPU resources. Staging data only lives for one batch.
+class UploadQueue {
+
+    struct sUpload {
+        uint64_t byte_size = 0u;
+        std::function<void()> prepare;
+        std::function<void()> upload;
+    };
+
+    std::deque<sUpload> uploads;
+    uint64_t pending_bytes = 0u;
+
+    uint32_t run_batch(uint64_t byte_budget);
+
+public:
+
+    uint64_t frame_byte_budget = 32ull << 20;
+
+    void add(uint64_t byte_size, std::function<void()> prepare, std::function<void()> upload);
+
+    // Once per frame, runs at least one upload even if it is larger than the budget
+    uint32_t process();
+
+    // Everything now, e.g. when measuring a whole load
+    void flush();
+
+    // Drops pending uploads, their targets are about to be deleted
+    void clear();
+
+    bool is_empty() const { return uploads.empty(); }
+    uint64_t get_pending_bytes() const { return pending_bytes; }
+};
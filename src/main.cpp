@@ -47,6 +47,15 @@ EMSCRIPTEN_BINDINGS(_Class_) {
         .function("setCameraSpeed", &SampleEngine::set_camera_speed)
         .function("resetCamera", &SampleEngine::reset_camera)
         .function("toggleSceneRotation", &SampleEngine::toggle_rotation)
+        .function("getAnimationNames", &SampleEngine::get_animation_names)
+        .function("playAnimation", &SampleEngine::play_animation)
+        .function("stopAnimation", &SampleEngine::stop_animation)
+        .function("seekAnimation", &SampleEngine::seek_animation)
+        .function("setTimeOfDay", &SampleEngine::set_time_of_day)
+        .function("setLightPreset", &SampleEngine::set_light_preset)
+        .function("hostGLB", &SampleEngine::host_glb)
+        .function("unhostScene", &SampleEngine::unhost_scene)
+        .function("getHostedSceneIds", &SampleEngine::get_hosted_scene_ids)
       /*  .function("setSceneMeshes", &SampleEngine::set_scene_meshes, emscripten::allow_raw_pointers())
         .function("setSceneTextures", &SampleEngine::set_scene_textures, emscripten::allow_raw_pointers())
         .function("setSceneMaterials", &SampleEngine::set_scene_materials, emscripten::allow_raw_pointers())
@@ -60,6 +69,7 @@ EMSCRIPTEN_BINDINGS(_Class_) {
         .function("setLightColor", &SampleEngine::set_light_color)
         .function("setLightIntensity", &SampleEngine::set_light_intensity);
 
+    emscripten::register_vector<int>("vector<int>");
     emscripten::register_vector<float>("vector<float>");
     emscripten::register_vector<std::string>("vector<string>");
 }
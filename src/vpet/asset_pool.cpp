@@ -0,0 +1,228 @@
+#include "asset_pool.h"
+
+#include "hash.h"
+
+#include "engine/job_system.h"
+
+#include <cstring>
+
+namespace {
+
+    template<typename T>
+    uint64_t hash_array(const std::vector<T>& values, uint64_t hash)
+    {
+        uint64_t count = values.size();
+        hash = hash_bytes(reinterpret_cast<const uint8_t*>(&count), sizeof(uint64_t), hash);
+        return hash_bytes(reinterpret_cast<const uint8_t*>(values.data()), values.size() * sizeof(T), hash);
+    }
+
+    template<typename T>
+    bool same_array(const std::vector<T>& a, const std::vector<T>& b)
+    {
+        return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    // What the clients get, names and LODs are not part of it
+    uint64_t hash_mesh(const sVPETMesh& mesh)
+    {
+        uint64_t hash = FNV_OFFSET;
+        hash = hash_array(mesh.vertex_array, hash);
+        hash = hash_array(mesh.index_array, hash);
+        hash = hash_array(mesh.normal_array, hash);
+        hash = hash_array(mesh.uv_array, hash);
+        hash = hash_array(mesh.bone_weights_array, hash);
+        hash = hash_array(mesh.bone_indices_array, hash);
+        hash = hash_array(mesh.skin_weights, hash);
+        hash = hash_array(mesh.skin_indices, hash);
+        return hash_bytes(reinterpret_cast<const uint8_t*>(&mesh.skin_index_size), sizeof(uint32_t), hash);
+    }
+
+    bool same_mesh(const sVPETMesh& a, const sVPETMesh& b)
+    {
+        return same_array(a.vertex_array, b.vertex_array) && same_array(a.index_array, b.index_array) &&
+            same_array(a.normal_array, b.normal_array) && same_array(a.uv_array, b.uv_array) &&
+            same_array(a.bone_weights_array, b.bone_weights_array) && same_array(a.bone_indices_array, b.bone_indices_array) &&
+            same_array(a.skin_weights, b.skin_weights) && same_array(a.skin_indices, b.skin_indices) &&
+            a.skin_index_size == b.skin_index_size;
+    }
+
+    uint64_t hash_texture(const sVPETTexture& texture)
+    {
+        uint32_t description[3] = { texture.width, texture.height, texture.format };
+        uint64_t hash = hash_bytes(reinterpret_cast<const uint8_t*>(description), sizeof(description), FNV_OFFSET);
+        return hash_array(texture.get_texture_data(), hash);
+    }
+
+    bool same_texture(const sVPETTexture& a, const sVPETTexture& b)
+    {
+        return a.width == b.width && a.height == b.height && a.format == b.format && same_array(a.get_texture_data(), b.get_texture_data());
+    }
+}
+
+sVPETMesh* AssetPool::share_mesh(sVPETMesh* mesh, uint64_t hash)
+{
+    auto range = meshes_by_hash.equal_range(hash);
+
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == mesh || same_mesh(*it->second, *mesh)) {
+            mesh_entries[it->second].references++;
+            return it->second;
+        }
+    }
+
+    meshes_by_hash.insert({ hash, mesh });
+    mesh_entries[mesh] = { hash, 1u };
+
+    return mesh;
+}
+
+sVPETTexture* AssetPool::share_texture(sVPETTexture* texture, uint64_t hash)
+{
+    auto range = textures_by_hash.equal_range(hash);
+
+    for (auto it = range.first; it != range.second; ++it) {
+        sVPETTexture* pooled = it->second;
+
+        if (pooled != texture && !same_texture(*pooled, *texture)) {
+            continue;
+        }
+
+        // Engine textures go away with the scene that loaded them, a texture used by a second context keeps its
+        // own pixels from now on
+        if (pooled->shared_data) {
+            const std::vector<uint8_t>* source = pooled->shared_data;
+
+            pooled->texture_data = *source;
+            pooled->shared_data = nullptr;
+
+            for (sVPETTextureVariant& variant : pooled->variants) {
+                if (variant.shared_data == source) {
+                    variant.shared_data = &pooled->texture_data;
+                }
+            }
+        }
+
+        texture_entries[pooled].references++;
+        return pooled;
+    }
+
+    textures_by_hash.insert({ hash, texture });
+    texture_entries[texture] = { hash, 1u };
+
+    return texture;
+}
+
+uint32_t AssetPool::share(sVPETContext& vpet)
+{
+    uint32_t shared_count = 0u;
+
+    std::vector<uint64_t> mesh_hashes(vpet.geo_list.size());
+    std::vector<uint64_t> texture_hashes(vpet.texture_list.size());
+
+    uint32_t mesh_count = static_cast<uint32_t>(mesh_hashes.size());
+
+    // Hashing reads every vertex and pixel once, lookups stay on this thread
+    JobSystem::parallel_for(mesh_count + static_cast<uint32_t>(texture_hashes.size()), [&](uint32_t index) {
+        if (index < mesh_count) {
+            mesh_hashes[index] = hash_mesh(*vpet.geo_list[index]);
+        }
+        else {
+            texture_hashes[index - mesh_count] = hash_texture(*vpet.texture_list[index - mesh_count]);
+        }
+    });
+
+    for (uint32_t i = 0u; i < vpet.geo_list.size(); ++i) {
+        sVPETMesh* mesh = vpet.geo_list[i];
+        sVPETMesh* pooled = share_mesh(mesh, mesh_hashes[i]);
+
+        if (pooled != mesh) {
+            delete mesh;
+            vpet.geo_list[i] = pooled;
+            shared_count++;
+        }
+    }
+
+    for (uint32_t i = 0u; i < vpet.texture_list.size(); ++i) {
+        sVPETTexture* texture = vpet.texture_list[i];
+        sVPETTexture* pooled = share_texture(texture, texture_hashes[i]);
+
+        if (pooled != texture) {
+            delete texture;
+            vpet.texture_list[i] = pooled;
+            shared_count++;
+        }
+    }
+
+    vpet.asset_pool = this;
+
+    return shared_count;
+}
+
+bool AssetPool::release(sVPETMesh* mesh)
+{
+    auto entry = mesh_entries.find(mesh);
+
+    if (entry == mesh_entries.end()) {
+        return false;
+    }
+
+    if (--entry->second.references > 0u) {
+        return true;
+    }
+
+    auto range = meshes_by_hash.equal_range(entry->second.hash);
+
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == mesh) {
+            meshes_by_hash.erase(it);
+            break;
+        }
+    }
+
+    mesh_entries.erase(entry);
+    delete mesh;
+
+    return true;
+}
+
+bool AssetPool::release(sVPETTexture* texture)
+{
+    auto entry = texture_entries.find(texture);
+
+    if (entry == texture_entries.end()) {
+        return false;
+    }
+
+    if (--entry->second.references > 0u) {
+        return true;
+    }
+
+    auto range = textures_by_hash.equal_range(entry->second.hash);
+
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == texture) {
+            textures_by_hash.erase(it);
+            break;
+        }
+    }
+
+    texture_entries.erase(entry);
+    delete texture;
+
+    return true;
+}
+
+void sVPETContext::release_assets()
+{
+    for (sVPETMesh* mesh : geo_list) {
+        if (!asset_pool || !asset_pool->release(mesh)) {
+            delete mesh;
+        }
+    }
+
+    for (sVPETTexture* texture : texture_list) {
+        if (!asset_pool || !asset_pool->release(texture)) {
+            delete texture;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "structs.h"
+
+#include <unordered_map>
+
+// Meshes and textures shared by the scene contexts of the process. Contexts built from the same assets (props
+// placed in several locations, a location hosted twice) point at one copy, found by content hash and compared
+// in full, and that copy is freed with the last context referencing it. LODs and texture variants go with the
+// copy, a context's own ones are dropped with its duplicates.
+// Not thread safe, contexts are shared and released by whoever holds them exclusively.
+class AssetPool {
+
+    struct sEntry {
+        uint64_t hash = 0u;
+        uint32_t references = 0u;
+    };
+
+    std::unordered_multimap<uint64_t, sVPETMesh*> meshes_by_hash;
+    std::unordered_multimap<uint64_t, sVPETTexture*> textures_by_hash;
+
+    std::unordered_map<const sVPETMesh*, sEntry> mesh_entries;
+    std::unordered_map<const sVPETTexture*, sEntry> texture_entries;
+
+    sVPETMesh* share_mesh(sVPETMesh* mesh, uint64_t hash);
+    sVPETTexture* share_texture(sVPETTexture* texture, uint64_t hash);
+
+public:
+
+    // Swaps the meshes and textures of the context for pooled equals, deleting its own copies, and pools the
+    // rest. Run once the LODs and variants are generated so pooled assets are never written, ids into the lists
+    // do not change.
+    // Returns how many of its assets were already pooled
+    uint32_t share(sVPETContext& vpet);
+
+    // False when the asset is not pooled and still belongs to the caller
+    bool release(sVPETMesh* mesh);
+    bool release(sVPETTexture* texture);
+
+    uint32_t get_mesh_count() const { return static_cast<uint32_t>(mesh_entries.size()); }
+    uint32_t get_texture_count() const { return static_cast<uint32_t>(texture_entries.size()); }
+};
@@ -0,0 +1,369 @@
+#include "character_distribution.h"
+
+#include "framework/nodes/mesh_instance_3d.h"
+#include "framework/animation/skeleton.h"
+
+#include "graphics/surface.h"
+
+#include "spdlog/spdlog.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+    // Mirrors z, as done for positions and rotations
+    glm::mat4 to_unity_matrix(const glm::mat4& matrix)
+    {
+        glm::mat4 result = matrix;
+
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row) {
+                if ((column == 2) != (row == 2)) {
+                    result[column][row] = -result[column][row];
+                }
+            }
+        }
+
+        return result;
+    }
+
+    void quantize_weights(const glm::vec4& weights, uint8_t* quantized)
+    {
+        float total = weights.x + weights.y + weights.z + weights.w;
+        float scale = total > 0.0f ? 255.0f / total : 0.0f;
+
+        int32_t sum = 0;
+        uint32_t largest = 0u;
+
+        for (uint32_t i = 0u; i < 4u; ++i) {
+            quantized[i] = static_cast<uint8_t>(std::lround(std::max(weights[i], 0.0f) * scale));
+            sum += quantized[i];
+
+            if (quantized[i] > quantized[largest]) {
+                largest = i;
+            }
+        }
+
+        // Rounding error goes to the largest influence, so the weights still add up to one
+        if (total > 0.0f) {
+            quantized[largest] = static_cast<uint8_t>(quantized[largest] + (255 - sum));
+        }
+    }
+
+    // Influences on joints the skeleton does not have are removed and the remaining weights scaled back to one,
+    // neither the skinning nor the clients index bones past bone_count. Returns how many were removed
+    uint32_t drop_invalid_influences(sVPETMesh& mesh, uint32_t bone_count)
+    {
+        uint32_t vertex_count = mesh.bone_weights_array.size();
+        uint32_t dropped_count = 0u;
+
+        for (uint32_t vertex_idx = 0u; vertex_idx < vertex_count; ++vertex_idx) {
+            glm::vec4& weights = mesh.bone_weights_array[vertex_idx];
+            bool dropped = false;
+
+            for (uint32_t i = 0u; i < 4u; ++i) {
+                uint32_t& bone = mesh.bone_indices_array[vertex_idx * 4u + i];
+
+                if (bone < bone_count) {
+                    continue;
+                }
+
+                bone = 0u;
+                weights[i] = 0.0f;
+                dropped = true;
+                dropped_count++;
+
+                if (mesh.skin_index_size == 1u) {
+                    mesh.skin_indices[vertex_idx * 4u + i] = 0u;
+                }
+                else {
+                    memset(&mesh.skin_indices[(vertex_idx * 4u + i) * 2u], 0, sizeof(uint16_t));
+                }
+            }
+
+            if (!dropped) {
+                continue;
+            }
+
+            uint8_t* quantized = &mesh.skin_weights[vertex_idx * 4u];
+            quantize_weights(weights, quantized);
+
+            for (uint32_t i = 0u; i < 4u; ++i) {
+                weights[i] = quantized[i] / 255.0f;
+            }
+        }
+
+        return dropped_count;
+    }
+
+    uint32_t get_character_byte_size(const sVPETContext& vpet, const sVPETCharacter& character)
+    {
+        uint32_t bone_count = character.bone_parents.size();
+        uint32_t byte_size = 2 * sizeof(uint32_t);
+
+        byte_size += bone_count * (sizeof(int32_t) + 2 * sizeof(glm::vec3) + sizeof(glm::quat) + sizeof(glm::mat4) + sizeof(uint32_t));
+
+        for (const std::string& name : character.bone_names) {
+            byte_size += name.size();
+        }
+
+        byte_size += sizeof(uint32_t);
+
+        for (int32_t geo_id : character.geo_ids) {
+            const sVPETMesh* mesh = vpet.geo_list[geo_id];
+            byte_size += 3 * sizeof(uint32_t) + mesh->skin_weights.size() + mesh->skin_indices.size();
+        }
+
+        return byte_size;
+    }
+}
+
+void process_skin(sVPETContext& vpet, sVPETMesh& mesh, const sSurfaceData& surface_data)
+{
+    uint32_t vertex_count = surface_data.vertices.size();
+
+    if (surface_data.joints.size() != vertex_count || surface_data.weights.size() != vertex_count) {
+        return;
+    }
+
+    uint32_t max_bone = 0u;
+    for (const glm::ivec4& joints : surface_data.joints) {
+        for (uint32_t i = 0u; i < 4u; ++i) {
+            max_bone = std::max(max_bone, static_cast<uint32_t>(std::max(joints[i], 0)));
+        }
+    }
+
+    mesh.skin_index_size = max_bone < 256u ? 1u : 2u;
+
+    mesh.bone_weights_array.resize(vertex_count);
+    mesh.bone_indices_array.resize(vertex_count * 4u);
+    mesh.skin_weights.resize(vertex_count * 4u);
+    mesh.skin_indices.resize(vertex_count * 4u * mesh.skin_index_size);
+
+    for (uint32_t vertex_idx = 0u; vertex_idx < vertex_count; ++vertex_idx) {
+        const glm::ivec4& joints = surface_data.joints[vertex_idx];
+        uint8_t* quantized = &mesh.skin_weights[vertex_idx * 4u];
+
+        quantize_weights(surface_data.weights[vertex_idx], quantized);
+
+        for (uint32_t i = 0u; i < 4u; ++i) {
+            uint32_t bone = static_cast<uint32_t>(std::max(joints[i], 0));
+
+            mesh.bone_weights_array[vertex_idx][i] = quantized[i] / 255.0f;
+            mesh.bone_indices_array[vertex_idx * 4u + i] = bone;
+
+            if (mesh.skin_index_size == 1u) {
+                mesh.skin_indices[vertex_idx * 4u + i] = static_cast<uint8_t>(bone);
+            }
+            else {
+                uint16_t bone_16 = static_cast<uint16_t>(bone);
+                memcpy(&mesh.skin_indices[(vertex_idx * 4u + i) * 2u], &bone_16, sizeof(uint16_t));
+            }
+        }
+    }
+
+    vpet.geos_byte_size += vertex_count * (sizeof(glm::vec4) + 4 * sizeof(uint32_t));
+}
+
+void process_character(sVPETContext& vpet, MeshInstance3D* mesh_instance, int32_t node_id, const std::vector<int32_t>& geo_ids)
+{
+    Skeleton* skeleton = mesh_instance->get_skeleton();
+
+    if (!skeleton) {
+        return;
+    }
+
+    const Pose& bind_pose = skeleton->get_bind_pose();
+    const std::vector<glm::mat4>& inverse_bind_matrices = skeleton->get_invbind_pose();
+    const std::vector<std::string>& joint_names = skeleton->get_joint_names();
+
+    uint32_t bone_count = bind_pose.size();
+
+    if (bone_count == 0u || inverse_bind_matrices.size() != bone_count) {
+        spdlog::warn("Skipping skeleton of {}, {} bones and {} bind matrices", mesh_instance->get_name(), bone_count, inverse_bind_matrices.size());
+        return;
+    }
+
+    sVPETCharacter* character = new sVPETCharacter();
+    character->node_id = node_id;
+    character->skeleton_ref = skeleton;
+    character->inverse_bind_matrices = inverse_bind_matrices;
+
+    character->bone_parents.resize(bone_count);
+    character->bone_names.resize(bone_count);
+    character->bone_positions.resize(bone_count);
+    character->bone_rotations.resize(bone_count);
+    character->bone_scales.resize(bone_count);
+
+    for (uint32_t bone_idx = 0u; bone_idx < bone_count; ++bone_idx) {
+        Transform local_transform = bind_pose.get_local_transform(bone_idx);
+
+        character->bone_parents[bone_idx] = bind_pose.get_parent(bone_idx);
+        character->bone_positions[bone_idx] = local_transform.get_position();
+        character->bone_rotations[bone_idx] = local_transform.get_rotation();
+        character->bone_scales[bone_idx] = local_transform.get_scale();
+        character->bone_names[bone_idx] = bone_idx < joint_names.size() ? joint_names[bone_idx] : "bone_" + std::to_string(bone_idx);
+    }
+
+    // glTF does not order joints, sort them by depth so parents come first
+    std::vector<uint32_t> depths(bone_count, 0u);
+
+    for (uint32_t bone_idx = 0u; bone_idx < bone_count; ++bone_idx) {
+        int32_t parent = character->bone_parents[bone_idx];
+
+        while (parent >= 0 && depths[bone_idx] < bone_count) {
+            depths[bone_idx]++;
+            parent = character->bone_parents[parent];
+        }
+    }
+
+    character->bone_order.resize(bone_count);
+    for (uint32_t bone_idx = 0u; bone_idx < bone_count; ++bone_idx) {
+        character->bone_order[bone_idx] = bone_idx;
+    }
+
+    std::stable_sort(character->bone_order.begin(), character->bone_order.end(), [&](uint32_t a, uint32_t b) {
+        return depths[a] < depths[b];
+    });
+
+    for (int32_t geo_id : geo_ids) {
+        if (geo_id < 0 || vpet.geo_list[geo_id]->skin_weights.empty()) {
+            continue;
+        }
+
+        uint32_t dropped_count = drop_invalid_influences(*vpet.geo_list[geo_id], bone_count);
+
+        if (dropped_count > 0u) {
+            spdlog::warn("Dropped {} influences of {} on joints past its {} bones", dropped_count, mesh_instance->get_name(), bone_count);
+        }
+
+        character->geo_ids.push_back(geo_id);
+    }
+
+    vpet.characters_byte_size += get_character_byte_size(vpet, *character);
+
+    vpet.character_list.push_back(character);
+}
+
+void write_characters(const sVPETContext& vpet, uint8_t* byte_array, uint32_t& buffer_ptr)
+{
+    for (const sVPETCharacter* character : vpet.character_list) {
+
+        memcpy(&byte_array[buffer_ptr], &character->node_id, sizeof(int32_t));
+        buffer_ptr += sizeof(int32_t);
+
+        uint32_t bone_count = character->bone_parents.size();
+        memcpy(&byte_array[buffer_ptr], &bone_count, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        memcpy(&byte_array[buffer_ptr], character->bone_parents.data(), bone_count * sizeof(int32_t));
+        buffer_ptr += bone_count * sizeof(int32_t);
+
+        // Transform to unity coordinate system
+        for (uint32_t bone_idx = 0u; bone_idx < bone_count; ++bone_idx) {
+            glm::vec3 transformed_pos = character->bone_positions[bone_idx];
+            transformed_pos.z = -transformed_pos.z;
+            memcpy(&byte_array[buffer_ptr], &transformed_pos, sizeof(glm::vec3));
+            buffer_ptr += sizeof(glm::vec3);
+        }
+
+        for (uint32_t bone_idx = 0u; bone_idx < bone_count; ++bone_idx) {
+            glm::quat transformed_rot = character->bone_rotations[bone_idx];
+            transformed_rot.x = -transformed_rot.x;
+            transformed_rot.y = -transformed_rot.y;
+            memcpy(&byte_array[buffer_ptr], &transformed_rot, sizeof(glm::quat));
+            buffer_ptr += sizeof(glm::quat);
+        }
+
+        memcpy(&byte_array[buffer_ptr], character->bone_scales.data(), bone_count * sizeof(glm::vec3));
+        buffer_ptr += bone_count * sizeof(glm::vec3);
+
+        for (uint32_t bone_idx = 0u; bone_idx < bone_count; ++bone_idx) {
+            glm::mat4 transformed_matrix = to_unity_matrix(character->inverse_bind_matrices[bone_idx]);
+            memcpy(&byte_array[buffer_ptr], &transformed_matrix, sizeof(glm::mat4));
+            buffer_ptr += sizeof(glm::mat4);
+        }
+
+        for (const std::string& name : character->bone_names) {
+            uint32_t name_size = name.size();
+            memcpy(&byte_array[buffer_ptr], &name_size, sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            memcpy(&byte_array[buffer_ptr], name.data(), name_size);
+            buffer_ptr += name_size;
+        }
+
+        uint32_t skin_count = character->geo_ids.size();
+        memcpy(&byte_array[buffer_ptr], &skin_count, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        for (int32_t geo_id : character->geo_ids) {
+            const sVPETMesh* mesh = vpet.geo_list[geo_id];
+
+            memcpy(&byte_array[buffer_ptr], &geo_id, sizeof(int32_t));
+            buffer_ptr += sizeof(int32_t);
+
+            uint32_t vertex_count = mesh->skin_weights.size() / 4u;
+            memcpy(&byte_array[buffer_ptr], &vertex_count, sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            memcpy(&byte_array[buffer_ptr], &mesh->skin_index_size, sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            memcpy(&byte_array[buffer_ptr], mesh->skin_weights.data(), mesh->skin_weights.size());
+            buffer_ptr += mesh->skin_weights.size();
+
+            memcpy(&byte_array[buffer_ptr], mesh->skin_indices.data(), mesh->skin_indices.size());
+            buffer_ptr += mesh->skin_indices.size();
+        }
+    }
+}
+
+void pack_bone_rotation(const glm::quat& rotation, int16_t* packed)
+{
+    // Unity coordinates, and w positive since q and -q are the same rotation
+    glm::quat transformed_rot = glm::normalize(rotation);
+    transformed_rot.x = -transformed_rot.x;
+    transformed_rot.y = -transformed_rot.y;
+
+    float sign = transformed_rot.w < 0.0f ? -1.0f : 1.0f;
+
+    packed[0] = static_cast<int16_t>(std::lround(transformed_rot.x * sign * 32767.0f));
+    packed[1] = static_cast<int16_t>(std::lround(transformed_rot.y * sign * 32767.0f));
+    packed[2] = static_cast<int16_t>(std::lround(transformed_rot.z * sign * 32767.0f));
+    packed[3] = static_cast<int16_t>(std::lround(transformed_rot.w * sign * 32767.0f));
+}
+
+uint32_t get_pose_message_size(uint32_t bone_count)
+{
+    return 4 * sizeof(uint8_t) + 2 * sizeof(uint16_t) + sizeof(glm::vec3) + bone_count * 4 * sizeof(int16_t);
+}
+
+void write_pose_message(uint8_t sender_id, uint8_t time, uint8_t scene_id, uint16_t character_id, const glm::vec3& root_position,
+    const int16_t* rotations, uint32_t bone_count, uint8_t* byte_array)
+{
+    uint32_t buffer_ptr = 0u;
+
+    byte_array[buffer_ptr++] = sender_id;
+    byte_array[buffer_ptr++] = time;
+    byte_array[buffer_ptr++] = static_cast<uint8_t>(eVPETMessageType::POSE);
+    byte_array[buffer_ptr++] = scene_id;
+
+    memcpy(&byte_array[buffer_ptr], &character_id, sizeof(uint16_t));
+    buffer_ptr += sizeof(uint16_t);
+
+    uint16_t bone_count_16 = static_cast<uint16_t>(bone_count);
+    memcpy(&byte_array[buffer_ptr], &bone_count_16, sizeof(uint16_t));
+    buffer_ptr += sizeof(uint16_t);
+
+    glm::vec3 transformed_pos = root_position;
+    transformed_pos.z = -transformed_pos.z;
+    memcpy(&byte_array[buffer_ptr], &transformed_pos, sizeof(glm::vec3));
+    buffer_ptr += sizeof(glm::vec3);
+
+    memcpy(&byte_array[buffer_ptr], rotations, bone_count * 4 * sizeof(int16_t));
+    buffer_ptr += bone_count * 4 * sizeof(int16_t);
+
+    assert(buffer_ptr == get_pose_message_size(bone_count));
+}
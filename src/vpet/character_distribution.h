@@ -0,0 +1,31 @@
+#pragma once
+
+#include "structs.h"
+
+class MeshInstance3D;
+struct sSurfaceData;
+
+// "characters" answers the skeletons of the skinned meshes, per character:
+//   node id, bone count, bone parents, bind pose positions, rotations and scales, inverse bind matrices,
+//   bone names (size and chars), then skin count and per skin its geo id, vertex count, index size,
+//   4 weights per vertex as bytes summing to 255 and 4 bone indices per vertex of 1 or 2 bytes.
+// Everything in the Unity coordinate system, as "nodes" and "objects".
+//
+// Poses go out as POSE messages on the update stream whenever the quantized pose of a character changes:
+//   header, scene id, character id (uint16), bone count (uint16), root bone position, then per bone its local
+//   rotation as 4 signed 16-bit components.
+
+// Fills the TRACER bone arrays and the compact skin of a mesh from its glTF joints and weights
+void process_skin(sVPETContext& vpet, sVPETMesh& mesh, const sSurfaceData& surface_data);
+
+// Adds the skeleton of a skinned mesh instance, node_id is its index in node_list and geo_ids its surfaces
+void process_character(sVPETContext& vpet, MeshInstance3D* mesh_instance, int32_t node_id, const std::vector<int32_t>& geo_ids);
+
+void write_characters(const sVPETContext& vpet, uint8_t* byte_array, uint32_t& buffer_ptr);
+
+// Engine side rotation, to the Unity coordinate system and 16 bits per component
+void pack_bone_rotation(const glm::quat& rotation, int16_t* packed);
+
+uint32_t get_pose_message_size(uint32_t bone_count);
+void write_pose_message(uint8_t sender_id, uint8_t time, uint8_t scene_id, uint16_t character_id, const glm::vec3& root_position,
+    const int16_t* rotations, uint32_t bone_count, uint8_t* byte_array);
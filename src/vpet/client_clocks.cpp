@@ -0,0 +1,159 @@
+#include "client_clocks.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    // Weight of a new sample, as for TCP's smoothed round trip
+    const float SMOOTHING = 0.125f;
+}
+
+void ClientClocks::initialize(uint32_t new_frame_rate, uint64_t now_us)
+{
+    frame_rate = std::max(new_frame_rate, 1u);
+    time_steps = std::max((128u / frame_rate) * frame_rate, 1u);
+    epoch_us = now_us;
+
+    for (sClient& client : clients) {
+        client = {};
+    }
+}
+
+float ClientClocks::get_steps(uint64_t now_us) const
+{
+    double steps = (now_us - epoch_us) * 1e-6 * frame_rate;
+    return static_cast<float>(fmod(steps, time_steps));
+}
+
+float ClientClocks::wrap_steps(float steps) const
+{
+    // Into [-time_steps / 2, time_steps / 2)
+    float half = time_steps * 0.5f;
+    steps = fmodf(steps + half, static_cast<float>(time_steps));
+    return (steps < 0.0f ? steps + time_steps : steps) - half;
+}
+
+uint8_t ClientClocks::get_time(uint64_t now_us) const
+{
+    return static_cast<uint8_t>(static_cast<uint32_t>(get_steps(now_us)) % time_steps);
+}
+
+void ClientClocks::sync(uint8_t server_time, uint64_t now_us)
+{
+    uint64_t step_us = 1000000u / frame_rate;
+    uint64_t offset_us = (server_time % time_steps) * step_us;
+
+    epoch_us = now_us > offset_us ? now_us - offset_us : 0u;
+
+    // The clients jump to the server time as well, offsets start over with the next ping replies
+    for (sClient& client : clients) {
+        client.has_offset = false;
+        client.offset_steps = 0.0f;
+        client.anchor_us = 0u;
+    }
+}
+
+uint8_t ClientClocks::send_ping(uint64_t now_us)
+{
+    uint8_t engine_time = get_time(now_us);
+    ping_send_us[engine_time] = now_us;
+    return engine_time;
+}
+
+bool ClientClocks::on_ping_reply(uint8_t client_id, uint8_t client_time, uint8_t engine_time, uint64_t now_us)
+{
+    uint64_t send_us = ping_send_us[engine_time];
+
+    // Older than a wrap, the step may have been reused
+    if (send_us == 0u || now_us < send_us || now_us - send_us > time_steps * 1000000ull / frame_rate) {
+        return false;
+    }
+
+    float round_trip_us = static_cast<float>(now_us - send_us);
+
+    // The client stamped its reply about halfway, its step covers the whole step
+    float engine_steps = get_steps(send_us + static_cast<uint64_t>(round_trip_us * 0.5f));
+    float offset_steps = wrap_steps(client_time + 0.5f - engine_steps);
+
+    sClient& client = clients[client_id];
+
+    if (!client.has_round_trip) {
+        client.round_trip_us = round_trip_us;
+        client.has_round_trip = true;
+    }
+    else {
+        client.round_trip_us += SMOOTHING * (round_trip_us - client.round_trip_us);
+    }
+
+    if (!client.has_offset) {
+        client.offset_steps = offset_steps;
+        client.has_offset = true;
+    }
+    else {
+        client.offset_steps = wrap_steps(client.offset_steps + SMOOTHING * wrap_steps(offset_steps - client.offset_steps));
+    }
+
+    client.ping_count++;
+
+    return true;
+}
+
+bool ClientClocks::get_latency(uint8_t client_id, uint8_t client_time, uint64_t now_us, uint64_t& latency_us) const
+{
+    const sClient& client = clients[client_id];
+
+    if (!client.has_round_trip || !client.has_offset) {
+        return false;
+    }
+
+    // Engine step at which the update was stamped, then forward to now
+    float send_steps = client_time + 0.5f - client.offset_steps;
+    float elapsed_steps = fmodf(get_steps(now_us) - send_steps, static_cast<float>(time_steps));
+
+    if (elapsed_steps < 0.0f) {
+        elapsed_steps += time_steps;
+    }
+
+    // Slightly ahead of now from step rounding and offset error, not almost a whole wrap late
+    if (elapsed_steps > time_steps - 1.0f) {
+        elapsed_steps = 0.0f;
+    }
+
+    // The stamp is off by up to half a step, only whole steps beyond the one-way trip are waiting time
+    float one_way_us = client.round_trip_us * 0.5f;
+    float waited_steps = std::round(std::max(elapsed_steps - one_way_us * frame_rate * 1e-6f, 0.0f));
+
+    latency_us = static_cast<uint64_t>(one_way_us + waited_steps * 1e6f / frame_rate);
+
+    return true;
+}
+
+uint64_t ClientClocks::get_send_time(uint8_t client_id, uint8_t client_time, uint64_t now_us)
+{
+    uint64_t latency_us = 0u;
+
+    if (get_latency(client_id, client_time, now_us, latency_us)) {
+        return now_us - std::min(latency_us, now_us);
+    }
+
+    sClient& client = clients[client_id];
+
+    uint64_t step_us = 1000000u / frame_rate;
+    uint64_t send_us = now_us;
+
+    if (client.anchor_us != 0u) {
+        uint32_t steps = (client_time % time_steps + time_steps - client.anchor_time % time_steps) % time_steps;
+        uint64_t stepped_us = client.anchor_us + steps * step_us;
+
+        // Later than its arrival the update went faster than the ones before, half a wrap behind the count lost track
+        if (stepped_us <= now_us && now_us - stepped_us < time_steps * step_us / 2u) {
+            send_us = stepped_us;
+        }
+    }
+
+    client.anchor_us = send_us;
+    client.anchor_time = client_time;
+
+    return send_us;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+// TRACER messages carry the time of their sender as a frame step that wraps every time_steps steps, the clients
+// use (128 / frame_rate) * frame_rate steps, 120 at 60 fps, so about two seconds. The engine keeps its own step
+// clock, set by the SYNC messages of the server as the clients do, and per client the round trip and the clock
+// offset measured from the replies to the engine PINGs.
+// A step is 16.7 ms at 60 fps, too coarse for the latencies of a local network, so the one-way trip comes from
+// the round trip, measured in microseconds on the engine clock, and the step stamp of an update only adds the
+// whole steps it waited beyond that. Replying to the engine PINGs is not part of the stock clients, they stay
+// unmeasured.
+class ClientClocks {
+
+public:
+
+    static const uint32_t MAX_CLIENTS = 256u;
+
+private:
+
+    struct sClient {
+        bool has_round_trip = false;
+        // The offset is measured again after each SYNC, the round trip does not depend on it
+        bool has_offset = false;
+        // Smoothed, the offset is the client step minus the engine step at the same instant
+        float round_trip_us = 0.0f;
+        float offset_steps = 0.0f;
+        uint32_t ping_count = 0u;
+
+        // Unmeasured clients, send time and stamp of their last update, 0 when there is none to count from
+        uint64_t anchor_us = 0u;
+        uint8_t anchor_time = 0u;
+    };
+
+    sClient clients[MAX_CLIENTS];
+
+    uint32_t frame_rate = 60u;
+    uint32_t time_steps = 120u;
+
+    // Time of engine step 0
+    uint64_t epoch_us = 0u;
+
+    // Send time of our pings by the step they were stamped with
+    uint64_t ping_send_us[256] = {};
+
+    float get_steps(uint64_t now_us) const;
+    float wrap_steps(float steps) const;
+
+public:
+
+    void initialize(uint32_t frame_rate, uint64_t now_us);
+
+    uint8_t get_time(uint64_t now_us) const;
+    uint32_t get_time_steps() const { return time_steps; }
+
+    // The server time is adopted as is, like the clients do, which moves the offsets measured so far
+    void sync(uint8_t server_time, uint64_t now_us);
+
+    // Returns the step to stamp our ping with
+    uint8_t send_ping(uint64_t now_us);
+
+    // A client answered our ping stamped engine_time with its own time, returns false for unknown pings
+    bool on_ping_reply(uint8_t client_id, uint8_t client_time, uint8_t engine_time, uint64_t now_us);
+
+    // Estimated time since the client sent the message stamped client_time, false until the client answered a
+    // ping since the last SYNC. Only latencies under one wrap of the step clock can be told apart
+    bool get_latency(uint8_t client_id, uint8_t client_time, uint64_t now_us, uint64_t& latency_us) const;
+
+    // Send time of the message stamped client_time on the engine clock. Unmeasured clients are counted in their
+    // own steps from their last update, so updates drained in the same frame stay as far apart as they were sent;
+    // the count starts over at the arrival time when it would place an update after its arrival
+    uint64_t get_send_time(uint8_t client_id, uint8_t client_time, uint64_t now_us);
+
+    bool is_measured(uint8_t client_id) const { return clients[client_id].has_round_trip && clients[client_id].has_offset; }
+    float get_round_trip_us(uint8_t client_id) const { return clients[client_id].round_trip_us; }
+    float get_offset_us(uint8_t client_id) const { return clients[client_id].offset_steps * 1e6f / frame_rate; }
+};
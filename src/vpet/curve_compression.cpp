@@ -0,0 +1,323 @@
+#include "curve_compression.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+    const float QUANTIZATION_STEPS = 65535.0f;
+
+    glm::vec4 load_key(const float* values, uint32_t key, uint32_t component_count)
+    {
+        glm::vec4 value = {};
+        for (uint32_t c = 0u; c < component_count; ++c) {
+            value[c] = values[key * component_count + c];
+        }
+        return value;
+    }
+
+    // Four components are a rotation, x, y, z, w
+    glm::vec4 blend(const glm::vec4& a, const glm::vec4& b, float t, bool rotation)
+    {
+        if (!rotation) {
+            return glm::mix(a, b, t);
+        }
+
+        glm::quat rotation_a = glm::quat(a.w, a.x, a.y, a.z);
+        glm::quat rotation_b = glm::quat(b.w, b.x, b.y, b.z);
+        glm::quat blended = glm::slerp(rotation_a, rotation_b, t);
+
+        return glm::vec4(blended.x, blended.y, blended.z, blended.w);
+    }
+
+    float get_error(const glm::vec4& a, const glm::vec4& b, bool rotation)
+    {
+        if (!rotation) {
+            return glm::length(a - b);
+        }
+
+        // Angle between the rotations, q and -q are the same
+        float cos_half_angle = std::min(std::abs(glm::dot(a, b)), 1.0f);
+        return 2.0f * std::acos(cos_half_angle);
+    }
+
+    uint16_t quantize(float value, float min, float extent)
+    {
+        if (extent <= 0.0f) {
+            return 0u;
+        }
+
+        float normalized = std::clamp((value - min) / extent, 0.0f, 1.0f);
+        return static_cast<uint16_t>(normalized * QUANTIZATION_STEPS + 0.5f);
+    }
+}
+
+void compress_curve(const float* times, const float* values, uint32_t key_count, uint32_t component_count,
+    eVPETCurveInterpolation interpolation, float tolerance, sVPETCurve& curve)
+{
+    assert(key_count > 0u && component_count > 0u && component_count <= 4u);
+
+    bool rotation = component_count == 4u;
+
+    std::vector<glm::vec4> keys(key_count);
+
+    for (uint32_t key = 0u; key < key_count; ++key) {
+        keys[key] = load_key(values, key, component_count);
+
+        if (!rotation) {
+            continue;
+        }
+
+        keys[key] = glm::normalize(keys[key]);
+
+        // Same hemisphere as the previous key, so blending and quantizing stay continuous
+        if (key > 0u && glm::dot(keys[key], keys[key - 1u]) < 0.0f) {
+            keys[key] = -keys[key];
+        }
+    }
+
+    uint32_t last_key = key_count - 1u;
+
+    std::vector<uint8_t> kept(key_count, 0u);
+    kept[0] = 1u;
+
+    if (interpolation == eVPETCurveInterpolation::STEP) {
+        uint32_t previous = 0u;
+
+        for (uint32_t key = 1u; key < key_count; ++key) {
+            if (get_error(keys[key], keys[previous], rotation) > tolerance) {
+                kept[key] = 1u;
+                previous = key;
+            }
+        }
+    }
+    else {
+        float constant_error = 0.0f;
+        for (uint32_t key = 1u; key < key_count; ++key) {
+            constant_error = std::max(constant_error, get_error(keys[key], keys[0], rotation));
+        }
+
+        // Otherwise split at the worst key until every dropped key is within tolerance of its interpolation
+        if (constant_error > tolerance) {
+            kept[last_key] = 1u;
+
+            std::vector<std::pair<uint32_t, uint32_t>> spans = { { 0u, last_key } };
+
+            while (!spans.empty()) {
+                auto [first, last] = spans.back();
+                spans.pop_back();
+
+                float span_time = times[last] - times[first];
+                float max_error = 0.0f;
+                uint32_t max_key = first;
+
+                for (uint32_t key = first + 1u; key < last; ++key) {
+                    float t = span_time > 0.0f ? (times[key] - times[first]) / span_time : 0.0f;
+                    float error = get_error(blend(keys[first], keys[last], t, rotation), keys[key], rotation);
+
+                    if (error > max_error) {
+                        max_error = error;
+                        max_key = key;
+                    }
+                }
+
+                if (max_error <= tolerance) {
+                    continue;
+                }
+
+                kept[max_key] = 1u;
+                spans.push_back({ first, max_key });
+                spans.push_back({ max_key, last });
+            }
+        }
+    }
+
+    std::vector<uint32_t> kept_keys;
+    for (uint32_t key = 0u; key < key_count; ++key) {
+        if (kept[key]) {
+            kept_keys.push_back(key);
+        }
+    }
+
+    curve.interpolation = interpolation;
+    curve.component_count = static_cast<uint8_t>(component_count);
+    curve.start_time = times[kept_keys.front()];
+    curve.time_extent = times[kept_keys.back()] - curve.start_time;
+
+    glm::vec4 value_max = keys[kept_keys.front()];
+    curve.value_min = value_max;
+
+    for (uint32_t key : kept_keys) {
+        curve.value_min = glm::min(curve.value_min, keys[key]);
+        value_max = glm::max(value_max, keys[key]);
+    }
+
+    curve.value_extent = value_max - curve.value_min;
+
+    curve.key_times.resize(kept_keys.size());
+    curve.key_values.resize(kept_keys.size() * component_count);
+
+    for (uint32_t i = 0u; i < kept_keys.size(); ++i) {
+        uint32_t key = kept_keys[i];
+
+        curve.key_times[i] = quantize(times[key], curve.start_time, curve.time_extent);
+
+        for (uint32_t c = 0u; c < component_count; ++c) {
+            curve.key_values[i * component_count + c] = quantize(keys[key][c], curve.value_min[c], curve.value_extent[c]);
+        }
+    }
+
+    // Measured on what the clients get
+    curve.max_error = 0.0f;
+    for (uint32_t key = 0u; key < key_count; ++key) {
+        curve.max_error = std::max(curve.max_error, get_error(evaluate_curve(curve, times[key]), keys[key], rotation));
+    }
+}
+
+void sample_cubic_spline(const float* times, const float* values, uint32_t key_count, uint32_t component_count,
+    uint32_t samples_per_key, std::vector<float>& sampled_times, std::vector<float>& sampled_values)
+{
+    sampled_times.clear();
+    sampled_values.clear();
+
+    if (key_count == 0u) {
+        return;
+    }
+
+    // Per key: in tangent, value, out tangent
+    auto get = [&](uint32_t key, uint32_t element) {
+        return load_key(values, key * 3u + element, component_count);
+    };
+
+    for (uint32_t key = 0u; key + 1u < key_count; ++key) {
+        float key_time = times[key + 1u] - times[key];
+
+        glm::vec4 value = get(key, 1u);
+        glm::vec4 out_tangent = get(key, 2u) * key_time;
+        glm::vec4 next_value = get(key + 1u, 1u);
+        glm::vec4 next_in_tangent = get(key + 1u, 0u) * key_time;
+
+        for (uint32_t sample = 0u; sample < samples_per_key; ++sample) {
+            float s = static_cast<float>(sample) / static_cast<float>(samples_per_key);
+            float s2 = s * s;
+            float s3 = s2 * s;
+
+            glm::vec4 sampled = (2.0f * s3 - 3.0f * s2 + 1.0f) * value + (s3 - 2.0f * s2 + s) * out_tangent +
+                (-2.0f * s3 + 3.0f * s2) * next_value + (s3 - s2) * next_in_tangent;
+
+            sampled_times.push_back(times[key] + s * key_time);
+            for (uint32_t c = 0u; c < component_count; ++c) {
+                sampled_values.push_back(sampled[c]);
+            }
+        }
+    }
+
+    glm::vec4 last_value = get(key_count - 1u, 1u);
+
+    sampled_times.push_back(times[key_count - 1u]);
+    for (uint32_t c = 0u; c < component_count; ++c) {
+        sampled_values.push_back(last_value[c]);
+    }
+}
+
+float get_curve_key_time(const sVPETCurve& curve, uint32_t key)
+{
+    return curve.start_time + curve.key_times[key] / QUANTIZATION_STEPS * curve.time_extent;
+}
+
+glm::vec4 get_curve_key_value(const sVPETCurve& curve, uint32_t key)
+{
+    glm::vec4 value = {};
+
+    for (uint32_t c = 0u; c < curve.component_count; ++c) {
+        value[c] = curve.value_min[c] + curve.key_values[key * curve.component_count + c] / QUANTIZATION_STEPS * curve.value_extent[c];
+    }
+
+    if (curve.component_count == 4u) {
+        value = glm::normalize(value);
+    }
+
+    return value;
+}
+
+glm::vec4 evaluate_curve(const sVPETCurve& curve, float time)
+{
+    uint32_t key_count = curve.key_times.size();
+
+    if (key_count == 0u) {
+        return {};
+    }
+
+    if (key_count == 1u || curve.time_extent <= 0.0f || time <= curve.start_time) {
+        return get_curve_key_value(curve, 0u);
+    }
+
+    // In quantized time, the first key past it ends the span
+    float position = (time - curve.start_time) / curve.time_extent * QUANTIZATION_STEPS;
+    uint32_t next = std::upper_bound(curve.key_times.begin(), curve.key_times.end(), position) - curve.key_times.begin();
+
+    if (next >= key_count) {
+        return get_curve_key_value(curve, key_count - 1u);
+    }
+
+    uint32_t previous = next - 1u;
+
+    if (curve.interpolation == eVPETCurveInterpolation::STEP) {
+        return get_curve_key_value(curve, previous);
+    }
+
+    float t = (position - curve.key_times[previous]) / static_cast<float>(curve.key_times[next] - curve.key_times[previous]);
+
+    return blend(get_curve_key_value(curve, previous), get_curve_key_value(curve, next), t, curve.component_count == 4u);
+}
+
+uint32_t get_curve_byte_size(const sVPETCurve& curve)
+{
+    uint32_t key_count = curve.key_times.size();
+
+    // Node id, parameter id, interpolation, component count, key count, start time and extent
+    uint32_t byte_size = sizeof(int32_t) + sizeof(uint16_t) + 2u * sizeof(uint8_t) + sizeof(uint32_t) + 2u * sizeof(float);
+    byte_size += 2u * curve.component_count * sizeof(float);
+    byte_size += key_count * sizeof(uint16_t);
+    byte_size += key_count * curve.component_count * sizeof(uint16_t);
+
+    return byte_size;
+}
+
+void write_curve(const sVPETCurve& curve, uint8_t* byte_array, uint32_t& buffer_ptr)
+{
+    memcpy(&byte_array[buffer_ptr], &curve.node_id, sizeof(int32_t));
+    buffer_ptr += sizeof(int32_t);
+
+    memcpy(&byte_array[buffer_ptr], &curve.parameter_id, sizeof(uint16_t));
+    buffer_ptr += sizeof(uint16_t);
+
+    byte_array[buffer_ptr] = static_cast<uint8_t>(curve.interpolation);
+    buffer_ptr += sizeof(uint8_t);
+
+    byte_array[buffer_ptr] = curve.component_count;
+    buffer_ptr += sizeof(uint8_t);
+
+    uint32_t key_count = curve.key_times.size();
+    memcpy(&byte_array[buffer_ptr], &key_count, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&byte_array[buffer_ptr], &curve.start_time, sizeof(float));
+    buffer_ptr += sizeof(float);
+
+    memcpy(&byte_array[buffer_ptr], &curve.time_extent, sizeof(float));
+    buffer_ptr += sizeof(float);
+
+    memcpy(&byte_array[buffer_ptr], &curve.value_min[0], curve.component_count * sizeof(float));
+    buffer_ptr += curve.component_count * sizeof(float);
+
+    memcpy(&byte_array[buffer_ptr], &curve.value_extent[0], curve.component_count * sizeof(float));
+    buffer_ptr += curve.component_count * sizeof(float);
+
+    memcpy(&byte_array[buffer_ptr], curve.key_times.data(), key_count * sizeof(uint16_t));
+    buffer_ptr += key_count * sizeof(uint16_t);
+
+    memcpy(&byte_array[buffer_ptr], curve.key_values.data(), curve.key_values.size() * sizeof(uint16_t));
+    buffer_ptr += curve.key_values.size() * sizeof(uint16_t);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "structs.h"
+
+// Error allowed when dropping keys, in scene units for positions and scales and in radians for rotations.
+// Quantization adds at most half a 16-bit step of the curve range on top
+struct sCurveTolerance {
+    float position = 0.001f;
+    float rotation = 0.001f;
+    float scale = 0.001f;
+};
+
+// Keys of a linear or step channel with component_count floats per key, rotations as x, y, z, w. Keys that the
+// interpolation of their neighbours reproduces within tolerance are dropped, the rest are quantized into curve
+void compress_curve(const float* times, const float* values, uint32_t key_count, uint32_t component_count,
+    eVPETCurveInterpolation interpolation, float tolerance, sVPETCurve& curve);
+
+// Cubic spline keys (in tangent, value and out tangent per key) to samples_per_key linear keys per interval
+void sample_cubic_spline(const float* times, const float* values, uint32_t key_count, uint32_t component_count,
+    uint32_t samples_per_key, std::vector<float>& sampled_times, std::vector<float>& sampled_values);
+
+float get_curve_key_time(const sVPETCurve& curve, uint32_t key);
+glm::vec4 get_curve_key_value(const sVPETCurve& curve, uint32_t key);
+
+// Value at time as the clients evaluate it, times outside the curve clamp to its ends
+glm::vec4 evaluate_curve(const sVPETCurve& curve, float time);
+
+uint32_t get_curve_byte_size(const sVPETCurve& curve);
+void write_curve(const sVPETCurve& curve, uint8_t* byte_array, uint32_t& buffer_ptr);
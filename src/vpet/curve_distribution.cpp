@@ -0,0 +1,450 @@
+#include "curve_distribution.h"
+
+#include "tiny_gltf.h"
+
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+    // Linear keys per cubic spline interval, the curve fit drops the ones that are not needed
+    const uint32_t CUBIC_SPLINE_SAMPLES = 4u;
+
+    // Scene id, object id, parameter id, type and length before each value of a PARAMETER_UPDATE
+    const uint32_t PARAMETER_UPDATE_OVERHEAD = 10u;
+
+    bool skip_image(tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*)
+    {
+        return true;
+    }
+
+    // JSON of a glTF or GLB file, without its buffers
+    bool read_gltf_json(const std::string& filename, bool binary, std::string& json)
+    {
+        std::ifstream file(filename, std::ios::binary);
+
+        if (!file) {
+            return false;
+        }
+
+        if (!binary) {
+            json.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            return true;
+        }
+
+        // Magic, version and length, then the length and type of the JSON chunk
+        uint32_t header[5];
+
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != 0x46546C67u || header[4] != 0x4E4F534Au) {
+            return false;
+        }
+
+        json.resize(header[3]);
+        return static_cast<bool>(file.read(json.data(), json.size()));
+    }
+
+    // Accessor values as floats, normalized integers mapped to [0, 1] or [-1, 1]
+    bool read_accessor(const tinygltf::Model& model, int32_t accessor_idx, std::vector<float>& values, uint32_t& component_count)
+    {
+        if (accessor_idx < 0 || accessor_idx >= static_cast<int32_t>(model.accessors.size())) {
+            return false;
+        }
+
+        const tinygltf::Accessor& accessor = model.accessors[accessor_idx];
+
+        if (accessor.sparse.isSparse || accessor.bufferView < 0 || accessor.count == 0u) {
+            return false;
+        }
+
+        const tinygltf::BufferView& buffer_view = model.bufferViews[accessor.bufferView];
+        const tinygltf::Buffer& buffer = model.buffers[buffer_view.buffer];
+
+        int32_t components = tinygltf::GetNumComponentsInType(accessor.type);
+        int32_t component_size = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+        int32_t stride = accessor.ByteStride(buffer_view);
+
+        if (components <= 0 || component_size <= 0 || stride <= 0) {
+            return false;
+        }
+
+        size_t offset = buffer_view.byteOffset + accessor.byteOffset;
+
+        if (offset + (accessor.count - 1u) * stride + components * component_size > buffer.data.size()) {
+            return false;
+        }
+
+        component_count = static_cast<uint32_t>(components);
+        values.resize(accessor.count * component_count);
+
+        for (size_t element_idx = 0u; element_idx < accessor.count; ++element_idx) {
+            const uint8_t* element = &buffer.data[offset + element_idx * stride];
+
+            for (uint32_t c = 0u; c < component_count; ++c) {
+                const uint8_t* component = element + c * component_size;
+                float value = 0.0f;
+
+                switch (accessor.componentType) {
+                case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                    memcpy(&value, component, sizeof(float));
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_BYTE:
+                    value = std::max(static_cast<int8_t>(*component) / 127.0f, -1.0f);
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                    value = *component / 255.0f;
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_SHORT: {
+                    int16_t short_value;
+                    memcpy(&short_value, component, sizeof(int16_t));
+                    value = std::max(short_value / 32767.0f, -1.0f);
+                    break;
+                }
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+                    uint16_t short_value;
+                    memcpy(&short_value, component, sizeof(uint16_t));
+                    value = short_value / 65535.0f;
+                    break;
+                }
+                default:
+                    return false;
+                }
+
+                values[element_idx * component_count + c] = value;
+            }
+        }
+
+        return true;
+    }
+
+    int32_t get_parameter_id(const std::string& target_path)
+    {
+        if (target_path == "translation") {
+            return 0;
+        }
+
+        if (target_path == "rotation") {
+            return 1;
+        }
+
+        if (target_path == "scale") {
+            return 2;
+        }
+
+        return -1;
+    }
+
+    // glTF to the Unity coordinate system, as the "nodes" transforms
+    void to_unity_space(int32_t parameter_id, uint32_t key_count, float* values)
+    {
+        for (uint32_t key = 0u; key < key_count; ++key) {
+            if (parameter_id == 0) {
+                values[key * 3u + 2u] = -values[key * 3u + 2u];
+            }
+            else if (parameter_id == 1) {
+                values[key * 4u] = -values[key * 4u];
+                values[key * 4u + 1u] = -values[key * 4u + 1u];
+            }
+        }
+    }
+}
+
+void extract_animations(const tinygltf::Model& model, const CurveNodeResolver& resolve_node, const sCurveTolerance& tolerance,
+    std::vector<sVPETAnimation*>& animations)
+{
+    std::vector<float> times;
+    std::vector<float> values;
+    std::vector<float> sampled_times;
+    std::vector<float> sampled_values;
+
+    for (uint32_t animation_idx = 0u; animation_idx < model.animations.size(); ++animation_idx) {
+        const tinygltf::Animation& animation = model.animations[animation_idx];
+
+        sVPETAnimation* vpet_animation = new sVPETAnimation();
+        vpet_animation->name = animation.name.empty() ? "Animation_" + std::to_string(animation_idx) : animation.name;
+
+        uint32_t skipped_channels = 0u;
+
+        for (const tinygltf::AnimationChannel& channel : animation.channels) {
+            int32_t parameter_id = get_parameter_id(channel.target_path);
+            int32_t node_id = channel.target_node >= 0 ? resolve_node(channel.target_node) : -1;
+
+            if (parameter_id < 0 || node_id < 0 || channel.sampler < 0 || channel.sampler >= static_cast<int32_t>(animation.samplers.size())) {
+                skipped_channels++;
+                continue;
+            }
+
+            const tinygltf::AnimationSampler& sampler = animation.samplers[channel.sampler];
+
+            uint32_t time_components = 0u;
+            uint32_t value_components = 0u;
+
+            if (!read_accessor(model, sampler.input, times, time_components) || !read_accessor(model, sampler.output, values, value_components)) {
+                skipped_channels++;
+                continue;
+            }
+
+            uint32_t key_count = times.size();
+            uint32_t component_count = parameter_id == 1 ? 4u : 3u;
+            bool cubic_spline = sampler.interpolation == "CUBICSPLINE";
+
+            if (time_components != 1u || value_components != component_count || values.size() != key_count * component_count * (cubic_spline ? 3u : 1u)) {
+                skipped_channels++;
+                continue;
+            }
+
+            if (cubic_spline) {
+                sample_cubic_spline(times.data(), values.data(), key_count, component_count, CUBIC_SPLINE_SAMPLES, sampled_times, sampled_values);
+                std::swap(times, sampled_times);
+                std::swap(values, sampled_values);
+                key_count = times.size();
+            }
+
+            to_unity_space(parameter_id, key_count, values.data());
+
+            eVPETCurveInterpolation interpolation = sampler.interpolation == "STEP" ? eVPETCurveInterpolation::STEP : eVPETCurveInterpolation::LINEAR;
+            float channel_tolerance = parameter_id == 0 ? tolerance.position : (parameter_id == 1 ? tolerance.rotation : tolerance.scale);
+
+            sVPETCurve curve;
+            curve.node_id = node_id;
+            curve.parameter_id = static_cast<uint16_t>(parameter_id);
+
+            compress_curve(times.data(), values.data(), key_count, component_count, interpolation, channel_tolerance, curve);
+
+            vpet_animation->duration = std::max(vpet_animation->duration, times.back());
+            vpet_animation->source_key_count += key_count;
+            vpet_animation->curves.push_back(std::move(curve));
+        }
+
+        if (skipped_channels > 0u) {
+            spdlog::debug("Animation {}: {} channels not sent, weights or nodes outside the scene", vpet_animation->name, skipped_channels);
+        }
+
+        if (vpet_animation->curves.empty()) {
+            delete vpet_animation;
+            continue;
+        }
+
+        // Curves of a node next to each other, players set each node once
+        std::stable_sort(vpet_animation->curves.begin(), vpet_animation->curves.end(), [](const sVPETCurve& a, const sVPETCurve& b) {
+            return a.node_id < b.node_id;
+        });
+
+        animations.push_back(vpet_animation);
+    }
+}
+
+uint32_t process_animations(sVPETContext& vpet, const std::string& filename, const sCurveTolerance& tolerance)
+{
+    bool binary = filename.ends_with(".glb");
+
+    if (!binary && !filename.ends_with(".gltf")) {
+        return 0u;
+    }
+
+    // Most locations are static, the buffers are only loaded when the JSON has animations
+    std::string json;
+    if (!read_gltf_json(filename, binary, json) || json.find("\"animations\"") == std::string::npos) {
+        return 0u;
+    }
+
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    std::string error;
+    std::string warning;
+
+    // Images stay encoded, the scene already has them
+    loader.SetImageLoader(skip_image, nullptr);
+
+    bool loaded = binary ? loader.LoadBinaryFromFile(&model, &error, &warning, filename) : loader.LoadASCIIFromFile(&model, &error, &warning, filename);
+
+    if (!loaded) {
+        spdlog::warn("Could not read the animations of {}: {}", filename, error);
+        return 0u;
+    }
+
+    // Scene nodes by name, names used more than once can't be told apart and are not animated
+    std::unordered_map<std::string, int32_t> node_ids;
+
+    for (uint32_t node_idx = 0u; node_idx < vpet.node_list.size(); ++node_idx) {
+        const char* name = vpet.node_list[node_idx]->name;
+        auto [it, inserted] = node_ids.emplace(std::string(name, strnlen(name, sizeof(sVPETNode::name))), node_idx);
+
+        if (!inserted) {
+            it->second = -1;
+        }
+    }
+
+    auto resolve_node = [&](int32_t gltf_node) -> int32_t {
+        if (gltf_node >= static_cast<int32_t>(model.nodes.size())) {
+            return -1;
+        }
+
+        const std::string& name = model.nodes[gltf_node].name;
+        auto it = node_ids.find(name.substr(0, sizeof(sVPETNode::name)));
+
+        return it != node_ids.end() ? it->second : -1;
+    };
+
+    extract_animations(model, resolve_node, tolerance, vpet.animation_list);
+
+    vpet.curves_byte_size = get_curves_byte_size(vpet.animation_list);
+
+    return vpet.animation_list.size();
+}
+
+uint32_t get_curves_byte_size(const std::vector<sVPETAnimation*>& animations)
+{
+    uint32_t byte_size = sizeof(uint32_t);
+
+    for (const sVPETAnimation* animation : animations) {
+        // Name size and chars, duration, curve count
+        byte_size += sizeof(uint32_t) + animation->name.size() + sizeof(float) + sizeof(uint32_t);
+
+        for (const sVPETCurve& curve : animation->curves) {
+            byte_size += get_curve_byte_size(curve);
+        }
+    }
+
+    return byte_size;
+}
+
+void write_curves(const std::vector<sVPETAnimation*>& animations, uint8_t* byte_array, uint32_t& buffer_ptr)
+{
+    uint32_t animation_count = animations.size();
+    memcpy(&byte_array[buffer_ptr], &animation_count, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    for (const sVPETAnimation* animation : animations) {
+        uint32_t name_size = animation->name.size();
+        memcpy(&byte_array[buffer_ptr], &name_size, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        memcpy(&byte_array[buffer_ptr], animation->name.data(), name_size);
+        buffer_ptr += name_size;
+
+        memcpy(&byte_array[buffer_ptr], &animation->duration, sizeof(float));
+        buffer_ptr += sizeof(float);
+
+        uint32_t curve_count = animation->curves.size();
+        memcpy(&byte_array[buffer_ptr], &curve_count, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        for (const sVPETCurve& curve : animation->curves) {
+            write_curve(curve, byte_array, buffer_ptr);
+        }
+    }
+}
+
+sCurveReport get_curve_report(const sVPETAnimation& animation, uint32_t frame_rate, float state_interval)
+{
+    sCurveReport report;
+    report.source_key_count = animation.source_key_count;
+
+    std::unordered_set<int32_t> nodes;
+
+    // All animated channels of a frame batched in one message
+    uint32_t update_frame_bytes = 3u;
+
+    for (const sVPETCurve& curve : animation.curves) {
+        nodes.insert(curve.node_id);
+
+        report.key_count += curve.key_times.size();
+        report.curve_bytes += get_curve_byte_size(curve);
+
+        update_frame_bytes += PARAMETER_UPDATE_OVERHEAD + curve.component_count * sizeof(float);
+
+        float& max_error = curve.parameter_id == 0 ? report.max_position_error : (curve.parameter_id == 1 ? report.max_rotation_error : report.max_scale_error);
+        max_error = std::max(max_error, curve.max_error);
+    }
+
+    report.node_count = nodes.size();
+
+    if (report.node_count == 0u) {
+        return report;
+    }
+
+    float node_count = static_cast<float>(report.node_count);
+    float duration = std::max(animation.duration, 1.0f / frame_rate);
+
+    report.curve_bytes_per_node_second = report.curve_bytes / (node_count * duration);
+    if (state_interval > 0.0f) {
+        report.curve_bytes_per_node_second += ANIMATION_MESSAGE_SIZE / (state_interval * node_count);
+    }
+
+    report.update_bytes_per_node_second = update_frame_bytes * static_cast<float>(frame_rate) / node_count;
+
+    return report;
+}
+
+void log_curve_report(const std::vector<sVPETAnimation*>& animations, uint32_t frame_rate, float state_interval)
+{
+    for (const sVPETAnimation* animation : animations) {
+        sCurveReport report = get_curve_report(*animation, frame_rate, state_interval);
+
+        spdlog::info("Animation {}: {:.2f} s, {} nodes, {} of {} keys, {} bytes. {:.1f} B/node/s as curves, {:.1f} B/node/s as PARAMETER_UPDATE at {} fps",
+            animation->name, animation->duration, report.node_count, report.key_count, report.source_key_count, report.curve_bytes,
+            report.curve_bytes_per_node_second, report.update_bytes_per_node_second, frame_rate);
+
+        spdlog::info("Animation {}: max error {:.5f} position, {:.5f} rad rotation, {:.5f} scale", animation->name,
+            report.max_position_error, report.max_rotation_error, report.max_scale_error);
+    }
+}
+
+void write_animation_message(uint8_t sender_id, uint8_t time, uint8_t scene_id, const sVPETAnimationCommand& command, uint8_t* byte_array)
+{
+    uint32_t buffer_ptr = 0u;
+
+    byte_array[buffer_ptr++] = sender_id;
+    byte_array[buffer_ptr++] = time;
+    byte_array[buffer_ptr++] = static_cast<uint8_t>(eVPETMessageType::ANIMATION);
+    byte_array[buffer_ptr++] = scene_id;
+
+    memcpy(&byte_array[buffer_ptr], &command.animation_id, sizeof(uint16_t));
+    buffer_ptr += sizeof(uint16_t);
+
+    byte_array[buffer_ptr++] = static_cast<uint8_t>(command.command);
+    byte_array[buffer_ptr++] = command.loop ? 1u : 0u;
+
+    memcpy(&byte_array[buffer_ptr], &command.time, sizeof(float));
+    buffer_ptr += sizeof(float);
+
+    memcpy(&byte_array[buffer_ptr], &command.speed, sizeof(float));
+    buffer_ptr += sizeof(float);
+
+    assert(buffer_ptr == ANIMATION_MESSAGE_SIZE);
+}
+
+bool read_animation_message(const uint8_t* buffer, uint32_t msg_size, uint8_t& scene_id, sVPETAnimationCommand& command)
+{
+    if (msg_size < ANIMATION_MESSAGE_SIZE) {
+        return false;
+    }
+
+    uint32_t buffer_ptr = 3u;
+
+    scene_id = buffer[buffer_ptr++];
+
+    memcpy(&command.animation_id, &buffer[buffer_ptr], sizeof(uint16_t));
+    buffer_ptr += sizeof(uint16_t);
+
+    if (buffer[buffer_ptr] > static_cast<uint8_t>(eVPETAnimationCommand::SEEK)) {
+        return false;
+    }
+
+    command.command = static_cast<eVPETAnimationCommand>(buffer[buffer_ptr++]);
+    command.loop = buffer[buffer_ptr++] != 0u;
+
+    memcpy(&command.time, &buffer[buffer_ptr], sizeof(float));
+    buffer_ptr += sizeof(float);
+
+    memcpy(&command.speed, &buffer[buffer_ptr], sizeof(float));
+    buffer_ptr += sizeof(float);
+
+    return std::isfinite(command.time) && std::isfinite(command.speed);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "structs.h"
+#include "curve_compression.h"
+
+#include <functional>
+
+namespace tinygltf {
+    class Model;
+}
+
+// "curve" answers the glTF animations of the scene as keyframe curves the clients evaluate themselves:
+//   animation count, then per animation its name (size and chars), duration and curve count, and per curve its
+//   node id (in "nodes"), parameter id (0 position, 1 rotation, 2 scale, as in PARAMETER_UPDATE), interpolation
+//   (0 linear, 1 step), component count, key count, start time, time extent, per component min and extent, then
+//   key times as 16-bit fractions of the time extent and key values as 16-bit fractions of their extent.
+// Values in the Unity coordinate system, rotations as x, y, z, w and slerped between keys.
+//
+// Playback goes out as ANIMATION messages, nothing is sent per frame:
+//   header, scene id, animation id (uint16), command (0 stop, 1 play, 2 seek), loop, time (float), speed (float)
+// Stop and play set the time, seek keeps playing or stopped.
+
+enum class eVPETAnimationCommand : uint8_t {
+    STOP, PLAY, SEEK
+};
+
+struct sVPETAnimationCommand {
+    uint16_t animation_id = 0;
+    eVPETAnimationCommand command = eVPETAnimationCommand::STOP;
+    bool loop = true;
+    // In seconds of the animation
+    float time = 0.0f;
+    float speed = 1.0f;
+};
+
+const uint32_t ANIMATION_MESSAGE_SIZE = 16u;
+
+// Index in node_list of a glTF node, -1 for nodes that are not sent
+using CurveNodeResolver = std::function<int32_t(int32_t gltf_node)>;
+
+// Translation, rotation and scale channels of every glTF animation, morph target weights are not sent
+void extract_animations(const tinygltf::Model& model, const CurveNodeResolver& resolve_node, const sCurveTolerance& tolerance,
+    std::vector<sVPETAnimation*>& animations);
+
+// Reads the animations of a glTF or GLB file, its nodes are matched by name with node_list. Returns the animation count
+uint32_t process_animations(sVPETContext& vpet, const std::string& filename, const sCurveTolerance& tolerance = {});
+
+uint32_t get_curves_byte_size(const std::vector<sVPETAnimation*>& animations);
+void write_curves(const std::vector<sVPETAnimation*>& animations, uint8_t* byte_array, uint32_t& buffer_ptr);
+
+// Cost of an animation on the wire, as curves or as a PARAMETER_UPDATE of every animated channel each frame
+struct sCurveReport {
+    uint32_t node_count = 0;
+    uint32_t source_key_count = 0;
+    uint32_t key_count = 0;
+    uint32_t curve_bytes = 0;
+    // The curves spread over a single run, they are sent once per client, plus the playback state refreshes
+    float curve_bytes_per_node_second = 0.0f;
+    float update_bytes_per_node_second = 0.0f;
+    float max_position_error = 0.0f;
+    float max_rotation_error = 0.0f;
+    float max_scale_error = 0.0f;
+};
+
+sCurveReport get_curve_report(const sVPETAnimation& animation, uint32_t frame_rate, float state_interval);
+void log_curve_report(const std::vector<sVPETAnimation*>& animations, uint32_t frame_rate, float state_interval);
+
+void write_animation_message(uint8_t sender_id, uint8_t time, uint8_t scene_id, const sVPETAnimationCommand& command, uint8_t* byte_array);
+bool read_animation_message(const uint8_t* buffer, uint32_t msg_size, uint8_t& scene_id, sVPETAnimationCommand& command);
@@ -0,0 +1,22 @@
+#include "hash.h"
+
+#include <cstring>
+
+uint64_t hash_bytes(const uint8_t* data, size_t size, uint64_t hash)
+{
+    size_t word_count = size / sizeof(uint64_t);
+
+    for (size_t i = 0u; i < word_count; ++i) {
+        uint64_t word;
+        memcpy(&word, &data[i * sizeof(uint64_t)], sizeof(uint64_t));
+        hash ^= word;
+        hash *= FNV_PRIME;
+    }
+
+    for (size_t i = word_count * sizeof(uint64_t); i < size; ++i) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+const uint64_t FNV_OFFSET = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+// FNV-1a over 64 bit words, the tail bytewise. Pass a previous hash to continue it
+uint64_t hash_bytes(const uint8_t* data, size_t size, uint64_t hash = FNV_OFFSET);
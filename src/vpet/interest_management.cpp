@@ -0,0 +1,391 @@
+#include "interest_management.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+    enum ePlane {
+        PLANE_NEAR,
+        PLANE_FAR,
+        PLANE_LEFT,
+        PLANE_RIGHT,
+        PLANE_BOTTOM,
+        PLANE_TOP
+    };
+
+    glm::vec4 make_plane(const glm::vec3& normal, const glm::vec3& point)
+    {
+        return glm::vec4(normal, -glm::dot(normal, point));
+    }
+
+    // Cameras look down -z in the engine coordinate system
+    void compute_frustum_planes(const sVPETInterest& interest, std::array<glm::vec4, 6>& planes)
+    {
+        glm::vec3 forward = interest.rotation * glm::vec3(0.0f, 0.0f, -1.0f);
+        glm::vec3 right = interest.rotation * glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 up = interest.rotation * glm::vec3(0.0f, 1.0f, 0.0f);
+
+        float half_vertical = glm::radians(interest.fov) * 0.5f;
+        float half_horizontal = std::atan(std::tan(half_vertical) * interest.aspect);
+
+        const glm::vec3& eye = interest.position;
+
+        planes[PLANE_NEAR] = make_plane(forward, eye + forward * interest.near_plane);
+        planes[PLANE_FAR] = make_plane(-forward, eye + forward * interest.far_plane);
+
+        // Side normals point inwards, tilted towards the view direction by the half angle
+        planes[PLANE_LEFT] = make_plane(right * std::cos(half_horizontal) + forward * std::sin(half_horizontal), eye);
+        planes[PLANE_RIGHT] = make_plane(-right * std::cos(half_horizontal) + forward * std::sin(half_horizontal), eye);
+        planes[PLANE_BOTTOM] = make_plane(up * std::cos(half_vertical) + forward * std::sin(half_vertical), eye);
+        planes[PLANE_TOP] = make_plane(-up * std::cos(half_vertical) + forward * std::sin(half_vertical), eye);
+    }
+
+    template<typename T>
+    void read_value(const uint8_t* buffer, uint32_t& buffer_ptr, T& value)
+    {
+        memcpy(&value, &buffer[buffer_ptr], sizeof(T));
+        buffer_ptr += sizeof(T);
+    }
+
+    template<typename T>
+    void write_value(uint8_t* buffer, uint32_t& buffer_ptr, const T& value)
+    {
+        memcpy(&buffer[buffer_ptr], &value, sizeof(T));
+        buffer_ptr += sizeof(T);
+    }
+
+    void write_record(uint8_t scene_id, uint16_t object_id, uint16_t parameter_id, eVPETParameterType type,
+        const void* value, uint32_t length, std::vector<uint8_t>& message)
+    {
+        uint32_t buffer_ptr = message.size();
+        message.resize(buffer_ptr + 10u + length);
+
+        write_value(message.data(), buffer_ptr, scene_id);
+        write_value(message.data(), buffer_ptr, object_id);
+        write_value(message.data(), buffer_ptr, parameter_id);
+        write_value(message.data(), buffer_ptr, type);
+        write_value(message.data(), buffer_ptr, length);
+
+        memcpy(&message[buffer_ptr], value, length);
+    }
+}
+
+bool read_interest_message(const uint8_t* buffer, uint32_t msg_size, uint8_t& scene_id, sVPETInterest& interest)
+{
+    // Header, scene id and shape
+    if (msg_size < 5u) {
+        return false;
+    }
+
+    uint32_t buffer_ptr = 3u;
+
+    scene_id = buffer[buffer_ptr++];
+
+    if (buffer[buffer_ptr] > static_cast<uint8_t>(eVPETInterestShape::FRUSTUM)) {
+        return false;
+    }
+
+    interest = {};
+    interest.shape = static_cast<eVPETInterestShape>(buffer[buffer_ptr++]);
+
+    switch (interest.shape) {
+    case eVPETInterestShape::NONE:
+        return true;
+    case eVPETInterestShape::SPHERE:
+        if (msg_size < INTEREST_SPHERE_MESSAGE_SIZE) {
+            return false;
+        }
+        read_value(buffer, buffer_ptr, interest.position);
+        read_value(buffer, buffer_ptr, interest.radius);
+        break;
+    case eVPETInterestShape::FRUSTUM:
+        if (msg_size < INTEREST_FRUSTUM_MESSAGE_SIZE) {
+            return false;
+        }
+        read_value(buffer, buffer_ptr, interest.position);
+        read_value(buffer, buffer_ptr, interest.rotation);
+        read_value(buffer, buffer_ptr, interest.fov);
+        read_value(buffer, buffer_ptr, interest.aspect);
+        read_value(buffer, buffer_ptr, interest.near_plane);
+        read_value(buffer, buffer_ptr, interest.far_plane);
+        break;
+    }
+
+    // From the Unity coordinate system
+    interest.position.z = -interest.position.z;
+    interest.rotation.x = -interest.rotation.x;
+    interest.rotation.y = -interest.rotation.y;
+
+    if (interest.shape == eVPETInterestShape::SPHERE) {
+        return std::isfinite(interest.radius) && interest.radius >= 0.0f;
+    }
+
+    interest.rotation = glm::normalize(interest.rotation);
+
+    return interest.fov > 0.0f && interest.fov < 180.0f && interest.aspect > 0.0f &&
+        interest.near_plane >= 0.0f && interest.far_plane > interest.near_plane;
+}
+
+uint32_t write_interest_message(uint8_t client_id, uint8_t time, uint8_t scene_id, const sVPETInterest& interest, uint8_t* message)
+{
+    uint32_t buffer_ptr = 0u;
+
+    message[buffer_ptr++] = client_id;
+    message[buffer_ptr++] = time;
+    message[buffer_ptr++] = static_cast<uint8_t>(eVPETMessageType::INTEREST);
+    message[buffer_ptr++] = scene_id;
+    message[buffer_ptr++] = static_cast<uint8_t>(interest.shape);
+
+    // To the Unity coordinate system
+    glm::vec3 position = interest.position;
+    position.z = -position.z;
+
+    glm::quat rotation = interest.rotation;
+    rotation.x = -rotation.x;
+    rotation.y = -rotation.y;
+
+    switch (interest.shape) {
+    case eVPETInterestShape::NONE:
+        break;
+    case eVPETInterestShape::SPHERE:
+        write_value(message, buffer_ptr, position);
+        write_value(message, buffer_ptr, interest.radius);
+        assert(buffer_ptr == INTEREST_SPHERE_MESSAGE_SIZE);
+        break;
+    case eVPETInterestShape::FRUSTUM:
+        write_value(message, buffer_ptr, position);
+        write_value(message, buffer_ptr, rotation);
+        write_value(message, buffer_ptr, interest.fov);
+        write_value(message, buffer_ptr, interest.aspect);
+        write_value(message, buffer_ptr, interest.near_plane);
+        write_value(message, buffer_ptr, interest.far_plane);
+        assert(buffer_ptr == INTEREST_FRUSTUM_MESSAGE_SIZE);
+        break;
+    }
+
+    return buffer_ptr;
+}
+
+void write_transform_records(uint8_t scene_id, uint16_t object_id, const glm::vec3& position, const glm::quat& rotation,
+    const glm::vec3& scale, std::vector<uint8_t>& message)
+{
+    // Transform to unity coordinate system
+    glm::vec3 transformed_pos = position;
+    transformed_pos.z = -transformed_pos.z;
+
+    glm::quat transformed_rot = rotation;
+    transformed_rot.x = -transformed_rot.x;
+    transformed_rot.y = -transformed_rot.y;
+
+    write_record(scene_id, object_id, 0u, eVPETParameterType::VECTOR3, &transformed_pos, sizeof(glm::vec3), message);
+    write_record(scene_id, object_id, 1u, eVPETParameterType::QUATERNION, &transformed_rot, sizeof(glm::quat), message);
+    write_record(scene_id, object_id, 2u, eVPETParameterType::VECTOR3, &scale, sizeof(glm::vec3), message);
+}
+
+bool InterestManager::is_inside(const sClient& client, const sBVHBounds& bounds, float margin) const
+{
+    if (!bounds.is_valid()) {
+        return false;
+    }
+
+    if (client.interest.shape == eVPETInterestShape::SPHERE) {
+        float radius = client.interest.radius + margin;
+        return bounds.distance_squared(client.interest.position) <= radius * radius;
+    }
+
+    // Out when the corner furthest along a plane normal is still behind it
+    for (const glm::vec4& plane : client.planes) {
+        glm::vec3 corner = glm::vec3(plane.x >= 0.0f ? bounds.max.x : bounds.min.x, plane.y >= 0.0f ? bounds.max.y : bounds.min.y,
+            plane.z >= 0.0f ? bounds.max.z : bounds.min.z);
+
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < -margin) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void InterestManager::evaluate_region(sClient& client)
+{
+    for (uint32_t editable_id = 0u; editable_id < client.members.size(); ++editable_id) {
+        bool was_inside = client.members[editable_id] != 0u;
+        bool inside = is_inside(client, vpet->editables_node_list[editable_id]->world_bounds, was_inside ? hysteresis : 0.0f);
+
+        if (inside && !was_inside) {
+            client.entered.push_back(editable_id);
+            entered_count++;
+        }
+        else if (!inside && was_inside) {
+            left_count++;
+        }
+
+        client.members[editable_id] = inside ? 1u : 0u;
+    }
+}
+
+void InterestManager::build(const sVPETContext& vpet)
+{
+    this->vpet = &vpet;
+
+    uint32_t editable_count = static_cast<uint32_t>(vpet.editables_node_list.size());
+
+    editable_ids.clear();
+    for (uint32_t editable_id = 0u; editable_id < editable_count; ++editable_id) {
+        editable_ids[vpet.editables_node_list[editable_id]] = editable_id;
+    }
+
+    dirty_editables.clear();
+    dirty_flags.assign(editable_count, 0u);
+
+    for (uint8_t client_id : client_ids) {
+        sClient& client = clients[client_id];
+        client.members.assign(editable_count, 0u);
+        evaluate_region(client);
+    }
+}
+
+void InterestManager::clear()
+{
+    vpet = nullptr;
+
+    editable_ids.clear();
+    dirty_editables.clear();
+    dirty_flags.clear();
+
+    for (uint8_t client_id : client_ids) {
+        clients[client_id].members.clear();
+        clients[client_id].entered.clear();
+    }
+}
+
+void InterestManager::set_interest(uint8_t client_id, const sVPETInterest& interest, uint64_t now_us)
+{
+    if (interest.shape == eVPETInterestShape::NONE) {
+        remove_client(client_id);
+        return;
+    }
+
+    sClient& client = clients[client_id];
+
+    if (!client.registered) {
+        client.registered = true;
+        client_ids.push_back(client_id);
+    }
+
+    client.lease_start_us = now_us;
+    client.interest = interest;
+
+    if (interest.shape == eVPETInterestShape::FRUSTUM) {
+        compute_frustum_planes(interest, client.planes);
+    }
+
+    if (!vpet) {
+        return;
+    }
+
+    // Members from the previous region keep their hysteresis
+    client.members.resize(vpet->editables_node_list.size(), 0u);
+    evaluate_region(client);
+}
+
+void InterestManager::remove_client(uint8_t client_id)
+{
+    sClient& client = clients[client_id];
+
+    if (!client.registered) {
+        return;
+    }
+
+    client = {};
+    client_ids.erase(std::find(client_ids.begin(), client_ids.end(), client_id));
+}
+
+uint32_t InterestManager::expire(uint64_t now_us)
+{
+    uint32_t expired_count = 0u;
+
+    for (uint32_t i = client_ids.size(); i > 0u; --i) {
+        uint8_t client_id = client_ids[i - 1u];
+
+        if (now_us - clients[client_id].lease_start_us > INTEREST_LEASE_US) {
+            remove_client(client_id);
+            expired_count++;
+        }
+    }
+
+    return expired_count;
+}
+
+void InterestManager::mark_dirty(const sVPETNode* vpet_node)
+{
+    auto it = editable_ids.find(vpet_node);
+
+    if (it == editable_ids.end() || dirty_flags[it->second]) {
+        return;
+    }
+
+    dirty_flags[it->second] = 1u;
+    dirty_editables.push_back(it->second);
+}
+
+void InterestManager::collect(std::vector<sVPETInterestBatch>& batches)
+{
+    batches.clear();
+
+    if (!vpet) {
+        return;
+    }
+
+    for (uint8_t client_id : client_ids) {
+        sClient& client = clients[client_id];
+
+        sVPETInterestBatch batch;
+        batch.client_id = client_id;
+
+        for (uint32_t editable_id : dirty_editables) {
+            bool was_inside = client.members[editable_id] != 0u;
+            bool inside = is_inside(client, vpet->editables_node_list[editable_id]->world_bounds, was_inside ? hysteresis : 0.0f);
+
+            if (inside != was_inside) {
+                inside ? entered_count++ : left_count++;
+                client.members[editable_id] = inside ? 1u : 0u;
+            }
+
+            if (inside) {
+                batch.editables.push_back(editable_id);
+            }
+        }
+
+        // Regions may have changed several times since the last collect, moved members are already in the batch
+        std::sort(client.entered.begin(), client.entered.end());
+        client.entered.erase(std::unique(client.entered.begin(), client.entered.end()), client.entered.end());
+
+        for (uint32_t editable_id : client.entered) {
+            if (client.members[editable_id] && !dirty_flags[editable_id]) {
+                batch.editables.push_back(editable_id);
+            }
+        }
+
+        client.entered.clear();
+
+        if (!batch.editables.empty()) {
+            batches.push_back(std::move(batch));
+        }
+    }
+
+    for (uint32_t editable_id : dirty_editables) {
+        dirty_flags[editable_id] = 0u;
+    }
+
+    dirty_editables.clear();
+}
+
+uint32_t InterestManager::get_member_count(uint8_t client_id) const
+{
+    const sClient& client = clients[client_id];
+    return static_cast<uint32_t>(std::count(client.members.begin(), client.members.end(), 1u));
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "structs.h"
+
+#include <array>
+#include <unordered_map>
+
+// Interest regions let each client hear only about the editables around it. A client registers with an INTEREST
+// message, an engine extension routed as the updates:
+//   header, scene id, shape, then for SPHERE center (vec3) and radius (float),
+//   for FRUSTUM camera position (vec3), rotation (quat), vertical fov in degrees, aspect, near and far (floats).
+// Values are in the Unity coordinate system as in PARAMETER_UPDATE, shape NONE unregisters. Regions are leased,
+// clients send theirs again at least every INTEREST_LEASE_US.
+//
+// Edits the engine fans out go on the interest plane, a PUB socket of the engine, as two frames: the recipient
+// client id, which clients subscribe to, and a PARAMETER_UPDATE with position, rotation and scale per object.
+
+enum class eVPETInterestShape : uint8_t {
+    NONE,
+    SPHERE,
+    FRUSTUM
+};
+
+struct sVPETInterest {
+    eVPETInterestShape shape = eVPETInterestShape::NONE;
+    // Sphere center or camera position
+    glm::vec3 position = {};
+    float radius = 0.0f;
+    glm::quat rotation = { 1.0f, 0.0f, 0.0f, 0.0f };
+    float fov = 60.0f;
+    float aspect = 1.0f;
+    float near_plane = 0.1f;
+    float far_plane = 100.0f;
+};
+
+const uint32_t INTEREST_SPHERE_MESSAGE_SIZE = 21u;
+const uint32_t INTEREST_FRUSTUM_MESSAGE_SIZE = 49u;
+
+const uint64_t INTEREST_LEASE_US = 10000000u;
+
+// Values come back in the engine coordinate system
+bool read_interest_message(const uint8_t* buffer, uint32_t msg_size, uint8_t& scene_id, sVPETInterest& interest);
+uint32_t write_interest_message(uint8_t client_id, uint8_t time, uint8_t scene_id, const sVPETInterest& interest, uint8_t* message);
+
+// Position, rotation and scale records of one object, engine space values converted as for "nodes"
+const uint32_t TRANSFORM_RECORDS_SIZE = 70u;
+void write_transform_records(uint8_t scene_id, uint16_t object_id, const glm::vec3& position, const glm::quat& rotation,
+    const glm::vec3& scale, std::vector<uint8_t>& message);
+
+struct sVPETInterestBatch {
+    uint8_t client_id = 0u;
+    // Indices into editables_node_list
+    std::vector<uint32_t> editables;
+};
+
+// Which editables each registered client is interested in, by the world bounds of the editables. A node enters a
+// region when its bounds touch it and leaves once they are hysteresis away from it, so nodes on the border do not
+// flicker in and out while they or the camera move a little. Membership is only evaluated for moved nodes and
+// changed regions, a frame costs moved nodes times clients bound tests.
+class InterestManager {
+
+    struct sClient {
+        bool registered = false;
+        uint64_t lease_start_us = 0u;
+        sVPETInterest interest;
+        // Inside when dot(plane, position) + w >= 0, frustum regions only
+        std::array<glm::vec4, 6> planes;
+        std::vector<uint8_t> members;
+        // Came into the region with a region change since the last collect, sent even when they did not move
+        std::vector<uint32_t> entered;
+    };
+
+    const sVPETContext* vpet = nullptr;
+    std::unordered_map<const sVPETNode*, uint32_t> editable_ids;
+
+    std::array<sClient, 256> clients;
+    std::vector<uint8_t> client_ids;
+
+    std::vector<uint32_t> dirty_editables;
+    std::vector<uint8_t> dirty_flags;
+
+    float hysteresis = 1.0f;
+
+    uint64_t entered_count = 0u;
+    uint64_t left_count = 0u;
+
+    bool is_inside(const sClient& client, const sBVHBounds& bounds, float margin) const;
+    void evaluate_region(sClient& client);
+
+public:
+
+    // Regions are kept over a rebuild, their members are evaluated again on the new context
+    void build(const sVPETContext& vpet);
+    void clear();
+
+    void set_hysteresis(float distance) { hysteresis = distance; }
+    float get_hysteresis() const { return hysteresis; }
+
+    // Shape NONE unregisters the client
+    void set_interest(uint8_t client_id, const sVPETInterest& interest, uint64_t now_us);
+    void remove_client(uint8_t client_id);
+
+    // Unregisters clients whose lease ran out, returns how many
+    uint32_t expire(uint64_t now_us);
+
+    // Moved since the last collect, nodes that are not editable are ignored
+    void mark_dirty(const sVPETNode* vpet_node);
+
+    // One batch per registered client with something to send: its moved members and the nodes that entered its
+    // region. Clears the moved nodes
+    void collect(std::vector<sVPETInterestBatch>& batches);
+
+    uint32_t get_client_count() const { return static_cast<uint32_t>(client_ids.size()); }
+    uint32_t get_member_count(uint8_t client_id) const;
+    uint64_t get_entered_count() const { return entered_count; }
+    uint64_t get_left_count() const { return left_count; }
+};
@@ -0,0 +1,195 @@
+#include "jitter_buffer.h"
+
+#include "framework/nodes/node_3d.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+    glm::quat to_quat(const glm::vec4& value)
+    {
+        return glm::quat(value.w, value.x, value.y, value.z);
+    }
+
+    // t above 1 continues the motion from a to b
+    glm::vec4 blend(JitterBuffer::eChannel channel, const glm::vec4& a, const glm::vec4& b, float t)
+    {
+        if (channel != JitterBuffer::CHANNEL_ROTATION) {
+            return glm::mix(a, b, t);
+        }
+
+        glm::quat rotation_a = to_quat(a);
+        glm::quat rotation_b = to_quat(b);
+
+        // Shortest arc, q and -q are the same rotation
+        if (glm::dot(rotation_a, rotation_b) < 0.0f) {
+            rotation_b = -rotation_b;
+        }
+
+        glm::quat rotation = glm::normalize(glm::slerp(rotation_a, rotation_b, t));
+
+        return glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+    }
+}
+
+void JitterBuffer::push(sVPETNode* vpet_node, eChannel channel_type, const glm::vec4& value, uint64_t time_us)
+{
+    auto it = track_lookup.find(vpet_node);
+
+    if (it == track_lookup.end()) {
+        it = track_lookup.emplace(vpet_node, static_cast<uint32_t>(tracks.size())).first;
+        tracks.emplace_back();
+        tracks.back().vpet_node = vpet_node;
+    }
+
+    sChannel& channel = tracks[it->second].channels[channel_type];
+    sSample* samples = channel.samples;
+
+    // Usually the newest, reordered updates are sorted in
+    uint32_t index = channel.count;
+    while (index > 0u && samples[index - 1u].time_us > time_us) {
+        index--;
+    }
+
+    // Same step of the client clock, the later update wins
+    if (index > 0u && samples[index - 1u].time_us == time_us) {
+        samples[index - 1u].value = value;
+        return;
+    }
+
+    if (channel.count == MAX_SAMPLES) {
+        if (index == 0u) {
+            return;
+        }
+
+        std::copy(samples + 1u, samples + channel.count, samples);
+        channel.count--;
+        index--;
+    }
+
+    std::copy_backward(samples + index, samples + channel.count, samples + channel.count + 1u);
+    samples[index] = { time_us, value };
+    channel.count++;
+}
+
+bool JitterBuffer::evaluate(sChannel& channel, eChannel channel_type, uint64_t render_us, glm::vec4& value) const
+{
+    sSample* samples = channel.samples;
+
+    // The node keeps its current state until the first sample is due
+    if (render_us < samples[0].time_us) {
+        return false;
+    }
+
+    uint32_t index = 0u;
+    while (index + 1u < channel.count && samples[index + 1u].time_us <= render_us) {
+        index++;
+    }
+
+    // Samples before the one shown are done with, but extrapolation needs the one before the last
+    uint32_t first = (index + 1u == channel.count && index > 0u) ? index - 1u : index;
+
+    if (first > 0u) {
+        std::copy(samples + first, samples + channel.count, samples);
+        channel.count -= first;
+        index -= first;
+    }
+
+    const sSample& sample = samples[index];
+
+    if (index + 1u < channel.count) {
+        const sSample& next = samples[index + 1u];
+        float t = static_cast<float>(render_us - sample.time_us) / static_cast<float>(next.time_us - sample.time_us);
+        value = blend(channel_type, sample.value, next.value, t);
+        return true;
+    }
+
+    // Past the last sample
+    if (render_us - sample.time_us >= max_extrapolation_us) {
+        value = sample.value;
+        channel.count = 0u;
+        return true;
+    }
+
+    if (index > 0u && sample.time_us - samples[index - 1u].time_us <= max_extrapolation_gap_us) {
+        const sSample& previous = samples[index - 1u];
+        float t = static_cast<float>(render_us - previous.time_us) / static_cast<float>(sample.time_us - previous.time_us);
+        value = blend(channel_type, previous.value, sample.value, t);
+        return true;
+    }
+
+    value = sample.value;
+    return true;
+}
+
+void JitterBuffer::update(uint64_t now_us, std::vector<sVPETNode*>& moved_nodes)
+{
+    uint64_t render_us = now_us > delay_us ? now_us - delay_us : 0u;
+
+    uint32_t track_idx = 0u;
+
+    while (track_idx < tracks.size()) {
+        sTrack& track = tracks[track_idx];
+        Node3D* node = track.vpet_node->node_ref;
+
+        bool moved = false;
+        bool pending = false;
+
+        for (uint32_t channel_idx = 0u; channel_idx < CHANNEL_COUNT; ++channel_idx) {
+            sChannel& channel = track.channels[channel_idx];
+
+            if (channel.count == 0u) {
+                continue;
+            }
+
+            eChannel channel_type = static_cast<eChannel>(channel_idx);
+            glm::vec4 value;
+
+            if (evaluate(channel, channel_type, render_us, value)) {
+                switch (channel_type) {
+                case CHANNEL_POSITION:
+                    node->set_position(glm::vec3(value));
+                    break;
+                case CHANNEL_ROTATION:
+                    node->set_rotation(to_quat(value));
+                    break;
+                case CHANNEL_SCALE:
+                    node->set_scale(glm::vec3(value));
+                    break;
+                default:
+                    assert(0);
+                }
+
+                moved = true;
+            }
+
+            pending |= channel.count > 0u;
+        }
+
+        if (moved) {
+            moved_nodes.push_back(track.vpet_node);
+        }
+
+        if (pending) {
+            track_idx++;
+            continue;
+        }
+
+        // Settled, swap with the last track
+        track_lookup.erase(track.vpet_node);
+
+        if (track_idx + 1u < tracks.size()) {
+            tracks[track_idx] = tracks.back();
+            track_lookup[tracks[track_idx].vpet_node] = track_idx;
+        }
+
+        tracks.pop_back();
+    }
+}
+
+void JitterBuffer::clear()
+{
+    tracks.clear();
+    track_lookup.clear();
+}
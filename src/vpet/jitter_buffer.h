@@ -0,0 +1,75 @@
+#pragma once
+
+#include "structs.h"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Optional smoothing of remote transform edits. Over Wi-Fi the updates of a drag arrive in bursts, some frames
+// get none and others several, so applying them as they come makes the object stutter. Here every update is
+// stamped and held per node and channel, and each frame the nodes are set to where they were delay_us ago,
+// interpolated between the samples around that time or extrapolated from the last two for a short while.
+class JitterBuffer {
+
+public:
+
+    enum eChannel : uint8_t {
+        CHANNEL_POSITION,
+        CHANNEL_ROTATION,
+        CHANNEL_SCALE,
+        CHANNEL_COUNT
+    };
+
+    // Per channel, the oldest sample is dropped when a new one does not fit
+    static const uint32_t MAX_SAMPLES = 8u;
+
+private:
+
+    struct sSample {
+        uint64_t time_us = 0u;
+        // Vectors in xyz, quaternions as x, y, z, w
+        glm::vec4 value = {};
+    };
+
+    // Sorted by time, empty once the last sample has been applied
+    struct sChannel {
+        sSample samples[MAX_SAMPLES];
+        uint32_t count = 0u;
+    };
+
+    struct sTrack {
+        sVPETNode* vpet_node = nullptr;
+        sChannel channels[CHANNEL_COUNT];
+    };
+
+    std::vector<sTrack> tracks;
+    std::unordered_map<sVPETNode*, uint32_t> track_lookup;
+
+    // False while the channel has nothing to show yet at render_us
+    bool evaluate(sChannel& channel, eChannel channel_type, uint64_t render_us, glm::vec4& value) const;
+
+public:
+
+    // How far in the past the nodes are shown, should cover the update interval and its jitter
+    uint64_t delay_us = 100000u;
+
+    // Past the last sample motion continues this long, then the node settles on the last sample
+    uint64_t max_extrapolation_us = 50000u;
+
+    // Samples further apart than this are a pause, not a motion to continue
+    uint64_t max_extrapolation_gap_us = 250000u;
+
+    // time_us is when the client sent the value, on the engine clock
+    void push(sVPETNode* vpet_node, eChannel channel, const glm::vec4& value, uint64_t time_us);
+
+    // Sets the nodes with samples to their state at now_us - delay_us, moved_nodes gets the ones that were set
+    void update(uint64_t now_us, std::vector<sVPETNode*>& moved_nodes);
+
+    void clear();
+
+    uint32_t get_track_count() const { return static_cast<uint32_t>(tracks.size()); }
+};
@@ -0,0 +1,93 @@
+#include "lock_table.h"
+
+LockTable::sLock& LockTable::get_lock(uint16_t object_id)
+{
+    if (object_id >= locks.size()) {
+        locks.resize(object_id + 1u);
+    }
+
+    return locks[object_id];
+}
+
+bool LockTable::lock(uint16_t object_id, uint8_t client_id, uint64_t now_us, uint8_t& owner)
+{
+    sLock& lock = get_lock(object_id);
+
+    if (lock.locked && lock.owner != client_id && now_us < lock.lease_end_us) {
+        owner = lock.owner;
+        return false;
+    }
+
+    if (!lock.locked) {
+        locked_count++;
+    }
+
+    lock.locked = true;
+    lock.owner = client_id;
+    lock.lease_end_us = now_us + lease_us;
+
+    owner = client_id;
+
+    return true;
+}
+
+bool LockTable::unlock(uint16_t object_id, uint8_t client_id)
+{
+    if (object_id >= locks.size()) {
+        return false;
+    }
+
+    sLock& lock = locks[object_id];
+
+    if (!lock.locked || lock.owner != client_id) {
+        return false;
+    }
+
+    lock.locked = false;
+    locked_count--;
+
+    return true;
+}
+
+bool LockTable::accepts(uint16_t object_id, uint8_t client_id, uint64_t now_us)
+{
+    if (object_id >= locks.size() || !locks[object_id].locked) {
+        return true;
+    }
+
+    sLock& lock = locks[object_id];
+
+    if (lock.owner == client_id) {
+        lock.lease_end_us = now_us + lease_us;
+        return true;
+    }
+
+    // Expired leases are released by expire, until then the object is free to take
+    return now_us >= lock.lease_end_us;
+}
+
+void LockTable::expire(uint64_t now_us, std::vector<sLockChange>& expired)
+{
+    if (locked_count == 0u) {
+        return;
+    }
+
+    for (uint32_t object_idx = 0u; object_idx < locks.size(); ++object_idx) {
+        sLock& lock = locks[object_idx];
+
+        if (!lock.locked || now_us < lock.lease_end_us) {
+            continue;
+        }
+
+        lock.locked = false;
+        locked_count--;
+
+        expired.push_back({ static_cast<uint16_t>(object_idx), lock.owner });
+    }
+}
+
+void LockTable::clear()
+{
+    locks.clear();
+    locked_count = 0u;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Owner of every locked editable node, so only one client at a time moves an object. TRACER clients lock an
+// object while they manipulate it and unlock it when done; updates of anyone else are dropped before they touch
+// the scene. A lock is a lease renewed by its owner's LOCKs and updates, a client that vanished without unlocking
+// loses it after lease_us.
+class LockTable {
+
+public:
+
+    struct sLockChange {
+        uint16_t object_id = 0u;
+        uint8_t owner = 0u;
+    };
+
+private:
+
+    struct sLock {
+        bool locked = false;
+        uint8_t owner = 0u;
+        uint64_t lease_end_us = 0u;
+    };
+
+    // By editable node index
+    std::vector<sLock> locks;
+    uint32_t locked_count = 0u;
+
+    sLock& get_lock(uint16_t object_id);
+
+public:
+
+    uint64_t lease_us = 30000000u;
+
+    // False if another client holds the lock, owner is then that client
+    bool lock(uint16_t object_id, uint8_t client_id, uint64_t now_us, uint8_t& owner);
+
+    // False if the client does not hold the lock
+    bool unlock(uint16_t object_id, uint8_t client_id);
+
+    // Whether an update of the client may be applied, renews the lease of the owner
+    bool accepts(uint16_t object_id, uint8_t client_id, uint64_t now_us);
+
+    // Releases the locks whose lease ran out, expired gets them with their last owner
+    void expire(uint64_t now_us, std::vector<sLockChange>& expired);
+
+    void clear();
+
+    uint32_t get_locked_count() const { return locked_count; }
+};
@@ -0,0 +1,243 @@
+#include "mesh_simplification.h"
+
+#include "engine/job_system.h"
+
+#include "spdlog/spdlog.h"
+
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+    // Meshes below this triangle count are not worth simplifying
+    const uint32_t MIN_LOD_TRIANGLES = 32u;
+
+    struct sCluster {
+        glm::vec3 position = {};
+        glm::vec3 normal = {};
+        glm::vec2 uv = {};
+        uint32_t count = 0u;
+        uint32_t index = 0u;
+    };
+
+    uint64_t get_cell_key(const glm::vec3& position, const glm::vec3& origin, float cell_size)
+    {
+        glm::vec3 cell = glm::floor((position - origin) / cell_size);
+
+        // 21 bits per axis
+        uint64_t x = static_cast<uint64_t>(cell.x) & 0x1FFFFF;
+        uint64_t y = static_cast<uint64_t>(cell.y) & 0x1FFFFF;
+        uint64_t z = static_cast<uint64_t>(cell.z) & 0x1FFFFF;
+
+        return x | (y << 21) | (z << 42);
+    }
+}
+
+void simplify_mesh(const sVPETMesh& mesh, float cell_size, sVPETMesh& simplified_mesh)
+{
+    simplified_mesh.name = mesh.name;
+    simplified_mesh.vertex_array.clear();
+    simplified_mesh.normal_array.clear();
+    simplified_mesh.uv_array.clear();
+    simplified_mesh.index_array.clear();
+
+    if (mesh.vertex_array.empty()) {
+        return;
+    }
+
+    glm::vec3 origin = mesh.vertex_array[0];
+    for (const glm::vec3& position : mesh.vertex_array) {
+        origin = glm::min(origin, position);
+    }
+
+    bool has_normals = mesh.normal_array.size() == mesh.vertex_array.size();
+    bool has_uvs = mesh.uv_array.size() == mesh.vertex_array.size();
+
+    std::unordered_map<uint64_t, uint32_t> cell_to_cluster;
+    std::vector<sCluster> clusters;
+    std::vector<uint32_t> vertex_to_cluster(mesh.vertex_array.size());
+
+    for (uint32_t i = 0u; i < mesh.vertex_array.size(); ++i) {
+        uint64_t key = get_cell_key(mesh.vertex_array[i], origin, cell_size);
+
+        auto it = cell_to_cluster.find(key);
+        uint32_t cluster_idx;
+
+        if (it == cell_to_cluster.end()) {
+            cluster_idx = clusters.size();
+            cell_to_cluster[key] = cluster_idx;
+            clusters.push_back({});
+        }
+        else {
+            cluster_idx = it->second;
+        }
+
+        sCluster& cluster = clusters[cluster_idx];
+        cluster.position += mesh.vertex_array[i];
+        if (has_normals) {
+            cluster.normal += mesh.normal_array[i];
+        }
+        if (has_uvs) {
+            cluster.uv = cluster.uv + mesh.uv_array[i];
+        }
+        cluster.count++;
+
+        vertex_to_cluster[i] = cluster_idx;
+    }
+
+    // Only clusters referenced by a surviving triangle become vertices
+    const uint32_t unused = UINT32_MAX;
+    for (sCluster& cluster : clusters) {
+        cluster.index = unused;
+    }
+
+    for (uint32_t i = 0u; i + 2u < mesh.index_array.size(); i += 3u) {
+        uint32_t c0 = vertex_to_cluster[mesh.index_array[i]];
+        uint32_t c1 = vertex_to_cluster[mesh.index_array[i + 1u]];
+        uint32_t c2 = vertex_to_cluster[mesh.index_array[i + 2u]];
+
+        if (c0 == c1 || c1 == c2 || c0 == c2) {
+            continue;
+        }
+
+        for (uint32_t c : { c0, c1, c2 }) {
+            sCluster& cluster = clusters[c];
+
+            if (cluster.index == unused) {
+                cluster.index = simplified_mesh.vertex_array.size();
+
+                float inv_count = 1.0f / static_cast<float>(cluster.count);
+                simplified_mesh.vertex_array.push_back(cluster.position * inv_count);
+
+                if (has_normals) {
+                    float normal_length = glm::length(cluster.normal);
+                    simplified_mesh.normal_array.push_back(normal_length > 0.0f ? cluster.normal / normal_length : glm::vec3(0.0f, 1.0f, 0.0f));
+                }
+
+                if (has_uvs) {
+                    simplified_mesh.uv_array.push_back(cluster.uv * inv_count);
+                }
+            }
+
+            simplified_mesh.index_array.push_back(cluster.index);
+        }
+    }
+}
+
+void generate_mesh_lods(sVPETMesh& mesh, uint32_t lod_count)
+{
+    mesh.lod_list.clear();
+
+    uint32_t triangle_count = mesh.index_array.size() / 3u;
+
+    // Clustering would drop the skin, skinned meshes are always sent whole
+    if (triangle_count < MIN_LOD_TRIANGLES || mesh.vertex_array.empty() || !mesh.bone_weights_array.empty()) {
+        return;
+    }
+
+    glm::vec3 min_position = mesh.vertex_array[0];
+    glm::vec3 max_position = mesh.vertex_array[0];
+    for (const glm::vec3& position : mesh.vertex_array) {
+        min_position = glm::min(min_position, position);
+        max_position = glm::max(max_position, position);
+    }
+
+    glm::vec3 size = max_position - min_position;
+    float extent = std::max(size.x, std::max(size.y, size.z));
+    if (extent <= 0.0f) {
+        return;
+    }
+
+    // Start with a grid whose cell count is about the vertex count and coarsen it until the target is reached
+    float grid_resolution = std::max(2.0f, std::cbrt(static_cast<float>(mesh.vertex_array.size())) * 2.0f);
+
+    uint32_t previous_triangles = triangle_count;
+
+    for (uint32_t level = 1u; level <= lod_count; ++level) {
+
+        uint32_t target_triangles = previous_triangles / 4u;
+
+        if (target_triangles < MIN_LOD_TRIANGLES / 4u) {
+            break;
+        }
+
+        sVPETMesh lod_mesh;
+
+        while (grid_resolution >= 2.0f) {
+            simplify_mesh(mesh, extent / grid_resolution, lod_mesh);
+
+            if (lod_mesh.index_array.size() / 3u <= target_triangles) {
+                break;
+            }
+
+            grid_resolution *= 0.7f;
+        }
+
+        uint32_t lod_triangles = lod_mesh.index_array.size() / 3u;
+
+        // Stop when the grid can not remove any more triangles
+        if (lod_triangles == 0u || lod_triangles >= previous_triangles) {
+            break;
+        }
+
+        mesh.lod_list.push_back(std::move(lod_mesh));
+        previous_triangles = lod_triangles;
+    }
+}
+
+void generate_context_lods(sVPETContext& vpet, uint32_t lod_count)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Pooled meshes come with their LODs and may be listed twice, each mesh is simplified at most once
+    std::vector<sVPETMesh*> pending_meshes;
+    std::unordered_set<sVPETMesh*> visited_meshes;
+
+    for (sVPETMesh* mesh : vpet.geo_list) {
+        if (mesh->lod_list.empty() && visited_meshes.insert(mesh).second) {
+            pending_meshes.push_back(mesh);
+        }
+    }
+
+    JobSystem::parallel_for(static_cast<uint32_t>(pending_meshes.size()), [&](uint32_t index) {
+        generate_mesh_lods(*pending_meshes[index], lod_count);
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    vpet.lod_count = lod_count;
+    vpet.geos_lod_byte_size.assign(lod_count, 0u);
+
+    uint32_t total_triangles = 0u;
+    std::vector<uint32_t> lod_triangles(lod_count, 0u);
+
+    for (sVPETMesh* mesh : vpet.geo_list) {
+        total_triangles += mesh->index_array.size() / 3u;
+
+        for (uint32_t level = 0u; level < lod_count; ++level) {
+            const sVPETMesh& lod_mesh = mesh->get_lod(level + 1u);
+            vpet.geos_lod_byte_size[level] += get_mesh_byte_size(lod_mesh);
+            lod_triangles[level] += lod_mesh.index_array.size() / 3u;
+        }
+    }
+
+    for (uint32_t level = 0u; level < lod_count; ++level) {
+        spdlog::info("LOD {}: {} triangles of {}, {} bytes", level + 1u, lod_triangles[level], total_triangles, vpet.geos_lod_byte_size[level]);
+    }
+
+    spdlog::info("Mesh LODs generated in {:.2f} ms", std::chrono::duration<float, std::milli>(end - start).count());
+}
+
+uint32_t get_mesh_byte_size(const sVPETMesh& mesh)
+{
+    uint32_t byte_size = 0u;
+
+    byte_size += sizeof(uint32_t) + mesh.vertex_array.size() * sizeof(glm::vec3);
+    byte_size += sizeof(uint32_t) + mesh.index_array.size() * sizeof(uint32_t);
+    byte_size += sizeof(uint32_t) + mesh.normal_array.size() * sizeof(glm::vec3);
+    byte_size += sizeof(uint32_t) + mesh.uv_array.size() * sizeof(glm::vec2);
+    byte_size += sizeof(uint32_t) + mesh.bone_weights_array.size() * (sizeof(glm::vec4) + 4 * sizeof(uint32_t));
+
+    return byte_size;
+}
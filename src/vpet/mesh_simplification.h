@@ -0,0 +1,14 @@
+#pragma once
+
+#include "structs.h"
+
+// Vertex clustering on a uniform grid, cells are cubes of cell_size
+void simplify_mesh(const sVPETMesh& mesh, float cell_size, sVPETMesh& simplified_mesh);
+
+// Fills mesh.lod_list with up to lod_count coarser levels, each one aiming at a quarter of the previous triangle count
+void generate_mesh_lods(sVPETMesh& mesh, uint32_t lod_count);
+
+// Generates the LOD chains of every mesh of the context in parallel and updates the per-level byte sizes
+void generate_context_lods(sVPETContext& vpet, uint32_t lod_count);
+
+uint32_t get_mesh_byte_size(const sVPETMesh& mesh);
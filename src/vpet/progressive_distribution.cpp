@@ -0,0 +1,332 @@
+#include "progressive_distribution.h"
+
+#include "mesh_simplification.h"
+
+#include "framework/nodes/node_3d.h"
+
+#include "spdlog/spdlog.h"
+
+#include <chrono>
+
+namespace {
+
+    // About a third of a second on a 50 Mbit link
+    const uint32_t DEFAULT_CHUNK_SIZE = 2u * 1024u * 1024u;
+    const float DEFAULT_FOV = 60.0f;
+    // Weight of content outside the view cone, still ordered by coverage
+    const float OUT_OF_VIEW_WEIGHT = 0.1f;
+    // Plans past the limit are evicted least recently used first, except those a download asked for recently
+    const uint32_t MAX_CACHED_PLANS = 16u;
+    const uint64_t PLAN_IN_USE_US = 30u * 1000000u;
+
+    uint32_t get_uint_option(const sVPETRequest& request, const std::string& key, uint32_t default_value)
+    {
+        const std::string* value = request.get_option(key);
+        return value ? static_cast<uint32_t>(strtoul(value->c_str(), nullptr, 10)) : default_value;
+    }
+
+    uint64_t get_time_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::string remove_option(const std::string& request, const std::string& option)
+    {
+        size_t option_start = request.find(option);
+        if (option_start == std::string::npos) {
+            return request;
+        }
+
+        size_t option_end = request.find('&', option_start);
+        return request.substr(0, option_start) + (option_end == std::string::npos ? "" : request.substr(option_end + 1));
+    }
+
+    std::string get_plan_key(const std::string& request)
+    {
+        // The request string without its chunk index and plan version
+        return remove_option(remove_option(request, "chunk="), "plan=");
+    }
+
+    // Returns the version of the plan, 0 if there is none
+    uint32_t find_delivery_plan(const sVPETContext& vpet, const std::string& plan_key, uint32_t version, const glm::vec3& eye, const glm::vec3& direction)
+    {
+        auto it = vpet.delivery_plans.find(version);
+
+        if (it != vpet.delivery_plans.end() && it->second.key == plan_key) {
+            return version;
+        }
+
+        // Chunk 0 or a client that does not send the version, any plan from the same viewpoint will do
+        for (const auto& [plan_version, plan] : vpet.delivery_plans) {
+            if (plan.key == plan_key && plan.eye == eye && plan.direction == direction) {
+                return plan_version;
+            }
+        }
+
+        return 0u;
+    }
+
+    void evict_delivery_plan(sVPETContext& vpet, uint64_t now_us)
+    {
+        auto victim = vpet.delivery_plans.end();
+
+        for (auto it = vpet.delivery_plans.begin(); it != vpet.delivery_plans.end(); ++it) {
+            if (now_us - it->second.last_used_us >= PLAN_IN_USE_US &&
+                (victim == vpet.delivery_plans.end() || it->second.last_used_us < victim->second.last_used_us)) {
+                victim = it;
+            }
+        }
+
+        if (victim != vpet.delivery_plans.end()) {
+            vpet.delivery_plans.erase(victim);
+        }
+    }
+
+    uint32_t get_item_byte_size(const sVPETContext& vpet, const sVPETRequest& request, bool meshes, int32_t profile_index, uint32_t item)
+    {
+        if (meshes) {
+            uint32_t lod_level = std::min(get_uint_option(request, "lod", 0u), vpet.lod_count);
+            return get_mesh_byte_size(vpet.geo_list[item]->get_lod(lod_level));
+        }
+
+        const sVPETTexture* texture = vpet.texture_list[item];
+
+        if (profile_index >= 0) {
+            return 5 * sizeof(uint32_t) + texture->variants[profile_index].get_texture_data().size();
+        }
+
+        return 4 * sizeof(uint32_t) + texture->get_texture_data().size();
+    }
+}
+
+bool get_request_viewpoint(const sVPETContext& vpet, const sVPETRequest& request, glm::vec3& eye, glm::vec3& direction)
+{
+    if (const std::string* view = request.get_option("view")) {
+        float values[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+        const char* ptr = view->c_str();
+        for (uint32_t i = 0; i < 6 && *ptr; ++i) {
+            char* end = nullptr;
+            values[i] = strtof(ptr, &end);
+            ptr = (*end == ',') ? end + 1 : end;
+        }
+
+        // Transform from unity coordinate system
+        eye = { values[0], values[1], -values[2] };
+        direction = { values[3], values[4], -values[5] };
+
+        float direction_length = glm::length(direction);
+        direction = direction_length > 0.0f ? direction / direction_length : glm::vec3(0.0f, 0.0f, -1.0f);
+
+        return true;
+    }
+
+    if (const std::string* camera = request.get_option("camera")) {
+        uint32_t camera_index = strtoul(camera->c_str(), nullptr, 10);
+        uint32_t current_index = 0;
+
+        for (sVPETNode* node : vpet.node_list) {
+            if (node->node_type != eVPETNodeType::CAMERA) {
+                continue;
+            }
+
+            if (current_index++ != camera_index) {
+                continue;
+            }
+
+            if (!node->node_ref) {
+                return false;
+            }
+
+            // Copied on the main thread, engine nodes move without the context lock
+            const sVPETCamNode* cam_node = static_cast<const sVPETCamNode*>(node);
+            eye = cam_node->world_eye;
+            direction = cam_node->world_direction;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void compute_delivery_plan(sVPETContext& vpet, const sVPETRequest& request, int32_t profile_index, sVPETDeliveryPlan& plan)
+{
+    const glm::vec3& eye = plan.eye;
+    const glm::vec3& direction = plan.direction;
+
+    bool meshes = request.name == "objects";
+    uint32_t item_count = meshes ? vpet.geo_list.size() : vpet.texture_list.size();
+
+    float fov = glm::radians(static_cast<float>(get_uint_option(request, "fov", static_cast<uint32_t>(DEFAULT_FOV))));
+    float half_fov_cos = cosf(fov * 0.5f);
+
+    // Items that no node references go last
+    std::vector<float> item_scores(item_count, -1.0f);
+
+    for (sVPETNode* node : vpet.node_list) {
+        if (node->node_type != eVPETNodeType::GEO || !node->world_bounds.is_valid()) {
+            continue;
+        }
+
+        sVPETGeoNode* geo_node = static_cast<sVPETGeoNode*>(node);
+
+        glm::vec3 center = node->world_bounds.get_center();
+        float radius = glm::length(node->world_bounds.get_size()) * 0.5f;
+
+        glm::vec3 to_node = center - eye;
+        float distance = glm::max(glm::length(to_node), 0.01f);
+
+        // Bounding sphere size over distance, approximates screen coverage
+        float score = radius / distance;
+
+        bool in_view = distance <= radius || glm::dot(to_node / distance, direction) >= half_fov_cos - radius / distance;
+        if (!in_view) {
+            score *= OUT_OF_VIEW_WEIGHT;
+        }
+
+        if (meshes) {
+            if (geo_node->geo_id >= 0 && geo_node->geo_id < item_count) {
+                item_scores[geo_node->geo_id] = glm::max(item_scores[geo_node->geo_id], score);
+            }
+            continue;
+        }
+
+        if (geo_node->material_id < 0 || geo_node->material_id >= vpet.material_list.size()) {
+            continue;
+        }
+
+        const sVPETMaterial* material = vpet.material_list[geo_node->material_id];
+
+        for (uint32_t i = 0; i < material->texture_ids_size; ++i) {
+            int32_t texture_id = material->texture_ids[i];
+            if (texture_id >= 0 && texture_id < item_count) {
+                item_scores[texture_id] = glm::max(item_scores[texture_id], score);
+            }
+        }
+    }
+
+    plan.order.resize(item_count);
+    for (uint32_t i = 0; i < item_count; ++i) {
+        plan.order[i] = i;
+    }
+
+    std::stable_sort(plan.order.begin(), plan.order.end(), [&](uint32_t a, uint32_t b) {
+        return item_scores[a] > item_scores[b];
+    });
+
+    uint32_t chunk_size = get_uint_option(request, "chunk_size", DEFAULT_CHUNK_SIZE);
+    uint32_t current_chunk_size = 0;
+
+    plan.chunk_starts.clear();
+
+    for (uint32_t i = 0; i < item_count; ++i) {
+        uint32_t item_size = get_item_byte_size(vpet, request, meshes, profile_index, plan.order[i]);
+
+        // Every chunk holds at least one item
+        if (plan.chunk_starts.empty() || current_chunk_size + item_size > chunk_size) {
+            plan.chunk_starts.push_back(i);
+            current_chunk_size = 0;
+        }
+
+        current_chunk_size += item_size;
+    }
+}
+
+uint32_t get_progressive_request_buffer(sVPETContext& vpet, const std::string& request, const sVPETRequest& parsed_request, uint8_t** byte_array)
+{
+    bool meshes = parsed_request.name == "objects";
+
+    std::string plan_key = get_plan_key(request);
+
+    // Resolved once, an unknown profile is reported once per request
+    int32_t profile_index = meshes ? -1 : find_texture_profile(vpet, parsed_request);
+
+    glm::vec3 eye = {};
+    glm::vec3 direction = { 0.0f, 0.0f, -1.0f };
+    bool valid_viewpoint = get_request_viewpoint(vpet, parsed_request, eye, direction);
+
+    uint32_t requested_version = get_uint_option(parsed_request, "plan", 0u);
+    uint64_t now_us = get_time_us();
+
+    uint32_t plan_version = find_delivery_plan(vpet, plan_key, requested_version, eye, direction);
+
+    if (plan_version == 0u) {
+        if (!valid_viewpoint) {
+            spdlog::warn("Chunked request {} without a valid viewpoint, using the origin", request);
+        }
+
+        if (requested_version != 0u) {
+            spdlog::warn("Delivery plan {} of {} is gone, computing a new one", requested_version, plan_key);
+        }
+
+        if (vpet.delivery_plans.size() >= MAX_CACHED_PLANS) {
+            evict_delivery_plan(vpet, now_us);
+        }
+
+        // 0 is never a version, it means none was sent
+        if (++vpet.delivery_plan_version == 0u) {
+            ++vpet.delivery_plan_version;
+        }
+
+        plan_version = vpet.delivery_plan_version;
+
+        sVPETDeliveryPlan& new_plan = vpet.delivery_plans[plan_version];
+        new_plan.key = plan_key;
+        new_plan.eye = eye;
+        new_plan.direction = direction;
+
+        compute_delivery_plan(vpet, parsed_request, profile_index, new_plan);
+    }
+
+    sVPETDeliveryPlan& plan = vpet.delivery_plans[plan_version];
+    plan.last_used_us = now_us;
+
+    uint32_t chunk_count = plan.chunk_starts.size();
+    uint32_t chunk = get_uint_option(parsed_request, "chunk", 0u);
+
+    uint32_t first_item = chunk < chunk_count ? plan.chunk_starts[chunk] : plan.order.size();
+    uint32_t last_item = chunk + 1 < chunk_count ? plan.chunk_starts[chunk + 1] : plan.order.size();
+    uint32_t item_count = last_item - first_item;
+
+    uint32_t byte_array_size = 3 * sizeof(uint32_t);
+    for (uint32_t i = first_item; i < last_item; ++i) {
+        byte_array_size += sizeof(uint32_t) + get_item_byte_size(vpet, parsed_request, meshes, profile_index, plan.order[i]);
+    }
+
+    *byte_array = new uint8_t[byte_array_size];
+
+    uint32_t buffer_ptr = 0;
+
+    memcpy(&(*byte_array)[buffer_ptr], &chunk_count, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&(*byte_array)[buffer_ptr], &plan_version, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&(*byte_array)[buffer_ptr], &item_count, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    uint32_t lod_level = std::min(get_uint_option(parsed_request, "lod", 0u), vpet.lod_count);
+
+    for (uint32_t i = first_item; i < last_item; ++i) {
+        uint32_t item = plan.order[i];
+
+        memcpy(&(*byte_array)[buffer_ptr], &item, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        if (meshes) {
+            write_mesh(vpet.geo_list[item]->get_lod(lod_level), *byte_array, buffer_ptr);
+        }
+        else if (profile_index >= 0) {
+            write_texture_variant(vpet.texture_list[item]->variants[profile_index], *byte_array, buffer_ptr);
+        }
+        else {
+            write_texture(*vpet.texture_list[item], *byte_array, buffer_ptr);
+        }
+    }
+
+    assert(buffer_ptr == byte_array_size);
+
+    return byte_array_size;
+}
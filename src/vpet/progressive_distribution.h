@@ -0,0 +1,19 @@
+#pragma once
+
+#include "scene_distribution.h"
+
+// Chunked "objects" and "textures" requests, ordered by what is visible from a viewpoint:
+//   objects?view=px,py,pz,dx,dy,dz&chunk=0
+//   textures?camera=1&chunk=0&profile=mobile
+// The viewpoint is in TRACER coordinates, or the index of a scene camera. Clients request
+// "nodes" and "materials" first, then chunks until the count in the reply is reached.
+// Reply: chunk count, plan version, item count, then per item its geo/texture id and the usual record.
+// The following chunks pass the version back, plan=3, and keep the order of the first one even if the
+// camera moved meanwhile; without it a camera plan is recomputed once the camera moved.
+
+bool get_request_viewpoint(const sVPETContext& vpet, const sVPETRequest& request, glm::vec3& eye, glm::vec3& direction);
+
+// profile_index as resolved by find_texture_profile for the request
+void compute_delivery_plan(sVPETContext& vpet, const sVPETRequest& request, int32_t profile_index, sVPETDeliveryPlan& plan);
+
+uint32_t get_progressive_request_buffer(sVPETContext& vpet, const std::string& request, const sVPETRequest& parsed_request, uint8_t** byte_array);
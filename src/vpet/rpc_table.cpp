@@ -0,0 +1,194 @@
+#include "rpc_table.h"
+
+namespace {
+
+    // Scene id, object id, parameter id, type and value length
+    const uint32_t CALL_HEADER_SIZE = 10u;
+}
+
+RPCTable::sParameter* RPCTable::find_parameter(uint16_t object_id, uint16_t parameter_id)
+{
+    if (object_id == 0u || object_id > objects.size()) {
+        return nullptr;
+    }
+
+    sObject& object = objects[object_id - 1u];
+
+    return parameter_id < object.parameters.size() ? &object.parameters[parameter_id] : nullptr;
+}
+
+uint16_t RPCTable::add_object(const std::string& name)
+{
+    objects.push_back({ name });
+    dirty = true;
+
+    return static_cast<uint16_t>(objects.size());
+}
+
+uint32_t RPCTable::dispatch(const uint8_t* buffer, uint32_t msg_size, uint32_t& rejected)
+{
+    uint32_t call_count = 0u;
+
+    // After the message header
+    uint32_t buffer_ptr = 3u;
+
+    while (buffer_ptr + CALL_HEADER_SIZE <= msg_size) {
+        // The scene id is the engine's, parameter objects are not per scene
+        buffer_ptr += sizeof(uint8_t);
+
+        uint16_t object_id;
+        memcpy(&object_id, &buffer[buffer_ptr], sizeof(uint16_t));
+        buffer_ptr += sizeof(uint16_t);
+
+        uint16_t parameter_id;
+        memcpy(&parameter_id, &buffer[buffer_ptr], sizeof(uint16_t));
+        buffer_ptr += sizeof(uint16_t);
+
+        sVPETParameterValue value;
+        value.type = static_cast<eVPETParameterType>(buffer[buffer_ptr]);
+        buffer_ptr += sizeof(uint8_t);
+
+        memcpy(&value.length, &buffer[buffer_ptr], sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        // Truncated, nothing after it can be trusted
+        if (value.length > msg_size - buffer_ptr) {
+            rejected++;
+            break;
+        }
+
+        value.data = &buffer[buffer_ptr];
+        buffer_ptr += value.length;
+
+        sParameter* parameter = find_parameter(object_id, parameter_id);
+
+        // Capacity of the previous value is reused
+        if (!parameter || !parameter->handler || !parameter->handler(value, parameter->value)) {
+            rejected++;
+            continue;
+        }
+
+        dirty = true;
+
+        call_count++;
+    }
+
+    return call_count;
+}
+
+void RPCTable::write_call(uint8_t scene_id, uint16_t object_id, uint16_t parameter_id, std::vector<uint8_t>& message) const
+{
+    assert(object_id > 0u && object_id <= objects.size() && parameter_id < objects[object_id - 1u].parameters.size());
+
+    const sParameter& parameter = objects[object_id - 1u].parameters[parameter_id];
+
+    uint32_t buffer_ptr = message.size();
+    message.resize(buffer_ptr + CALL_HEADER_SIZE + parameter.value.size());
+
+    message[buffer_ptr] = scene_id;
+    buffer_ptr += sizeof(uint8_t);
+
+    memcpy(&message[buffer_ptr], &object_id, sizeof(uint16_t));
+    buffer_ptr += sizeof(uint16_t);
+
+    memcpy(&message[buffer_ptr], &parameter_id, sizeof(uint16_t));
+    buffer_ptr += sizeof(uint16_t);
+
+    message[buffer_ptr] = static_cast<uint8_t>(parameter.type);
+    buffer_ptr += sizeof(uint8_t);
+
+    uint32_t length = parameter.value.size();
+    memcpy(&message[buffer_ptr], &length, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&message[buffer_ptr], parameter.value.data(), length);
+}
+
+void RPCTable::publish(sVPETContext& vpet, uint8_t scene_id)
+{
+    vpet.clean_parameter_objects();
+
+    for (uint32_t object_idx = 0u; object_idx < objects.size(); ++object_idx) {
+        const sObject& object = objects[object_idx];
+
+        sVPETParameterObject* parameter_object = new sVPETParameterObject();
+        parameter_object->scene_id = scene_id;
+        parameter_object->object_id = static_cast<uint16_t>(object_idx + 1u);
+        parameter_object->name = object.name;
+
+        for (const sParameter& parameter : object.parameters) {
+            parameter_object->parameters.push_back({ parameter.name, parameter.type, parameter.rpc, parameter.value });
+        }
+
+        vpet.parameter_object_list.push_back(parameter_object);
+    }
+
+    vpet.parameter_objects_byte_size = get_parameter_objects_byte_size(vpet.parameter_object_list);
+
+    dirty = false;
+}
+
+uint32_t get_parameter_objects_byte_size(const std::vector<sVPETParameterObject*>& parameter_objects)
+{
+    uint32_t byte_size = sizeof(uint32_t);
+
+    for (const sVPETParameterObject* parameter_object : parameter_objects) {
+        // Scene id, object id, name size and chars, parameter count
+        byte_size += sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint32_t) + parameter_object->name.size() + sizeof(uint16_t);
+
+        for (const sVPETParameter& parameter : parameter_object->parameters) {
+            // Type, rpc flag, name size and chars, value length and bytes
+            byte_size += 2u * sizeof(uint8_t) + sizeof(uint32_t) + parameter.name.size() + sizeof(uint32_t) + parameter.value.size();
+        }
+    }
+
+    return byte_size;
+}
+
+void write_parameter_objects(const std::vector<sVPETParameterObject*>& parameter_objects, uint8_t* byte_array, uint32_t& buffer_ptr)
+{
+    uint32_t object_count = parameter_objects.size();
+    memcpy(&byte_array[buffer_ptr], &object_count, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    for (const sVPETParameterObject* parameter_object : parameter_objects) {
+        byte_array[buffer_ptr] = parameter_object->scene_id;
+        buffer_ptr += sizeof(uint8_t);
+
+        memcpy(&byte_array[buffer_ptr], &parameter_object->object_id, sizeof(uint16_t));
+        buffer_ptr += sizeof(uint16_t);
+
+        uint32_t name_size = parameter_object->name.size();
+        memcpy(&byte_array[buffer_ptr], &name_size, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        memcpy(&byte_array[buffer_ptr], parameter_object->name.data(), name_size);
+        buffer_ptr += name_size;
+
+        uint16_t parameter_count = parameter_object->parameters.size();
+        memcpy(&byte_array[buffer_ptr], &parameter_count, sizeof(uint16_t));
+        buffer_ptr += sizeof(uint16_t);
+
+        for (const sVPETParameter& parameter : parameter_object->parameters) {
+            byte_array[buffer_ptr] = static_cast<uint8_t>(parameter.type);
+            buffer_ptr += sizeof(uint8_t);
+
+            byte_array[buffer_ptr] = parameter.rpc ? 1u : 0u;
+            buffer_ptr += sizeof(uint8_t);
+
+            name_size = parameter.name.size();
+            memcpy(&byte_array[buffer_ptr], &name_size, sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            memcpy(&byte_array[buffer_ptr], parameter.name.data(), name_size);
+            buffer_ptr += name_size;
+
+            uint32_t value_length = parameter.value.size();
+            memcpy(&byte_array[buffer_ptr], &value_length, sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            memcpy(&byte_array[buffer_ptr], parameter.value.data(), value_length);
+            buffer_ptr += value_length;
+        }
+    }
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "structs.h"
+
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+
+// "parameterobjects" answers the scene wide controls of the engine:
+//   object count, then per object its scene id, object id (uint16), name (size and chars) and parameter count
+//   (uint16), and per parameter its type, rpc flag, name (size and chars) and current value (length and bytes).
+// Parameter ids are the order of the parameters in their object.
+//
+// RPC messages call them, as many calls per message as fit, each laid out as a parameter update:
+//   header, then per call scene id, object id (uint16), parameter id (uint16), type, value length (uint32), value
+// Values as in PARAMETER_UPDATE, bools take one byte, ints are int32 and strings are not terminated.
+
+// No value, for parameters that only trigger something
+struct sVPETAction {};
+
+// Value of a call, pointing into the message it came in
+struct sVPETParameterValue {
+    eVPETParameterType type = eVPETParameterType::NONE;
+    const uint8_t* data = nullptr;
+    uint32_t length = 0u;
+};
+
+template<typename T>
+struct sVPETParameterTraits;
+
+template<> struct sVPETParameterTraits<sVPETAction> { static constexpr eVPETParameterType type = eVPETParameterType::ACTION; };
+template<> struct sVPETParameterTraits<bool> { static constexpr eVPETParameterType type = eVPETParameterType::BOOL; };
+template<> struct sVPETParameterTraits<int32_t> { static constexpr eVPETParameterType type = eVPETParameterType::INT; };
+template<> struct sVPETParameterTraits<float> { static constexpr eVPETParameterType type = eVPETParameterType::FLOAT; };
+template<> struct sVPETParameterTraits<glm::vec2> { static constexpr eVPETParameterType type = eVPETParameterType::VECTOR2; };
+template<> struct sVPETParameterTraits<glm::vec3> { static constexpr eVPETParameterType type = eVPETParameterType::VECTOR3; };
+template<> struct sVPETParameterTraits<glm::vec4> { static constexpr eVPETParameterType type = eVPETParameterType::VECTOR4; };
+template<> struct sVPETParameterTraits<glm::quat> { static constexpr eVPETParameterType type = eVPETParameterType::QUATERNION; };
+template<> struct sVPETParameterTraits<std::string_view> { static constexpr eVPETParameterType type = eVPETParameterType::STRING; };
+
+// Decodes without copying more than the value itself, false when the call does not carry a T
+template<typename T>
+bool read_parameter_value(const sVPETParameterValue& value, T& decoded)
+{
+    if (value.type != sVPETParameterTraits<T>::type) {
+        return false;
+    }
+
+    if constexpr (std::is_same_v<T, sVPETAction>) {
+        return true;
+    }
+    else if constexpr (std::is_same_v<T, std::string_view>) {
+        decoded = std::string_view(reinterpret_cast<const char*>(value.data), value.length);
+        return true;
+    }
+    else if constexpr (std::is_same_v<T, bool>) {
+        if (value.length < 1u) {
+            return false;
+        }
+        decoded = value.data[0] != 0u;
+        return true;
+    }
+    else {
+        if (value.length < sizeof(T)) {
+            return false;
+        }
+        memcpy(&decoded, value.data, sizeof(T));
+        return true;
+    }
+}
+
+template<typename T>
+void write_parameter_value(const T& value, std::vector<uint8_t>& bytes)
+{
+    if constexpr (std::is_same_v<T, sVPETAction>) {
+        bytes.clear();
+    }
+    else if constexpr (std::is_same_v<T, std::string_view>) {
+        bytes.assign(value.begin(), value.end());
+    }
+    else if constexpr (std::is_same_v<T, bool>) {
+        bytes.assign(1u, value ? 1u : 0u);
+    }
+    else {
+        bytes.resize(sizeof(T));
+        memcpy(bytes.data(), &value, sizeof(T));
+    }
+}
+
+// Scene wide controls and the handlers their RPCs go to. Everything is registered once at startup, a call is
+// found by object and parameter id with two index lookups and its value reaches the typed handler straight from
+// the message buffer. Handlers run on the thread that dispatches, the render thread, and return the value they
+// applied, e.g. clamped, which is what the parameter keeps.
+class RPCTable {
+
+    struct sParameter {
+        std::string name;
+        eVPETParameterType type = eVPETParameterType::NONE;
+        bool rpc = true;
+        // Last applied value, bytes as on the wire
+        std::vector<uint8_t> value;
+        // Writes the applied value to its second argument, untouched when the call does not decode
+        std::function<bool(const sVPETParameterValue&, std::vector<uint8_t>&)> handler;
+    };
+
+    struct sObject {
+        std::string name;
+        std::vector<sParameter> parameters;
+    };
+
+    std::vector<sObject> objects;
+
+    // Values changed since the last publish
+    bool dirty = true;
+
+    sParameter* find_parameter(uint16_t object_id, uint16_t parameter_id);
+
+public:
+
+    // Returns the object id, one based as the scene objects
+    uint16_t add_object(const std::string& name);
+
+    template<typename T>
+    uint16_t add_parameter(uint16_t object_id, const std::string& name, const T& initial_value, std::function<T(const T&)> handler)
+    {
+        assert(object_id > 0u && object_id <= objects.size());
+
+        sObject& object = objects[object_id - 1u];
+
+        sParameter& parameter = object.parameters.emplace_back();
+        parameter.name = name;
+        parameter.type = sVPETParameterTraits<T>::type;
+        parameter.rpc = static_cast<bool>(handler);
+        write_parameter_value(initial_value, parameter.value);
+
+        if (handler) {
+            parameter.handler = [handler = std::move(handler)](const sVPETParameterValue& value, std::vector<uint8_t>& applied) {
+                T decoded = {};
+                if (!read_parameter_value(value, decoded)) {
+                    return false;
+                }
+                write_parameter_value(handler(decoded), applied);
+                return true;
+            };
+        }
+
+        dirty = true;
+
+        return static_cast<uint16_t>(object.parameters.size() - 1u);
+    }
+
+    // Runs every call of an RPC message, rejected counts calls to unknown parameters or with the wrong type.
+    // Returns the calls that reached their handler
+    uint32_t dispatch(const uint8_t* buffer, uint32_t msg_size, uint32_t& rejected);
+
+    // Calls the handler as an RPC would and keeps the applied value, for changes made on the engine
+    template<typename T>
+    bool call(uint16_t object_id, uint16_t parameter_id, const T& value)
+    {
+        sParameter* parameter = find_parameter(object_id, parameter_id);
+
+        if (!parameter || parameter->type != sVPETParameterTraits<T>::type || !parameter->handler) {
+            return false;
+        }
+
+        std::vector<uint8_t> bytes;
+        write_parameter_value(value, bytes);
+
+        if (!parameter->handler({ parameter->type, bytes.data(), static_cast<uint32_t>(bytes.size()) }, parameter->value)) {
+            return false;
+        }
+
+        dirty = true;
+
+        return true;
+    }
+
+    // Appends the call of a parameter with its current value to an RPC message
+    void write_call(uint8_t scene_id, uint16_t object_id, uint16_t parameter_id, std::vector<uint8_t>& message) const;
+
+    // Rebuilds the parameter objects of the context, callers hold the context exclusively
+    void publish(sVPETContext& vpet, uint8_t scene_id);
+
+    bool is_dirty() const { return dirty; }
+};
+
+uint32_t get_parameter_objects_byte_size(const std::vector<sVPETParameterObject*>& parameter_objects);
+void write_parameter_objects(const std::vector<sVPETParameterObject*>& parameter_objects, uint8_t* byte_array, uint32_t& buffer_ptr);
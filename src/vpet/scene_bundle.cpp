@@ -0,0 +1,195 @@
+#include "scene_bundle.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+    struct sBundlePartDesc {
+        const char* name = nullptr;
+        // The only request option that changes the part
+        const char* option = nullptr;
+        bool cached = false;
+    };
+
+    // Every profile and LOD is a full copy of its part, the cache keeps the most recently sent within this
+    const uint64_t BUNDLE_CACHE_MAX_BYTES = 256ull << 20;
+
+    const sBundlePartDesc BUNDLE_PARTS[] = {
+        { "header", "profiles", false },
+        { "materials", nullptr, true },
+        { "textures", "profile", true },
+        { "objects", "lod", true },
+        { "nodes", nullptr, false },
+        { "characters", nullptr, true },
+        { "curve", nullptr, true },
+        { "parameterobjects", nullptr, false },
+    };
+
+    // Profiles and LODs are resolved as the part would resolve them, so cached parts are keyed by what they hold
+    // and not by whatever text the client sent
+    std::string get_part_request(const sVPETContext& vpet, const sBundlePartDesc& desc, const sVPETRequest& request)
+    {
+        std::string part_request = desc.name;
+
+        if (!desc.option) {
+            return part_request;
+        }
+
+        const std::string* value = request.get_option(desc.option);
+
+        if (!value) {
+            return part_request;
+        }
+
+        if (strcmp(desc.option, "profile") == 0) {
+            int32_t profile_index = find_texture_profile(vpet, request);
+
+            if (profile_index >= 0) {
+                part_request += "?profile=" + vpet.texture_profiles[profile_index].name;
+            }
+        }
+        else if (strcmp(desc.option, "lod") == 0) {
+            uint32_t lod_level = std::min(static_cast<uint32_t>(strtoul(value->c_str(), nullptr, 10)), vpet.lod_count);
+
+            if (lod_level > 0u) {
+                part_request += "?lod=" + std::to_string(lod_level);
+            }
+        }
+        else {
+            part_request += std::string("?") + desc.option;
+
+            if (!value->empty()) {
+                part_request += "=" + *value;
+            }
+        }
+
+        return part_request;
+    }
+
+    void serialize_part(sVPETContext& vpet, const std::string& part_request, std::vector<uint8_t>& data)
+    {
+        uint8_t* byte_array = nullptr;
+        uint32_t byte_array_size = get_scene_request_buffer(nullptr, part_request, vpet, &byte_array);
+
+        data.assign(byte_array, byte_array + byte_array_size);
+
+        if (byte_array) {
+            delete[] byte_array;
+        }
+    }
+
+    // Drops least recently sent parts until size fits, never those of the request being built since its parts
+    // point into them. False when the part does not fit and is not cached
+    bool make_bundle_cache_room(sVPETContext& vpet, uint64_t size, uint64_t request_index)
+    {
+        if (size > BUNDLE_CACHE_MAX_BYTES) {
+            return false;
+        }
+
+        while (vpet.bundle_parts_byte_size + size > BUNDLE_CACHE_MAX_BYTES) {
+            auto victim = vpet.bundle_parts.end();
+
+            for (auto it = vpet.bundle_parts.begin(); it != vpet.bundle_parts.end(); ++it) {
+                if (it->second.last_used < request_index && (victim == vpet.bundle_parts.end() || it->second.last_used < victim->second.last_used)) {
+                    victim = it;
+                }
+            }
+
+            if (victim == vpet.bundle_parts.end()) {
+                return false;
+            }
+
+            vpet.bundle_parts_byte_size -= victim->second.data.size();
+            vpet.bundle_parts.erase(victim);
+        }
+
+        return true;
+    }
+}
+
+void get_bundle_parts(sVPETContext& vpet, const sVPETRequest& request, std::vector<sVPETBundlePart>& parts)
+{
+    const uint32_t part_count = sizeof(BUNDLE_PARTS) / sizeof(BUNDLE_PARTS[0]);
+
+    parts.clear();
+    parts.resize(part_count + 1u);
+
+    uint64_t request_index = ++vpet.bundle_request_count;
+
+    for (uint32_t i = 0u; i < part_count; ++i) {
+        const sBundlePartDesc& desc = BUNDLE_PARTS[i];
+        sVPETBundlePart& part = parts[i + 1u];
+
+        part.name = desc.name;
+
+        std::string part_request = get_part_request(vpet, desc, request);
+
+        auto it = desc.cached ? vpet.bundle_parts.find(part_request) : vpet.bundle_parts.end();
+
+        if (it != vpet.bundle_parts.end()) {
+            it->second.last_used = request_index;
+
+            part.data = it->second.data.data();
+            part.size = it->second.data.size();
+            continue;
+        }
+
+        serialize_part(vpet, part_request, part.owned);
+
+        if (desc.cached && make_bundle_cache_room(vpet, part.owned.size(), request_index)) {
+            vpet.bundle_parts_byte_size += part.owned.size();
+            it = vpet.bundle_parts.emplace(part_request, sVPETBundleCacheEntry{ std::move(part.owned), request_index }).first;
+
+            part.data = it->second.data.data();
+            part.size = it->second.data.size();
+        }
+        else {
+            part.data = part.owned.data();
+            part.size = part.owned.size();
+        }
+    }
+
+    sVPETBundlePart& manifest = parts[0];
+    manifest.name = "manifest";
+
+    uint32_t manifest_size = sizeof(uint32_t);
+    for (uint32_t i = 1u; i < parts.size(); ++i) {
+        manifest_size += 3 * sizeof(uint32_t) + parts[i].name.size();
+    }
+
+    manifest.owned.resize(manifest_size);
+
+    uint8_t* byte_array = manifest.owned.data();
+    uint32_t buffer_ptr = 0u;
+
+    memcpy(&byte_array[buffer_ptr], &part_count, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    uint32_t offset = 0u;
+
+    for (uint32_t i = 1u; i < parts.size(); ++i) {
+        const sVPETBundlePart& part = parts[i];
+
+        uint32_t name_size = part.name.size();
+        memcpy(&byte_array[buffer_ptr], &name_size, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        memcpy(&byte_array[buffer_ptr], part.name.data(), name_size);
+        buffer_ptr += name_size;
+
+        memcpy(&byte_array[buffer_ptr], &offset, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        memcpy(&byte_array[buffer_ptr], &part.size, sizeof(uint32_t));
+        buffer_ptr += sizeof(uint32_t);
+
+        offset += part.size;
+    }
+
+    assert(buffer_ptr == manifest_size);
+
+    manifest.data = manifest.owned.data();
+    manifest.size = manifest.owned.size();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "scene_distribution.h"
+
+// "bundle" answers the whole join handshake in one multipart reply, options go to the parts they affect:
+//   bundle?profiles&profile=mobile&lod=2
+// Part 0 is the manifest: part count, then per part its name size, name, offset and byte size, offsets as if
+// the parts were concatenated. Then header, materials, textures, objects, nodes, characters, curve and
+// parameterobjects, each as its own request would have answered. Materials, textures, objects, characters and curve
+// do not change after load, they are built once per scene and resolved profile or LOD, and kept up to a byte
+// budget with the least recently sent dropped first; header, nodes and parameterobjects are built per request
+// since nodes follow the parameter updates and parameter objects the RPCs.
+
+struct sVPETBundlePart {
+    std::string name;
+    const uint8_t* data = nullptr;
+    uint32_t size = 0u;
+
+    // Backs data for parts built for this request only
+    std::vector<uint8_t> owned;
+};
+
+void get_bundle_parts(sVPETContext& vpet, const sVPETRequest& request, std::vector<sVPETBundlePart>& parts);
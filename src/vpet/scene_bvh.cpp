@@ -0,0 +1,407 @@
+#include "scene_bvh.h"
+
+#include "framework/nodes/mesh_instance_3d.h"
+
+#include <algorithm>
+
+namespace {
+
+    // Tolerated growth of the root surface area since the last build
+    const float MAX_REFIT_GROWTH = 2.0f;
+
+    // Below the 64 entries of the traversal stack
+    const uint32_t MAX_INSERT_DEPTH = 48u;
+}
+
+float sBVHBounds::get_surface_area() const
+{
+    if (!is_valid()) {
+        return 0.0f;
+    }
+
+    glm::vec3 size = get_size();
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void sBVHBounds::extend(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void sBVHBounds::extend(const sBVHBounds& bounds)
+{
+    min = glm::min(min, bounds.min);
+    max = glm::max(max, bounds.max);
+}
+
+bool sBVHBounds::intersects(const sBVHBounds& bounds) const
+{
+    return min.x <= bounds.max.x && max.x >= bounds.min.x &&
+           min.y <= bounds.max.y && max.y >= bounds.min.y &&
+           min.z <= bounds.max.z && max.z >= bounds.min.z;
+}
+
+float sBVHBounds::distance_squared(const glm::vec3& point) const
+{
+    glm::vec3 closest = glm::clamp(point, min, max);
+    glm::vec3 delta = point - closest;
+    return glm::dot(delta, delta);
+}
+
+sBVHBounds get_world_bounds(Node3D* node)
+{
+    sBVHBounds bounds;
+
+    if (dynamic_cast<MeshInstance3D*>(node)) {
+        AABB aabb = node->get_aabb();
+        bounds.min = aabb.center - aabb.half_size;
+        bounds.max = aabb.center + aabb.half_size;
+    }
+    else {
+        glm::vec3 position = glm::vec3(node->get_global_model()[3]);
+        bounds.min = position;
+        bounds.max = position;
+    }
+
+    return bounds;
+}
+
+void SceneBVH::build(const std::vector<sBVHBounds>& item_bounds)
+{
+    clear();
+
+    if (item_bounds.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> items(item_bounds.size());
+    for (uint32_t i = 0u; i < items.size(); ++i) {
+        items[i] = i;
+    }
+
+    nodes.reserve(item_bounds.size() * 2u - 1u);
+    item_leaves.resize(item_bounds.size(), -1);
+
+    root = build_recursive(items, 0u, items.size(), -1, item_bounds);
+    build_surface_area = nodes[root].bounds.get_surface_area();
+}
+
+int32_t SceneBVH::build_recursive(std::vector<uint32_t>& items, uint32_t begin, uint32_t end, int32_t parent, const std::vector<sBVHBounds>& item_bounds)
+{
+    int32_t node_idx = nodes.size();
+    nodes.push_back({});
+    nodes[node_idx].parent = parent;
+
+    if (end - begin == 1u) {
+        uint32_t item = items[begin];
+        nodes[node_idx].item = item;
+        nodes[node_idx].bounds = item_bounds[item];
+        item_leaves[item] = node_idx;
+        return node_idx;
+    }
+
+    // Median split of the centers along the longest axis
+    sBVHBounds center_bounds;
+    for (uint32_t i = begin; i < end; ++i) {
+        center_bounds.extend(item_bounds[items[i]].get_center());
+    }
+
+    glm::vec3 size = center_bounds.get_size();
+    int axis = 0;
+    if (size.y > size.x) {
+        axis = 1;
+    }
+    if (size.z > size[axis]) {
+        axis = 2;
+    }
+
+    uint32_t middle = begin + (end - begin) / 2u;
+
+    std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end, [&](uint32_t a, uint32_t b) {
+        return item_bounds[a].get_center()[axis] < item_bounds[b].get_center()[axis];
+    });
+
+    int32_t left = build_recursive(items, begin, middle, node_idx, item_bounds);
+    int32_t right = build_recursive(items, middle, end, node_idx, item_bounds);
+
+    sBVHNode& node = nodes[node_idx];
+    node.left = left;
+    node.right = right;
+    node.bounds = nodes[left].bounds;
+    node.bounds.extend(nodes[right].bounds);
+
+    return node_idx;
+}
+
+void SceneBVH::clear()
+{
+    nodes.clear();
+    item_leaves.clear();
+    free_nodes.clear();
+    free_items.clear();
+    root = -1;
+    build_surface_area = 0.0f;
+    too_deep = false;
+}
+
+void SceneBVH::update_item(uint32_t item, const sBVHBounds& bounds)
+{
+    if (item >= item_leaves.size() || item_leaves[item] < 0) {
+        return;
+    }
+
+    int32_t leaf_idx = item_leaves[item];
+    nodes[leaf_idx].bounds = bounds;
+
+    refit_ancestors(nodes[leaf_idx].parent);
+}
+
+void SceneBVH::refit_ancestors(int32_t node_idx)
+{
+    while (node_idx >= 0) {
+        sBVHNode& node = nodes[node_idx];
+
+        sBVHBounds bounds = nodes[node.left].bounds;
+        bounds.extend(nodes[node.right].bounds);
+
+        // Nothing above changes when the bounds stay the same
+        if (bounds.min == node.bounds.min && bounds.max == node.bounds.max) {
+            return;
+        }
+
+        node.bounds = bounds;
+        node_idx = node.parent;
+    }
+}
+
+bool SceneBVH::is_degraded() const
+{
+    if (too_deep) {
+        return true;
+    }
+
+    if (root < 0 || build_surface_area <= 0.0f) {
+        return false;
+    }
+
+    return nodes[root].bounds.get_surface_area() > build_surface_area * MAX_REFIT_GROWTH;
+}
+
+int32_t SceneBVH::allocate_node()
+{
+    if (free_nodes.empty()) {
+        nodes.push_back({});
+        return nodes.size() - 1;
+    }
+
+    int32_t node_idx = free_nodes.back();
+    free_nodes.pop_back();
+    nodes[node_idx] = {};
+
+    return node_idx;
+}
+
+void SceneBVH::replace_child(int32_t parent, int32_t child, int32_t new_child)
+{
+    if (parent < 0) {
+        root = new_child;
+    }
+    else if (nodes[parent].left == child) {
+        nodes[parent].left = new_child;
+    }
+    else {
+        nodes[parent].right = new_child;
+    }
+
+    if (new_child >= 0) {
+        nodes[new_child].parent = parent;
+    }
+}
+
+uint32_t SceneBVH::insert_item(const sBVHBounds& bounds)
+{
+    uint32_t item = item_leaves.size();
+
+    if (!free_items.empty()) {
+        item = free_items.back();
+        free_items.pop_back();
+    }
+    else {
+        item_leaves.push_back(-1);
+    }
+
+    int32_t leaf_idx = allocate_node();
+    nodes[leaf_idx].bounds = bounds;
+    nodes[leaf_idx].item = item;
+    item_leaves[item] = leaf_idx;
+
+    if (root < 0) {
+        root = leaf_idx;
+        build_surface_area = std::max(build_surface_area, bounds.get_surface_area());
+        return item;
+    }
+
+    // Walk down while pairing with a child is cheaper than pairing with the node, every node passed grows
+    int32_t sibling = root;
+    uint32_t depth = 1u;
+
+    while (!nodes[sibling].is_leaf()) {
+        const sBVHNode& node = nodes[sibling];
+
+        sBVHBounds combined = node.bounds;
+        combined.extend(bounds);
+
+        float pair_cost = 2.0f * combined.get_surface_area();
+        float inherited_cost = 2.0f * (combined.get_surface_area() - node.bounds.get_surface_area());
+
+        auto get_child_cost = [&](int32_t child_idx) {
+            sBVHBounds child_combined = nodes[child_idx].bounds;
+            child_combined.extend(bounds);
+
+            float cost = child_combined.get_surface_area();
+            if (!nodes[child_idx].is_leaf()) {
+                cost -= nodes[child_idx].bounds.get_surface_area();
+            }
+
+            return cost + inherited_cost;
+        };
+
+        float left_cost = get_child_cost(node.left);
+        float right_cost = get_child_cost(node.right);
+
+        if (pair_cost < left_cost && pair_cost < right_cost) {
+            break;
+        }
+
+        sibling = left_cost < right_cost ? node.left : node.right;
+        depth++;
+    }
+
+    int32_t old_parent = nodes[sibling].parent;
+    int32_t new_parent = allocate_node();
+
+    nodes[new_parent].left = sibling;
+    nodes[new_parent].right = leaf_idx;
+    nodes[new_parent].bounds = nodes[sibling].bounds;
+    nodes[new_parent].bounds.extend(bounds);
+
+    replace_child(old_parent, sibling, new_parent);
+    nodes[sibling].parent = new_parent;
+    nodes[leaf_idx].parent = new_parent;
+
+    refit_ancestors(old_parent);
+
+    // The root grows with what was inserted, only later refits count as degradation
+    build_surface_area = std::max(build_surface_area, nodes[root].bounds.get_surface_area());
+    too_deep = too_deep || depth + 1u > MAX_INSERT_DEPTH;
+
+    return item;
+}
+
+void SceneBVH::remove_item(uint32_t item)
+{
+    if (item >= item_leaves.size() || item_leaves[item] < 0) {
+        return;
+    }
+
+    int32_t leaf_idx = item_leaves[item];
+    int32_t parent = nodes[leaf_idx].parent;
+
+    item_leaves[item] = -1;
+    free_items.push_back(item);
+    free_nodes.push_back(leaf_idx);
+
+    if (parent < 0) {
+        root = -1;
+        return;
+    }
+
+    // The sibling takes the place of the parent
+    int32_t sibling = nodes[parent].left == leaf_idx ? nodes[parent].right : nodes[parent].left;
+    int32_t grandparent = nodes[parent].parent;
+
+    replace_child(grandparent, parent, sibling);
+    free_nodes.push_back(parent);
+
+    refit_ancestors(grandparent);
+}
+
+sBVHBounds SceneBVH::get_bounds() const
+{
+    if (root < 0) {
+        return {};
+    }
+
+    return nodes[root].bounds;
+}
+
+template<typename Fn>
+void SceneBVH::traverse(Fn&& overlaps, std::vector<uint32_t>& items) const
+{
+    if (root < 0) {
+        return;
+    }
+
+    int32_t stack[64];
+    uint32_t stack_size = 0u;
+    stack[stack_size++] = root;
+
+    while (stack_size > 0u) {
+        const sBVHNode& node = nodes[stack[--stack_size]];
+
+        if (!overlaps(node.bounds)) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            items.push_back(node.item);
+        }
+        else {
+            stack[stack_size++] = node.left;
+            stack[stack_size++] = node.right;
+        }
+    }
+}
+
+void SceneBVH::query_frustum(const glm::mat4& view_projection, std::vector<uint32_t>& items) const
+{
+    glm::vec4 row_0 = { view_projection[0][0], view_projection[1][0], view_projection[2][0], view_projection[3][0] };
+    glm::vec4 row_1 = { view_projection[0][1], view_projection[1][1], view_projection[2][1], view_projection[3][1] };
+    glm::vec4 row_3 = { view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3] };
+
+    // Near and far depend on the depth convention, the side planes do all the useful work here
+    glm::vec4 planes[4] = { row_3 + row_0, row_3 - row_0, row_3 + row_1, row_3 - row_1 };
+
+    traverse([&](const sBVHBounds& bounds) {
+        glm::vec3 center = bounds.get_center();
+        glm::vec3 extent = bounds.max - center;
+
+        for (const glm::vec4& plane : planes) {
+            glm::vec3 normal = { plane.x, plane.y, plane.z };
+            float radius = glm::dot(extent, glm::abs(normal));
+
+            if (glm::dot(normal, center) + plane.w < -radius) {
+                return false;
+            }
+        }
+
+        return true;
+    }, items);
+}
+
+void SceneBVH::query_sphere(const glm::vec3& center, float radius, std::vector<uint32_t>& items) const
+{
+    float radius_squared = radius * radius;
+
+    traverse([&](const sBVHBounds& bounds) {
+        return bounds.distance_squared(center) <= radius_squared;
+    }, items);
+}
+
+void SceneBVH::query_bounds(const sBVHBounds& query, std::vector<uint32_t>& items) const
+{
+    traverse([&](const sBVHBounds& bounds) {
+        return bounds.intersects(query);
+    }, items);
+}
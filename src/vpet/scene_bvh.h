@@ -0,0 +1,89 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+class Node3D;
+
+struct sBVHBounds {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool is_valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 get_center() const { return (min + max) * 0.5f; }
+    glm::vec3 get_size() const { return max - min; }
+    float get_surface_area() const;
+
+    void extend(const glm::vec3& point);
+    void extend(const sBVHBounds& bounds);
+    bool intersects(const sBVHBounds& bounds) const;
+    float distance_squared(const glm::vec3& point) const;
+};
+
+// Mesh instances use their world AABB, any other node its world position
+sBVHBounds get_world_bounds(Node3D* node);
+
+// Binary AABB tree over externally owned items, identified by their index in the build list. Items inserted
+// after the build take the slots of removed ones first, then the next index
+class SceneBVH {
+
+    struct sBVHNode {
+        sBVHBounds bounds;
+        int32_t parent = -1;
+        int32_t left = -1;
+        int32_t right = -1;
+        int32_t item = -1;
+
+        bool is_leaf() const { return item >= 0; }
+    };
+
+    std::vector<sBVHNode> nodes;
+    std::vector<int32_t> item_leaves;
+    int32_t root = -1;
+
+    // Left behind by remove_item, reused by insert_item
+    std::vector<int32_t> free_nodes;
+    std::vector<uint32_t> free_items;
+
+    // Refits make the tree looser, rebuild once the root grows past this factor of its build size
+    float build_surface_area = 0.0f;
+
+    // Inserts can deepen the tree past what traverse handles
+    bool too_deep = false;
+
+    int32_t build_recursive(std::vector<uint32_t>& items, uint32_t begin, uint32_t end, int32_t parent, const std::vector<sBVHBounds>& item_bounds);
+    void refit_ancestors(int32_t node_idx);
+
+    int32_t allocate_node();
+    void replace_child(int32_t parent, int32_t child, int32_t new_child);
+
+    template<typename Fn>
+    void traverse(Fn&& overlaps, std::vector<uint32_t>& items) const;
+
+public:
+
+    void build(const std::vector<sBVHBounds>& item_bounds);
+    void clear();
+
+    // Refits the item leaf and its ancestors, call rebuild_if_degraded after a batch of updates
+    void update_item(uint32_t item, const sBVHBounds& bounds);
+    bool is_degraded() const;
+
+    // Adds a leaf next to the node it enlarges the least and returns its item, no rebuild needed
+    uint32_t insert_item(const sBVHBounds& bounds);
+    void remove_item(uint32_t item);
+
+    bool empty() const { return root < 0; }
+    // Including removed slots
+    uint32_t get_item_count() const { return item_leaves.size(); }
+    const sBVHBounds& get_item_bounds(uint32_t item) const { return nodes[item_leaves[item]].bounds; }
+    sBVHBounds get_bounds() const;
+
+    // Frustum given by its view projection, only the side planes are tested
+    void query_frustum(const glm::mat4& view_projection, std::vector<uint32_t>& items) const;
+    void query_sphere(const glm::vec3& center, float radius, std::vector<uint32_t>& items) const;
+    void query_bounds(const sBVHBounds& bounds, std::vector<uint32_t>& items) const;
+};
@@ -0,0 +1,570 @@
+#include "scene_cache.h"
+
+#include "hash.h"
+
+#include "engine/job_system.h"
+#include "engine/mapped_file.h"
+
+#include "spdlog/spdlog.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+    const char CACHE_MAGIC[4] = { 'D', 'L', 'S', 'C' };
+
+    // Chunks are hashed in parallel and their hashes combined in order
+    const size_t HASH_CHUNK_SIZE = 64u << 20;
+
+    template<typename T>
+    uint64_t hash_value(const T& value, uint64_t hash)
+    {
+        return hash_bytes(reinterpret_cast<const uint8_t*>(&value), sizeof(T), hash);
+    }
+
+    class CacheWriter {
+
+        FILE* file = nullptr;
+
+    public:
+
+        bool failed = false;
+
+        CacheWriter(FILE* file) : file(file) {}
+
+        void write_bytes(const void* data, size_t size)
+        {
+            if (size > 0u && fwrite(data, size, 1, file) != 1) {
+                failed = true;
+            }
+        }
+
+        template<typename T>
+        void write(const T& value)
+        {
+            write_bytes(&value, sizeof(T));
+        }
+
+        template<typename T>
+        void write_array(const std::vector<T>& values)
+        {
+            uint32_t count = values.size();
+            write(count);
+            write_bytes(values.data(), count * sizeof(T));
+        }
+
+        void write_string(const std::string& value)
+        {
+            uint32_t size = value.size();
+            write(size);
+            write_bytes(value.data(), size);
+        }
+    };
+
+    class CacheReader {
+
+        const uint8_t* data = nullptr;
+        size_t size = 0u;
+        size_t buffer_ptr = 0u;
+
+    public:
+
+        CacheReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+        bool read_bytes(void* dst, size_t byte_count)
+        {
+            if (byte_count > size - buffer_ptr) {
+                return false;
+            }
+
+            memcpy(dst, &data[buffer_ptr], byte_count);
+            buffer_ptr += byte_count;
+
+            return true;
+        }
+
+        template<typename T>
+        bool read(T& value)
+        {
+            return read_bytes(&value, sizeof(T));
+        }
+
+        // Counts come from the file, each of the records takes at least record_size bytes of what is left
+        bool fits(uint32_t count, size_t record_size) const
+        {
+            return count <= (size - buffer_ptr) / record_size;
+        }
+
+        template<typename T>
+        bool read_array(std::vector<T>& values)
+        {
+            uint32_t count = 0u;
+
+            if (!read(count) || count * sizeof(T) > size - buffer_ptr) {
+                return false;
+            }
+
+            values.resize(count);
+
+            return read_bytes(values.data(), count * sizeof(T));
+        }
+
+        bool read_string(std::string& value)
+        {
+            uint32_t length = 0u;
+
+            if (!read(length) || length > size - buffer_ptr) {
+                return false;
+            }
+
+            value.assign(reinterpret_cast<const char*>(&data[buffer_ptr]), length);
+            buffer_ptr += length;
+
+            return true;
+        }
+    };
+
+    void write_mesh(CacheWriter& writer, const sVPETMesh& mesh)
+    {
+        writer.write_string(mesh.name);
+        writer.write_array(mesh.vertex_array);
+        writer.write_array(mesh.index_array);
+        writer.write_array(mesh.normal_array);
+        writer.write_array(mesh.uv_array);
+        writer.write_array(mesh.bone_weights_array);
+        writer.write_array(mesh.bone_indices_array);
+
+        uint32_t lod_count = mesh.lod_list.size();
+        writer.write(lod_count);
+
+        for (const sVPETMesh& lod_mesh : mesh.lod_list) {
+            write_mesh(writer, lod_mesh);
+        }
+    }
+
+    // Name and array sizes plus the LOD count
+    const size_t MESH_RECORD_SIZE = 8u * sizeof(uint32_t);
+
+    // LOD meshes have no LODs of their own
+    bool read_mesh(CacheReader& reader, sVPETMesh& mesh, uint32_t max_lod_count)
+    {
+        uint32_t lod_count = 0u;
+
+        if (!reader.read_string(mesh.name) || !reader.read_array(mesh.vertex_array) || !reader.read_array(mesh.index_array) ||
+            !reader.read_array(mesh.normal_array) || !reader.read_array(mesh.uv_array) || !reader.read_array(mesh.bone_weights_array) ||
+            !reader.read_array(mesh.bone_indices_array) || !reader.read(lod_count) || lod_count > max_lod_count ||
+            !reader.fits(lod_count, MESH_RECORD_SIZE)) {
+            return false;
+        }
+
+        mesh.lod_list.resize(lod_count);
+
+        for (sVPETMesh& lod_mesh : mesh.lod_list) {
+            if (!read_mesh(reader, lod_mesh, 0u)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // The source pixels are not stored, link_scene_objects points the texture at those of the parsed scene
+    void write_texture(CacheWriter& writer, const sVPETTexture& texture)
+    {
+        writer.write_string(texture.name);
+        writer.write(texture.width);
+        writer.write(texture.height);
+        writer.write(texture.format);
+
+        static const std::vector<uint8_t> empty_data;
+
+        uint32_t variant_count = texture.variants.size();
+        writer.write(variant_count);
+
+        for (const sVPETTextureVariant& variant : texture.variants) {
+            // Variants sharing the source are stored empty and shared again on load
+            uint8_t shared = variant.shared_data != nullptr;
+            writer.write(shared);
+            writer.write(variant.width);
+            writer.write(variant.height);
+            writer.write(variant.format);
+            writer.write(variant.mip_count);
+            writer.write_array(shared ? empty_data : variant.texture_data);
+        }
+    }
+
+    // Shared flag, size, format, mip count and data size
+    const size_t VARIANT_RECORD_SIZE = sizeof(uint8_t) + 5u * sizeof(uint32_t);
+
+    bool read_texture(CacheReader& reader, sVPETTexture& texture, uint32_t max_variant_count)
+    {
+        uint32_t variant_count = 0u;
+
+        if (!reader.read_string(texture.name) || !reader.read(texture.width) || !reader.read(texture.height) ||
+            !reader.read(texture.format) || !reader.read(variant_count) || variant_count > max_variant_count ||
+            !reader.fits(variant_count, VARIANT_RECORD_SIZE)) {
+            return false;
+        }
+
+        texture.variants.resize(variant_count);
+
+        for (sVPETTextureVariant& variant : texture.variants) {
+            uint8_t shared = 0u;
+
+            if (!reader.read(shared) || !reader.read(variant.width) || !reader.read(variant.height) || !reader.read(variant.format) ||
+                !reader.read(variant.mip_count) || !reader.read_array(variant.texture_data)) {
+                return false;
+            }
+
+            if (shared) {
+                variant.shared_data = &texture.texture_data;
+            }
+        }
+
+        return true;
+    }
+
+    void write_material(CacheWriter& writer, const sVPETMaterial& material)
+    {
+        writer.write(material.type);
+        writer.write(material.name_size);
+        writer.write(material.name);
+        writer.write(material.src_size);
+        writer.write(material.src);
+        writer.write(material.material_id);
+        writer.write(material.texture_ids_size);
+        writer.write_array(material.texture_ids);
+        writer.write_array(material.texture_offsets);
+        writer.write_array(material.texture_scales);
+
+        std::vector<uint8_t> shader_configs(material.shader_configs.begin(), material.shader_configs.end());
+        writer.write(material.shader_config_size);
+        writer.write_array(shader_configs);
+        writer.write(material.shader_properties_ids_size);
+        writer.write_array(material.shader_property_ids);
+        writer.write(material.shader_properties_types_size);
+        writer.write_array(material.shader_property_types);
+        writer.write(material.shader_properties_size);
+        writer.write_array(material.shader_properties);
+    }
+
+    bool read_material(CacheReader& reader, sVPETMaterial& material)
+    {
+        std::vector<uint8_t> shader_configs;
+
+        if (!reader.read(material.type) || !reader.read(material.name_size) || !reader.read(material.name) ||
+            !reader.read(material.src_size) || !reader.read(material.src) || !reader.read(material.material_id) ||
+            !reader.read(material.texture_ids_size) || !reader.read_array(material.texture_ids) ||
+            !reader.read_array(material.texture_offsets) || !reader.read_array(material.texture_scales) ||
+            !reader.read(material.shader_config_size) || !reader.read_array(shader_configs) ||
+            !reader.read(material.shader_properties_ids_size) || !reader.read_array(material.shader_property_ids) ||
+            !reader.read(material.shader_properties_types_size) || !reader.read_array(material.shader_property_types) ||
+            !reader.read(material.shader_properties_size) || !reader.read_array(material.shader_properties)) {
+            return false;
+        }
+
+        material.shader_configs.assign(shader_configs.begin(), shader_configs.end());
+
+        return true;
+    }
+
+    void write_node(CacheWriter& writer, const sVPETNode& node)
+    {
+        writer.write(node.node_type);
+        writer.write(node.editable);
+        writer.write(node.child_count);
+        writer.write(node.position);
+        writer.write(node.scale);
+        writer.write(node.rotation);
+        writer.write(node.name);
+
+        switch (node.node_type) {
+        case eVPETNodeType::GEO: {
+            const sVPETGeoNode& geo_node = static_cast<const sVPETGeoNode&>(node);
+            writer.write(geo_node.geo_id);
+            writer.write(geo_node.material_id);
+            writer.write(geo_node.color);
+            break;
+        }
+        case eVPETNodeType::LIGHT: {
+            const sVPETLightNode& light_node = static_cast<const sVPETLightNode&>(node);
+            writer.write(light_node.light_type);
+            writer.write(light_node.intensity);
+            writer.write(light_node.angle);
+            writer.write(light_node.range);
+            writer.write(light_node.exposure);
+            writer.write(light_node.color);
+            break;
+        }
+        case eVPETNodeType::CAMERA: {
+            const sVPETCamNode& cam_node = static_cast<const sVPETCamNode&>(node);
+            writer.write(cam_node.fov);
+            writer.write(cam_node.near);
+            writer.write(cam_node.far);
+            writer.write(cam_node.aspect);
+            writer.write(cam_node.focal_dist);
+            writer.write(cam_node.aperture);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    sVPETNode* read_node(CacheReader& reader)
+    {
+        eVPETNodeType node_type;
+
+        if (!reader.read(node_type)) {
+            return nullptr;
+        }
+
+        sVPETNode* node = nullptr;
+
+        switch (node_type) {
+        case eVPETNodeType::GEO:
+            node = new sVPETGeoNode();
+            break;
+        case eVPETNodeType::LIGHT:
+            node = new sVPETLightNode();
+            break;
+        case eVPETNodeType::CAMERA:
+            node = new sVPETCamNode();
+            break;
+        default:
+            node = new sVPETNode();
+            break;
+        }
+
+        node->node_type = node_type;
+
+        bool valid = reader.read(node->editable) && reader.read(node->child_count) && reader.read(node->position) &&
+            reader.read(node->scale) && reader.read(node->rotation) && reader.read(node->name);
+
+        switch (node_type) {
+        case eVPETNodeType::GEO: {
+            sVPETGeoNode* geo_node = static_cast<sVPETGeoNode*>(node);
+            valid = valid && reader.read(geo_node->geo_id) && reader.read(geo_node->material_id) && reader.read(geo_node->color);
+            break;
+        }
+        case eVPETNodeType::LIGHT: {
+            sVPETLightNode* light_node = static_cast<sVPETLightNode*>(node);
+            valid = valid && reader.read(light_node->light_type) && reader.read(light_node->intensity) && reader.read(light_node->angle) &&
+                reader.read(light_node->range) && reader.read(light_node->exposure) && reader.read(light_node->color);
+            break;
+        }
+        case eVPETNodeType::CAMERA: {
+            sVPETCamNode* cam_node = static_cast<sVPETCamNode*>(node);
+            valid = valid && reader.read(cam_node->fov) && reader.read(cam_node->near) && reader.read(cam_node->far) &&
+                reader.read(cam_node->aspect) && reader.read(cam_node->focal_dist) && reader.read(cam_node->aperture);
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (!valid) {
+            delete node;
+            return nullptr;
+        }
+
+        return node;
+    }
+}
+
+uint64_t get_scene_cache_key(const std::string& source_filename, const sVPETContext& vpet, uint32_t lod_count)
+{
+    MappedFile source_file;
+
+    if (!source_file.open(source_filename)) {
+        return 0u;
+    }
+
+    const uint8_t* data = source_file.get_data();
+    size_t size = source_file.get_size();
+
+    uint32_t chunk_count = static_cast<uint32_t>((size + HASH_CHUNK_SIZE - 1u) / HASH_CHUNK_SIZE);
+    std::vector<uint64_t> chunk_hashes(chunk_count);
+
+    JobSystem::parallel_for(chunk_count, [&](uint32_t chunk) {
+        size_t offset = chunk * HASH_CHUNK_SIZE;
+        chunk_hashes[chunk] = hash_bytes(&data[offset], std::min(HASH_CHUNK_SIZE, size - offset));
+    });
+
+    uint64_t key = hash_bytes(reinterpret_cast<const uint8_t*>(chunk_hashes.data()), chunk_hashes.size() * sizeof(uint64_t));
+
+    key = hash_value(size, key);
+    key = hash_value(SCENE_CACHE_VERSION, key);
+    key = hash_value(lod_count, key);
+
+    for (const sVPETTextureProfile& profile : vpet.texture_profiles) {
+        key = hash_bytes(reinterpret_cast<const uint8_t*>(profile.name.data()), profile.name.size(), key);
+        key = hash_value(profile.max_size, key);
+        key = hash_value(profile.generate_mipmaps, key);
+        key = hash_value(profile.format, key);
+    }
+
+    return key;
+}
+
+std::string get_scene_cache_path(const std::string& cache_directory, uint64_t key)
+{
+    return fmt::format("{}/{:016x}.dlcache", cache_directory, key);
+}
+
+bool write_scene_cache(const sVPETContext& vpet, const std::string& cache_path, uint64_t key)
+{
+    std::filesystem::path path = cache_path;
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    // Written aside and renamed, a crash never leaves a truncated entry under the final name
+    std::string temp_path = cache_path + ".tmp";
+
+    FILE* file = fopen(temp_path.c_str(), "wb");
+
+    if (!file) {
+        spdlog::error("Could not create scene cache {}", cache_path);
+        return false;
+    }
+
+    CacheWriter writer(file);
+
+    writer.write(CACHE_MAGIC);
+    writer.write(SCENE_CACHE_VERSION);
+    writer.write(key);
+
+    writer.write(vpet.lod_count);
+    writer.write_array(vpet.geos_lod_byte_size);
+    writer.write_array(vpet.texture_variants_byte_size);
+    writer.write(vpet.nodes_byte_size);
+    writer.write(vpet.geos_byte_size);
+    writer.write(vpet.textures_byte_size);
+    writer.write(vpet.materials_byte_size);
+
+    uint32_t count = vpet.geo_list.size();
+    writer.write(count);
+    for (const sVPETMesh* mesh : vpet.geo_list) {
+        write_mesh(writer, *mesh);
+    }
+
+    count = vpet.texture_list.size();
+    writer.write(count);
+    for (const sVPETTexture* texture : vpet.texture_list) {
+        write_texture(writer, *texture);
+    }
+
+    count = vpet.material_list.size();
+    writer.write(count);
+    for (const sVPETMaterial* material : vpet.material_list) {
+        write_material(writer, *material);
+    }
+
+    count = vpet.node_list.size();
+    writer.write(count);
+    for (const sVPETNode* node : vpet.node_list) {
+        write_node(writer, *node);
+    }
+
+    bool failed = writer.failed;
+    failed |= fclose(file) != 0;
+
+    if (failed) {
+        spdlog::error("Could not write scene cache {}", cache_path);
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+
+    std::filesystem::rename(temp_path, cache_path, error);
+
+    if (error) {
+        spdlog::error("Could not write scene cache {}: {}", cache_path, error.message());
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+
+    return true;
+}
+
+bool read_scene_cache(sVPETContext& vpet, const std::string& cache_path, uint64_t key)
+{
+    if (!std::filesystem::exists(cache_path)) {
+        return false;
+    }
+
+    MappedFile cache_file;
+
+    if (!cache_file.open(cache_path)) {
+        return false;
+    }
+
+    CacheReader reader(cache_file.get_data(), cache_file.get_size());
+
+    char magic[4];
+    uint32_t version = 0u;
+    uint64_t file_key = 0u;
+
+    if (!reader.read(magic) || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || !reader.read(version) ||
+        version != SCENE_CACHE_VERSION || !reader.read(file_key) || file_key != key) {
+        spdlog::warn("Ignoring scene cache {}, written for another source or version", cache_path);
+        return false;
+    }
+
+    bool valid = reader.read(vpet.lod_count) && reader.read_array(vpet.geos_lod_byte_size) &&
+        reader.read_array(vpet.texture_variants_byte_size) && reader.read(vpet.nodes_byte_size) &&
+        reader.read(vpet.geos_byte_size) && reader.read(vpet.textures_byte_size) && reader.read(vpet.materials_byte_size);
+
+    uint32_t count = 0u;
+
+    // The key covers the LOD count and the texture profiles, entries never hold more
+    valid = valid && vpet.lod_count == vpet.geos_lod_byte_size.size() && reader.read(count) && reader.fits(count, MESH_RECORD_SIZE);
+    for (uint32_t i = 0u; valid && i < count; ++i) {
+        sVPETMesh* mesh = new sVPETMesh();
+        vpet.geo_list.push_back(mesh);
+        valid = read_mesh(reader, *mesh, vpet.lod_count);
+        mesh->compute_bounds();
+    }
+
+    uint32_t variant_count = static_cast<uint32_t>(vpet.texture_profiles.size());
+
+    valid = valid && reader.read(count);
+    for (uint32_t i = 0u; valid && i < count; ++i) {
+        sVPETTexture* texture = new sVPETTexture();
+        vpet.texture_list.push_back(texture);
+        valid = read_texture(reader, *texture, variant_count);
+    }
+
+    valid = valid && reader.read(count);
+    for (uint32_t i = 0u; valid && i < count; ++i) {
+        sVPETMaterial* material = new sVPETMaterial();
+        vpet.material_list.push_back(material);
+        valid = read_material(reader, *material);
+    }
+
+    valid = valid && reader.read(count);
+    for (uint32_t i = 0u; valid && i < count; ++i) {
+        sVPETNode* node = read_node(reader);
+
+        if (!node) {
+            valid = false;
+            break;
+        }
+
+        vpet.node_list.push_back(node);
+
+        if (node->editable) {
+            vpet.editables_node_list.push_back(node);
+        }
+    }
+
+    if (!valid) {
+        spdlog::error("Scene cache {} is corrupted", cache_path);
+        vpet.clean();
+        return false;
+    }
+
+    return true;
+}
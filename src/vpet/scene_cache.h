@@ -0,0 +1,24 @@
+#pragma once
+
+#include "structs.h"
+
+#include <string>
+
+// On-disk cache of a processed sVPETContext: nodes, meshes with their LOD chains, textures with their
+// profile variants and materials, so a restart skips simplification and texture encoding. The rendered scene
+// is still parsed from the source file and the cached nodes and textures are linked to it, see
+// link_scene_objects, so source pixels are not stored.
+// Files are named after a hash of the source file content plus everything that changes the pipeline
+// output (SCENE_CACHE_VERSION, texture profiles, LOD count), stale entries are never read.
+
+// Bump when the processing of any cached data changes
+const uint32_t SCENE_CACHE_VERSION = 2u;
+
+uint64_t get_scene_cache_key(const std::string& source_filename, const sVPETContext& vpet, uint32_t lod_count);
+
+std::string get_scene_cache_path(const std::string& cache_directory, uint64_t key);
+
+bool write_scene_cache(const sVPETContext& vpet, const std::string& cache_path, uint64_t key);
+
+// Fills a clean context, engine node references are left empty
+bool read_scene_cache(sVPETContext& vpet, const std::string& cache_path, uint64_t key);
@@ -1,10 +1,17 @@
 #include "scene_distribution.h"
 
+#include "progressive_distribution.h"
+#include "character_distribution.h"
+#include "curve_distribution.h"
+#include "rpc_table.h"
+
 #include "framework/nodes/mesh_instance_3d.h"
 #include "framework/nodes/light_3d.h"
 #include "framework/nodes/spot_light_3d.h"
 #include "framework/nodes/camera.h"
 
+#include "spdlog/spdlog.h"
+
 uint32_t process_texture(sVPETContext& vpet, Texture* texture)
 {
     std::string name = texture->get_name();
@@ -20,14 +27,14 @@ uint32_t process_texture(sVPETContext& vpet, Texture* texture)
 
     sVPETTexture* vpet_texture = new sVPETTexture();
 
-    vpet_texture->texture_data = texture->get_texture_data();
+    vpet_texture->shared_data = &texture->get_texture_data();
     vpet_texture->width = texture->get_width();
     vpet_texture->height = texture->get_height();
     vpet_texture->format = 4; // RGBA32
     vpet_texture->name = name;
 
     vpet.textures_byte_size += 4 * sizeof(uint32_t);
-    vpet.textures_byte_size += vpet_texture->texture_data.size();
+    vpet.textures_byte_size += vpet_texture->get_texture_data().size();
 
     vpet.texture_list.push_back(vpet_texture);
 
@@ -46,7 +53,7 @@ uint32_t process_material(sVPETContext& vpet, Surface* surface)
     vpet_material->type = 1;
     vpet.materials_byte_size += sizeof(uint32_t);
 
-    vpet_material->name_size = material->get_name().size();
+    vpet_material->name_size = std::min(static_cast<uint32_t>(material->get_name().size()), 64u);
     vpet.materials_byte_size += sizeof(uint32_t);
 
     memcpy(vpet_material->name, material->get_name().data(), std::min(vpet_material->name_size, 64u));
@@ -127,6 +134,8 @@ uint32_t process_geo(sVPETContext& vpet, Surface* surface)
         vpet_mesh->vertex_array[idx].z = -vpet_mesh->vertex_array[idx].z;
     }
 
+    vpet_mesh->compute_bounds();
+
     vpet.geos_byte_size += sizeof(uint32_t) + vpet_mesh->vertex_array.size() * sizeof(glm::vec3);
 
     vpet_mesh->uv_array = surface_data.uvs;
@@ -154,6 +163,8 @@ uint32_t process_geo(sVPETContext& vpet, Surface* surface)
     // bone weights & bone indices sizes
     vpet.geos_byte_size += sizeof(uint32_t);
 
+    process_skin(vpet, *vpet_mesh, surface_data);
+
     vpet.geo_list.push_back(vpet_mesh);
 
     return vpet.geo_list.size() - 1;
@@ -177,6 +188,7 @@ void add_scene_object(sVPETContext& vpet, sVPETNode* vpet_node, Node* node)
     vpet.nodes_byte_size += 64;
 
     vpet_node->node_ref = node_3d;
+    vpet_node->world_bounds = get_world_bounds(node_3d);
 
     vpet.node_list.push_back(vpet_node);
 
@@ -192,8 +204,12 @@ void process_scene_object(sVPETContext& vpet, Node* node)
 
         sVPETNode* vpet_node = new sVPETNode();
         vpet_node->editable = true;
+
+        int32_t node_id = vpet.node_list.size();
         add_scene_object(vpet, vpet_node, node);
 
+        std::vector<int32_t> geo_ids;
+
         int idx = 0;
         // Special case since MeshInstance3D may have several surfaces
         for (Surface* surface : mesh_instance->get_surfaces()) {
@@ -205,6 +221,7 @@ void process_scene_object(sVPETContext& vpet, Node* node)
             geo_node->node_type = eVPETNodeType::GEO;
 
             geo_node->geo_id = process_geo(vpet, surface);
+            geo_ids.push_back(geo_node->geo_id);
             geo_node->material_id = process_material(vpet, surface);
 
             geo_node->editable = false;
@@ -213,12 +230,20 @@ void process_scene_object(sVPETContext& vpet, Node* node)
 
             add_scene_object(vpet, geo_node, &tmp_node);
 
+            // The temporary node goes away, surfaces map to their mesh instance
+            geo_node->node_ref = mesh_instance;
+            geo_node->world_bounds = vpet_node->world_bounds;
+
             idx++;
         }
 
         // Surfaces are added as child nodes
         vpet_node->child_count = mesh_instance->get_surfaces().size();
 
+        if (mesh_instance->get_skeleton()) {
+            process_character(vpet, mesh_instance, node_id, geo_ids);
+        }
+
         return;
     }
 
@@ -280,19 +305,391 @@ void process_scene_object(sVPETContext& vpet, Node* node)
     }
 }
 
+// Cached textures carry no pixels, they point at those of the engine texture again as process_texture does.
+// False when the material of the surface does not use the cached texture
+bool link_texture(sVPETContext& vpet, int32_t material_id, Surface* surface)
+{
+    if (material_id < 0 || material_id >= static_cast<int32_t>(vpet.material_list.size())) {
+        return material_id < 0;
+    }
+
+    const sVPETMaterial* vpet_material = vpet.material_list[material_id];
+    Material* material = surface->get_material();
+    Texture* texture = material ? material->get_diffuse_texture() : nullptr;
+
+    if (vpet_material->texture_ids.empty()) {
+        return !texture;
+    }
+
+    if (!texture || vpet_material->texture_ids[0] >= vpet.texture_list.size()) {
+        return false;
+    }
+
+    sVPETTexture* vpet_texture = vpet.texture_list[vpet_material->texture_ids[0]];
+    const std::vector<uint8_t>* source = &texture->get_texture_data();
+
+    if (vpet_texture->shared_data == source) {
+        return true;
+    }
+
+    if (vpet_texture->shared_data || vpet_texture->name != texture->get_name() || vpet_texture->width != texture->get_width() ||
+        vpet_texture->height != texture->get_height()) {
+        return false;
+    }
+
+    for (sVPETTextureVariant& variant : vpet_texture->variants) {
+        if (variant.shared_data == &vpet_texture->texture_data) {
+            variant.shared_data = source;
+        }
+    }
+
+    vpet_texture->shared_data = source;
+
+    return true;
+}
+
+bool link_scene_objects(sVPETContext& vpet, Node* node, uint32_t& node_idx)
+{
+    if (node_idx >= vpet.node_list.size()) {
+        return false;
+    }
+
+    Node3D* node_3d = static_cast<Node3D*>(node);
+
+    sVPETNode* vpet_node = vpet.node_list[node_idx++];
+    vpet_node->node_ref = node_3d;
+    vpet_node->world_bounds = get_world_bounds(node_3d);
+
+    // Surfaces follow their mesh instance as in process_scene_object
+    MeshInstance3D* mesh_instance = dynamic_cast<MeshInstance3D*>(node);
+    if (mesh_instance) {
+        for (uint32_t i = 0u; i < mesh_instance->get_surfaces().size(); ++i) {
+            if (node_idx >= vpet.node_list.size() || vpet.node_list[node_idx]->node_type != eVPETNodeType::GEO) {
+                return false;
+            }
+
+            sVPETGeoNode* geo_node = static_cast<sVPETGeoNode*>(vpet.node_list[node_idx++]);
+            geo_node->node_ref = mesh_instance;
+            geo_node->world_bounds = vpet_node->world_bounds;
+
+            if (!link_texture(vpet, geo_node->material_id, mesh_instance->get_surface(i))) {
+                return false;
+            }
+        }
+    }
+
+    for (Node* child : node->get_children()) {
+        if (!link_scene_objects(vpet, child, node_idx)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const std::string* sVPETRequest::get_option(const std::string& key) const
+{
+    for (const auto& option : options) {
+        if (option.first == key) {
+            return &option.second;
+        }
+    }
+
+    return nullptr;
+}
+
+sVPETRequest parse_scene_request(const std::string& request)
+{
+    sVPETRequest parsed_request;
+
+    size_t options_start = request.find('?');
+    parsed_request.name = request.substr(0, options_start);
+
+    while (options_start != std::string::npos) {
+        size_t option_end = request.find('&', options_start + 1);
+        std::string option = request.substr(options_start + 1, option_end - options_start - 1);
+
+        size_t separator = option.find('=');
+        if (separator != std::string::npos) {
+            parsed_request.options.push_back({ option.substr(0, separator), option.substr(separator + 1) });
+        }
+        else if (!option.empty()) {
+            parsed_request.options.push_back({ option, "" });
+        }
+
+        options_start = option_end;
+    }
+
+    return parsed_request;
+}
+
+bool is_scene_request_name(const std::string& name)
+{
+    static const std::string names[] = { "header", "materials", "textures", "objects", "nodes", "characters", "curve", "parameterobjects" };
+    return std::find(std::begin(names), std::end(names), name) != std::end(names);
+}
+
+int32_t find_texture_profile(const sVPETContext& vpet, const sVPETRequest& request)
+{
+    const std::string* profile_name = request.get_option("profile");
+
+    if (!profile_name) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < vpet.texture_profiles.size(); ++i) {
+        if (vpet.texture_profiles[i].name == *profile_name && i < vpet.texture_variants_byte_size.size()) {
+            return i;
+        }
+    }
+
+    spdlog::warn("Unknown texture profile {}, sending source textures", *profile_name);
+
+    return -1;
+}
+
+void update_camera_view(sVPETNode* vpet_node)
+{
+    if (vpet_node->node_type != eVPETNodeType::CAMERA || !vpet_node->node_ref) {
+        return;
+    }
+
+    sVPETCamNode* cam_node = static_cast<sVPETCamNode*>(vpet_node);
+
+    glm::mat4 model = vpet_node->node_ref->get_global_model();
+    cam_node->world_eye = glm::vec3(model[3]);
+    cam_node->world_direction = -glm::normalize(glm::vec3(model[2]));
+}
+
+void build_context_bvh(sVPETContext& vpet)
+{
+    std::vector<sBVHBounds> node_bounds(vpet.node_list.size());
+
+    for (uint32_t i = 0; i < vpet.node_list.size(); ++i) {
+        vpet.node_list[i]->node_id = i;
+        node_bounds[i] = vpet.node_list[i]->world_bounds;
+        update_camera_view(vpet.node_list[i]);
+    }
+
+    vpet.node_bvh.build(node_bounds);
+}
+
+uint32_t get_subtree_end(const sVPETContext& vpet, uint32_t node_idx)
+{
+    // Nodes are stored depth first, so a subtree is a contiguous range
+    uint32_t pending_children = vpet.node_list[node_idx]->child_count;
+    uint32_t end = node_idx + 1;
+
+    while (pending_children > 0 && end < vpet.node_list.size()) {
+        pending_children += vpet.node_list[end]->child_count;
+        pending_children--;
+        end++;
+    }
+
+    return end;
+}
+
+sBVHBounds get_context_bounds(const sVPETContext& vpet, sVPETNode* vpet_node)
+{
+    if (vpet_node->node_type != eVPETNodeType::GEO) {
+        return get_world_bounds(vpet_node->node_ref);
+    }
+
+    const sVPETMesh* vpet_mesh = vpet.geo_list[static_cast<sVPETGeoNode*>(vpet_node)->geo_id];
+
+    glm::mat4 model = vpet_node->node_ref->get_global_model();
+
+    sBVHBounds bounds;
+
+    if (!vpet_mesh->bounds.is_valid()) {
+        bounds.extend(glm::vec3(model[3]));
+        return bounds;
+    }
+
+    for (uint32_t corner = 0u; corner < 8u; ++corner) {
+        glm::vec3 point = {
+            (corner & 1u) ? vpet_mesh->bounds.max.x : vpet_mesh->bounds.min.x,
+            (corner & 2u) ? vpet_mesh->bounds.max.y : vpet_mesh->bounds.min.y,
+            // Back from the unity coordinate system of the vertices
+            (corner & 4u) ? -vpet_mesh->bounds.max.z : -vpet_mesh->bounds.min.z
+        };
+        bounds.extend(glm::vec3(model * glm::vec4(point, 1.0f)));
+    }
+
+    return bounds;
+}
+
+void update_context_bounds(sVPETContext& vpet, sVPETNode* vpet_node)
+{
+    // Nodes of another context or added after the last build are not indexed
+    uint32_t node_idx = static_cast<uint32_t>(vpet_node->node_id);
+    if (vpet.node_bvh.empty() || node_idx >= vpet.node_list.size() || vpet.node_list[node_idx] != vpet_node) {
+        return;
+    }
+
+    uint32_t subtree_end = get_subtree_end(vpet, node_idx);
+
+    for (uint32_t i = node_idx; i < subtree_end; ++i) {
+        sVPETNode* node = vpet.node_list[i];
+
+        if (!node->node_ref) {
+            continue;
+        }
+
+        node->world_bounds = get_context_bounds(vpet, node);
+        vpet.node_bvh.update_item(i, node->world_bounds);
+
+        update_camera_view(node);
+    }
+
+    if (vpet.node_bvh.is_degraded()) {
+        build_context_bvh(vpet);
+    }
+}
+
+void write_texture(const sVPETTexture& texture, uint8_t* byte_array, uint32_t& buffer_ptr)
+{
+    memcpy(&byte_array[buffer_ptr], &texture.width, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&byte_array[buffer_ptr], &texture.height, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&byte_array[buffer_ptr], &texture.format, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    const std::vector<uint8_t>& texture_data = texture.get_texture_data();
+
+    uint32_t texture_size = texture_data.size();
+    memcpy(&byte_array[buffer_ptr], &texture_size, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&byte_array[buffer_ptr], texture_data.data(), texture_size);
+    buffer_ptr += texture_size;
+}
+
+void write_texture_variant(const sVPETTextureVariant& variant, uint8_t* byte_array, uint32_t& buffer_ptr)
+{
+    // Same layout as the source textures plus the mip count
+    memcpy(&byte_array[buffer_ptr], &variant.width, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&byte_array[buffer_ptr], &variant.height, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&byte_array[buffer_ptr], &variant.format, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&byte_array[buffer_ptr], &variant.mip_count, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    const std::vector<uint8_t>& texture_data = variant.get_texture_data();
+
+    uint32_t texture_size = texture_data.size();
+    memcpy(&byte_array[buffer_ptr], &texture_size, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+
+    memcpy(&byte_array[buffer_ptr], texture_data.data(), texture_size);
+    buffer_ptr += texture_size;
+}
+
+void write_mesh(const sVPETMesh& mesh, uint8_t* byte_array, uint32_t& buffer_ptr)
+{
+    uint32_t vertices_size = mesh.vertex_array.size();
+    memcpy(&byte_array[buffer_ptr], &vertices_size, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+    memcpy(&byte_array[buffer_ptr], mesh.vertex_array.data(), vertices_size * sizeof(glm::vec3));
+    buffer_ptr += vertices_size * sizeof(glm::vec3);
+
+    uint32_t indices_size = mesh.index_array.size();
+    memcpy(&byte_array[buffer_ptr], &indices_size, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+    memcpy(&byte_array[buffer_ptr], mesh.index_array.data(), indices_size * sizeof(uint32_t));
+    buffer_ptr += indices_size * sizeof(uint32_t);
+
+    uint32_t normals_size = mesh.normal_array.size();
+    memcpy(&byte_array[buffer_ptr], &normals_size, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+    memcpy(&byte_array[buffer_ptr], mesh.normal_array.data(), normals_size * sizeof(glm::vec3));
+    buffer_ptr += normals_size * sizeof(glm::vec3);
+
+    uint32_t uvs_size = mesh.uv_array.size();
+    memcpy(&byte_array[buffer_ptr], &uvs_size, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+    memcpy(&byte_array[buffer_ptr], mesh.uv_array.data(), uvs_size * sizeof(glm::vec2));
+    buffer_ptr += uvs_size * sizeof(glm::vec2);
+
+    uint32_t bone_weights_size = mesh.bone_weights_array.size();
+    memcpy(&byte_array[buffer_ptr], &bone_weights_size, sizeof(uint32_t));
+    buffer_ptr += sizeof(uint32_t);
+    memcpy(&byte_array[buffer_ptr], mesh.bone_weights_array.data(), bone_weights_size * sizeof(glm::vec4));
+    buffer_ptr += bone_weights_size * sizeof(glm::vec4);
+
+    uint32_t bone_indices_size = bone_weights_size * 4u;
+    memcpy(&byte_array[buffer_ptr], mesh.bone_indices_array.data(), bone_indices_size * sizeof(uint32_t));
+    buffer_ptr += bone_indices_size * sizeof(uint32_t);
+}
+
 uint32_t get_scene_request_buffer(void* distributor, const std::string& request, sVPETContext& vpet, uint8_t** byte_array)
 {
     uint32_t byte_array_size = 0;
 
-    if (request == "header") {
-        sVPETHeader header = { .sender_id = 1 };
+    sVPETRequest parsed_request = parse_scene_request(request);
+
+    bool chunked = parsed_request.get_option("chunk") != nullptr;
+    if (chunked && (parsed_request.name == "objects" || parsed_request.name == "textures")) {
+        return get_progressive_request_buffer(vpet, request, parsed_request, byte_array);
+    }
+
+    if (parsed_request.name == "header") {
+        sVPETHeader header = { .sender_id = vpet.scene_id };
 
         byte_array_size = sizeof(sVPETHeader);
+
+        // Clients that know about texture profiles ask for them after the header
+        bool send_profiles = parsed_request.get_option("profiles") != nullptr;
+
+        if (send_profiles) {
+            byte_array_size += sizeof(uint32_t);
+            for (const sVPETTextureProfile& profile : vpet.texture_profiles) {
+                byte_array_size += 4 * sizeof(uint32_t) + profile.name.size();
+            }
+        }
+
         *byte_array = new uint8_t[byte_array_size];
 
         memcpy(&(*byte_array)[0], &header, sizeof(sVPETHeader));
+
+        if (send_profiles) {
+            uint32_t buffer_ptr = sizeof(sVPETHeader);
+
+            uint32_t profile_count = vpet.texture_profiles.size();
+            memcpy(&(*byte_array)[buffer_ptr], &profile_count, sizeof(uint32_t));
+            buffer_ptr += sizeof(uint32_t);
+
+            for (const sVPETTextureProfile& profile : vpet.texture_profiles) {
+                uint32_t name_size = profile.name.size();
+                memcpy(&(*byte_array)[buffer_ptr], &name_size, sizeof(uint32_t));
+                buffer_ptr += sizeof(uint32_t);
+
+                memcpy(&(*byte_array)[buffer_ptr], profile.name.data(), name_size);
+                buffer_ptr += name_size;
+
+                memcpy(&(*byte_array)[buffer_ptr], &profile.max_size, sizeof(uint32_t));
+                buffer_ptr += sizeof(uint32_t);
+
+                memcpy(&(*byte_array)[buffer_ptr], &profile.format, sizeof(uint32_t));
+                buffer_ptr += sizeof(uint32_t);
+
+                uint32_t mipmaps = profile.generate_mipmaps;
+                memcpy(&(*byte_array)[buffer_ptr], &mipmaps, sizeof(uint32_t));
+                buffer_ptr += sizeof(uint32_t);
+            }
+
+            assert(buffer_ptr == byte_array_size);
+        }
     } else
-    if (request == "materials") {
+    if (parsed_request.name == "materials") {
 
         byte_array_size = vpet.materials_byte_size;
         *byte_array = new uint8_t[byte_array_size];
@@ -337,81 +734,59 @@ uint32_t get_scene_request_buffer(void* distributor, const std::string& request,
         assert(buffer_ptr == vpet.materials_byte_size);
 
     } else
-    if (request == "textures") {
+    if (parsed_request.name == "textures") {
 
-        byte_array_size = vpet.textures_byte_size;
-        *byte_array = new uint8_t[byte_array_size];
+        int32_t profile_index = find_texture_profile(vpet, parsed_request);
 
-        uint32_t buffer_ptr = 0;
+        if (profile_index >= 0) {
 
-        for (sVPETTexture* texture : vpet.texture_list) {
-            memcpy(&(*byte_array)[buffer_ptr], &texture->width, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
+            byte_array_size = vpet.texture_variants_byte_size[profile_index];
+            *byte_array = new uint8_t[byte_array_size];
 
-            memcpy(&(*byte_array)[buffer_ptr], &texture->height, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
+            uint32_t buffer_ptr = 0;
 
-            memcpy(&(*byte_array)[buffer_ptr], &texture->format, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
+            for (sVPETTexture* texture : vpet.texture_list) {
+                write_texture_variant(texture->variants[profile_index], *byte_array, buffer_ptr);
+            }
 
-            uint32_t texture_size = texture->texture_data.size();
-            memcpy(&(*byte_array)[buffer_ptr], &texture_size, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
+            assert(buffer_ptr == byte_array_size);
 
-            memcpy(&(*byte_array)[buffer_ptr], texture->texture_data.data(), texture_size);
-            buffer_ptr += texture_size;
+            return byte_array_size;
+        }
+
+        byte_array_size = vpet.textures_byte_size;
+        *byte_array = new uint8_t[byte_array_size];
+
+        uint32_t buffer_ptr = 0;
+
+        for (sVPETTexture* texture : vpet.texture_list) {
+            write_texture(*texture, *byte_array, buffer_ptr);
         }
 
         assert(buffer_ptr == vpet.textures_byte_size);
 
     } else
-    if (request == "objects") { // meshes
+    if (parsed_request.name == "objects") { // meshes
+
+        // Coarse levels first lets clients show the location early and refine it later with "objects"
+        uint32_t lod_level = 0u;
+        if (const std::string* lod = parsed_request.get_option("lod")) {
+            lod_level = std::min(static_cast<uint32_t>(strtoul(lod->c_str(), nullptr, 10)), vpet.lod_count);
+        }
 
-        byte_array_size = vpet.geos_byte_size;
+        byte_array_size = lod_level > 0u ? vpet.geos_lod_byte_size[lod_level - 1u] : vpet.geos_byte_size;
         *byte_array = new uint8_t[byte_array_size];
 
         uint32_t buffer_ptr = 0u;
 
         for (sVPETMesh* mesh : vpet.geo_list) {
-            uint32_t vertices_size = mesh->vertex_array.size();
-            memcpy(&(*byte_array)[buffer_ptr], &vertices_size, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
-            memcpy(&(*byte_array)[buffer_ptr], mesh->vertex_array.data(), vertices_size * sizeof(glm::vec3));
-            buffer_ptr += vertices_size * sizeof(glm::vec3);
-
-            uint32_t indices_size = mesh->index_array.size();
-            memcpy(&(*byte_array)[buffer_ptr], &indices_size, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
-            memcpy(&(*byte_array)[buffer_ptr], mesh->index_array.data(), indices_size * sizeof(uint32_t));
-            buffer_ptr += indices_size * sizeof(uint32_t);
-
-            uint32_t normals_size = mesh->normal_array.size();
-            memcpy(&(*byte_array)[buffer_ptr], &normals_size, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
-            memcpy(&(*byte_array)[buffer_ptr], mesh->normal_array.data(), normals_size * sizeof(glm::vec3));
-            buffer_ptr += normals_size * sizeof(glm::vec3);
-
-            uint32_t uvs_size = mesh->uv_array.size();
-            memcpy(&(*byte_array)[buffer_ptr], &uvs_size, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
-            memcpy(&(*byte_array)[buffer_ptr], mesh->uv_array.data(), uvs_size * sizeof(glm::vec2));
-            buffer_ptr += uvs_size * sizeof(glm::vec2);
-
-            uint32_t bone_weights_size = mesh->bone_weights_array.size();
-            memcpy(&(*byte_array)[buffer_ptr], &bone_weights_size, sizeof(uint32_t));
-            buffer_ptr += sizeof(uint32_t);
-            memcpy(&(*byte_array)[buffer_ptr], mesh->bone_weights_array.data(), bone_weights_size * sizeof(glm::vec4));
-            buffer_ptr += bone_weights_size * sizeof(glm::vec4);
-
-            uint32_t bone_indices_size = bone_weights_size;
-            memcpy(&(*byte_array)[buffer_ptr], mesh->bone_indices_array.data(), bone_indices_size * sizeof(uint32_t));
-            buffer_ptr += bone_indices_size * sizeof(uint32_t);
+            write_mesh(mesh->get_lod(lod_level), *byte_array, buffer_ptr);
         }
 
-        assert(buffer_ptr == vpet.geos_byte_size);
+        assert(buffer_ptr == byte_array_size);
 
     } else
-    if (request == "nodes") {
+    if (parsed_request.name == "nodes") {
 
         byte_array_size = vpet.nodes_byte_size;
         *byte_array = new uint8_t[byte_array_size];
@@ -423,7 +798,8 @@ uint32_t get_scene_request_buffer(void* distributor, const std::string& request,
             memcpy(&(*byte_array)[buffer_ptr], &node->node_type, sizeof(uint32_t));
             buffer_ptr += sizeof(uint32_t);
 
-            memcpy(&(*byte_array)[buffer_ptr], &node->editable, sizeof(uint32_t));
+            uint32_t editable = node->editable;
+            memcpy(&(*byte_array)[buffer_ptr], &editable, sizeof(uint32_t));
             buffer_ptr += sizeof(uint32_t);
 
             memcpy(&(*byte_array)[buffer_ptr], &node->child_count, sizeof(uint32_t));
@@ -520,13 +896,40 @@ uint32_t get_scene_request_buffer(void* distributor, const std::string& request,
         assert(buffer_ptr == vpet.nodes_byte_size);
 
     } else
-    if (request == "characters") {
+    if (parsed_request.name == "characters") {
+
+        byte_array_size = vpet.characters_byte_size;
+        *byte_array = new uint8_t[byte_array_size];
+
+        uint32_t buffer_ptr = 0;
+
+        write_characters(vpet, *byte_array, buffer_ptr);
+
+        assert(buffer_ptr == vpet.characters_byte_size);
 
     } else
-    if (request == "curve") {
+    if (parsed_request.name == "curve") {
+
+        byte_array_size = vpet.curves_byte_size;
+        *byte_array = new uint8_t[byte_array_size];
+
+        uint32_t buffer_ptr = 0;
+
+        write_curves(vpet.animation_list, *byte_array, buffer_ptr);
+
+        assert(buffer_ptr == vpet.curves_byte_size);
 
     } else
-    if (request == "parameterobjects") {
+    if (parsed_request.name == "parameterobjects") {
+
+        byte_array_size = vpet.parameter_objects_byte_size;
+        *byte_array = new uint8_t[byte_array_size];
+
+        uint32_t buffer_ptr = 0;
+
+        write_parameter_objects(vpet.parameter_object_list, *byte_array, buffer_ptr);
+
+        assert(buffer_ptr == vpet.parameter_objects_byte_size);
 
     }
     else {
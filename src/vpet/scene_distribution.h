@@ -9,6 +9,19 @@
 
 class Surface;
 
+// Scene requests may carry options, e.g. "textures?profile=mobile"
+struct sVPETRequest {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> options;
+
+    const std::string* get_option(const std::string& key) const;
+};
+
+sVPETRequest parse_scene_request(const std::string& request);
+
+// Names get_scene_request_buffer serves, "scenes" and "bundle" are answered by the scene server
+bool is_scene_request_name(const std::string& name);
+
 uint32_t process_texture(sVPETContext& vpet, Texture* texture);
 
 uint32_t process_material(sVPETContext& vpet, Surface* surface);
@@ -19,4 +32,24 @@ void add_scene_object(sVPETContext& vpet, sVPETNode* vpet_node, Node* node, uint
 
 void process_scene_object(sVPETContext& vpet, Node* node);
 
+// Points the nodes of a context built from the same tree, e.g. read from the scene cache, at the engine nodes of
+// the subtree, in process_scene_object order, and its textures at the engine pixels. False when the tree does
+// not match the context
+bool link_scene_objects(sVPETContext& vpet, Node* node, uint32_t& node_idx);
+
+// Spatial index over the world bounds of node_list, used to serve what is near a viewpoint first. Building and
+// updating it also copies the camera views, see sVPETCamNode::world_eye
+void build_context_bvh(sVPETContext& vpet);
+void update_context_bounds(sVPETContext& vpet, sVPETNode* vpet_node);
+// GEO nodes take the bounds of their mesh, valid while the engine instance has no surfaces of its own (geometry
+// pool members), other nodes those of their engine node
+sBVHBounds get_context_bounds(const sVPETContext& vpet, sVPETNode* vpet_node);
+uint32_t get_subtree_end(const sVPETContext& vpet, uint32_t node_idx);
+
+int32_t find_texture_profile(const sVPETContext& vpet, const sVPETRequest& request);
+
+void write_texture(const sVPETTexture& texture, uint8_t* byte_array, uint32_t& buffer_ptr);
+void write_texture_variant(const sVPETTextureVariant& variant, uint8_t* byte_array, uint32_t& buffer_ptr);
+void write_mesh(const sVPETMesh& mesh, uint8_t* byte_array, uint32_t& buffer_ptr);
+
 uint32_t get_scene_request_buffer(void* distributor, const std::string& request, sVPETContext& vpet, uint8_t** byte_array);
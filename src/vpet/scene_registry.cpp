@@ -0,0 +1,66 @@
+#include "scene_registry.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+void SceneRegistry::add(uint8_t scene_id, sVPETContext* vpet)
+{
+    assert(vpet && (!scenes[scene_id] || scenes[scene_id] == vpet));
+
+    scenes[scene_id] = vpet;
+    vpet->scene_id = scene_id;
+}
+
+void SceneRegistry::remove(uint8_t scene_id)
+{
+    scenes[scene_id] = nullptr;
+}
+
+sVPETContext* SceneRegistry::find(const sVPETRequest& request) const
+{
+    const std::string* scene_option = request.get_option("scene");
+
+    if (!scene_option) {
+        return scenes[default_scene_id];
+    }
+
+    char* end = nullptr;
+    unsigned long scene_id = strtoul(scene_option->c_str(), &end, 10);
+
+    if (scene_option->empty() || *end != '\0' || scene_id >= scenes.size()) {
+        return nullptr;
+    }
+
+    return scenes[scene_id];
+}
+
+void SceneRegistry::get_scene_ids(std::vector<uint8_t>& scene_ids) const
+{
+    scene_ids.clear();
+
+    if (scenes[default_scene_id]) {
+        scene_ids.push_back(default_scene_id);
+    }
+
+    for (uint32_t scene_id = 0u; scene_id < scenes.size(); ++scene_id) {
+        if (scenes[scene_id] && scene_id != default_scene_id) {
+            scene_ids.push_back(static_cast<uint8_t>(scene_id));
+        }
+    }
+}
+
+uint32_t get_scene_list_buffer(const SceneRegistry& registry, uint8_t** byte_array)
+{
+    std::vector<uint8_t> scene_ids;
+    registry.get_scene_ids(scene_ids);
+
+    uint32_t byte_array_size = sizeof(uint32_t) + scene_ids.size();
+    *byte_array = new uint8_t[byte_array_size];
+
+    uint32_t scene_count = scene_ids.size();
+    memcpy(*byte_array, &scene_count, sizeof(uint32_t));
+    memcpy(*byte_array + sizeof(uint32_t), scene_ids.data(), scene_ids.size());
+
+    return byte_array_size;
+}
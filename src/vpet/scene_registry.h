@@ -0,0 +1,37 @@
+#pragma once
+
+#include "asset_pool.h"
+#include "scene_distribution.h"
+
+#include <array>
+
+// Scene contexts served by the process, keyed by the scene id of the PARAMETER_UPDATE, LOCK and ANIMATION records
+// and by the "scene" option of the scene requests, e.g. "nodes?scene=2". Requests without it get the default scene.
+// Contexts are added and removed under the exclusive lock of the context mutex and looked up under either lock.
+class SceneRegistry {
+
+    std::array<sVPETContext*, 256> scenes = {};
+    uint8_t default_scene_id = 0u;
+
+public:
+
+    // Shared by every registered context, they release into it when cleaned
+    AssetPool asset_pool;
+
+    void set_default_scene(uint8_t scene_id) { default_scene_id = scene_id; }
+    uint8_t get_default_scene() const { return default_scene_id; }
+
+    // The context stays owned by the caller and must be unregistered before it goes away
+    void add(uint8_t scene_id, sVPETContext* vpet);
+    void remove(uint8_t scene_id);
+
+    sVPETContext* find(uint8_t scene_id) const { return scenes[scene_id]; }
+
+    // Null for a "scene" option that is not registered or not a scene id
+    sVPETContext* find(const sVPETRequest& request) const;
+
+    void get_scene_ids(std::vector<uint8_t>& scene_ids) const;
+};
+
+// "scenes" answers the registered scene ids: count (uint32), then one byte per scene, the default one first
+uint32_t get_scene_list_buffer(const SceneRegistry& registry, uint8_t** byte_array);
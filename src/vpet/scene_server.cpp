@@ -0,0 +1,163 @@
+#include "scene_server.h"
+
+#include "scene_bundle.h"
+
+#include "engine/stats.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <mutex>
+
+#ifndef __EMSCRIPTEN__
+#include "zmq.h"
+#endif
+
+namespace {
+
+    // How often the thread checks for stop while idle
+    const long POLL_TIMEOUT_MS = 100;
+}
+
+void SceneServer::start(void* zmq_context, const std::string& endpoint, const SceneRegistry* scenes, std::shared_mutex* context_mutex, int io_affinity)
+{
+    stop();
+
+    this->scenes = scenes;
+    this->context_mutex = context_mutex;
+
+    running = true;
+    server_thread = std::thread(&SceneServer::run, this, zmq_context, endpoint, io_affinity);
+}
+
+void SceneServer::stop()
+{
+    running = false;
+
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+void SceneServer::run(void* zmq_context, std::string endpoint, int io_affinity)
+{
+#ifndef __EMSCRIPTEN__
+    static const uint32_t bytes_sent_counter = Stats::get_metric("vpet.bytes_sent", Stats::METRIC_COUNTER);
+    static const uint32_t requests_counter = Stats::get_metric("vpet.requests", Stats::METRIC_COUNTER);
+
+    // Sockets are not thread safe, this one lives and dies on the server thread
+    void* distributor = zmq_socket(zmq_context, ZMQ_REP);
+
+    if (io_affinity != 0) {
+        uint64_t affinity = io_affinity;
+        zmq_setsockopt(distributor, ZMQ_AFFINITY, &affinity, sizeof(uint64_t));
+    }
+
+    if (zmq_bind(distributor, endpoint.c_str()) != 0) {
+        spdlog::error("Scene server could not bind {}", endpoint);
+        zmq_close(distributor);
+        running = false;
+        return;
+    }
+
+    while (running) {
+        zmq_pollitem_t item = { distributor, 0, ZMQ_POLLIN, 0 };
+
+        if (zmq_poll(&item, 1, POLL_TIMEOUT_MS) <= 0 || item.revents == 0) {
+            continue;
+        }
+
+        char buffer[256];
+        int msg_size = zmq_recv(distributor, buffer, 256, 0);
+
+        if (msg_size < 0) {
+            continue;
+        }
+
+        std::string request(buffer, std::min(msg_size, 256));
+
+        spdlog::debug("Requested: {}", request);
+
+        uint32_t byte_array_size = serve_request(distributor, request);
+
+        spdlog::debug("Sent {} bytes", byte_array_size);
+
+        Stats::add_count(requests_counter);
+        Stats::add_count(bytes_sent_counter, byte_array_size);
+    }
+
+    zmq_close(distributor);
+#endif
+}
+
+uint32_t SceneServer::serve_request(void* socket, const std::string& request)
+{
+    uint32_t byte_array_size = 0u;
+
+#ifndef __EMSCRIPTEN__
+    sVPETRequest parsed_request = parse_scene_request(request);
+
+    // Names come from clients, an unknown one gets an empty reply and no metric of its own
+    if (parsed_request.name != "scenes" && parsed_request.name != "bundle" && !is_scene_request_name(parsed_request.name)) {
+        spdlog::warn("Unknown request {}", request);
+        zmq_send(socket, nullptr, 0, 0);
+        return 0u;
+    }
+
+    // One timer per request category, e.g. serialize.objects
+    uint32_t serialize_timer = Stats::is_enabled() ? Stats::get_metric("serialize." + parsed_request.name, Stats::METRIC_TIMER) : 0u;
+
+    // Held until the reply is queued, cached bundle parts are sent from the context itself
+    std::shared_lock<std::shared_mutex> lock(*context_mutex);
+
+    sVPETContext* vpet = scenes->find(parsed_request);
+
+    if (parsed_request.name == "scenes" || !vpet) {
+        uint8_t* byte_array = nullptr;
+
+        // An unknown scene gets an empty reply, the socket still has to answer
+        if (vpet) {
+            ScopedTimer serialize_scope(serialize_timer);
+            byte_array_size = get_scene_list_buffer(*scenes, &byte_array);
+        }
+        else {
+            spdlog::warn("Request {} for a scene that is not hosted", request);
+        }
+
+        zmq_send(socket, byte_array, byte_array_size, 0);
+
+        if (byte_array) {
+            delete[] byte_array;
+        }
+    }
+    else if (parsed_request.name == "bundle") {
+        std::vector<sVPETBundlePart> parts;
+
+        {
+            ScopedTimer serialize_scope(serialize_timer);
+            get_bundle_parts(*vpet, parsed_request, parts);
+        }
+
+        for (uint32_t i = 0u; i < parts.size(); ++i) {
+            zmq_send(socket, parts[i].data, parts[i].size, i + 1u < parts.size() ? ZMQ_SNDMORE : 0);
+            byte_array_size += parts[i].size;
+        }
+    }
+    else {
+        uint8_t* byte_array = nullptr;
+
+        {
+            ScopedTimer serialize_scope(serialize_timer);
+            byte_array_size = get_scene_request_buffer(socket, request, *vpet, &byte_array);
+        }
+
+        zmq_send(socket, byte_array, byte_array_size, 0);
+
+        if (byte_array) {
+            delete[] byte_array;
+        }
+    }
+#endif
+
+    return byte_array_size;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "scene_registry.h"
+
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+
+// Bulk plane of the TRACER connection: answers scene requests (header, textures, objects, bundle...) on its
+// own REP socket and thread, so a large reply never holds back the update drain on the render thread.
+// Requests are served under a shared lock of context_mutex, whoever changes a context or the registry takes it
+// exclusively. Each request goes to the context of its "scene" option, "scenes" lists them.
+// The request caches in the context (delivery plans, bundle parts) are only touched from this thread.
+class SceneServer {
+
+    const SceneRegistry* scenes = nullptr;
+    std::shared_mutex* context_mutex = nullptr;
+
+    std::thread server_thread;
+    std::atomic<bool> running = false;
+
+    void run(void* zmq_context, std::string endpoint, int io_affinity);
+    uint32_t serve_request(void* socket, const std::string& request);
+
+public:
+
+    ~SceneServer() { stop(); }
+
+    // io_affinity selects the ZMQ I/O threads used by the socket, 0 for any
+    void start(void* zmq_context, const std::string& endpoint, const SceneRegistry* scenes, std::shared_mutex* context_mutex, int io_affinity = 0);
+    void stop();
+
+    bool is_running() const { return running; }
+};
@@ -3,9 +3,17 @@
 #include "glm/glm.hpp"
 #include "glm/gtx/quaternion.hpp"
 
+#include "scene_bvh.h"
+
+#include <algorithm>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class Node3D;
+class Skeleton;
+struct sVPETParameterObject;
+class AssetPool;
 
 enum class eVPETNodeType : uint32_t {
     GROUP, GEO, LIGHT, CAMERA, SKINNED_MESH, CHARACTER
@@ -22,6 +30,9 @@ struct sVPETHeader {
 };
 
 struct sVPETNode {
+    // Nodes are deleted through base pointers
+    virtual ~sVPETNode() = default;
+
     eVPETNodeType node_type;
     bool editable = false;
     uint32_t child_count = 0;
@@ -30,6 +41,10 @@ struct sVPETNode {
     glm::quat rotation = { 0.f, 0.f, 0.f, 1.f };
     char name[64] = "";
     Node3D* node_ref = nullptr;
+    // World space, not serialized
+    sBVHBounds world_bounds;
+    // In node_list, set by build_context_bvh, not serialized
+    int32_t node_id = -1;
 };
 
 struct sVPETGeoNode : public sVPETNode {
@@ -54,6 +69,9 @@ struct sVPETCamNode : public sVPETNode {
     float aspect = 16.0f / 9.0f;
     float focal_dist = 1.0f;
     float aperture = 2.8f;
+    // Engine space, copied from the engine node with the context bounds so the scene server never reads it
+    glm::vec3 world_eye = {};
+    glm::vec3 world_direction = { 0.0f, 0.0f, -1.0f };
 };
 
 struct sVPETMesh {
@@ -62,8 +80,112 @@ struct sVPETMesh {
     std::vector<uint32_t> index_array;
     std::vector<glm::vec3> normal_array;
     std::vector<glm::vec2> uv_array;
+    // Four influences per vertex, bone_indices_array holds four indices per weight
     std::vector<glm::vec4> bone_weights_array;
     std::vector<uint32_t> bone_indices_array;
+    // Same influences for "characters", weights in 1/255 steps summing to 255, indices of skin_index_size bytes
+    std::vector<uint8_t> skin_weights;
+    std::vector<uint8_t> skin_indices;
+    uint32_t skin_index_size = 0;
+    // Coarser levels of detail, lod_list[0] is LOD 1
+    std::vector<sVPETMesh> lod_list;
+    // Object space bounds of vertex_array, unity coordinates as the vertices, set where the mesh is built since
+    // pooled meshes are read by several contexts
+    sBVHBounds bounds;
+
+    void compute_bounds() {
+        bounds = {};
+        for (const glm::vec3& vertex : vertex_array) {
+            bounds.extend(vertex);
+        }
+    }
+
+    // Falls back to the coarsest available level
+    const sVPETMesh& get_lod(uint32_t level) const {
+        if (level == 0 || lod_list.empty()) {
+            return *this;
+        }
+        return lod_list[std::min<size_t>(level, lod_list.size()) - 1];
+    }
+};
+
+// Skeleton of a skinned glTF mesh, bones in skin joint order
+struct sVPETCharacter {
+    // In node_list, the node the skinned surfaces hang from
+    int32_t node_id = -1;
+    std::vector<int32_t> bone_parents;
+    std::vector<std::string> bone_names;
+    // Bind pose relative to the parent bone
+    std::vector<glm::vec3> bone_positions;
+    std::vector<glm::quat> bone_rotations;
+    std::vector<glm::vec3> bone_scales;
+    std::vector<glm::mat4> inverse_bind_matrices;
+    // Parents before children, to accumulate global transforms
+    std::vector<uint32_t> bone_order;
+    // Meshes deformed by this skeleton
+    std::vector<int32_t> geo_ids;
+    Skeleton* skeleton_ref = nullptr;
+};
+
+enum class eVPETCurveInterpolation : uint8_t {
+    LINEAR, STEP
+};
+
+// One animated transform channel of a node, keys quantized to 16 bits over the time and value ranges
+struct sVPETCurve {
+    // In node_list
+    int32_t node_id = -1;
+    // As in PARAMETER_UPDATE, 0 position, 1 rotation, 2 scale
+    uint16_t parameter_id = 0;
+    eVPETCurveInterpolation interpolation = eVPETCurveInterpolation::LINEAR;
+    uint8_t component_count = 3;
+    float start_time = 0.0f;
+    float time_extent = 0.0f;
+    glm::vec4 value_min = {};
+    glm::vec4 value_extent = {};
+    std::vector<uint16_t> key_times;
+    // component_count values per key
+    std::vector<uint16_t> key_values;
+    // Largest difference to the source keys after fitting and quantization, not serialized
+    float max_error = 0.0f;
+};
+
+// glTF animation, values in the Unity coordinate system as sent in "curve"
+struct sVPETAnimation {
+    std::string name;
+    float duration = 0.0f;
+    std::vector<sVPETCurve> curves;
+    // Keys of the source channels, not serialized
+    uint32_t source_key_count = 0;
+};
+
+// Values follow Unity's TextureFormat, which is what TRACER clients expect
+enum class eVPETTextureFormat : uint32_t {
+    RGBA32 = 4,
+    DXT1 = 10,
+    DXT5 = 12,
+    ETC2_RGBA8 = 47,
+    ASTC_4x4 = 48
+};
+
+struct sVPETTextureProfile {
+    std::string name;
+    uint32_t max_size = 0; // 0 keeps the source resolution
+    bool generate_mipmaps = false;
+    eVPETTextureFormat format = eVPETTextureFormat::RGBA32;
+};
+
+struct sVPETTextureVariant {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t format = 4;
+    uint32_t mip_count = 1;
+    // All mip levels, largest first
+    std::vector<uint8_t> texture_data;
+    // Set instead of texture_data when the variant is the source texture unchanged
+    const std::vector<uint8_t>* shared_data = nullptr;
+
+    const std::vector<uint8_t>& get_texture_data() const { return shared_data ? *shared_data : texture_data; }
 };
 
 struct sVPETTexture {
@@ -71,7 +193,13 @@ struct sVPETTexture {
     uint32_t width;
     uint32_t height;
     uint32_t format;
+    // Textures received from a client own their pixels, engine textures are referenced and must outlive the context
     std::vector<uint8_t> texture_data;
+    const std::vector<uint8_t>* shared_data = nullptr;
+    // One per texture profile of the context
+    std::vector<sVPETTextureVariant> variants;
+
+    const std::vector<uint8_t>& get_texture_data() const { return shared_data ? *shared_data : texture_data; }
 };
 
 struct sVPETMaterial {
@@ -97,17 +225,68 @@ struct sVPETMaterial {
     std::vector<uint8_t> shader_properties;
 };
 
+// Meshes or textures ordered by priority from a viewpoint, split in chunks of a byte budget
+struct sVPETDeliveryPlan {
+    // Chunked request without its chunk index and plan version
+    std::string key;
+    glm::vec3 eye = {};
+    glm::vec3 direction = {};
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> chunk_starts;
+    uint64_t last_used_us = 0u;
+};
+
+// Serialized bundle part, stamped with the last bundle request that sent it
+struct sVPETBundleCacheEntry {
+    std::vector<uint8_t> data;
+    uint64_t last_used = 0u;
+};
+
 struct sVPETContext {
     std::vector<sVPETNode*> node_list;
     std::vector<sVPETMesh*> geo_list;
     std::vector<sVPETTexture*> texture_list;
     std::vector<sVPETMaterial*> material_list;
     std::vector<sVPETNode*> editables_node_list;
+    std::vector<sVPETCharacter*> character_list;
+    std::vector<sVPETAnimation*> animation_list;
+    // Scene wide controls, published by the RPC table of the engine
+    std::vector<sVPETParameterObject*> parameter_object_list;
+
+    // Over node_list, item i is node_list[i]
+    SceneBVH node_bvh;
+
+    // Keyed by plan version, clients send it back with the following chunks of a download
+    std::unordered_map<uint32_t, sVPETDeliveryPlan> delivery_plans;
+    uint32_t delivery_plan_version = 0;
+
+    // Serialized bundle parts that only change with the scene, keyed by their part request, least recently
+    // sent ones are dropped past the byte budget of scene_bundle.cpp
+    std::unordered_map<std::string, sVPETBundleCacheEntry> bundle_parts;
+    uint64_t bundle_parts_byte_size = 0u;
+    uint64_t bundle_request_count = 0u;
+
+    std::vector<sVPETTextureProfile> texture_profiles;
+    std::vector<uint32_t> texture_variants_byte_size;
+
+    uint32_t lod_count = 0;
+    // Byte size of the "objects" payload at each LOD, starting at LOD 1
+    std::vector<uint32_t> geos_lod_byte_size;
 
     uint32_t nodes_byte_size = 0;
     uint32_t geos_byte_size = 0;
     uint32_t textures_byte_size = 0;
     uint32_t materials_byte_size = 0;
+    uint32_t characters_byte_size = 0;
+    uint32_t curves_byte_size = 0;
+    uint32_t parameter_objects_byte_size = 0;
+
+    // Meshes and textures are shared with the other contexts of the process when set, see AssetPool
+    AssetPool* asset_pool = nullptr;
+
+    // Set by the SceneRegistry, sent as the sender id of the header, which clients use as the scene id of
+    // their updates
+    uint8_t scene_id = 0;
 
     ~sVPETContext() { clean(); }
 
@@ -116,28 +295,77 @@ struct sVPETContext {
             delete node;
         }
 
-        for (sVPETMesh* mesh : geo_list) {
-            delete mesh;
+        release_assets();
+
+        for (sVPETMaterial* material : material_list) {
+            delete material;
         }
 
-        for (sVPETTexture* texture : texture_list) {
-            delete texture;
+        for (sVPETCharacter* character : character_list) {
+            delete character;
         }
 
-        for (sVPETMaterial* material : material_list) {
-            delete material;
+        for (sVPETAnimation* animation : animation_list) {
+            delete animation;
         }
 
+        clean_parameter_objects();
+
         node_list.clear();
         geo_list.clear();
         texture_list.clear();
         material_list.clear();
+        editables_node_list.clear();
+        character_list.clear();
+        animation_list.clear();
+        node_bvh.clear();
+        delivery_plans.clear();
+        bundle_parts.clear();
+        bundle_parts_byte_size = 0u;
+
+        texture_variants_byte_size.clear();
+        geos_lod_byte_size.clear();
+        lod_count = 0;
 
         nodes_byte_size = 0;
         geos_byte_size = 0;
         textures_byte_size = 0;
         materials_byte_size = 0;
+        characters_byte_size = 0;
+        curves_byte_size = 0;
+    }
+
+    // Exchanges the scenes of two contexts with their request caches. Parameter objects belong to the RPC table
+    // and plan versions keep counting, so neither is exchanged
+    void swap_scene(sVPETContext& other) {
+        std::swap(node_list, other.node_list);
+        std::swap(geo_list, other.geo_list);
+        std::swap(texture_list, other.texture_list);
+        std::swap(material_list, other.material_list);
+        std::swap(editables_node_list, other.editables_node_list);
+        std::swap(character_list, other.character_list);
+        std::swap(animation_list, other.animation_list);
+        std::swap(node_bvh, other.node_bvh);
+        std::swap(delivery_plans, other.delivery_plans);
+        std::swap(bundle_parts, other.bundle_parts);
+        std::swap(bundle_parts_byte_size, other.bundle_parts_byte_size);
+        std::swap(texture_profiles, other.texture_profiles);
+        std::swap(texture_variants_byte_size, other.texture_variants_byte_size);
+        std::swap(lod_count, other.lod_count);
+        std::swap(geos_lod_byte_size, other.geos_lod_byte_size);
+        std::swap(nodes_byte_size, other.nodes_byte_size);
+        std::swap(geos_byte_size, other.geos_byte_size);
+        std::swap(textures_byte_size, other.textures_byte_size);
+        std::swap(materials_byte_size, other.materials_byte_size);
+        std::swap(characters_byte_size, other.characters_byte_size);
+        std::swap(curves_byte_size, other.curves_byte_size);
+        std::swap(asset_pool, other.asset_pool);
     }
+
+    void clean_parameter_objects();
+
+    // Deletes the meshes and textures or hands them back to the pool, defined with AssetPool
+    void release_assets();
 };
 
 // Update messages
@@ -151,6 +379,12 @@ enum class eVPETMessageType : uint8_t {
     UNDO_REDO_ADD,
     RESET_OBJECT,
     RPC,
+    // Engine extension, bone rotations of a character packed in one message
+    POSE,
+    // Engine extension, play, stop or seek of an animation served in "curve"
+    ANIMATION,
+    // Engine extension, region a client wants the edits of, see interest_management.h
+    INTEREST,
     EMPTY = 255
 };
 
@@ -170,6 +404,33 @@ enum class eVPETParameterType : uint8_t {
     UNKNOWN = 100
 };
 
+// Scene wide control, served in "parameterobjects" and called through RPC messages
+struct sVPETParameter {
+    std::string name;
+    eVPETParameterType type = eVPETParameterType::NONE;
+    bool rpc = true;
+    // As on the wire
+    std::vector<uint8_t> value;
+};
+
+struct sVPETParameterObject {
+    uint8_t scene_id = 0;
+    // One based, as the scene objects
+    uint16_t object_id = 0;
+    std::string name;
+    std::vector<sVPETParameter> parameters;
+};
+
+inline void sVPETContext::clean_parameter_objects()
+{
+    for (sVPETParameterObject* parameter_object : parameter_object_list) {
+        delete parameter_object;
+    }
+
+    parameter_object_list.clear();
+    parameter_objects_byte_size = 0;
+}
+
 //struct sVPETUpdate {
 //    uint8_t id;
 //    uint8_t param_type;
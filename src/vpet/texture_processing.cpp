@@ -0,0 +1,344 @@
+#include "texture_processing.h"
+
+#include "engine/job_system.h"
+
+#include "spdlog/spdlog.h"
+
+#include <chrono>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+
+    struct sColorBlock {
+        uint8_t pixels[16][4];
+    };
+
+    void fetch_block(const uint8_t* src, uint32_t width, uint32_t height, uint32_t block_x, uint32_t block_y, sColorBlock& block)
+    {
+        for (uint32_t y = 0u; y < 4u; ++y) {
+            // Clamp to edge for sizes that are not a multiple of 4
+            uint32_t src_y = std::min(block_y * 4u + y, height - 1u);
+
+            for (uint32_t x = 0u; x < 4u; ++x) {
+                uint32_t src_x = std::min(block_x * 4u + x, width - 1u);
+                memcpy(block.pixels[y * 4u + x], &src[(src_y * width + src_x) * 4u], 4u);
+            }
+        }
+    }
+
+    uint16_t to_rgb565(const uint8_t* color)
+    {
+        return static_cast<uint16_t>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+    }
+
+    void from_rgb565(uint16_t color, int32_t* rgb)
+    {
+        uint32_t r = (color >> 11) & 31u;
+        uint32_t g = (color >> 5) & 63u;
+        uint32_t b = color & 31u;
+
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // Bounding box endpoints inset by 1/16 of the range, always in 4 color mode
+    void encode_color_block(const sColorBlock& block, uint8_t* dst)
+    {
+        uint8_t min_color[3] = { 255, 255, 255 };
+        uint8_t max_color[3] = { 0, 0, 0 };
+
+        for (uint32_t i = 0u; i < 16u; ++i) {
+            for (uint32_t c = 0u; c < 3u; ++c) {
+                min_color[c] = std::min(min_color[c], block.pixels[i][c]);
+                max_color[c] = std::max(max_color[c], block.pixels[i][c]);
+            }
+        }
+
+        for (uint32_t c = 0u; c < 3u; ++c) {
+            uint8_t inset = (max_color[c] - min_color[c]) >> 4;
+            min_color[c] = std::min(255, min_color[c] + inset);
+            max_color[c] = std::max(0, max_color[c] - inset);
+        }
+
+        uint16_t color_0 = to_rgb565(max_color);
+        uint16_t color_1 = to_rgb565(min_color);
+
+        uint32_t indices = 0u;
+
+        if (color_0 < color_1) {
+            std::swap(color_0, color_1);
+        }
+
+        if (color_0 != color_1) {
+
+            int32_t palette[4][3];
+            from_rgb565(color_0, palette[0]);
+            from_rgb565(color_1, palette[1]);
+
+            for (uint32_t c = 0u; c < 3u; ++c) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                uint32_t best_index = 0u;
+                int32_t best_distance = INT32_MAX;
+
+                for (uint32_t p = 0u; p < 4u; ++p) {
+                    int32_t dr = block.pixels[i][0] - palette[p][0];
+                    int32_t dg = block.pixels[i][1] - palette[p][1];
+                    int32_t db = block.pixels[i][2] - palette[p][2];
+                    int32_t distance = dr * dr + dg * dg + db * db;
+
+                    if (distance < best_distance) {
+                        best_distance = distance;
+                        best_index = p;
+                    }
+                }
+
+                indices |= best_index << (i * 2u);
+            }
+        }
+
+        memcpy(&dst[0], &color_0, sizeof(uint16_t));
+        memcpy(&dst[2], &color_1, sizeof(uint16_t));
+        memcpy(&dst[4], &indices, sizeof(uint32_t));
+    }
+
+    // 8 alpha values interpolated between the block min and max
+    void encode_alpha_block(const sColorBlock& block, uint8_t* dst)
+    {
+        uint8_t alpha_0 = 0;
+        uint8_t alpha_1 = 255;
+
+        for (uint32_t i = 0u; i < 16u; ++i) {
+            alpha_0 = std::max(alpha_0, block.pixels[i][3]);
+            alpha_1 = std::min(alpha_1, block.pixels[i][3]);
+        }
+
+        uint64_t indices = 0u;
+
+        if (alpha_0 != alpha_1) {
+
+            int32_t palette[8];
+            palette[0] = alpha_0;
+            palette[1] = alpha_1;
+
+            for (int32_t p = 1; p < 7; ++p) {
+                palette[p + 1] = ((7 - p) * alpha_0 + p * alpha_1) / 7;
+            }
+
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                uint64_t best_index = 0u;
+                int32_t best_distance = INT32_MAX;
+
+                for (uint32_t p = 0u; p < 8u; ++p) {
+                    int32_t distance = std::abs(block.pixels[i][3] - palette[p]);
+
+                    if (distance < best_distance) {
+                        best_distance = distance;
+                        best_index = p;
+                    }
+                }
+
+                indices |= best_index << (i * 3u);
+            }
+        }
+
+        dst[0] = alpha_0;
+        dst[1] = alpha_1;
+
+        for (uint32_t i = 0u; i < 6u; ++i) {
+            dst[2 + i] = static_cast<uint8_t>(indices >> (i * 8u));
+        }
+    }
+
+    uint32_t get_blocks_count(uint32_t size)
+    {
+        return std::max(1u, (size + 3u) / 4u);
+    }
+
+    void append_level(const uint8_t* src, uint32_t width, uint32_t height, eVPETTextureFormat format, std::vector<uint8_t>& dst)
+    {
+        std::vector<uint8_t> level_data;
+
+        switch (format) {
+        case eVPETTextureFormat::DXT1:
+            encode_bc1(src, width, height, level_data);
+            break;
+        case eVPETTextureFormat::DXT5:
+            encode_bc3(src, width, height, level_data);
+            break;
+        default:
+            dst.insert(dst.end(), src, src + width * height * 4u);
+            return;
+        }
+
+        dst.insert(dst.end(), level_data.begin(), level_data.end());
+    }
+}
+
+void downscale_rgba8(const uint8_t* src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst, uint32_t& dst_width, uint32_t& dst_height)
+{
+    dst_width = std::max(1u, width / 2u);
+    dst_height = std::max(1u, height / 2u);
+
+    dst.resize(dst_width * dst_height * 4u);
+
+    for (uint32_t y = 0u; y < dst_height; ++y) {
+        uint32_t y0 = std::min(y * 2u, height - 1u);
+        uint32_t y1 = std::min(y * 2u + 1u, height - 1u);
+
+        for (uint32_t x = 0u; x < dst_width; ++x) {
+            uint32_t x0 = std::min(x * 2u, width - 1u);
+            uint32_t x1 = std::min(x * 2u + 1u, width - 1u);
+
+            for (uint32_t c = 0u; c < 4u; ++c) {
+                uint32_t sum = src[(y0 * width + x0) * 4u + c] + src[(y0 * width + x1) * 4u + c] +
+                               src[(y1 * width + x0) * 4u + c] + src[(y1 * width + x1) * 4u + c];
+                dst[(y * dst_width + x) * 4u + c] = static_cast<uint8_t>((sum + 2u) / 4u);
+            }
+        }
+    }
+}
+
+void encode_bc1(const uint8_t* src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst)
+{
+    uint32_t blocks_x = get_blocks_count(width);
+    uint32_t blocks_y = get_blocks_count(height);
+
+    dst.resize(blocks_x * blocks_y * 8u);
+
+    sColorBlock block;
+
+    for (uint32_t by = 0u; by < blocks_y; ++by) {
+        for (uint32_t bx = 0u; bx < blocks_x; ++bx) {
+            fetch_block(src, width, height, bx, by, block);
+            encode_color_block(block, &dst[(by * blocks_x + bx) * 8u]);
+        }
+    }
+}
+
+void encode_bc3(const uint8_t* src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst)
+{
+    uint32_t blocks_x = get_blocks_count(width);
+    uint32_t blocks_y = get_blocks_count(height);
+
+    dst.resize(blocks_x * blocks_y * 16u);
+
+    sColorBlock block;
+
+    for (uint32_t by = 0u; by < blocks_y; ++by) {
+        for (uint32_t bx = 0u; bx < blocks_x; ++bx) {
+            fetch_block(src, width, height, bx, by, block);
+
+            uint8_t* block_dst = &dst[(by * blocks_x + bx) * 16u];
+            encode_alpha_block(block, block_dst);
+            encode_color_block(block, block_dst + 8u);
+        }
+    }
+}
+
+void bake_texture_variant(const sVPETTexture& texture, const sVPETTextureProfile& profile, sVPETTextureVariant& variant)
+{
+    variant = {};
+
+    // Only RGBA8 sources can be resized or compressed, anything else is sent as is
+    const std::vector<uint8_t>& source = texture.get_texture_data();
+
+    if (source.size() != static_cast<size_t>(texture.width) * texture.height * 4u) {
+        variant.width = texture.width;
+        variant.height = texture.height;
+        variant.format = texture.format;
+        variant.shared_data = &source;
+        return;
+    }
+
+    eVPETTextureFormat format = profile.format;
+
+    if (format == eVPETTextureFormat::ETC2_RGBA8 || format == eVPETTextureFormat::ASTC_4x4) {
+        spdlog::warn("Texture profile {}: no encoder for format {}, using RGBA32", profile.name, static_cast<uint32_t>(format));
+        format = eVPETTextureFormat::RGBA32;
+    }
+
+    const uint8_t* level = source.data();
+    uint32_t width = texture.width;
+    uint32_t height = texture.height;
+
+    std::vector<uint8_t> level_data[2];
+    uint32_t current = 0u;
+
+    while (profile.max_size > 0u && std::max(width, height) > profile.max_size) {
+        downscale_rgba8(level, width, height, level_data[current], width, height);
+        level = level_data[current].data();
+        current = 1u - current;
+    }
+
+    variant.width = width;
+    variant.height = height;
+    variant.format = static_cast<uint32_t>(format);
+    variant.mip_count = 1u;
+
+    append_level(level, width, height, format, variant.texture_data);
+
+    if (!profile.generate_mipmaps) {
+        return;
+    }
+
+    while (width > 1u || height > 1u) {
+        downscale_rgba8(level, width, height, level_data[current], width, height);
+        level = level_data[current].data();
+        current = 1u - current;
+
+        append_level(level, width, height, format, variant.texture_data);
+        variant.mip_count++;
+    }
+}
+
+void bake_texture_variants(sVPETContext& vpet)
+{
+    vpet.texture_variants_byte_size.assign(vpet.texture_profiles.size(), 0u);
+
+    if (vpet.texture_profiles.empty()) {
+        return;
+    }
+
+    uint32_t texture_count = static_cast<uint32_t>(vpet.texture_list.size());
+    uint32_t profile_count = static_cast<uint32_t>(vpet.texture_profiles.size());
+
+    // Pooled textures come with their variants and may be listed twice, each texture is baked at most once
+    std::vector<sVPETTexture*> pending_textures;
+    std::unordered_set<sVPETTexture*> visited_textures;
+
+    for (sVPETTexture* texture : vpet.texture_list) {
+        if (texture->variants.size() != profile_count && visited_textures.insert(texture).second) {
+            texture->variants.resize(profile_count);
+            pending_textures.push_back(texture);
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // One job per texture and profile so a single huge texture does not serialize the rest
+    JobSystem::parallel_for(static_cast<uint32_t>(pending_textures.size()) * profile_count, [&](uint32_t job_index) {
+        sVPETTexture* texture = pending_textures[job_index / profile_count];
+        uint32_t profile_index = job_index % profile_count;
+        bake_texture_variant(*texture, vpet.texture_profiles[profile_index], texture->variants[profile_index]);
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t p = 0u; p < profile_count; ++p) {
+        for (sVPETTexture* texture : vpet.texture_list) {
+            vpet.texture_variants_byte_size[p] += 5 * sizeof(uint32_t);
+            vpet.texture_variants_byte_size[p] += texture->variants[p].get_texture_data().size();
+        }
+
+        spdlog::info("Texture profile {}: {} textures, {} bytes (source {} bytes)", vpet.texture_profiles[p].name,
+            texture_count, vpet.texture_variants_byte_size[p], vpet.textures_byte_size);
+    }
+
+    spdlog::info("Texture variants encoded in {:.2f} ms", std::chrono::duration<float, std::milli>(end - start).count());
+}
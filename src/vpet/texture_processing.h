@@ -0,0 +1,14 @@
+#pragma once
+
+#include "structs.h"
+
+// Halves an RGBA8 image with a box filter, odd sizes keep the last row/column
+void downscale_rgba8(const uint8_t* src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst, uint32_t& dst_width, uint32_t& dst_height);
+
+void encode_bc1(const uint8_t* src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst);
+void encode_bc3(const uint8_t* src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst);
+
+void bake_texture_variant(const sVPETTexture& texture, const sVPETTextureProfile& profile, sVPETTextureVariant& variant);
+
+// Encodes every texture of the context once per texture profile, textures are processed in parallel
+void bake_texture_variants(sVPETContext& vpet);
@@ -0,0 +1,118 @@
+#include "update_capture.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+    const char CAPTURE_MAGIC[4] = { 'T', 'R', 'U', 'C' };
+    const uint32_t CAPTURE_VERSION = 1u;
+}
+
+bool UpdateCaptureWriter::open(const std::string& filename)
+{
+    close();
+
+    file = fopen(filename.c_str(), "wb");
+
+    if (!file) {
+        spdlog::error("Could not open capture file {}", filename);
+        return false;
+    }
+
+    fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, file);
+    fwrite(&CAPTURE_VERSION, sizeof(uint32_t), 1, file);
+
+    start_time = std::chrono::steady_clock::now();
+    message_count = 0u;
+
+    spdlog::info("Capturing TRACER updates to {}", filename);
+
+    return true;
+}
+
+void UpdateCaptureWriter::close()
+{
+    if (!file) {
+        return;
+    }
+
+    fclose(file);
+    file = nullptr;
+
+    spdlog::info("Update capture closed, {} messages", message_count);
+}
+
+void UpdateCaptureWriter::write(const uint8_t* message, uint32_t size)
+{
+    if (!file) {
+        return;
+    }
+
+    uint64_t timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+    fwrite(&timestamp_us, sizeof(uint64_t), 1, file);
+    fwrite(&size, sizeof(uint32_t), 1, file);
+    fwrite(message, size, 1, file);
+
+    message_count++;
+}
+
+bool read_update_capture(const std::string& filename, std::vector<sCapturedMessage>& messages)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+
+    if (!file) {
+        spdlog::error("Could not open capture file {}", filename);
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0u;
+
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&version, sizeof(uint32_t), 1, file) != 1 || version != CAPTURE_VERSION) {
+        spdlog::error("{} is not an update capture", filename);
+        fclose(file);
+        return false;
+    }
+
+    std::error_code error;
+    uint64_t file_size = std::filesystem::file_size(filename, error);
+    uint64_t file_offset = sizeof(CAPTURE_MAGIC) + sizeof(uint32_t);
+
+    while (true) {
+        sCapturedMessage message;
+        uint32_t size = 0u;
+
+        if (fread(&message.timestamp_us, sizeof(uint64_t), 1, file) != 1 || fread(&size, sizeof(uint32_t), 1, file) != 1) {
+            break;
+        }
+
+        file_offset += sizeof(uint64_t) + sizeof(uint32_t);
+
+        // A capture cut short by a crash keeps its complete records, a size past the end is not allocated
+        if (error || size > file_size - std::min(file_offset, file_size)) {
+            spdlog::warn("{} ends with a truncated record", filename);
+            break;
+        }
+
+        message.data.resize(size);
+
+        if (size > 0u && fread(message.data.data(), size, 1, file) != 1) {
+            spdlog::warn("{} ends with a truncated record", filename);
+            break;
+        }
+
+        file_offset += size;
+
+        messages.push_back(std::move(message));
+    }
+
+    fclose(file);
+
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Binary log of received TRACER update messages:
+//   header: "TRUC" magic, version (u32)
+//   record: microseconds since capture start (u64), size (u32), message bytes
+
+class UpdateCaptureWriter {
+
+    FILE* file = nullptr;
+    std::chrono::steady_clock::time_point start_time;
+    uint64_t message_count = 0u;
+
+public:
+
+    ~UpdateCaptureWriter() { close(); }
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool is_open() const { return file != nullptr; }
+
+    void write(const uint8_t* message, uint32_t size);
+};
+
+struct sCapturedMessage {
+    uint64_t timestamp_us = 0u;
+    std::vector<uint8_t> data;
+};
+
+bool read_update_capture(const std::string& filename, std::vector<sCapturedMessage>& messages);
@@ -0,0 +1,174 @@
+#include "update_replay.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+#ifndef __EMSCRIPTEN__
+#include "zmq.h"
+#endif
+
+namespace {
+
+    const long SUBSCRIBER_WAIT_MS = 5000;
+
+    uint64_t get_time_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+bool UpdateReplayer::open(const std::string& capture_filename)
+{
+    messages.clear();
+
+    if (!read_update_capture(capture_filename, messages)) {
+        return false;
+    }
+
+    spdlog::info("Loaded {} captured updates from {}", messages.size(), capture_filename);
+
+    return !messages.empty();
+}
+
+void UpdateReplayer::start(void* zmq_context, const std::string& endpoint, float speed, bool measure)
+{
+    stop();
+
+    measure_latency = measure;
+
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex);
+        pending_send_times.clear();
+        latencies_us.clear();
+        last_applied_us = 0u;
+    }
+
+    running = true;
+    finished = false;
+    replay_thread = std::thread(&UpdateReplayer::run, this, zmq_context, endpoint, speed);
+}
+
+void UpdateReplayer::stop()
+{
+    running = false;
+
+    if (replay_thread.joinable()) {
+        replay_thread.join();
+    }
+}
+
+void UpdateReplayer::run(void* zmq_context, std::string endpoint, float speed)
+{
+#ifndef __EMSCRIPTEN__
+    // XPUB so the first subscription can be awaited, plain PUB would drop everything sent before it
+    void* publisher = zmq_socket(zmq_context, ZMQ_XPUB);
+
+    int high_water_mark = 0;
+    zmq_setsockopt(publisher, ZMQ_SNDHWM, &high_water_mark, sizeof(int));
+
+    if (zmq_bind(publisher, endpoint.c_str()) != 0) {
+        spdlog::error("Replay could not bind {}", endpoint);
+        zmq_close(publisher);
+        finished = true;
+        return;
+    }
+
+    zmq_pollitem_t item = { publisher, 0, ZMQ_POLLIN, 0 };
+    if (zmq_poll(&item, 1, SUBSCRIBER_WAIT_MS) > 0) {
+        char subscription[256];
+        zmq_recv(publisher, subscription, sizeof(subscription), 0);
+    }
+    else {
+        spdlog::warn("No subscriber on {}, replaying anyway", endpoint);
+    }
+
+    spdlog::info("Replaying {} updates on {} at {}", messages.size(), endpoint, speed > 0.0f ? fmt::format("{}x", speed) : "max speed");
+
+    replay_start_us = get_time_us();
+    uint64_t first_timestamp_us = messages.front().timestamp_us;
+
+    for (const sCapturedMessage& message : messages) {
+        if (!running) {
+            break;
+        }
+
+        if (speed > 0.0f) {
+            uint64_t target_us = replay_start_us + static_cast<uint64_t>((message.timestamp_us - first_timestamp_us) / speed);
+            uint64_t now_us = get_time_us();
+
+            if (target_us > now_us) {
+                std::this_thread::sleep_for(std::chrono::microseconds(target_us - now_us));
+            }
+        }
+
+        if (measure_latency) {
+            std::lock_guard<std::mutex> lock(latency_mutex);
+            pending_send_times.push_back(get_time_us());
+        }
+
+        zmq_send(publisher, message.data.data(), message.data.size(), 0);
+    }
+
+    replay_end_us = get_time_us();
+
+    // Keep the socket around a bit so queued messages still reach tcp subscribers
+    int linger_ms = 1000;
+    zmq_setsockopt(publisher, ZMQ_LINGER, &linger_ms, sizeof(int));
+    zmq_close(publisher);
+#endif
+
+    finished = true;
+}
+
+uint64_t UpdateReplayer::mark_applied()
+{
+    uint64_t now_us = get_time_us();
+
+    std::lock_guard<std::mutex> lock(latency_mutex);
+
+    if (pending_send_times.empty()) {
+        return 0u;
+    }
+
+    uint64_t latency_us = now_us - pending_send_times.front();
+    latencies_us.push_back(static_cast<uint32_t>(latency_us));
+    pending_send_times.pop_front();
+
+    last_applied_us = now_us;
+
+    return latency_us;
+}
+
+uint32_t UpdateReplayer::get_pending_count()
+{
+    std::lock_guard<std::mutex> lock(latency_mutex);
+    return pending_send_times.size();
+}
+
+void UpdateReplayer::log_summary()
+{
+    float send_seconds = (replay_end_us - replay_start_us) / 1e6f;
+
+    spdlog::info("Replay sent {} updates in {:.3f} s ({:.1f} updates/s)", messages.size(), send_seconds,
+        send_seconds > 0.0f ? messages.size() / send_seconds : 0.0f);
+
+    std::lock_guard<std::mutex> lock(latency_mutex);
+
+    if (latencies_us.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> sorted = latencies_us;
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&](float p) {
+        return sorted[std::min<size_t>(sorted.size() - 1u, static_cast<size_t>(p * sorted.size()))] / 1000.0f;
+    };
+
+    float apply_seconds = (last_applied_us - replay_start_us) / 1e6f;
+
+    spdlog::info("Replay applied {} updates in {:.3f} s ({:.1f} updates/s), latency p50 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms",
+        sorted.size(), apply_seconds, apply_seconds > 0.0f ? sorted.size() / apply_seconds : 0.0f,
+        percentile(0.5f), percentile(0.99f), sorted.back() / 1000.0f);
+}
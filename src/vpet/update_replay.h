@@ -0,0 +1,52 @@
+#pragma once
+
+#include "update_capture.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Publishes a capture on a ZMQ endpoint as the TRACER clients would, at the recorded pace times speed
+// (0 for as fast as possible). Started with measure_latency, e.g. over inproc://, the receiving side calls
+// mark_applied once per message, in order, to measure the latency from publishing to the update being applied.
+class UpdateReplayer {
+
+    std::vector<sCapturedMessage> messages;
+
+    std::thread replay_thread;
+    std::atomic<bool> running = false;
+    std::atomic<bool> finished = false;
+    // Without it nobody calls mark_applied, send times are not kept
+    bool measure_latency = false;
+
+    uint64_t replay_start_us = 0u;
+    uint64_t replay_end_us = 0u;
+
+    std::mutex latency_mutex;
+    std::deque<uint64_t> pending_send_times;
+    std::vector<uint32_t> latencies_us;
+    uint64_t last_applied_us = 0u;
+
+    void run(void* zmq_context, std::string endpoint, float speed);
+
+public:
+
+    ~UpdateReplayer() { stop(); }
+
+    bool open(const std::string& capture_filename);
+
+    uint32_t get_message_count() const { return messages.size(); }
+
+    // Waits for a subscriber before publishing the first message
+    void start(void* zmq_context, const std::string& endpoint, float speed, bool measure_latency = false);
+    void stop();
+
+    bool is_finished() const { return finished; }
+
+    // Returns the latency of the oldest message still pending, in microseconds
+    uint64_t mark_applied();
+    uint32_t get_pending_count();
+
+    void log_summary();
+};
@@ -0,0 +1,148 @@
+// Measures how long a TRACER client takes to join a running engine, the five request handshake against the
+// single "bundle" request. Latency is simulated by holding every message half a round trip in each direction,
+// bandwidth is not limited.
+//
+//   join_latency [--endpoint tcp://127.0.0.1:5555] [--latency 10,50,150] [--runs 5]
+
+#include "spdlog/spdlog.h"
+
+#include "zmq.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    const char* HANDSHAKE_REQUESTS[] = { "header", "materials", "textures", "objects", "nodes" };
+
+    // Returns the reply size, multipart replies are added up
+    uint64_t request(void* socket, const std::string& request_str, uint32_t latency_ms)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(latency_ms * 500u));
+
+        zmq_send(socket, request_str.data(), request_str.size(), 0);
+
+        uint64_t reply_size = 0u;
+        int more = 1;
+
+        while (more) {
+            zmq_msg_t message;
+            zmq_msg_init(&message);
+
+            if (zmq_msg_recv(&message, socket, 0) < 0) {
+                zmq_msg_close(&message);
+                return 0u;
+            }
+
+            reply_size += zmq_msg_size(&message);
+            more = zmq_msg_more(&message);
+
+            zmq_msg_close(&message);
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(latency_ms * 500u));
+
+        return reply_size;
+    }
+
+    // Milliseconds until the last reply arrived
+    double join(void* socket, bool bundled, uint32_t latency_ms, uint64_t& byte_size)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        byte_size = 0u;
+
+        if (bundled) {
+            byte_size = request(socket, "bundle", latency_ms);
+        }
+        else {
+            for (const char* request_str : HANDSHAKE_REQUESTS) {
+                byte_size += request(socket, request_str, latency_ms);
+            }
+        }
+
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    double get_median(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string endpoint = "tcp://127.0.0.1:5555";
+    std::vector<uint32_t> latencies = { 10u, 50u, 150u };
+    uint32_t runs = 5u;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--endpoint") == 0) {
+            endpoint = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--latency") == 0) {
+            latencies.clear();
+
+            const char* ptr = argv[i + 1];
+            while (*ptr) {
+                char* end = nullptr;
+                latencies.push_back(static_cast<uint32_t>(strtoul(ptr, &end, 10)));
+                ptr = *end == ',' ? end + 1 : end;
+            }
+        }
+        else if (strcmp(argv[i], "--runs") == 0) {
+            runs = std::max(1, atoi(argv[i + 1]));
+        }
+        else {
+            spdlog::error("Unknown option {}", argv[i]);
+            return 1;
+        }
+    }
+
+    void* context = zmq_ctx_new();
+    void* socket = zmq_socket(context, ZMQ_REQ);
+
+    int timeout_ms = 30000;
+    zmq_setsockopt(socket, ZMQ_RCVTIMEO, &timeout_ms, sizeof(int));
+
+    if (zmq_connect(socket, endpoint.c_str()) != 0) {
+        spdlog::error("Could not connect to {}", endpoint);
+        zmq_close(socket);
+        zmq_ctx_destroy(context);
+        return 1;
+    }
+
+    spdlog::info("{:>10} {:>14} {:>14} {:>12} {:>12}", "latency", "handshake ms", "bundle ms", "handshake B", "bundle B");
+
+    for (uint32_t latency_ms : latencies) {
+        std::vector<double> handshake_times;
+        std::vector<double> bundle_times;
+        uint64_t handshake_bytes = 0u;
+        uint64_t bundle_bytes = 0u;
+
+        // Alternated so both see the same engine state
+        for (uint32_t run = 0u; run < runs; ++run) {
+            handshake_times.push_back(join(socket, false, latency_ms, handshake_bytes));
+            bundle_times.push_back(join(socket, true, latency_ms, bundle_bytes));
+        }
+
+        if (handshake_bytes == 0u || bundle_bytes == 0u) {
+            spdlog::error("No reply from {}", endpoint);
+            break;
+        }
+
+        spdlog::info("{:>8}ms {:>14.1f} {:>14.1f} {:>12} {:>12}", latency_ms, get_median(handshake_times), get_median(bundle_times),
+            handshake_bytes, bundle_bytes);
+    }
+
+    zmq_close(socket);
+    zmq_ctx_destroy(context);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+// Replays a TRACER update capture on the subscriber endpoint of a running engine, as the clients would.
+// Engine side throughput and apply latency are reported by its stats (DIGITAL_LOCATIONS_STATS=log).
+//
+//   update_replay capture.bin [--endpoint tcp://127.0.0.1:5556] [--speed 1|4|max] [--loop 1]
+
+#include "vpet/update_replay.h"
+
+#include "spdlog/spdlog.h"
+
+#include "zmq.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        spdlog::error("Usage: {} capture.bin [--endpoint tcp://127.0.0.1:5556] [--speed N|max] [--loop N]", argv[0]);
+        return 1;
+    }
+
+    std::string capture_path = argv[1];
+    std::string endpoint = "tcp://127.0.0.1:5556";
+    float speed = 1.0f;
+    uint32_t loops = 1u;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--endpoint") == 0) {
+            endpoint = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--speed") == 0) {
+            speed = strcmp(argv[i + 1], "max") == 0 ? 0.0f : static_cast<float>(atof(argv[i + 1]));
+        }
+        else if (strcmp(argv[i], "--loop") == 0) {
+            loops = std::max(1, atoi(argv[i + 1]));
+        }
+        else {
+            spdlog::error("Unknown option {}", argv[i]);
+            return 1;
+        }
+    }
+
+    UpdateReplayer replayer;
+
+    if (!replayer.open(capture_path)) {
+        return 1;
+    }
+
+    void* context = zmq_ctx_new();
+
+    for (uint32_t i = 0u; i < loops; ++i) {
+        replayer.start(context, endpoint, speed);
+
+        while (!replayer.is_finished()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        replayer.stop();
+        replayer.log_summary();
+    }
+
+    zmq_ctx_destroy(context);
+
+    return 0;
+}